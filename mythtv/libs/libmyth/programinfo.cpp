@@ -19,6 +19,7 @@ using namespace std;
 #include <QFile>
 #include <QFileInfo>
 #include <QDir>
+#include <QDataStream>
 
 // MythTV headers
 #include "programinfo.h"
@@ -1266,6 +1267,174 @@ bool ProgramInfo::FromStringList(QStringList::const_iterator &it,
     return true;
 }
 
+#define STR_TO_BIN(x) \
+    do { QHash<QString,quint32>::iterator sit_ = strings.find(x);       \
+         if (sit_ == strings.end())                                     \
+             sit_ = strings.insert((x), strings.size());                \
+         out << *sit_; } while (0)
+
+#define UINT_TO_BIN(x)      do { out << (quint32)(x); } while (0)
+#define INT_TO_BIN(x)       do { out << (qint32)(x); } while (0)
+#define BYTE_TO_BIN(x)      do { out << (qint8)(x); } while (0)
+#define DATETIME_TO_BIN(x)  do { out << (quint32)(x).toTime_t(); } while (0)
+
+/** \fn ProgramInfo::ToBinary(QDataStream&, QHash<QString,quint32>&) const
+ *  \brief Serializes ProgramInfo into the compact binary encoding used by
+ *         ProgramListToBinary().
+ *
+ *   The fields are written in ToStringList() order. Strings are written
+ *   as indexes into \p strings, which collects the distinct strings of
+ *   the whole list so repeated titles, channels, categories and groups
+ *   are only sent once. Datetimes are written as time_t values.
+ *  \sa FromBinary(QDataStream&, const QStringList&)
+ */
+void ProgramInfo::ToBinary(QDataStream &out,
+                           QHash<QString,quint32> &strings) const
+{
+    STR_TO_BIN(title);
+    STR_TO_BIN(subtitle);
+    STR_TO_BIN(description);
+    STR_TO_BIN(category);
+    UINT_TO_BIN(chanid);
+    STR_TO_BIN(chanstr);
+    STR_TO_BIN(chansign);
+    STR_TO_BIN(channame);
+    STR_TO_BIN(pathname);
+    out << (quint64)filesize;
+
+    DATETIME_TO_BIN(startts);
+    DATETIME_TO_BIN(endts);
+    UINT_TO_BIN(findid);
+    STR_TO_BIN(hostname);
+    UINT_TO_BIN(sourceid);
+    UINT_TO_BIN(cardid);
+    UINT_TO_BIN(inputid);
+    INT_TO_BIN(recpriority);
+    BYTE_TO_BIN(recstatus);
+    UINT_TO_BIN(recordid);
+
+    BYTE_TO_BIN(rectype);
+    BYTE_TO_BIN(dupin);
+    BYTE_TO_BIN(dupmethod);
+    DATETIME_TO_BIN(recstartts);
+    DATETIME_TO_BIN(recendts);
+    UINT_TO_BIN(programflags);
+    STR_TO_BIN((!recgroup.isEmpty()) ? recgroup : "Default");
+    STR_TO_BIN(chanplaybackfilters);
+    STR_TO_BIN(seriesid);
+    STR_TO_BIN(programid);
+
+    DATETIME_TO_BIN(lastmodified);
+    out << stars;
+    INT_TO_BIN(originalAirDate.isValid() ? originalAirDate.toJulianDay() : 0);
+    STR_TO_BIN((!playgroup.isEmpty()) ? playgroup : "Default");
+    INT_TO_BIN(recpriority2);
+    UINT_TO_BIN(parentid);
+    STR_TO_BIN((!storagegroup.isEmpty()) ? storagegroup : "Default");
+    out << (quint16)properties;
+
+    out << (quint16)year;
+}
+
+#define STR_FROM_BIN(x) \
+    do { quint32 idx_; in >> idx_;                                      \
+         if (idx_ >= (quint32)strings.size())                           \
+         {                                                              \
+             VERBOSE(VB_IMPORTANT, LOC_ERR +                            \
+                     "FromBinary, bad string index.");                  \
+             clear();                                                   \
+             return false;                                              \
+         }                                                              \
+         (x) = strings[idx_]; } while (0)
+
+#define UINT_FROM_BIN(x)     do { quint32 v_; in >> v_; (x) = v_; } while (0)
+#define INT_FROM_BIN(x)      do { qint32 v_; in >> v_; (x) = v_; } while (0)
+#define ENUM_FROM_BIN(x, y)  do { qint8 v_; in >> v_; (x) = (y)v_; } while (0)
+#define DATETIME_FROM_BIN(x) \
+    do { quint32 v_; in >> v_; (x).setTime_t(v_); } while (0)
+
+/** \fn ProgramInfo::FromBinary(QDataStream&, const QStringList&)
+ *  \brief Initializes this ProgramInfo from the binary encoding written
+ *         by ToBinary().
+ *  \param in      Stream positioned at the start of the record
+ *  \param strings String table of the list this record belongs to
+ *  \return true if it succeeds, false if it fails.
+ */
+bool ProgramInfo::FromBinary(QDataStream &in, const QStringList &strings)
+{
+    uint      origChanid     = chanid;
+    QDateTime origRecstartts = recstartts;
+
+    STR_FROM_BIN(title);
+    STR_FROM_BIN(subtitle);
+    STR_FROM_BIN(description);
+    STR_FROM_BIN(category);
+    UINT_FROM_BIN(chanid);
+    STR_FROM_BIN(chanstr);
+    STR_FROM_BIN(chansign);
+    STR_FROM_BIN(channame);
+    STR_FROM_BIN(pathname);
+    quint64 size;
+    in >> size;
+    filesize = size;
+
+    DATETIME_FROM_BIN(startts);
+    DATETIME_FROM_BIN(endts);
+    UINT_FROM_BIN(findid);
+    STR_FROM_BIN(hostname);
+    UINT_FROM_BIN(sourceid);
+    UINT_FROM_BIN(cardid);
+    UINT_FROM_BIN(inputid);
+    INT_FROM_BIN(recpriority);
+    ENUM_FROM_BIN(recstatus, RecStatusType);
+    UINT_FROM_BIN(recordid);
+
+    ENUM_FROM_BIN(rectype, RecordingType);
+    ENUM_FROM_BIN(dupin, RecordingDupInType);
+    ENUM_FROM_BIN(dupmethod, RecordingDupMethodType);
+    DATETIME_FROM_BIN(recstartts);
+    DATETIME_FROM_BIN(recendts);
+    UINT_FROM_BIN(programflags);
+    STR_FROM_BIN(recgroup);
+    STR_FROM_BIN(chanplaybackfilters);
+    STR_FROM_BIN(seriesid);
+    STR_FROM_BIN(programid);
+
+    DATETIME_FROM_BIN(lastmodified);
+    in >> stars;
+    qint32 airdate;
+    in >> airdate;
+    originalAirDate = (airdate) ? QDate::fromJulianDay(airdate) : QDate();
+    STR_FROM_BIN(playgroup);
+    INT_FROM_BIN(recpriority2);
+    UINT_FROM_BIN(parentid);
+    STR_FROM_BIN(storagegroup);
+    quint16 props, yr;
+    in >> props >> yr;
+    properties = props;
+    year       = yr;
+
+    if (in.status() != QDataStream::Ok)
+    {
+        VERBOSE(VB_IMPORTANT, LOC_ERR + "FromBinary, record is truncated.");
+        clear();
+        return false;
+    }
+
+    if (!origChanid || !origRecstartts.isValid() ||
+        (origChanid != chanid) || (origRecstartts != recstartts))
+    {
+        availableStatus = asAvailable;
+        spread = -1;
+        startCol = -1;
+        sortTitle = QString();
+        inUseForWhat = QString();
+        positionMapDBReplacement = NULL;
+    }
+
+    return true;
+}
+
 /** \brief Converts ProgramInfo into QString QHash containing each field
  *         in ProgramInfo converted into localized strings.
  */
@@ -3116,24 +3285,23 @@ void ProgramInfo::SavePositionMap(
     if (!query.exec())
         MythDB::DBError("position map clear", query);
 
+    QVariantList key;
+    QStringList columns;
     if (IsVideo())
     {
-        query.prepare(
-            "INSERT INTO "
-            "filemarkup (filename, mark, type, offset) "
-            "VALUES ( :PATH , :MARK , :TYPE , :OFFSET )");
-        query.bindValue(":PATH", videoPath);
+        key << videoPath;
+        columns << "filename";
     }
     else // if (IsRecording())
     {
-        query.prepare(
-            "INSERT INTO "
-            "recordedseek (chanid, starttime, mark, type, offset) "
-            " VALUES ( :CHANID , :STARTTIME , :MARK , :TYPE , :OFFSET )");
-        query.bindValue(":CHANID",    chanid);
-        query.bindValue(":STARTTIME", recstartts);
+        key << chanid << recstartts;
+        columns << "chanid" << "starttime";
     }
-    query.bindValue(":TYPE", type);
+    key << type;
+    columns << "type" << "mark" << "offset";
+
+    MSqlBulkInsert bulk(query, IsVideo() ? "INSERT INTO filemarkup" :
+                        "INSERT INTO recordedseek", columns);
 
     frm_pos_map_t::iterator it;
     for (it = posMap.begin(); it != posMap.end(); ++it)
@@ -3148,14 +3316,9 @@ void ProgramInfo::SavePositionMap(
 
         uint64_t offset = *it;
 
-        query.bindValue(":MARK",   (quint64)frame);
-        query.bindValue(":OFFSET", (quint64)offset);
-
-        if (!query.exec())
-        {
-            MythDB::DBError("position map insert", query);
+        if (!bulk.AddRow(QVariantList(key) << (quint64)frame
+                         << (quint64)offset))
             break;
-        }
     }
 }
 
@@ -3174,30 +3337,28 @@ void ProgramInfo::SavePositionMapDelta(
         return;
     }
 
-    MSqlQuery query(MSqlQuery::InitCon());
-
+    QVariantList key;
+    QStringList columns;
     if (IsVideo())
     {
-        query.prepare(
-            "INSERT INTO "
-            "filemarkup (filename, mark, type, offset) "
-            "VALUES ( :PATH , :MARK , :TYPE , :OFFSET )");
-        query.bindValue(":PATH", StorageGroup::GetRelativePathname(pathname));
+        key << StorageGroup::GetRelativePathname(pathname);
+        columns << "filename";
     }
     else if (IsRecording())
     {
-        query.prepare(
-            "INSERT INTO "
-            "recordedseek (chanid, starttime, mark, type, offset) "
-            " VALUES ( :CHANID , :STARTTIME , :MARK , :TYPE , :OFFSET )");
-        query.bindValue(":CHANID",    chanid);
-        query.bindValue(":STARTTIME", recstartts);
+        key << chanid << recstartts;
+        columns << "chanid" << "starttime";
     }
     else
     {
         return;
     }
-    query.bindValue(":TYPE", type);
+    key << type;
+    columns << "type" << "mark" << "offset";
+
+    MSqlQuery query(MSqlQuery::InitCon());
+    MSqlBulkInsert bulk(query, IsVideo() ? "INSERT INTO filemarkup" :
+                        "INSERT INTO recordedseek", columns);
 
     frm_pos_map_t::iterator it;
     for (it = posMap.begin(); it != posMap.end(); ++it)
@@ -3205,14 +3366,9 @@ void ProgramInfo::SavePositionMapDelta(
         uint64_t frame  = it.key();
         uint64_t offset = *it;
 
-        query.bindValue(":MARK",   (quint64)frame);
-        query.bindValue(":OFFSET", (quint64)offset);
-
-        if (!query.exec())
-        {
-            MythDB::DBError("delta position map insert", query);
+        if (!bulk.AddRow(QVariantList(key) << (quint64)frame
+                         << (quint64)offset))
             break;
-        }
     }
 }
 
@@ -4318,6 +4474,110 @@ bool LoadFromRecorded(
     return true;
 }
 
+/// Identifies a ProgramListToBinary() payload, "MPL" and format version 1
+static const quint32 kBinaryListMagic = 0x4d504c01;
+
+/** \fn ProgramListToBinary(const ProgramList&)
+ *  \brief Encodes a list of programs in the compact binary form sent in
+ *         reply to "QUERY_RECORDINGS <type>" requests carrying "BINARY".
+ *
+ *   The payload holds a magic/version word, the number of programs, the
+ *   string table shared by all the records and then the records written
+ *   by ProgramInfo::ToBinary(). It is base64 encoded so it can travel as
+ *   a single element of an ordinary string list.
+ */
+QString ProgramListToBinary(const ProgramList &list)
+{
+    QTime timer;
+    timer.start();
+
+    QHash<QString,quint32> strings;
+    QByteArray records;
+    QDataStream rout(&records, QIODevice::WriteOnly);
+    rout.setVersion(QDataStream::Qt_4_0);
+
+    ProgramList::const_iterator it = list.begin();
+    for (; it != list.end(); ++it)
+        (*it)->ToBinary(rout, strings);
+
+    QStringList table;
+    for (int i = 0; i < strings.size(); i++)
+        table << QString();
+    QHash<QString,quint32>::const_iterator sit = strings.begin();
+    for (; sit != strings.end(); ++sit)
+        table[*sit] = sit.key();
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_4_0);
+    out << kBinaryListMagic << (quint32)list.size() << table << records;
+
+    QString encoded = QString::fromAscii(payload.toBase64());
+
+    VERBOSE(VB_NETWORK, QString("ProgramListToBinary: %1 programs, "
+                                "%2 strings, %3 bytes in %4 ms")
+            .arg(list.size()).arg(table.size()).arg(encoded.size())
+            .arg(timer.elapsed()));
+
+    return encoded;
+}
+
+/** \fn ProgramListFromBinary(const QString&, std::vector<ProgramInfo*>&)
+ *  \brief Decodes a ProgramListToBinary() payload, appending the programs
+ *         to \p destination.
+ *  \return number of programs appended, or -1 if the payload is invalid
+ */
+int ProgramListFromBinary(const QString                &payload,
+                          std::vector<ProgramInfo*>    &destination)
+{
+    QTime timer;
+    timer.start();
+
+    QByteArray data = QByteArray::fromBase64(payload.toAscii());
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_4_0);
+
+    quint32 magic, count;
+    QStringList table;
+    QByteArray records;
+    in >> magic >> count >> table >> records;
+
+    if (in.status() != QDataStream::Ok || magic != kBinaryListMagic)
+    {
+        VERBOSE(VB_IMPORTANT, "ProgramListFromBinary: Invalid payload.");
+        return -1;
+    }
+
+    QDataStream rin(records);
+    rin.setVersion(QDataStream::Qt_4_0);
+
+    std::vector<ProgramInfo*> decoded;
+    for (quint32 i = 0; i < count; i++)
+    {
+        ProgramInfo *pginfo = new ProgramInfo();
+        if (!pginfo->FromBinary(rin, table))
+        {
+            delete pginfo;
+            while (!decoded.empty())
+            {
+                delete decoded.back();
+                decoded.pop_back();
+            }
+            return -1;
+        }
+        decoded.push_back(pginfo);
+    }
+
+    destination.insert(destination.end(), decoded.begin(), decoded.end());
+
+    VERBOSE(VB_NETWORK, QString("ProgramListFromBinary: %1 programs, "
+                                "%2 strings, %3 bytes in %4 ms")
+            .arg(count).arg(table.size()).arg(payload.size())
+            .arg(timer.elapsed()));
+
+    return count;
+}
+
 QString SkipTypeToString(int flags)
 {
     if (COMM_DETECT_COMMFREE == flags)
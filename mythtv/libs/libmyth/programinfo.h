@@ -6,6 +6,9 @@
 // ANSI C
 #include <stdint.h> // for [u]int[32,64]_t
 
+// C++ headers
+#include <vector>
+
 #include <QStringList>
 #include <QDateTime>
 #include <QHash>
@@ -60,6 +63,7 @@ typedef AutoDeleteDeque<ProgramInfo*> ProgramList;
  *
  */
 
+class QDataStream;
 class MSqlQuery;
 class ProgramInfoUpdater;
 class PMapDBReplacement;
@@ -256,6 +260,7 @@ class MPUBLIC ProgramInfo
 
     // Serializers
     void ToStringList(QStringList &list) const;
+    void ToBinary(QDataStream &out, QHash<QString,quint32> &strings) const;
     virtual void ToMap(QHash<QString, QString> &progMap,
                        bool showrerecord = false,
                        uint star_range = 10) const;
@@ -588,6 +593,7 @@ class MPUBLIC ProgramInfo
 
     bool FromStringList(QStringList::const_iterator &it,
                         QStringList::const_iterator  end);
+    bool FromBinary(QDataStream &in, const QStringList &strings);
 
     static void QueryMarkupMap(
         const QString &video_pathname,
@@ -698,6 +704,12 @@ MPUBLIC bool LoadFromRecorded(
     const QMap<QString,bool> &isJobRunning,
     const QMap<QString, ProgramInfo*> &recMap);
 
+MPUBLIC QString ProgramListToBinary(const ProgramList &list);
+
+MPUBLIC int ProgramListFromBinary(
+    const QString                &payload,
+    std::vector<ProgramInfo*>    &destination);
+
 template<typename TYPE>
 bool LoadFromScheduler(
     AutoDeleteDeque<TYPE*> &destination,
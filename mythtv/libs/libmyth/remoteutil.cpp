@@ -12,6 +12,20 @@
 #include "mythevent.h"
 
 vector<ProgramInfo *> *RemoteGetRecordedList(bool deltype)
+{
+    uint instance, generation;
+    return RemoteGetRecordedList(deltype, instance, generation);
+}
+
+/** \fn RemoteGetRecordedList(bool, uint&, uint&)
+ *  \brief Returns the recordings list, along with the instance and
+ *         generation to pass to RemoteGetRecordingChanges() later.
+ *
+ *   The instance and generation are 0 when the backend does not keep
+ *   a recording list change log.
+ */
+vector<ProgramInfo *> *RemoteGetRecordedList(
+    bool deltype, uint &instance, uint &generation)
 {
     QString str = "QUERY_RECORDINGS ";
     if (deltype)
@@ -20,18 +34,87 @@ vector<ProgramInfo *> *RemoteGetRecordedList(bool deltype)
         str += "Play";
 
     QStringList strlist(str);
+    strlist << "BINARY";
 
     vector<ProgramInfo *> *info = new vector<ProgramInfo *>;
 
+    instance = generation = 0;
+
     if (!RemoteGetRecordingList(*info, strlist))
     {
         delete info;
         return NULL;
     }
+
+    if (strlist.size() >= 5 && strlist[0] == "BINARY")
+    {
+        instance   = strlist[3].toUInt();
+        generation = strlist[4].toUInt();
+    }
  
     return info;
 }
 
+/** \fn RemoteGetRecordingChanges(uint&, uint&, vector<ProgramInfo*>&,
+                                  QStringList&)
+ *  \brief Fetches the recordings which changed since a list was loaded
+ *         by RemoteGetRecordedList(bool, uint&, uint&).
+ *  \param instance   instance of the loaded list, updated on success
+ *  \param generation generation of the loaded list, updated on success
+ *  \param updated    receives the added and updated recordings
+ *  \param deleted    receives ProgramInfo::MakeUniqueKey() keys of the
+ *                    deleted recordings
+ *  \return false if the whole list must be reloaded instead
+ */
+bool RemoteGetRecordingChanges(
+    uint &instance, uint &generation,
+    vector<ProgramInfo *> &updated, QStringList &deleted)
+{
+    QStringList strlist(QString("QUERY_RECORDING_CHANGES %1 %2")
+                        .arg(instance).arg(generation));
+
+    if (!gCoreContext->SendReceiveStringList(strlist) || strlist.empty())
+        return false;
+
+    if (strlist[0] == "UNKNOWN_COMMAND")
+    {
+        // A backend which predates the command, forget the list's
+        // generation so the caller stops asking.
+        VERBOSE(VB_GENERAL, "RemoteGetRecordingChanges(): Backend does "
+                "not support QUERY_RECORDING_CHANGES, loading full lists.");
+        instance = generation = 0;
+        return false;
+    }
+
+    if (strlist.size() < 5 || strlist[0] != "CHANGES")
+        return false;
+
+    int numdeleted = strlist[3].toInt();
+    if (numdeleted < 0 || 5 + numdeleted > strlist.size())
+        return false;
+
+    QStringList::const_iterator it = strlist.begin() + 4;
+    for (int i = 0; i < numdeleted; i++)
+        deleted << *it++;
+
+    int numupdated = (*it++).toInt();
+    if (numupdated < 0 ||
+        numupdated * NUMPROGRAMLINES > (int)(strlist.end() - it))
+    {
+        VERBOSE(VB_IMPORTANT, "RemoteGetRecordingChanges() "
+                "list size appears to be incorrect.");
+        return false;
+    }
+
+    for (int i = 0; i < numupdated; i++)
+        updated.push_back(new ProgramInfo(it, strlist.end()));
+
+    instance   = strlist[1].toUInt();
+    generation = strlist[2].toUInt();
+
+    return true;
+}
+
 /** \fn RemoteGetFreeSpace(void)
  *  \brief Returns total and used space in kilobytes for each backend.
  */
@@ -199,6 +282,19 @@ uint RemoteGetRecordingList(
     if (!gCoreContext->SendReceiveStringList(strList))
         return 0;
 
+    if (strList[0] == "BINARY")
+    {
+        if (strList.size() < 3)
+        {
+            VERBOSE(VB_IMPORTANT, "RemoteGetRecordingList() "
+                    "binary reply is incomplete.");
+            return 0;
+        }
+
+        int decoded = ProgramListFromBinary(strList[2], reclist);
+        return (decoded > 0) ? decoded : 0;
+    }
+
     int numrecordings = strList[0].toInt();
     if (numrecordings <= 0)
         return 0;
@@ -594,6 +690,7 @@ vector<ProgramInfo *> *RemoteGetCurrentlyRecordingList(void)
     QString str = "QUERY_RECORDINGS ";
     str += "Recording";
     QStringList strlist( str );
+    strlist << "BINARY";
 
     vector<ProgramInfo *> *reclist = new vector<ProgramInfo *>;
     vector<ProgramInfo *> *info = new vector<ProgramInfo *>;
@@ -31,6 +31,11 @@ class MPUBLIC FileSystemInfo
 };
 
 MPUBLIC vector<ProgramInfo *> *RemoteGetRecordedList(bool deltype);
+MPUBLIC vector<ProgramInfo *> *RemoteGetRecordedList(
+    bool deltype, uint &instance, uint &generation);
+MPUBLIC bool RemoteGetRecordingChanges(
+    uint &instance, uint &generation,
+    vector<ProgramInfo *> &updated, QStringList &deleted);
 MPUBLIC vector<FileSystemInfo> RemoteGetFreeSpace(void);
 MPUBLIC bool RemoteGetLoad(float load[3]);
 MPUBLIC bool RemoteGetUptime(time_t &uptime);
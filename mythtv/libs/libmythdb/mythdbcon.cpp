@@ -8,6 +8,8 @@
 #include <QSqlError>
 #include <QSqlField>
 #include <QSqlRecord>
+#include <QThread>
+#include <QAtomicInt>
 
 // MythTV
 #include "compat.h"
@@ -16,8 +18,16 @@
 #include "mythverbose.h"
 
 static const uint kPurgeTimeout = 60 * 60;
+/// Number of prepare() calls between statement cache statistics messages
+static const uint kPrepareStatsInterval = 1000;
 
-MSqlDatabase::MSqlDatabase(const QString &name)
+const int MSqlDatabase::kMaxPreparedQueries = 64;
+
+static QAtomicInt prepare_count;
+static QAtomicInt prepare_hits;
+static QAtomicInt exec_count;
+
+MSqlDatabase::MSqlDatabase(const QString &name) : m_lastThread(NULL)
 {
     m_name = name;
     m_db = QSqlDatabase::addDatabase("QMYSQL3", name);
@@ -33,6 +43,8 @@ MSqlDatabase::MSqlDatabase(const QString &name)
 
 MSqlDatabase::~MSqlDatabase()
 {
+    ClearPreparedQueries();
+
     if (m_db.isOpen())
     {
         m_db.close();
@@ -193,6 +205,7 @@ bool MSqlDatabase::KickDatabase()
 
         if (i == 0)
         {
+            ClearPreparedQueries();
             m_db.close();
             m_db.open();
         }
@@ -207,6 +220,7 @@ bool MSqlDatabase::KickDatabase()
 
 bool MSqlDatabase::Reconnect()
 {
+    ClearPreparedQueries();
     m_db.close();
     m_db.open();
 
@@ -217,6 +231,87 @@ bool MSqlDatabase::Reconnect()
     return open;
 }
 
+/** \brief Hands out the statement prepared for \p sql on this connection,
+ *         if there is one which no other MSqlQuery is using.
+ */
+bool MSqlDatabase::TakePreparedQuery(const QString &sql, QSqlQuery &query)
+{
+    QMutexLocker locker(&m_preparedLock);
+
+    QHash<QString, PreparedQuery>::iterator it = m_prepared.find(sql);
+    if (it == m_prepared.end() || (*it).inUse)
+        return false;
+
+    (*it).inUse = true;
+    query = (*it).query;
+
+    m_preparedLRU.removeOne(sql);
+    m_preparedLRU.prepend(sql);
+
+    return true;
+}
+
+/** \brief Keeps a statement just prepared for \p sql, in use by the
+ *         caller, evicting the least recently used idle statement once
+ *         kMaxPreparedQueries are kept.
+ *  \return true if the statement was added
+ */
+bool MSqlDatabase::AddPreparedQuery(const QString &sql, const QSqlQuery &query)
+{
+    QMutexLocker locker(&m_preparedLock);
+
+    if (m_prepared.contains(sql))
+        return false;
+
+    for (int i = m_preparedLRU.size() - 1;
+         i >= 0 && m_prepared.size() >= kMaxPreparedQueries; i--)
+    {
+        if (m_prepared[m_preparedLRU[i]].inUse)
+            continue;
+        m_prepared.remove(m_preparedLRU[i]);
+        m_preparedLRU.removeAt(i);
+    }
+
+    if (m_prepared.size() >= kMaxPreparedQueries)
+        return false;
+
+    PreparedQuery &entry = m_prepared[sql];
+    entry.query = query;
+    entry.inUse = true;
+    m_preparedLRU.prepend(sql);
+
+    return true;
+}
+
+/** \brief Marks the statement for \p sql as no longer used, or forgets it
+ *         if \p keep is false.
+ */
+void MSqlDatabase::ReturnPreparedQuery(const QString &sql, bool keep)
+{
+    QMutexLocker locker(&m_preparedLock);
+
+    QHash<QString, PreparedQuery>::iterator it = m_prepared.find(sql);
+    if (it == m_prepared.end())
+        return;
+
+    if (keep)
+    {
+        (*it).inUse = false;
+        return;
+    }
+
+    m_prepared.erase(it);
+    m_preparedLRU.removeOne(sql);
+}
+
+/// \brief Forgets all prepared statements, they do not survive a reconnect.
+void MSqlDatabase::ClearPreparedQueries(void)
+{
+    QMutexLocker locker(&m_preparedLock);
+    m_prepared.clear();
+    m_preparedLRU.clear();
+}
+
 // -----------------------------------------------------------------------
 
 
@@ -250,6 +345,7 @@ MSqlDatabase *MDBManager::popConnection()
     m_lock.lock();
 
     MSqlDatabase *db;
+    QThread *thread = QThread::currentThread();
 
     if (m_pool.isEmpty())
     {
@@ -259,7 +355,22 @@ MSqlDatabase *MDBManager::popConnection()
                 QString("New DB connection, total: %1").arg(m_connCount));
     }
     else
-        db = m_pool.takeLast();
+    {
+        // Prefer the connection this thread used last, since it holds the
+        // statements this thread prepares, then the most recently used
+        // one so the others can go idle and be purged.
+        int idx = 0;
+        for (int i = 0; i < m_pool.size(); i++)
+        {
+            if (m_pool[i]->m_lastThread == thread)
+            {
+                idx = i;
+                break;
+            }
+        }
+        db = m_pool.takeAt(idx);
+    }
+    db->m_lastThread = thread;
 
     m_lock.unlock();
 
@@ -386,6 +497,7 @@ void MDBManager::CloseDatabases()
         db = *it;
         VERBOSE(VB_IMPORTANT,
                 "Closing DB connection named '" + db->m_name + '\'');
+        db->ClearPreparedQueries();
         db->m_db.close();
         ++it;
     }
@@ -420,6 +532,8 @@ MSqlQuery::MSqlQuery(const MSqlQueryInfo &qi)
 
 MSqlQuery::~MSqlQuery()
 {
+    ReturnPreparedQuery();
+
     if (m_returnConnection)
     {
         MDBManager *dbmanager = GetMythDB()->GetDBManager();
@@ -501,6 +615,22 @@ MSqlQueryInfo MSqlQuery::DDCon()
     return qi;
 }
 
+/** \brief Gives a statement taken from the connection's cache back,
+ *         leaving this query with a fresh result of its own.
+ *  \param keep false if the statement failed and must be prepared again
+ */
+void MSqlQuery::ReturnPreparedQuery(bool keep)
+{
+    if (m_prepared_key.isEmpty())
+        return;
+
+    finish();
+    QSqlQuery::operator=(QSqlQuery(QString::null, m_db->db()));
+
+    m_db->ReturnPreparedQuery(m_prepared_key, keep);
+    m_prepared_key.clear();
+}
+
 bool MSqlQuery::exec()
 {
     // Database connection down.  Try to restart it, give up if it's still
@@ -511,6 +641,8 @@ bool MSqlQuery::exec()
         return false;
     }
 
+    exec_count.fetchAndAddRelaxed(1);
+
     bool result = QSqlQuery::exec();
 
     // if the query failed with "MySQL server has gone away"
@@ -519,6 +651,13 @@ bool MSqlQuery::exec()
     if (!result && QSqlQuery::lastError().number() == 2006 && m_db->Reconnect())
         result = QSqlQuery::exec();
 
+    // A cached statement which failed may no longer be valid on the server
+    if (!result && !m_prepared_key.isEmpty())
+    {
+        m_db->ReturnPreparedQuery(m_prepared_key, false);
+        m_prepared_key.clear();
+    }
+
     if (VERBOSE_LEVEL_CHECK(VB_DATABASE))
     {
         QString str = lastQuery();
@@ -555,6 +694,9 @@ bool MSqlQuery::exec(const QString &query)
         return false;
     }
 
+    ReturnPreparedQuery();
+    exec_count.fetchAndAddRelaxed(1);
+
     bool result = QSqlQuery::exec(query);
 
     // if the query failed with "MySQL server has gone away"
@@ -599,7 +741,7 @@ bool MSqlQuery::next()
     return result;
 }
 
-bool MSqlQuery::prepare(const QString& query)
+bool MSqlQuery::prepare(const QString& query, bool cache)
 {
     m_last_prepared_query = query;
 #ifdef DEBUG_QT4_PORT
@@ -620,6 +762,42 @@ bool MSqlQuery::prepare(const QString& query)
         return false;
     }
 
+    // Returning a cached statement replaces the QSqlQuery, keep the
+    // forward only mode the caller asked for.
+    bool forwardOnly = isForwardOnly();
+    ReturnPreparedQuery();
+
+    // The counters wrap, read them as unsigned and use 64 bit math
+    uint prepares = (uint)(prepare_count.fetchAndAddRelaxed(1) + 1);
+    if (prepares % kPrepareStatsInterval == 0)
+    {
+        uint hits = (uint)(int)prepare_hits;
+        uint percent = (prepares) ? (uint)((quint64)hits * 100 / prepares) : 0;
+        VERBOSE(VB_DATABASE,
+                QString("MSqlQuery: %1 prepares, %2 statement cache hits "
+                        "(%3%), %4 execs")
+                .arg(prepares).arg(hits).arg(percent)
+                .arg((uint)(int)exec_count));
+    }
+
+    // Reuse the statement already prepared for this text on this
+    // connection when no other query is using it. The values bound by
+    // its last user are cleared, as they would be for a new statement.
+    QSqlQuery cached;
+    if (cache && m_db->TakePreparedQuery(query, cached))
+    {
+        QSqlQuery::operator=(cached);
+        m_prepared_key = query;
+        finish();
+        setForwardOnly(forwardOnly);
+        int bound = boundValues().size();
+        for (int i = 0; i < bound; i++)
+            QSqlQuery::bindValue(i, QVariant());
+        prepare_hits.fetchAndAddRelaxed(1);
+        return true;
+    }
+
+    setForwardOnly(forwardOnly);
     bool ok = QSqlQuery::prepare(query);
 
     // if the prepare failed with "MySQL server has gone away"
@@ -628,6 +806,9 @@ bool MSqlQuery::prepare(const QString& query)
     if (!ok && QSqlQuery::lastError().number() == 2006 && m_db->Reconnect())
         ok = QSqlQuery::prepare(query);
 
+    if (ok && cache && m_db->AddPreparedQuery(query, *this))
+        m_prepared_key = query;
+
     if (!ok && !(GetMythDB()->SuppressDBMessages()))
     {
         VERBOSE(VB_IMPORTANT, QString("Error preparing query: %1").arg(query));
@@ -755,3 +936,139 @@ void MSqlEscapeAsAQuery(QString &query, MSqlBindings &bindings)
     }
 }
 
+
+/// Largest number of rows sent by one MSqlBulkInsert statement
+const uint MSqlBulkInsert::kMaxRows = 1000;
+/// MySQL does not accept more placeholders in one prepared statement
+static const uint kMaxPlaceholders = 65535;
+/// max_allowed_packet of MySQL servers which do not report it
+static const uint kDefaultMaxPacket = 1024 * 1024;
+
+MSqlBulkInsert::MSqlBulkInsert(MSqlQuery &query, const QString &insert,
+                               const QStringList &columns) :
+    m_query(query),
+    m_insert(insert + " (" + columns.join(", ") + ") VALUES "),
+    m_columns(columns.size()),
+    m_maxRows(kMaxRows), m_maxBytes(GetMaxPacket() / 2),
+    m_rows(0), m_bytes(0), m_written(0), m_ok(true)
+{
+    QStringList holders;
+    for (uint i = 0; i < m_columns; i++)
+        holders << "?";
+    m_rowHolder = "(" + holders.join(",") + ")";
+
+    if (m_columns && m_maxRows * m_columns > kMaxPlaceholders)
+        m_maxRows = kMaxPlaceholders / m_columns;
+}
+
+MSqlBulkInsert::~MSqlBulkInsert()
+{
+    Flush();
+}
+
+/** \fn MSqlBulkInsert::GetMaxPacket(void)
+ *  \brief Returns the server's max_allowed_packet, which is only
+ *         queried once.
+ */
+uint MSqlBulkInsert::GetMaxPacket(void)
+{
+    static QMutex lock;
+    static uint max_packet = 0;
+
+    lock.lock();
+    uint known = max_packet;
+    lock.unlock();
+
+    if (known)
+        return known;
+
+    // Query without the lock held, a few threads may ask at once the
+    // first time but none waits on another's database round trip.
+    uint value = 0;
+    MSqlQuery query(MSqlQuery::InitCon());
+    if (query.exec("SELECT @@max_allowed_packet") && query.next())
+        value = query.value(0).toUInt();
+
+    if (!value)
+        return kDefaultMaxPacket;
+
+    QMutexLocker locker(&lock);
+    max_packet = value;
+    return max_packet;
+}
+
+/** \fn MSqlBulkInsert::AddRow(const QVariantList&)
+ *  \brief Queues a row, writing the pending rows first when the row
+ *         would not fit in the current statement.
+ *  \return false if writing the pending rows failed
+ */
+bool MSqlBulkInsert::AddRow(const QVariantList &row)
+{
+    if ((uint)row.size() != m_columns)
+    {
+        VERBOSE(VB_IMPORTANT, QString("MSqlBulkInsert: row has %1 values "
+                                      "for %2 columns")
+                .arg(row.size()).arg(m_columns));
+        return false;
+    }
+
+    uint bytes = 0;
+    QVariantList::const_iterator it = row.begin();
+    for (; it != row.end(); ++it)
+    {
+        // escaped UTF-8 text can take up to twice as many bytes
+        if ((*it).type() == QVariant::String)
+            bytes += (*it).toString().length() * 2 + 4;
+        else
+            bytes += 24;
+    }
+
+    bool ok = true;
+    if (m_rows && (m_rows >= m_maxRows || m_bytes + bytes > m_maxBytes))
+        ok = Flush();
+
+    m_values += row;
+    m_bytes  += bytes;
+    m_rows++;
+
+    return ok;
+}
+
+/** \fn MSqlBulkInsert::Flush(void)
+ *  \brief Writes the pending rows.
+ *  \return false if this or any earlier write failed
+ */
+bool MSqlBulkInsert::Flush(void)
+{
+    if (!m_rows)
+        return m_ok;
+
+    QString sql = m_insert;
+    sql.reserve(m_insert.length() + m_rows * (m_rowHolder.length() + 1));
+    for (uint i = 0; i < m_rows; i++)
+    {
+        if (i)
+            sql += ',';
+        sql += m_rowHolder;
+    }
+
+    bool ok = m_query.prepare(sql, m_rows == m_maxRows);
+    if (ok)
+    {
+        for (int i = 0; i < m_values.size(); i++)
+            m_query.bindValue(i, m_values[i]);
+        ok = m_query.exec();
+    }
+
+    if (ok)
+        m_written += m_rows;
+    else
+        MythDB::DBError("MSqlBulkInsert", m_query);
+
+    m_values.clear();
+    m_rows  = 0;
+    m_bytes = 0;
+    m_ok   &= ok;
+
+    return m_ok;
+}
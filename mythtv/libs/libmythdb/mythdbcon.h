@@ -8,10 +8,13 @@
 #include <QDateTime>
 #include <QMutex>
 #include <QList>
+#include <QHash>
+#include <QStringList>
 
 #include "mythexp.h"
 
 class QSemaphore;
+class QThread;
 
 /// \brief QSqlDatabase wrapper, used by MSqlQuery. Do not use directly.
 class MPUBLIC MSqlDatabase
@@ -30,10 +33,31 @@ class MPUBLIC MSqlDatabase
     QSqlDatabase db(void) const { return m_db; }
     bool Reconnect(void);
 
+    bool TakePreparedQuery(const QString &sql, QSqlQuery &query);
+    bool AddPreparedQuery(const QString &sql, const QSqlQuery &query);
+    void ReturnPreparedQuery(const QString &sql, bool keep);
+    void ClearPreparedQueries(void);
+
   private:
+    /// A statement prepared on this connection, see MSqlQuery::prepare()
+    class PreparedQuery
+    {
+      public:
+        PreparedQuery() : inUse(false) {}
+        QSqlQuery query;
+        bool      inUse;
+    };
+
     QString m_name;
     QSqlDatabase m_db;
     QDateTime m_lastDBKick;
+    QThread *m_lastThread;   ///< thread which last used this connection
+
+    QMutex                        m_preparedLock;
+    QHash<QString, PreparedQuery> m_prepared;
+    QList<QString>                m_preparedLRU;  ///< most recent first
+
+    static const int kMaxPreparedQueries;
 };
 
 /// \brief DB connection pool, used by MSqlQuery. Do not use directly.
@@ -122,7 +146,9 @@ class MPUBLIC MSqlQuery : public QSqlQuery
     bool exec(const QString &query);
 
     /// \brief QSqlQuery::prepare() is not thread safe in Qt <= 3.3.2
-    bool prepare(const QString &query);
+    /// \param cache false for statement text that is rarely repeated, so
+    ///              it does not evict the connection's common statements
+    bool prepare(const QString &query, bool cache = true);
 
     /// \brief Wrap QSqlQuery::bindValue so we can convert null QStrings to empty QStrings
     void bindValue ( const QString & placeholder, const QVariant & val, QSql::ParamType paramType = QSql::In );
@@ -155,13 +181,63 @@ class MPUBLIC MSqlQuery : public QSqlQuery
     static MSqlQueryInfo DDCon();
 
   private:
+    void ReturnPreparedQuery(bool keep = true);
+
     MSqlDatabase *m_db;
     bool m_isConnected;
     bool m_returnConnection;
     QString m_last_prepared_query; // holds a copy of the last prepared query
+    QString m_prepared_key; // cached statement in use, empty if none
 #ifdef DEBUG_QT4_PORT
     QRegExp m_testbindings;
 #endif
 };
 
+/** \brief Writes rows to a table with multi-row INSERT statements.
+ *
+ *   Rows are collected by AddRow() and sent in chunks of up to kMaxRows
+ *   rows, fewer when the values would not fit in the server's
+ *   max_allowed_packet. Full chunks share one statement text, so they
+ *   reuse the statement prepared for the first one. Shorter chunks are
+ *   prepared outside the statement cache, as each row count is a new
+ *   statement text. Pending rows are written by Flush() and by the
+ *   destructor. e.g.
+ *
+ *   MSqlBulkInsert bulk(query, "REPLACE INTO credits",
+ *                       QStringList() << "person" << "chanid"
+ *                                     << "starttime" << "role");
+ *   bulk.AddRow(QVariantList() << personid << chanid << starttime << role);
+ */
+class MPUBLIC MSqlBulkInsert
+{
+  public:
+    /// \param insert  statement up to the column list, e.g. "INSERT INTO t"
+    MSqlBulkInsert(MSqlQuery &query, const QString &insert,
+                   const QStringList &columns);
+    ~MSqlBulkInsert();
+
+    bool AddRow(const QVariantList &row);
+    bool Flush(void);
+
+    /// \brief Number of rows written so far
+    uint GetRowCount(void) const { return m_written; }
+
+  private:
+    static uint GetMaxPacket(void);
+
+    MSqlQuery    &m_query;
+    QString       m_insert;     ///< statement text before the VALUES rows
+    QString       m_rowHolder;  ///< "(?,?,...)" for a single row
+    uint          m_columns;
+    uint          m_maxRows;
+    uint          m_maxBytes;
+    QVariantList  m_values;     ///< values of the pending rows
+    uint          m_rows;
+    uint          m_bytes;      ///< approximate size of the pending values
+    uint          m_written;
+    bool          m_ok;
+
+    static const uint kMaxRows;
+};
+
 #endif
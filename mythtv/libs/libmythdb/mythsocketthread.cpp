@@ -1,5 +1,6 @@
 // ANSI C
 #include <cstdlib>
+#include <cstring>
 
 // C++
 #include <algorithm> // for min/max
@@ -19,6 +20,11 @@
 #define O_NONBLOCK 0 /* not actually supported in MINGW */
 #endif
 
+#if defined(linux) && !defined(USING_MINGW)
+#define USE_EPOLL
+#include <sys/epoll.h>  // for epoll_create, epoll_ctl, epoll_wait
+#endif
+
 // Qt
 #include <QTime>
 
@@ -31,11 +37,13 @@
     .arg((quint64)a, 0, 16).arg(a->socket())
 
 static void setup_pipe(int mypipe[2], long flags[2]);
+static int setup_epoll(int pipefd);
 
 const uint MythSocketThread::kShortWait = 100;
+const int  MythSocketThread::kMaxEpollEvents = 64;
 
 MythSocketThread::MythSocketThread()
-    : QThread(), m_readyread_run(false)
+    : QThread(), m_readyread_run(false), m_epoll_fd(-1)
 {
     for (int i = 0; i < 2; i++)
     {
@@ -61,6 +69,12 @@ void MythSocketThread::ShutdownReadyReadThread(void)
     wait(); // waits for thread to exit
 
     CloseReadyReadPipe();
+
+    if (m_epoll_fd >= 0)
+    {
+        ::close(m_epoll_fd);
+        m_epoll_fd = -1;
+    }
 }
 
 void MythSocketThread::CloseReadyReadPipe(void) const
@@ -83,6 +97,7 @@ void MythSocketThread::StartReadyReadThread(void)
     {
         atexit(ShutdownRRT);
         setup_pipe(m_readyread_pipe, m_readyread_pipe_flags);
+        m_epoll_fd = setup_epoll(m_readyread_pipe[0]);
         m_readyread_run = true;
         start();
         m_readyread_started_wait.wait(&m_readyread_lock);
@@ -174,7 +189,11 @@ void MythSocketThread::ProcessAddRemoveQueues(void)
         m_readyread_dellist.pop_front();
 
         if (m_readyread_list.removeAll(sock))
+        {
             m_readyread_downref_list.push_back(sock);
+            if (m_epoll_fd >= 0)
+                EpollRemove(sock);
+        }
     }
 
     while (!m_readyread_addlist.empty())
@@ -182,15 +201,48 @@ void MythSocketThread::ProcessAddRemoveQueues(void)
         MythSocket *sock = m_readyread_addlist.front();
         m_readyread_addlist.pop_front();
         m_readyread_list.push_back(sock);
+        if (m_epoll_fd >= 0)
+            EpollAdd(sock);
     }
 }
 
+/** \fn MythSocketThread::DownRefStaleSockets(void)
+ *  \brief Releases the sockets removed by ProcessAddRemoveQueues().
+ *
+ *   Must be called without m_readyread_lock held, since DownRef()
+ *   may delete the socket.
+ *  \return time spent in milliseconds
+ */
+uint MythSocketThread::DownRefStaleSockets(void)
+{
+    if (m_readyread_downref_list.empty())
+        return 0;
+
+    VERBOSE(VB_SOCKET|VB_EXTRA, "Deleting stale sockets");
+
+    QTime tm = QTime::currentTime();
+    QList<MythSocket*>::const_iterator it = m_readyread_downref_list.begin();
+    for (; it != m_readyread_downref_list.end(); ++it)
+        (*it)->DownRef();
+    m_readyread_downref_list.clear();
+
+    return tm.elapsed();
+}
+
 void MythSocketThread::run(void)
 {
     VERBOSE(VB_SOCKET, "MythSocketThread: readyread thread start");
 
     QMutexLocker locker(&m_readyread_lock);
     m_readyread_started_wait.wakeAll();
+
+    if (m_epoll_fd >= 0)
+    {
+        RunEpoll();
+        VERBOSE(VB_SOCKET, "MythSocketThread: readyread thread exit");
+        return;
+    }
+
     while (m_readyread_run)
     {
         VERBOSE(VB_SOCKET|VB_EXTRA, "ProcessAddRemoveQueues");
@@ -316,20 +368,7 @@ void MythSocketThread::run(void)
         // Actually read some data! This is a form of co-operative
         // multitasking so the ready read handlers should be quick..
 
-        uint downref_tm = 0;
-        if (!m_readyread_downref_list.empty())
-        {
-            VERBOSE(VB_SOCKET|VB_EXTRA, "Deleting stale sockets");
-
-            QTime tm = QTime::currentTime();
-            for (it = m_readyread_downref_list.begin();
-                 it != m_readyread_downref_list.end(); ++it)
-            {
-                (*it)->DownRef();
-            }
-            m_readyread_downref_list.clear();
-            downref_tm = tm.elapsed();
-        }
+        uint downref_tm = DownRefStaleSockets();
 
         VERBOSE(VB_SOCKET|VB_EXTRA, "Processing ready reads");
 
@@ -375,6 +414,258 @@ void MythSocketThread::run(void)
     VERBOSE(VB_SOCKET, "MythSocketThread: readyread thread exit");
 }
 
+/** \fn MythSocketThread::EpollAdd(MythSocket*)
+ *  \brief Queues a newly added socket for registration with epoll.
+ *
+ *   The socket is armed by EpollRearm() once it is connected, unlocked
+ *   and has no readyRead() notification outstanding, mirroring the
+ *   conditions the select() loop uses to build its FD_SET.
+ */
+void MythSocketThread::EpollAdd(MythSocket *sock)
+{
+    m_epoll_fds[sock] = -1;
+    m_epoll_disarmed.push_back(sock);
+}
+
+/** \fn MythSocketThread::EpollRemove(MythSocket*)
+ *  \brief Drops a socket's epoll registration.
+ *
+ *   A closed descriptor has already left the epoll set, and its number
+ *   may since have been reused by another socket, so the descriptor is
+ *   only deregistered while it still belongs to this socket.
+ */
+void MythSocketThread::EpollRemove(MythSocket *sock)
+{
+#ifdef USE_EPOLL
+    int regfd = m_epoll_fds.value(sock, -1);
+    if (regfd >= 0 && m_epoll_socks.value(regfd) == sock)
+    {
+        if (sock->socket() == regfd)
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, regfd, NULL);
+        m_epoll_socks.remove(regfd);
+    }
+#endif
+
+    m_epoll_fds.remove(sock);
+    m_epoll_disarmed.removeAll(sock);
+}
+
+/** \fn MythSocketThread::EpollRearm(void)
+ *  \brief Re-arms the one-shot registration of sockets which are ready
+ *         to be watched again.
+ *
+ *   Only sockets that have fired since the last pass are visited, so the
+ *   cost of each loop iteration is proportional to the number of active
+ *   sockets rather than to the number of connected ones.
+ */
+void MythSocketThread::EpollRearm(void)
+{
+#ifdef USE_EPOLL
+    QList<MythSocket*>::iterator it = m_epoll_disarmed.begin();
+    while (it != m_epoll_disarmed.end())
+    {
+        MythSocket *sock = *it;
+        if (!sock->TryLock(false))
+        {
+            ++it;
+            continue;
+        }
+
+        int fd = sock->socket();
+        if (fd < 0 || sock->state() != MythSocket::Connected ||
+            sock->m_notifyread)
+        {
+            sock->Unlock(false);
+            ++it;
+            continue;
+        }
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = sock;
+
+        int regfd = m_epoll_fds.value(sock, -1);
+        int ret;
+        if (regfd == fd && m_epoll_socks.value(fd) == sock)
+        {
+            ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        else
+        {
+            // the socket was reconnected on a new descriptor
+            if (regfd >= 0 && m_epoll_socks.value(regfd) == sock)
+                m_epoll_socks.remove(regfd);
+
+            ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+            if (ret < 0 && EEXIST == errno)
+                ret = epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        sock->Unlock(false);
+
+        if (ret < 0)
+        {
+            VERBOSE(VB_SOCKET, SLOC(sock) + "failed to arm epoll" + ENO);
+            ++it;
+            continue;
+        }
+
+        m_epoll_fds[sock] = fd;
+        m_epoll_socks[fd] = sock;
+        it = m_epoll_disarmed.erase(it);
+    }
+#endif
+}
+
+/** \fn MythSocketThread::RunEpoll(void)
+ *  \brief epoll() based variant of the readyread loop.
+ *
+ *   Sockets are registered level-triggered with EPOLLONESHOT rather than
+ *   edge-triggered: a readyRead() handler usually consumes a single
+ *   message, so any remaining data must be reported again once the
+ *   handler has finished, just as the select() loop does.
+ *
+ *   Must be called with m_readyread_lock held; returns with it held.
+ */
+void MythSocketThread::RunEpoll(void)
+{
+#ifdef USE_EPOLL
+    struct epoll_event events[kMaxEpollEvents];
+
+    while (m_readyread_run)
+    {
+        VERBOSE(VB_SOCKET|VB_EXTRA, "ProcessAddRemoveQueues");
+
+        ProcessAddRemoveQueues();
+        EpollRearm();
+
+        // If the pipe was closed by WakeReadyReadThread() poll for wakeups
+        int timeout = (m_readyread_pipe[0] >= 0) ? -1 : (int) kShortWait;
+
+        m_readyread_lock.unlock();
+        VERBOSE(VB_SOCKET|VB_EXTRA, "Waiting on epoll..");
+        int rval = epoll_wait(m_epoll_fd, events, kMaxEpollEvents, timeout);
+        VERBOSE(VB_SOCKET|VB_EXTRA, "Got data on epoll");
+        m_readyread_lock.lock();
+
+        if (rval < 0)
+        {
+            if (EINTR != errno)
+            {
+                VERBOSE(VB_SOCKET,
+                        "MythSocketThread: epoll_wait returned error" + ENO);
+                m_readyread_wait.wait(&m_readyread_lock, kShortWait);
+            }
+            continue;
+        }
+
+        QList<MythSocket*> ready;
+        for (int i = 0; i < rval; i++)
+        {
+            MythSocket *sock = (MythSocket*) events[i].data.ptr;
+            if (!sock)
+            {
+                char dummy[128];
+                if (m_readyread_pipe[0] >= 0 &&
+                    ::read(m_readyread_pipe[0], dummy, 128) < 0)
+                {
+                    VERBOSE(VB_SOCKET|VB_EXTRA,
+                            "Strange.. failed to read event pipe");
+                }
+                continue;
+            }
+
+            // ignore events for sockets removed since the wait began
+            if (!m_epoll_fds.contains(sock))
+                continue;
+
+            m_epoll_disarmed.push_back(sock);
+            ready.push_back(sock);
+        }
+
+        // ReadyToBeRead allows calls back into the socket so we need
+        // to release the lock for a little while. Sockets in the ready
+        // list hold a reference until the next ProcessAddRemoveQueues().
+        m_readyread_lock.unlock();
+
+        uint downref_tm = DownRefStaleSockets();
+
+        VERBOSE(VB_SOCKET|VB_EXTRA, "Processing ready reads");
+
+        QMap<uint,uint> timers;
+        QTime tm = QTime::currentTime();
+        QList<MythSocket*>::const_iterator it = ready.begin();
+        for (; it != ready.end() && m_readyread_run; ++it)
+        {
+            // a locked socket stays disarmed and is retried by EpollRearm()
+            if (!(*it)->TryLock(false))
+                continue;
+
+            int socket = (*it)->socket();
+            if (socket >= 0 && (*it)->state() == MythSocket::Connected)
+            {
+                QTime rrtm = QTime::currentTime();
+                ReadyToBeRead(*it);
+                timers[socket] = rrtm.elapsed();
+            }
+            (*it)->Unlock(false);
+        }
+
+        if (VERBOSE_LEVEL_CHECK(VB_SOCKET|VB_EXTRA))
+        {
+            QString rep = QString("Total read time: %1ms, on sockets")
+                .arg(tm.elapsed());
+            QMap<uint,uint>::const_iterator it = timers.begin();
+            for (; it != timers.end(); ++it)
+                rep += QString(" {%1,%2ms}").arg(it.key()).arg(*it);
+            if (downref_tm)
+                rep += QString(" {downref, %1ms}").arg(downref_tm);
+
+            VERBOSE(VB_SOCKET|VB_EXTRA, QString("MythSocketThread: ") + rep);
+        }
+
+        m_readyread_lock.lock();
+        VERBOSE(VB_SOCKET|VB_EXTRA, "Reacquired ready read lock");
+    }
+#endif
+}
+
+/** \brief Creates the epoll instance used by the readyread thread.
+ *  \return epoll descriptor, or -1 if the select() loop must be used
+ */
+static int setup_epoll(int pipefd)
+{
+#ifdef USE_EPOLL
+    if (pipefd < 0)
+        return -1;
+
+    int epfd = epoll_create(256);
+    if (epfd < 0)
+    {
+        VERBOSE(VB_IMPORTANT, "Failed to create epoll instance, "
+                "falling back to select()" + ENO);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, pipefd, &ev) < 0)
+    {
+        VERBOSE(VB_IMPORTANT, "Failed to watch readyread pipe with epoll, "
+                "falling back to select()" + ENO);
+        ::close(epfd);
+        return -1;
+    }
+
+    return epfd;
+#else
+    (void) pipefd;
+    return -1;
+#endif
+}
+
 #ifdef USING_MINGW
 static void setup_pipe(int[2], long[2]) {}
 #else
@@ -5,6 +5,7 @@
 #include <QThread>
 #include <QMutex>
 #include <QList>
+#include <QHash>
 
 class MythSocket;
 class MythSocketThread : public QThread
@@ -25,6 +26,12 @@ class MythSocketThread : public QThread
     void ProcessAddRemoveQueues(void);
     void ReadyToBeRead(MythSocket *sock);
     void CloseReadyReadPipe(void) const;
+    uint DownRefStaleSockets(void);
+
+    void RunEpoll(void);
+    void EpollAdd(MythSocket *sock);
+    void EpollRemove(MythSocket *sock);
+    void EpollRearm(void);
 
     bool                   m_readyread_run;
     mutable QMutex         m_readyread_lock;
@@ -39,7 +46,17 @@ class MythSocketThread : public QThread
     QList<MythSocket*> m_readyread_addlist;
     QList<MythSocket*> m_readyread_downref_list;
 
+    /// epoll instance, or -1 when the select() loop is used
+    int                    m_epoll_fd;
+    /// descriptor each socket is currently registered under, -1 if none
+    QHash<MythSocket*,int> m_epoll_fds;
+    /// socket owning each registered descriptor
+    QHash<int,MythSocket*> m_epoll_socks;
+    /// sockets whose one-shot registration has fired or is not yet armed
+    QList<MythSocket*>     m_epoll_disarmed;
+
     static const uint kShortWait;
+    static const int  kMaxEpollEvents;
 };
 
 #endif // _MYTH_SOCKET_THREAD_H_
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 using namespace std;
 
@@ -12,6 +13,8 @@ using namespace std;
 #include "compat.h"
 #include "mythtimer.h"
 
+const int RemoteFile::kMaxPipelineDepth = 8;
+
 RemoteFile::RemoteFile(const QString &_path, bool write, bool useRA,
                        int _timeout_ms,
                        const QStringList *possibleAuxiliaryFiles) :
@@ -22,7 +25,8 @@ RemoteFile::RemoteFile(const QString &_path, bool write, bool useRA,
     lock(QMutex::NonRecursive),
     controlSock(NULL),    sock(NULL),
     query("QUERY_FILETRANSFER %1"),
-    writemode(write)
+    writemode(write),
+    pipelinedepth(1),     sequential(false)
 {
     if (writemode)
     {
@@ -196,10 +200,22 @@ void RemoteFile::Close(void)
     strlist << "DONE";
 
     lock.lock();
-    controlSock->writeStringList(strlist);
-    if (!controlSock->readStringList(strlist, true))
+    if (pending.empty())
     {
-        VERBOSE(VB_IMPORTANT, "Remote file timeout.");
+        controlSock->writeStringList(strlist);
+        if (!controlSock->readStringList(strlist, true))
+        {
+            VERBOSE(VB_IMPORTANT, "Remote file timeout.");
+        }
+    }
+    else
+    {
+        // Rather than reading the blocks still in flight just to throw
+        // them away, drop the connection, the backend cleans up the
+        // file transfer when its socket closes.
+        VERBOSE(VB_NETWORK, QString("RemoteFile: Closing with %1 block "
+                "requests in flight").arg(pending.size()));
+        pending.clear();
     }
 
     if (sock)
@@ -370,6 +386,24 @@ long long RemoteFile::Seek(long long pos, int whence, long long curpos)
     if (!controlSock->isOpen() || controlSock->error())
         return 0;
 
+    // Reads keep readposition current, so a seek to where we already are
+    // can leave the blocks in flight alone.
+    long long from = (curpos > 0) ? curpos : readposition;
+    if (!pending.empty() &&
+        ((whence == SEEK_SET && pos == readposition) ||
+         (whence == SEEK_CUR && from + pos == readposition)))
+    {
+        long long retval = readposition;
+        lock.unlock();
+        return retval;
+    }
+
+    if (!drainPipeline() && !reconnect())
+    {
+        lock.unlock();
+        return -1;
+    }
+
     QStringList strlist( QString(query).arg(recordernum) );
     strlist << "SEEK";
     encodeLongLong(strlist, pos);
@@ -381,10 +415,11 @@ long long RemoteFile::Seek(long long pos, int whence, long long curpos)
 
     controlSock->writeStringList(strlist);
     controlSock->readStringList(strlist);
-    lock.unlock();
 
     long long retval = decodeLongLong(strlist, 0);
     readposition = retval;
+    sequential = false;
+    lock.unlock();
 
     Reset();
 
@@ -496,6 +531,9 @@ int RemoteFile::Read(void *data, int size)
     if (!controlSock->isOpen() || controlSock->error())
         return -1;
 
+    if (pipelinedepth > 1)
+        return readPipelined(data, size);
+
     if (sock->bytesAvailable() > 0)
     {
         VERBOSE(VB_NETWORK,
@@ -578,10 +616,271 @@ int RemoteFile::Read(void *data, int size)
 
     if (error || sent != recv)
         recv = -1;
+    else
+        readposition += recv;
 
     return recv;
 }
 
+/** \fn RemoteFile::readPipelined(void*, int)
+ *  \brief Reads from the file while keeping up to pipelinedepth
+ *         REQUEST_BLOCKs in flight, so the backend is already sending
+ *         the next block while we consume this one instead of each
+ *         read paying a full round trip.
+ *
+ *   The blocks arrive back to back on the data socket and the replies
+ *   with their lengths arrive in the same order on the control socket.
+ *   A reply shorter than the request means we reached the end of the
+ *   file for now, and no new request is sent until the next call.
+ *
+ *   WARNING: Must be called with lock held.
+ */
+int RemoteFile::readPipelined(void *data, int size)
+{
+    int recv = 0;
+    bool error = false;
+    bool ateof = false;
+
+    // The first read after a seek may be a one off, e.g. RingBuffer's
+    // prefetch, so only ask for what it needs until reads are sequential.
+    int depth = (sequential) ? pipelinedepth : 1;
+
+    while (pending.size() < depth && !error)
+        error = !sendBlockRequest(size);
+
+    int waitms = 10;
+    MythTimer mtimer;
+    mtimer.start();
+
+    while (recv < size && !pending.empty() && !error &&
+           mtimer.elapsed() < 10000)
+    {
+        PendingBlock &blk = pending.front();
+        int limit = (blk.replied) ? blk.total : blk.requested;
+        int want  = min(size - recv, limit - blk.received);
+
+        if (want > 0 && sock->waitForMore(waitms) > 0)
+        {
+            int ret = sock->readBlock(((char *)data) + recv, want);
+            if (ret > 0)
+            {
+                recv += ret;
+                blk.received += ret;
+            }
+            else if (sock->error() != MythSocket::NoError)
+            {
+                VERBOSE(VB_IMPORTANT, "RemoteFile::Read(): socket error");
+                error = true;
+                break;
+            }
+        }
+        else if (want <= 0 && !blk.replied)
+        {
+            controlSock->waitForMore(waitms);
+        }
+
+        if (waitms < 200)
+            waitms += 20;
+
+        if (!blk.replied && controlSock->bytesAvailable() > 0)
+        {
+            QStringList strlist;
+            if (!controlSock->readStringList(strlist, true) || strlist.empty())
+            {
+                VERBOSE(VB_IMPORTANT,
+                        "RemoteFile::Read(): No response from control socket.");
+                error = true;
+                break;
+            }
+            blk.total = strlist[0].toInt(); // -1 on backend error
+            blk.replied = true;
+            error = (blk.total < 0);
+        }
+
+        if (blk.replied && blk.received >= blk.total)
+        {
+            ateof = (blk.total < blk.requested);
+            pending.pop_front();
+
+            if (ateof)
+                break;
+
+            if (pending.size() < depth && (sequential || recv < size))
+                error |= !sendBlockRequest(size);
+        }
+    }
+
+    VERBOSE(VB_NETWORK, QString("Read(): reqd=%1, rcvd=%2, in flight=%3, "
+                                "error=%4")
+            .arg(size).arg(recv).arg(pending.size()).arg(error));
+
+    if (error)
+    {
+        pending.clear();
+        return -1;
+    }
+
+    if (!recv && !ateof)
+    {
+        VERBOSE(VB_IMPORTANT, "RemoteFile::Read(): timed out waiting "
+                "for pipelined data");
+        return -1;
+    }
+
+    readposition += recv;
+    sequential = true;
+
+    return recv;
+}
+
+/** \fn RemoteFile::sendBlockRequest(int)
+ *  \brief Sends a REQUEST_BLOCK without waiting for the reply.
+ *
+ *   WARNING: Must be called with lock held.
+ */
+bool RemoteFile::sendBlockRequest(int size)
+{
+    QStringList strlist( QString(query).arg(recordernum) );
+    strlist << "REQUEST_BLOCK";
+    strlist << QString::number(size);
+
+    if (!controlSock->writeStringList(strlist))
+        return false;
+
+    PendingBlock blk = { size, 0, 0, false };
+    pending.push_back(blk);
+
+    return true;
+}
+
+/** \fn RemoteFile::drainPipeline(void)
+ *  \brief Reads and discards the data and replies of all REQUEST_BLOCKs
+ *         still in flight, so the control socket can be used for other
+ *         commands and the backend's file position is known again.
+ *
+ *   WARNING: Must be called with lock held.
+ *
+ *  \return false if the sockets could not be brought back in step, in
+ *          which case the connection must be reopened with reconnect()
+ */
+bool RemoteFile::drainPipeline(void)
+{
+    if (pending.empty())
+        return true;
+
+    QByteArray trash(65536, 0);
+    int discarded = 0;
+
+    MythTimer mtimer;
+    mtimer.start();
+
+    while (!pending.empty() && mtimer.elapsed() < 10000)
+    {
+        PendingBlock &blk = pending.front();
+        int limit = (blk.replied) ? blk.total : blk.requested;
+        int want  = min(limit - blk.received, trash.size());
+
+        if (want > 0 && sock->waitForMore(10) > 0)
+        {
+            int ret = sock->readBlock(trash.data(), want);
+            if (ret > 0)
+            {
+                blk.received += ret;
+                discarded += ret;
+            }
+            else if (sock->error() != MythSocket::NoError)
+                break;
+        }
+        else if (want <= 0 && !blk.replied)
+        {
+            controlSock->waitForMore(10);
+        }
+
+        if (!blk.replied && controlSock->bytesAvailable() > 0)
+        {
+            QStringList strlist;
+            if (!controlSock->readStringList(strlist, true) || strlist.empty())
+                break;
+            blk.total = strlist[0].toInt();
+            blk.replied = true;
+        }
+
+        if (blk.replied && blk.received >= blk.total)
+            pending.pop_front();
+    }
+
+    if (!pending.empty())
+    {
+        VERBOSE(VB_IMPORTANT, QString("RemoteFile: Gave up on %1 block "
+                "requests in flight.").arg(pending.size()));
+        return false;
+    }
+
+    VERBOSE(VB_NETWORK, QString("RemoteFile: Discarded %1 bytes read ahead")
+            .arg(discarded));
+
+    return true;
+}
+
+/** \fn RemoteFile::reconnect(void)
+ *  \brief Replaces both sockets with a new file transfer at readposition,
+ *         for when replies or data of the old one may still be unread.
+ *
+ *   Reads fall back to stop-and-wait, since a backend that did not answer
+ *   the pipelined requests in time is unlikely to do better next time.
+ *   If the file can not be reopened the sockets are left closed, so
+ *   isOpen() returns false and further reads fail.
+ *
+ *   WARNING: Must be called with lock held.
+ */
+bool RemoteFile::reconnect(void)
+{
+    VERBOSE(VB_IMPORTANT, QString("RemoteFile: Reopening %1").arg(path));
+
+    pending.clear();
+    pipelinedepth = 1;
+    sequential = false;
+    auxfiles.clear();
+
+    if (sock)
+        sock->DownRef();
+    if (controlSock)
+        controlSock->DownRef();
+    sock = NULL;
+
+    controlSock = openSocket(true);
+    if (controlSock)
+        sock = openSocket(false);
+
+    if (!sock)
+    {
+        VERBOSE(VB_IMPORTANT, QString("RemoteFile: Failed to reopen %1")
+                .arg(path));
+        if (controlSock)
+            controlSock->DownRef();
+        controlSock = NULL;
+        return false;
+    }
+
+    QStringList strlist( QString(query).arg(recordernum) );
+    strlist << "SEEK";
+    encodeLongLong(strlist, readposition);
+    strlist << QString::number(SEEK_SET);
+    encodeLongLong(strlist, 0);
+    controlSock->writeStringList(strlist);
+    controlSock->readStringList(strlist, true);
+
+    if (timeoutisfast)
+    {
+        strlist = QStringList( QString(query).arg(recordernum) );
+        strlist << "SET_TIMEOUT" << "1";
+        controlSock->writeStringList(strlist);
+        controlSock->readStringList(strlist);
+    }
+
+    return true;
+}
+
 bool RemoteFile::SaveAs(QByteArray &data)
 {
     if (filesize < 0)
@@ -616,11 +915,66 @@ void RemoteFile::SetTimeout(bool fast)
     strlist << QString::number((int)fast);
 
     controlSock->writeStringList(strlist);
-    controlSock->readStringList(strlist);
+    if (pending.empty())
+    {
+        controlSock->readStringList(strlist);
+    }
+    else
+    {
+        // The backend handles the commands in order, so the reply comes
+        // after those of the blocks in flight. Queue it as an empty block
+        // instead of draining them, readPipelined() will consume it.
+        PendingBlock reply = { 0, 0, 0, false };
+        pending.push_back(reply);
+    }
 
     timeoutisfast = fast;
 }
 
+/** \fn RemoteFile::SetPipelineDepth(int)
+ *  \brief Asks the backend to let up to depth REQUEST_BLOCKs be in
+ *         flight at once on this file transfer.
+ *
+ *   Backends which predate pipelining reply "ok" to the unknown
+ *   SET_PIPELINE command, in which case reads stay stop-and-wait.
+ *
+ *  \return depth in use, 1 when pipelining is not available
+ */
+int RemoteFile::SetPipelineDepth(int depth)
+{
+    QMutexLocker locker(&lock);
+    if (!sock || writemode)
+        return pipelinedepth;
+
+    if (!sock->isOpen() || sock->error())
+        return pipelinedepth;
+
+    if (!controlSock->isOpen() || controlSock->error())
+        return pipelinedepth;
+
+    if (!drainPipeline() && !reconnect())
+        return pipelinedepth;
+
+    depth = max(1, min(depth, kMaxPipelineDepth));
+
+    QStringList strlist( QString(query).arg(recordernum) );
+    strlist << "SET_PIPELINE";
+    strlist << QString::number(depth);
+
+    controlSock->writeStringList(strlist);
+    if (!controlSock->readStringList(strlist, true) || strlist.empty())
+        return pipelinedepth;
+
+    bool ok = false;
+    int accepted = strlist[0].toInt(&ok);
+    pipelinedepth = (ok && accepted > 0) ? min(accepted, depth) : 1;
+
+    VERBOSE(VB_NETWORK, QString("RemoteFile::SetPipelineDepth(%1) -> %2")
+            .arg(depth).arg(pipelinedepth));
+
+    return pipelinedepth;
+}
+
 QDateTime RemoteFile::LastModified(const QString &url)
 {
     QDateTime result;
@@ -6,6 +6,7 @@
 #include <QDateTime>
 #include <QStringList>
 #include <QMutex>
+#include <QList>
 
 #include "mythexp.h"
 
@@ -40,6 +41,7 @@ class MPUBLIC RemoteFile
 
     void SetURL(const QString &url) { path = url; }
     void SetTimeout(bool fast);
+    int  SetPipelineDepth(int depth);
 
     bool isOpen(void) const
         { return sock && controlSock; }
@@ -54,8 +56,22 @@ class MPUBLIC RemoteFile
     QStringList GetAuxiliaryFiles(void) const
         { return auxfiles; }
 
+    static const int kMaxPipelineDepth;
+
   private:
     MythSocket     *openSocket(bool control);
+    bool            sendBlockRequest(int size);
+    int             readPipelined(void *data, int size);
+    bool            drainPipeline(void);
+    bool            reconnect(void);
+
+    typedef struct
+    {
+        int  requested; ///< bytes asked for in the REQUEST_BLOCK
+        int  received;  ///< bytes read from the data socket so far
+        int  total;     ///< bytes the backend says it sent
+        bool replied;   ///< true once total is known
+    } PendingBlock;
 
     QString         path;
     bool            usereadahead;
@@ -74,6 +90,10 @@ class MPUBLIC RemoteFile
 
     QStringList     possibleauxfiles;
     QStringList     auxfiles;
+
+    int                 pipelinedepth; ///< REQUEST_BLOCKs kept in flight
+    QList<PendingBlock> pending;       ///< in flight, oldest first
+    bool                sequential;    ///< false until a read after a seek
 };
 
 #endif
@@ -61,6 +61,12 @@ const int  RingBuffer::kLiveTVOpenTimeout  = 10000;
 /* should be minimum of the above test sizes */
 const uint RingBuffer::kReadTestSize = PNG_MIN_SIZE;
 
+/* largest read made ahead of time at a predicted seek target */
+const uint RingBuffer::kPrefetchSize = RingBuffer::kBufferSize / 4;
+
+/* block requests kept in flight to the backend for remote files */
+const int  RingBuffer::kRemotePipelineDepth = 4;
+
 QMutex      RingBuffer::subExtLock;
 QStringList RingBuffer::subExt;
 QStringList RingBuffer::subExtNoCheck;
@@ -120,6 +126,7 @@ RingBuffer::RingBuffer(const QString &lfilename,
                        int timeout_ms)
     : readpos(0),               writepos(0),
       internalreadpos(0),       ignorereadpos(-1),
+      prefetchpos(-1),
       rbrpos(0),                rbwpos(0),
       stopreads(false),
       filename(lfilename),      subtitlefilename(QString::null),
@@ -134,6 +141,11 @@ RingBuffer::RingBuffer(const QString &lfilename,
       fill_threshold(65536),    fill_min(-1),
       readblocksize(CHUNK),     wanttoread(0),
       numfailures(0),           commserror(false),
+      prefetchBuffer(NULL),     prefetchbufpos(-1),
+      prefetchbuflen(0),
+      readhits(0),              readmisses(0),
+      seekhits(0),              seekmisses(0),
+      prefetchhits(0),
       dvdPriv(NULL),            bdPriv(NULL),
       oldfile(false),           livetvchain(NULL),
       ignoreliveeof(false),     readAdjust(0)
@@ -291,6 +303,9 @@ void RingBuffer::OpenFile(const QString &lfilename, uint retry_ms)
         qWarning("Applying temporary OpenFile() hack");
     }
 
+    if (!GetReadAheadStats().isEmpty())
+        VERBOSE(VB_PLAYBACK, LOC + "Read ahead " + GetReadAheadStats());
+
     rwlock.lockForWrite();
 
     filename = lfilename;
@@ -530,6 +545,9 @@ void RingBuffer::OpenFile(const QString &lfilename, uint retry_ms)
             QStringList aux = remotefile->GetAuxiliaryFiles();
             if (aux.size())
                 subtitlefilename = dirName + "/" + aux[0];
+
+            if (startreadahead)
+                remotefile->SetPipelineDepth(kRemotePipelineDepth);
         }
     }
 
@@ -538,6 +556,14 @@ void RingBuffer::OpenFile(const QString &lfilename, uint retry_ms)
     commserror = false;
     numfailures = 0;
 
+    poslock.lockForWrite();
+    prefetchpos = -1;
+    poslock.unlock();
+    prefetchbufpos = -1;
+    prefetchbuflen = 0;
+    readhits = readmisses = 0;
+    seekhits = seekmisses = prefetchhits = 0;
+
     rawbitrate = 8000;
     CalcReadAheadThresh();
 
@@ -568,6 +594,9 @@ RingBuffer::~RingBuffer(void)
 {
     KillReadAheadThread();
 
+    if (!GetReadAheadStats().isEmpty())
+        VERBOSE(VB_PLAYBACK, LOC + "Read ahead " + GetReadAheadStats());
+
     rwlock.lockForWrite();
 
     if (remotefile)
@@ -605,6 +634,12 @@ RingBuffer::~RingBuffer(void)
         readAheadBuffer = NULL;
     }
 
+    if (prefetchBuffer) // this only runs if thread is terminated
+    {
+        delete [] prefetchBuffer;
+        prefetchBuffer = NULL;
+    }
+
     rwlock.unlock();
 }
 
@@ -751,6 +786,54 @@ int RingBuffer::safe_read(RemoteFile *rf, void *data, uint sz)
     return ret;
 }
 
+/** \fn RingBuffer::FillPrefetchBuffer(long long)
+ *  \brief Reads the data at a predicted seek target into the prefetch
+ *         buffer, so that a Seek() there does not have to wait for a
+ *         round trip to the backend before playback can resume.
+ *
+ *   WARNING: Must be called from the read ahead thread with rwlock
+ *            in read lock state.
+ *
+ *  \param pos Position in file the player is expected to seek to
+ */
+void RingBuffer::FillPrefetchBuffer(long long pos)
+{
+    int len = min((int)kPrefetchSize, 2 * max(fill_min, readblocksize));
+
+    if (!prefetchBuffer)
+        prefetchBuffer = new char[kPrefetchSize];
+
+    // Mark the target as handled up front, so that a failure
+    // here does not turn into a request on every loop iteration.
+    prefetchbufpos = pos;
+    prefetchbuflen = 0;
+
+    if (remotefile->Seek(pos, SEEK_SET) < 0)
+    {
+        VERBOSE(VB_FILE, LOC_WARN +
+                QString("FillPrefetchBuffer(%1): seek failed").arg(pos));
+    }
+    else
+    {
+        int ret = remotefile->Read(prefetchBuffer, len);
+        prefetchbuflen = max(ret, 0);
+    }
+
+    poslock.lockForRead();
+    long long resume = internalreadpos;
+    poslock.unlock();
+
+    if (remotefile->Seek(resume, SEEK_SET) < 0)
+    {
+        VERBOSE(VB_IMPORTANT, LOC_ERR + QString("FillPrefetchBuffer(%1): "
+                "failed to return to %2").arg(pos).arg(resume));
+        numfailures++;
+    }
+
+    VERBOSE(VB_FILE, LOC + QString("FillPrefetchBuffer(%1) -> %2 KB")
+            .arg(pos).arg(prefetchbuflen/1024));
+}
+
 /** \fn RingBuffer::UpdateRawBitrate(uint)
  *  \brief Set the raw bit rate, to allow RingBuffer adjust effective bitrate.
  *  \param raw_bitrate Streams average number of kilobits per second when
@@ -786,6 +869,41 @@ void RingBuffer::UpdatePlaySpeed(float play_speed)
     rwlock.unlock();
 }
 
+/** \fn RingBuffer::SetPrefetchHint(long long)
+ *  \brief Tells the RingBuffer where the player expects to seek to next,
+ *         e.g. the end of an upcoming commercial break or cut.
+ *
+ *   For local files the kernel is asked to start reading the target
+ *   into the page cache. For remote files the read ahead thread reads
+ *   the start of the target into a side buffer once the read ahead
+ *   buffer has filled, and Seek() uses that data if the seek comes.
+ *
+ *  \param pos Position in file, or -1 to clear the hint.
+ */
+void RingBuffer::SetPrefetchHint(long long pos)
+{
+    poslock.lockForWrite();
+    bool changed = (prefetchpos != pos);
+    prefetchpos = pos;
+    poslock.unlock();
+
+    if (!changed || pos < 0)
+        return;
+
+    VERBOSE(VB_FILE, LOC + QString("SetPrefetchHint(%1)").arg(pos));
+
+    rwlock.lockForRead();
+#if HAVE_POSIX_FADVISE
+    if (fd2 >= 0)
+    {
+        posix_fadvise(fd2, pos, 2 * max(fill_min, readblocksize),
+                      POSIX_FADV_WILLNEED);
+    }
+#endif
+    generalWait.wakeAll();
+    rwlock.unlock();
+}
+
 /** \fn RingBuffer::CalcReadAheadThresh(void)
  *  \brief Calculates fill_min, fill_threshold, and readblocksize
  *         from the estimated effective bitrate of the stream.
@@ -816,6 +934,9 @@ void RingBuffer::CalcReadAheadThresh(void)
     rbs            = (estbitrate > 5000)  ? KB128 : rbs;
     rbs            = (estbitrate > 9000)  ? KB256 : rbs;
     rbs            = (estbitrate > 18000) ? KB512 : rbs;
+    // each remote read costs a round trip to the backend,
+    // so ask for more per request when the bitrate is high
+    rbs            = (remotefile && estbitrate > 9000) ? rbs * 2 : rbs;
     readblocksize  = max(rbs,readblocksize);
 
     // minumum seconds of buffering before allowing read
@@ -860,6 +981,28 @@ bool RingBuffer::IsNearEnd(double fps, uint vvf) const
     return near_end;
 }
 
+/** \fn RingBuffer::GetReadAheadStats(void) const
+ *  \brief Returns a summary of how many reads and seeks since the file
+ *         was opened were served from buffered data, or an empty
+ *         string if there were none.
+ */
+QString RingBuffer::GetReadAheadStats(void) const
+{
+    QString ret;
+
+    rwlock.lockForRead();
+    if (readhits || readmisses || seekhits || seekmisses)
+    {
+        ret = QString("reads: %1 hit %2 miss, seeks: %3 hit "
+                      "(%4 prefetched) %5 miss")
+            .arg(readhits).arg(readmisses)
+            .arg(seekhits).arg(prefetchhits).arg(seekmisses);
+    }
+    rwlock.unlock();
+
+    return ret;
+}
+
 /// \brief Returns number of bytes available for reading into buffer.
 /// WARNING: Must be called with rwlock in locked state.
 int RingBuffer::ReadBufFree(void) const
@@ -1144,6 +1287,25 @@ void RingBuffer::run(void)
 
         long long totfree = ReadBufFree();
 
+        // Once the buffer is full, use the idle time to read the
+        // data at the player's predicted seek target, if any.
+        if (remotefile && !livetvchain && readsallowed &&
+            ((totfree < readblocksize) || ateof) &&
+            (ignorereadpos < 0) && !commserror && !stopreads)
+        {
+            poslock.lockForRead();
+            long long pos = prefetchpos;
+            bool buffered = (pos >= readpos) && (pos <= internalreadpos);
+            poslock.unlock();
+
+            if ((pos >= 0) && !buffered && (pos != prefetchbufpos))
+            {
+                FillPrefetchBuffer(pos);
+                ignore_for_read_timing = true;
+                continue;
+            }
+        }
+
         // These are conditions where we don't want to go through
         // the loop if they are true.
         if (((totfree < readblocksize) && readsallowed) ||
@@ -1247,6 +1409,15 @@ void RingBuffer::run(void)
             else
             {
                 read_return = safe_read(fd2, readAheadBuffer + rbwpos, totfree);
+#if HAVE_POSIX_FADVISE
+                // have the kernel fetch the next block while
+                // this one is being consumed
+                if (read_return > 0)
+                {
+                    posix_fadvise(fd2, internalreadpos + read_return,
+                                  readblocksize, POSIX_FADV_WILLNEED);
+                }
+#endif
             }
             VERBOSE(VB_FILE|VB_EXTRA, LOC +
                     QString("safe_read(...@%1, %2) -> %3")
@@ -1344,8 +1515,12 @@ void RingBuffer::run(void)
     reallyrunning = false;
     readsallowed = false;
     delete [] readAheadBuffer;
+    delete [] prefetchBuffer;
 
     readAheadBuffer = NULL;
+    prefetchBuffer = NULL;
+    prefetchbufpos = -1;
+    prefetchbuflen = 0;
     rbwlock.unlock();
     rbrlock.unlock();
     rwlock.unlock();
@@ -1606,6 +1781,11 @@ int RingBuffer::ReadPriv(void *buf, int count, bool peek)
         return 0;
     }
 
+    if (ReadBufAvail() >= count)
+        readhits++;
+    else
+        readmisses++;
+
     if (!WaitForAvail(count))
     {
         VERBOSE(VB_FILE, LOC + loc_desc + ": !WaitForAvail()");
@@ -1855,6 +2035,7 @@ long long RingBuffer::Seek(long long pos, int whence, bool has_lock)
 
         if (used_opt)
         {
+            seekhits++;
             if (ignorereadpos >= 0)
             {
                 // seek should always succeed since we were at this position
@@ -1991,6 +2172,43 @@ long long RingBuffer::Seek(long long pos, int whence, bool has_lock)
     }
 #endif
 
+    // If the player told us about this seek ahead of time the start
+    // of the data may already be in the prefetch buffer. Use it to
+    // seed the read ahead buffer and continue reading after it.
+    if (remotefile && readaheadrunning && (prefetchbuflen > 0) &&
+        (SEEK_SET == whence || SEEK_CUR == whence) &&
+        (new_pos >= prefetchbufpos) &&
+        (new_pos < prefetchbufpos + prefetchbuflen))
+    {
+        int off = new_pos - prefetchbufpos;
+        int len = prefetchbuflen - off;
+
+        if (remotefile->Seek(new_pos + len, SEEK_SET) >= 0)
+        {
+            readpos = new_pos;
+            ignorereadpos = -1;
+            ResetReadAhead(new_pos + len);
+
+            rbwlock.lockForWrite();
+            memcpy(readAheadBuffer, prefetchBuffer + off, len);
+            rbwpos = len;
+            rbwlock.unlock();
+
+            readAdjust = 0;
+            seekhits++;
+            prefetchhits++;
+
+            VERBOSE(VB_FILE, LOC + QString("Seek(): used %1 KB of "
+                    "prefetched data at %2").arg(len/1024).arg(new_pos));
+
+            poslock.unlock();
+            generalWait.wakeAll();
+            if (!has_lock)
+                rwlock.unlock();
+            return new_pos;
+        }
+    }
+
     // Here we perform a normal seek. When successful we
     // need to call ResetReadAhead(). A reset means we will
     // need to refill the buffer, which takes some time.
@@ -2029,7 +2247,10 @@ long long RingBuffer::Seek(long long pos, int whence, bool has_lock)
         ignorereadpos = -1;
 
         if (readaheadrunning)
+        {
             ResetReadAhead(readpos);
+            seekmisses++;
+        }
 
         readAdjust = 0;
     }
@@ -2102,6 +2323,32 @@ void RingBuffer::SetWriteBufferSize(int newSize)
     rwlock.unlock();
 }
 
+/** \fn RingBuffer::SetWriterDirectIO(bool)
+ *  \brief Calls ThreadedFileWriter::SetDirectIO(bool)
+ */
+bool RingBuffer::SetWriterDirectIO(bool enable)
+{
+    bool ok = false;
+    rwlock.lockForRead();
+    if (tfw)
+        ok = tfw->SetDirectIO(enable);
+    rwlock.unlock();
+    return ok;
+}
+
+/** \fn RingBuffer::GetWriterStats(void) const
+ *  \brief Calls ThreadedFileWriter::GetWriteLatencyStats(void)
+ */
+QString RingBuffer::GetWriterStats(void) const
+{
+    QString ret;
+    rwlock.lockForRead();
+    if (tfw)
+        ret = tfw->GetWriteLatencyStats();
+    rwlock.unlock();
+    return ret;
+}
+
 /** \fn RingBuffer::SetWriteBufferMinWriteSize(int)
  *  \brief Calls ThreadedFileWriter::SetWriteBufferMinWriteSize(int)
  */
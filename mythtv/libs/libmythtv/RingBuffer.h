@@ -34,10 +34,12 @@ class MPUBLIC RingBuffer : protected QThread
     // Sets
     void SetWriteBufferSize(int newSize);
     void SetWriteBufferMinWriteSize(int newMinSize);
+    bool SetWriterDirectIO(bool enable);
     void SetOldFile(bool is_old);
     void SetStreamOnly(bool stream);
     void UpdateRawBitrate(uint rawbitrate);
     void UpdatePlaySpeed(float playspeed);
+    void SetPrefetchHint(long long pos);
 
     // Gets
     QString   GetFilename(void)      const;
@@ -51,6 +53,7 @@ class MPUBLIC RingBuffer : protected QThread
     long long GetRealFileSize(void)  const;
     bool      IsOpen(void)           const;
     bool      IsNearEnd(double fps, uint vvf) const;
+    QString   GetReadAheadStats(void) const;
 
     // General Commands
     void OpenFile(const QString &lfilename,
@@ -85,6 +88,7 @@ class MPUBLIC RingBuffer : protected QThread
     bool IsIOBound(void) const;
     void WriterFlush(void);
     void Sync(void);
+    QString GetWriterStats(void) const;
     long long WriterSeek(long long pos, int whence, bool has_lock = false);
 
     // DVDRingBuffer proxies
@@ -126,6 +130,7 @@ class MPUBLIC RingBuffer : protected QThread
     int safe_read_dvd(void *data, uint sz);
     int safe_read(int fd, void *data, uint sz);
     int safe_read(RemoteFile *rf, void *data, uint sz);
+    void FillPrefetchBuffer(long long pos);
 
     int ReadPriv(void *buf, int count, bool peek);
     int ReadDirect(void *buf, int count, bool peek);
@@ -144,6 +149,7 @@ class MPUBLIC RingBuffer : protected QThread
     long long writepos;           // protected by poslock
     long long internalreadpos;    // protected by poslock
     long long ignorereadpos;      // protected by poslock
+    long long prefetchpos;        // protected by poslock
     mutable QReadWriteLock rbrlock;
     int       rbrpos;             // protected by rbrlock
     mutable QReadWriteLock rbwlock;
@@ -185,6 +191,16 @@ class MPUBLIC RingBuffer : protected QThread
     int       numfailures;        // protected by rwlock (see note 1)
     bool      commserror;         // protected by rwlock
 
+    char     *prefetchBuffer;     // protected by rwlock (see note 2)
+    long long prefetchbufpos;     // protected by rwlock (see note 2)
+    int       prefetchbuflen;     // protected by rwlock (see note 2)
+
+    uint      readhits;           // protected by rwlock (see note 2)
+    uint      readmisses;         // protected by rwlock (see note 2)
+    uint      seekhits;           // protected by rwlock
+    uint      seekmisses;         // protected by rwlock
+    uint      prefetchhits;       // protected by rwlock
+
     // We should really subclass for these two sets of functionality..
     // current implementation is not thread-safe.
     DVDRingBufferPriv *dvdPriv; // NOT protected by a lock
@@ -203,6 +219,11 @@ class MPUBLIC RingBuffer : protected QThread
     // fragile state of affairs and care must be taken when modifying
     // code or locking around this variable.
 
+    // note 2: the prefetch buffer state is only modified by the read
+    // ahead thread while it holds a read lock, and the read counters
+    // are only modified by the single reader while it holds a read
+    // lock. All other users take the write lock, as with note 1.
+
     /// Condition to signal that the read ahead thread is running
     QWaitCondition generalWait;         // protected by rwlock
 
@@ -215,6 +236,8 @@ class MPUBLIC RingBuffer : protected QThread
   public:
     static const uint kBufferSize;
     static const uint kReadTestSize;
+    static const uint kPrefetchSize;
+    static const int  kRemotePipelineDepth;
 };
 
 #endif // _RINGBUFFER_H_
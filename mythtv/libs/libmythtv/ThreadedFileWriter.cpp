@@ -5,6 +5,7 @@
 
 // Unix C headers
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <signal.h>
@@ -15,6 +16,7 @@
 
 // MythTV headers
 #include "ThreadedFileWriter.h"
+#include "mythcorecontext.h"
 #include "compat.h"
 #include "mythverbose.h"
 #include "mythconfig.h"
@@ -31,6 +33,13 @@
 const uint ThreadedFileWriter::TFW_DEF_BUF_SIZE   = 2*1024*1024;
 const uint ThreadedFileWriter::TFW_MAX_WRITE_SIZE = TFW_DEF_BUF_SIZE / 4;
 const uint ThreadedFileWriter::TFW_MIN_WRITE_SIZE = TFW_DEF_BUF_SIZE / 32;
+const uint ThreadedFileWriter::TFW_DIRECT_ALIGN   = 4096;
+const uint ThreadedFileWriter::TFW_MAX_BUF_SIZE   = TFW_DEF_BUF_SIZE * 16;
+
+QMutex   ThreadedFileWriter::s_stats_lock;
+TFWStats ThreadedFileWriter::s_stats = { 0, 0, 0, 0, 0, 0, 0, 0 };
+uint     ThreadedFileWriter::s_write_latency[24];
+uint     ThreadedFileWriter::s_write_count = 0;
 
 /** \class ThreadedFileWriter
  *  \brief This class supports the writing of recordings to disk.
@@ -99,6 +108,35 @@ static uint safe_write(int fd, const void *data, uint sz, bool &ok)
     return tot;
 }
 
+/// Sets or clears O_DIRECT on fd, returns false if this is not possible.
+static bool set_o_direct(int fd, bool enable)
+{
+#ifdef O_DIRECT
+    int fl = fcntl(fd, F_GETFL);
+    if (fl < 0)
+        return false;
+    fl = (enable) ? (fl | O_DIRECT) : (fl & ~O_DIRECT);
+    return fcntl(fd, F_SETFL, fl) >= 0;
+#else
+    return !enable;
+#endif // O_DIRECT
+}
+
+/// Returns upper bound in usec of the given percentile of a log2 histogram.
+static uint latency_percentile(const uint *hist, uint num_buckets,
+                               uint count, uint percent)
+{
+    uint64_t needed = ((uint64_t)count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (uint i = 0; i < num_buckets; i++)
+    {
+        seen += hist[i];
+        if (seen >= needed)
+            return 1 << i;
+    }
+    return 1 << (num_buckets - 1);
+}
+
 /** \fn ThreadedFileWriter::boot_writer(void*)
  *  \brief Thunk that runs ThreadedFileWriter::DiskLoop(void)
  */
@@ -135,13 +173,27 @@ ThreadedFileWriter::ThreadedFileWriter(const QString &fname,
     no_writes(false),                    flush(false),
     write_is_blocked(false),             in_dtor(false),
     ignore_writes(false),                tfw_min_write_size(0),
+    direct_io(false),                    direct_tail(0),
+    disk_busy(false),
     // buffer position state
     rpos(0),                             wpos(0),
     written(0),
     // buffer
-    buf(NULL),                           tfw_buf_size(0)
+    buf(NULL),                           tfw_buf_size(0),
+    buf_aligned(false),
+    // statistics
+    write_count(0),
+    // adaptive buffer sizing
+    tfw_base_buf_size(TFW_DEF_BUF_SIZE),
+    tfw_base_min_write_size(TFW_MIN_WRITE_SIZE),
+    adapt_high_water(0),                 adapt_iobound(0),
+    adapt_idle(0),
+    adapt_bytes_in(0),                   adapt_bytes_out(0),
+    adapt_usec_out(0)
 {
     filename.detach();
+    bzero(write_latency, sizeof(write_latency));
+    gettimeofday(&adapt_time, NULL);
 }
 
 /** \fn ThreadedFileWriter::Open(void)
@@ -171,12 +223,10 @@ bool ThreadedFileWriter::Open(void)
 #ifdef USING_MINGW
         _setmode(fd, _O_BINARY);
 #endif
-        buf = new char[TFW_DEF_BUF_SIZE + 1024];
-        bzero(buf, TFW_DEF_BUF_SIZE + 64);
+        AllocBuffer(TFW_DEF_BUF_SIZE);
 
         m_file_sync =  m_file_wpos = 0;
 
-        tfw_buf_size = TFW_DEF_BUF_SIZE;
         tfw_min_write_size = TFW_MIN_WRITE_SIZE;
 
         bool res = 0;
@@ -223,11 +273,7 @@ ThreadedFileWriter::~ThreadedFileWriter()
         fd = -1;
     }
 
-    if (buf)
-    {
-        delete [] buf;
-        buf = NULL;
-    }
+    FreeBuffer();
 }
 
 /** \fn ThreadedFileWriter::Write(const void*, uint)
@@ -254,6 +300,10 @@ uint ThreadedFileWriter::Write(const void *data, uint count)
     uint remaining = count;
     char *wdata = (char *)data;
 
+    buflock.lock();
+    AdaptBufferSizePriv();
+    buflock.unlock();
+
     while (remaining)
     {
         bool first = true;
@@ -264,6 +314,10 @@ uint ThreadedFileWriter::Write(const void *data, uint count)
             if (first)
             {
                 ++iobound_cnt;
+                ++adapt_iobound;
+                s_stats_lock.lock();
+                s_stats.iobound_events++;
+                s_stats_lock.unlock();
                 VERBOSE(VB_IMPORTANT, LOC_ERR + "Write() -- IOBOUND begin " +
                         QString("remaining(%1) free(%2) size(%3) cnt(%4)")
                         .arg(remaining).arg(BufFreePriv())
@@ -300,6 +354,8 @@ uint ThreadedFileWriter::Write(const void *data, uint count)
         if (twpos == wpos)
         {
             wpos = (wpos + bytes) % tfw_buf_size;
+            adapt_bytes_in += bytes;
+            adapt_high_water = max(adapt_high_water, BufUsedPriv());
         }
         else
         {
@@ -340,7 +396,16 @@ long long ThreadedFileWriter::Seek(long long pos, int whence)
 {
     Flush();
 
-    return lseek(fd, pos, whence);
+    QMutexLocker locker(&buflock);
+    DropDirectTailPriv();
+
+    long long ret = lseek(fd, pos, whence);
+
+    // O_DIRECT writes must start on an aligned file offset
+    if (direct_io && (ret % TFW_DIRECT_ALIGN))
+        SetDirectIOPriv(false);
+
+    return ret;
 }
 
 /** \fn ThreadedFileWriter::Flush(void)
@@ -350,7 +415,7 @@ void ThreadedFileWriter::Flush(void)
 {
     QMutexLocker locker(&buflock);
     flush = true;
-    while (BufUsedPriv() > 0)
+    while (BufUsedPriv() > direct_tail)
     {
         if (!bufferEmpty.wait(locker.mutex(), 2000))
             VERBOSE(VB_IMPORTANT, LOC + "Taking a long time to flush..");
@@ -409,11 +474,12 @@ void ThreadedFileWriter::SetWriteBufferSize(uint newSize)
     Flush();
 
     QMutexLocker locker(&buflock);
-    delete [] buf;
-    rpos = wpos = 0;
-    buf = new char[newSize + 1024];
-    bzero(buf, newSize + 64);
-    tfw_buf_size = newSize;
+    // keep the partial block left by an O_DIRECT flush at the buffer head
+    if (direct_tail)
+        ResizeBufferPriv(newSize);
+    else
+        AllocBuffer(newSize);
+    tfw_base_buf_size = tfw_buf_size;
 }
 
 /** \fn ThreadedFileWriter::SetWriteBufferMinWriteSize(uint)
@@ -425,7 +491,9 @@ void ThreadedFileWriter::SetWriteBufferMinWriteSize(uint newMinSize)
     if (newMinSize <= 0)
         return;
 
+    QMutexLocker locker(&buflock);
     tfw_min_write_size = newMinSize;
+    tfw_base_min_write_size = newMinSize;
 }
 
 /** \fn ThreadedFileWriter::SyncLoop(void)
@@ -452,16 +520,59 @@ void ThreadedFileWriter::DiskLoop(void)
     uint size = 0;
     written = 0;
 
-    while (!in_dtor || BufUsed() > 0)
+    while (true)
     {
         buflock.lock();
         size = BufUsedPriv();
 
-        if (size == 0)
+        if (in_dtor && size <= direct_tail)
+        {
+            buflock.unlock();
+            break;
+        }
+
+        if (size <= direct_tail)
         {
             buflock.unlock();
             bufferEmpty.wakeAll();
             buflock.lock();
+            size = BufUsedPriv();
+        }
+
+        /* O_DIRECT writes must be a whole number of blocks, so hold
+           back any partial block. When the buffer is being flushed the
+           partial block is written without O_DIRECT but left in the
+           buffer, it is written again with the block it belongs to,
+           so the file offset stays aligned and direct I/O stays on. */
+        if (direct_io && size)
+        {
+            uint tail = size % TFW_DIRECT_ALIGN;
+            if (size > tail)
+            {
+                size -= tail;
+            }
+            else if ((flush || in_dtor) && (tail > direct_tail))
+            {
+                uint trpos = rpos;
+                uint64_t offset = m_file_wpos;
+                disk_busy = true;
+                buflock.unlock();
+
+                bool ok = ignore_writes || WriteDirectTail(trpos, tail, offset);
+
+                buflock.lock();
+                disk_busy = false;
+                if (ok && (trpos == rpos))
+                    direct_tail = tail;
+                else if (!ok)
+                    SetDirectIOPriv(false);
+                buflock.unlock();
+                continue;
+            }
+            else
+            {
+                size = 0;
+            }
         }
 
         if (!size || (!in_dtor && !flush &&
@@ -473,6 +584,7 @@ void ThreadedFileWriter::DiskLoop(void)
             continue;
         }
         uint trpos = rpos;
+        disk_busy = true;
         buflock.unlock();
 
         /* cap the max. write size. Prevents the situation where 90% of the
@@ -481,6 +593,9 @@ void ThreadedFileWriter::DiskLoop(void)
            the 10% that was free... */
         size = (size > TFW_MAX_WRITE_SIZE) ? TFW_MAX_WRITE_SIZE : size;
 
+        struct timeval write_start, write_end;
+        gettimeofday(&write_start, NULL);
+
         bool write_ok;
         if (ignore_writes)
             ;
@@ -497,6 +612,13 @@ void ThreadedFileWriter::DiskLoop(void)
             size = safe_write(fd, buf + trpos, size, write_ok);
         }
 
+        // keep the file offset and rpos aligned after a short write
+        if (direct_io && !ignore_writes && (size % TFW_DIRECT_ALIGN))
+        {
+            lseek(fd, -(off_t)(size % TFW_DIRECT_ALIGN), SEEK_CUR);
+            size -= size % TFW_DIRECT_ALIGN;
+        }
+
         if (!ignore_writes && !write_ok && ((EFBIG == errno) || (ENOSPC == errno)))
         {
             QString msg;
@@ -531,10 +653,24 @@ void ThreadedFileWriter::DiskLoop(void)
             written += size;
         }
 
+        gettimeofday(&write_end, NULL);
+
         buflock.lock();
+        disk_busy = false;
+        if (!ignore_writes)
+        {
+            uint64_t usec =
+                (write_end.tv_sec  - write_start.tv_sec) * 1000000LL +
+                (write_end.tv_usec - write_start.tv_usec);
+            AddWriteLatency(usec);
+            adapt_bytes_out += size;
+            adapt_usec_out  += usec;
+        }
         if (trpos == rpos)
         {
             rpos = (rpos + size) % tfw_buf_size;
+            if (size)
+                direct_tail = 0;
         }
         else
         {
@@ -582,3 +718,355 @@ uint ThreadedFileWriter::BufFree(void) const
     return ((wpos >= rpos) ? (rpos + tfw_buf_size) : rpos) - wpos - 1;
 }
 
+
+/** \fn ThreadedFileWriter::AllocBuffer(uint)
+ *  \brief Replaces the write buffer with an empty one of the given size.
+ *
+ *   In O_DIRECT mode the buffer is aligned, and its size rounded up,
+ *   to TFW_DIRECT_ALIGN. Caller must hold buflock or own the buffer.
+ */
+void ThreadedFileWriter::AllocBuffer(uint size)
+{
+    FreeBuffer();
+
+#ifdef O_DIRECT
+    if (direct_io)
+    {
+        size = ((size + TFW_DIRECT_ALIGN - 1) / TFW_DIRECT_ALIGN) *
+            TFW_DIRECT_ALIGN;
+        void *ptr = NULL;
+        if (!posix_memalign(&ptr, TFW_DIRECT_ALIGN, size + TFW_DIRECT_ALIGN))
+        {
+            buf = (char*) ptr;
+            buf_aligned = true;
+        }
+    }
+#endif // O_DIRECT
+
+    if (!buf)
+        buf = new char[size + 1024];
+
+    bzero(buf, size + 64);
+    rpos = wpos = 0;
+    direct_tail = 0;
+    tfw_buf_size = size;
+}
+
+void ThreadedFileWriter::FreeBuffer(void)
+{
+    if (buf && buf_aligned)
+        free(buf);
+    else if (buf)
+        delete [] buf;
+
+    buf = NULL;
+    buf_aligned = false;
+}
+
+/** \fn ThreadedFileWriter::SetDirectIO(bool)
+ *  \brief Switches between O_DIRECT and normal buffered writes.
+ *
+ *   O_DIRECT writes bypass the page cache, so a backend writing many
+ *   recordings at once does not evict the data being played back, and
+ *   the kernel does not build up large amounts of dirty pages that
+ *   stall every writer when they are finally flushed. Data is written
+ *   from an aligned buffer in whole blocks, only the last partial block
+ *   is written without O_DIRECT when the file is flushed.
+ *
+ *   This should be called before anything has been written to the file.
+ *
+ *  \return true if the requested mode is now in effect.
+ */
+bool ThreadedFileWriter::SetDirectIO(bool enable)
+{
+    if (enable == direct_io)
+        return true;
+
+    Flush();
+
+    QMutexLocker locker(&buflock);
+    DropDirectTailPriv();
+
+    if (enable && (m_file_wpos % TFW_DIRECT_ALIGN))
+    {
+        VERBOSE(VB_IMPORTANT, LOC_ERR + "Can not enable direct I/O "
+                "at an unaligned file position.");
+        return false;
+    }
+
+    if (!SetDirectIOPriv(enable))
+        return false;
+
+    AllocBuffer(tfw_buf_size);
+    return true;
+}
+
+/// Changes the O_DIRECT flag of the open file, caller must hold buflock.
+bool ThreadedFileWriter::SetDirectIOPriv(bool enable)
+{
+#ifdef O_DIRECT
+    if (fd < 0)
+        return false;
+
+    if (!set_o_direct(fd, enable))
+    {
+        VERBOSE(VB_IMPORTANT, LOC_ERR +
+                QString("Failed to %1 direct I/O for '%2'")
+                .arg(enable ? "enable" : "disable").arg(filename) + ENO);
+        return false;
+    }
+
+    VERBOSE(VB_RECORD, LOC + QString("Direct I/O %1 for '%2'")
+            .arg(enable ? "enabled" : "disabled").arg(filename));
+
+    direct_io = enable;
+    return true;
+#else
+    (void) enable;
+    return false;
+#endif // O_DIRECT
+}
+
+/** \fn ThreadedFileWriter::WriteDirectTail(uint,uint,uint64_t)
+ *  \brief Writes a partial block at the given file offset without O_DIRECT.
+ *
+ *   pwrite() does not move the file offset, so the next O_DIRECT write
+ *   still starts on the block boundary and overwrites this data.
+ */
+bool ThreadedFileWriter::WriteDirectTail(uint trpos, uint size,
+                                         uint64_t offset)
+{
+    if (!set_o_direct(fd, false))
+        return false;
+
+    uint tot = 0;
+    while (tot < size)
+    {
+        ssize_t ret = pwrite(fd, buf + trpos + tot, size - tot, offset + tot);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+        {
+            VERBOSE(VB_IMPORTANT, LOC_ERR + "WriteDirectTail(): "
+                    "File I/O" + ENO);
+            break;
+        }
+        tot += ret;
+    }
+
+    return set_o_direct(fd, true) && (tot == size);
+}
+
+/** \fn ThreadedFileWriter::DropDirectTailPriv(void)
+ *  \brief Consumes the partial block already written by a flush.
+ *
+ *   Called before the file offset is moved or direct I/O is turned off,
+ *   after which the tail will not be rewritten. Caller must hold buflock.
+ */
+void ThreadedFileWriter::DropDirectTailPriv(void)
+{
+    if (!direct_tail)
+        return;
+
+    rpos = (rpos + direct_tail) % tfw_buf_size;
+    m_file_wpos += direct_tail;
+    lseek(fd, direct_tail, SEEK_CUR);
+    direct_tail = 0;
+}
+
+/** \fn ThreadedFileWriter::IsDirectIOStorageGroup(const QString&)
+ *  \brief Returns true if recordings in this storage group should be
+ *         written with direct I/O.
+ *
+ *   Controlled by the per host "DirectIOStorageGroups" setting, a comma
+ *   separated list of storage group names.
+ */
+bool ThreadedFileWriter::IsDirectIOStorageGroup(const QString &group)
+{
+    QStringList groups = gCoreContext->GetSetting("DirectIOStorageGroups")
+        .split(",", QString::SkipEmptyParts);
+
+    for (int i = 0; i < groups.size(); i++)
+    {
+        if (groups[i].trimmed() == group)
+            return true;
+    }
+
+    return false;
+}
+
+/// Records how long one write() took, caller must hold buflock.
+void ThreadedFileWriter::AddWriteLatency(uint64_t usec)
+{
+    const uint num_buckets = sizeof(write_latency) / sizeof(uint);
+    uint bucket = 0;
+    while ((bucket + 1 < num_buckets) && (usec >> bucket))
+        bucket++;
+
+    write_latency[bucket]++;
+    write_count++;
+
+    QMutexLocker locker(&s_stats_lock);
+    s_write_latency[bucket]++;
+    s_write_count++;
+}
+
+/** \fn ThreadedFileWriter::GetWriteLatencyStats(void) const
+ *  \brief Returns a summary of the write latency percentiles observed.
+ */
+QString ThreadedFileWriter::GetWriteLatencyStats(void) const
+{
+    QMutexLocker locker(&buflock);
+
+    if (!write_count)
+        return "no writes";
+
+    const uint num_buckets = sizeof(write_latency) / sizeof(uint);
+    uint p50 = latency_percentile(write_latency, num_buckets, write_count, 50);
+    uint p95 = latency_percentile(write_latency, num_buckets, write_count, 95);
+    uint p99 = latency_percentile(write_latency, num_buckets, write_count, 99);
+
+    return QString("%1 writes%2, p50 < %3 ms, p95 < %4 ms, p99 < %5 ms")
+        .arg(write_count).arg(direct_io ? " (direct)" : "")
+        .arg(p50 / 1000.0, 0, 'f', 1)
+        .arg(p95 / 1000.0, 0, 'f', 1)
+        .arg(p99 / 1000.0, 0, 'f', 1);
+}
+
+/** \fn ThreadedFileWriter::AdaptBufferSizePriv(void)
+ *  \brief Grows or shrinks the write buffer to match the disk's behaviour.
+ *
+ *   Called from Write() with buflock held, at most once a second this
+ *   looks at how full the buffer got and whether Write() had to wait on
+ *   the disk. The buffer is doubled, up to TFW_MAX_BUF_SIZE, when it
+ *   was more than half full or the writer blocked, and halved again, but
+ *   not below the size the owner asked for, after 30 seconds of being
+ *   mostly empty. When the disk writes slower than twice the incoming
+ *   bitrate, writes are coalesced into larger extents by raising the
+ *   minimum write size.
+ */
+void ThreadedFileWriter::AdaptBufferSizePriv(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    int64_t elapsed =
+        (now.tv_sec  - adapt_time.tv_sec) * 1000000LL +
+        (now.tv_usec - adapt_time.tv_usec);
+    if (elapsed < 1000000)
+        return;
+
+    uint64_t rate_in  = adapt_bytes_in * 1000000LL / elapsed;
+    uint64_t rate_out = (adapt_usec_out) ?
+        adapt_bytes_out * 1000000LL / adapt_usec_out : 0;
+
+    uint new_size = tfw_buf_size;
+    if (adapt_iobound || (adapt_high_water > tfw_buf_size / 2))
+    {
+        new_size = min((uint)tfw_buf_size * 2, TFW_MAX_BUF_SIZE);
+        adapt_idle = 0;
+    }
+    else if (adapt_high_water < tfw_buf_size / 8)
+    {
+        if (++adapt_idle >= 30)
+        {
+            new_size = max((uint)tfw_buf_size / 2, (uint)tfw_base_buf_size);
+            adapt_idle = 0;
+        }
+    }
+    else
+    {
+        adapt_idle = 0;
+    }
+
+    if (rate_out && (rate_out < rate_in * 2))
+    {
+        tfw_min_write_size = max((long long)tfw_base_min_write_size,
+                                 (long long)min(TFW_MAX_WRITE_SIZE,
+                                                new_size / 4));
+    }
+    else
+    {
+        tfw_min_write_size = tfw_base_min_write_size;
+    }
+
+    // Can't move the data while DiskLoop() is writing out of it,
+    // the decision will be made again on the next call.
+    if ((new_size != tfw_buf_size) && !disk_busy)
+        ResizeBufferPriv(new_size);
+
+    s_stats_lock.lock();
+    s_stats.max_buf_used = max(s_stats.max_buf_used, adapt_high_water);
+    s_stats.max_buf_size = max(s_stats.max_buf_size, (uint)tfw_buf_size);
+    s_stats_lock.unlock();
+
+    adapt_time       = now;
+    adapt_high_water = BufUsedPriv();
+    adapt_iobound    = 0;
+    adapt_bytes_in   = 0;
+    adapt_bytes_out  = 0;
+    adapt_usec_out   = 0;
+}
+
+/** \fn ThreadedFileWriter::ResizeBufferPriv(uint)
+ *  \brief Moves the buffered data into a new buffer of the given size.
+ *
+ *   Caller must hold buflock, be the thread calling Write(), and
+ *   DiskLoop() must not be writing out of the buffer.
+ */
+void ThreadedFileWriter::ResizeBufferPriv(uint newSize)
+{
+    uint used = BufUsedPriv();
+    if (used + TFW_DIRECT_ALIGN >= newSize)
+        return;
+
+    char *old_buf       = buf;
+    bool  old_aligned   = buf_aligned;
+    uint  old_size      = tfw_buf_size;
+    uint  old_rpos      = rpos;
+    uint  old_tail      = direct_tail;
+
+    buf = NULL;
+    AllocBuffer(newSize);
+
+    uint first = min(used, old_size - old_rpos);
+    memcpy(buf, old_buf + old_rpos, first);
+    memcpy(buf + first, old_buf, used - first);
+    wpos = used;
+    direct_tail = old_tail;
+
+    if (old_aligned)
+        free(old_buf);
+    else
+        delete [] old_buf;
+
+    VERBOSE(VB_RECORD, LOC + QString("Write buffer for '%1' %2 to %3 KB")
+            .arg(filename).arg((newSize > old_size) ? "grown" : "shrunk")
+            .arg(tfw_buf_size / 1024));
+
+    QMutexLocker locker(&s_stats_lock);
+    if (newSize > old_size)
+        s_stats.buf_grows++;
+    else
+        s_stats.buf_shrinks++;
+}
+
+/** \fn ThreadedFileWriter::GetStats(void)
+ *  \brief Returns write buffer statistics for all writers in this process.
+ */
+TFWStats ThreadedFileWriter::GetStats(void)
+{
+    QMutexLocker locker(&s_stats_lock);
+
+    const uint num_buckets = sizeof(s_write_latency) / sizeof(uint);
+    TFWStats stats = s_stats;
+    if (s_write_count)
+    {
+        stats.write_p50 = latency_percentile(
+            s_write_latency, num_buckets, s_write_count, 50);
+        stats.write_p95 = latency_percentile(
+            s_write_latency, num_buckets, s_write_count, 95);
+        stats.write_p99 = latency_percentile(
+            s_write_latency, num_buckets, s_write_count, 99);
+    }
+    return stats;
+}
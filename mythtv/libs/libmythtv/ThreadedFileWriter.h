@@ -5,11 +5,27 @@
 #include <QWaitCondition>
 #include <QString>
 #include <QMutex>
+#include <QStringList>
 
 #include <pthread.h>
 #include <stdint.h>
 
-class ThreadedFileWriter
+#include "mythexp.h"
+
+/// Write buffer statistics summed over all ThreadedFileWriters
+typedef struct
+{
+    uint iobound_events; ///< times Write() had to wait for the disk
+    uint max_buf_used;   ///< high water mark of any write buffer in bytes
+    uint max_buf_size;   ///< largest write buffer allocated in bytes
+    uint buf_grows;      ///< buffers grown because the disk fell behind
+    uint buf_shrinks;    ///< buffers shrunk after being mostly idle
+    uint write_p50;      ///< median write() latency in usec
+    uint write_p95;      ///< 95th percentile write() latency in usec
+    uint write_p99;      ///< 99th percentile write() latency in usec
+} TFWStats;
+
+class MPUBLIC ThreadedFileWriter
 {
   public:
     ThreadedFileWriter(const QString &fname, int flags, mode_t mode);
@@ -22,6 +38,8 @@ class ThreadedFileWriter
 
     void SetWriteBufferSize(uint newSize = TFW_DEF_BUF_SIZE);
     void SetWriteBufferMinWriteSize(uint newMinSize = TFW_MIN_WRITE_SIZE);
+    bool SetDirectIO(bool enable);
+    bool IsDirectIO(void) const { return direct_io; }
 
     uint BufUsed(void) const;
     uint BufFree(void) const;
@@ -29,6 +47,10 @@ class ThreadedFileWriter
     void Sync(void);
     void Flush(void);
 
+    QString GetWriteLatencyStats(void) const;
+    static bool IsDirectIOStorageGroup(const QString &group);
+    static TFWStats GetStats(void);
+
   protected:
     static void *boot_writer(void *);
     void DiskLoop(void);
@@ -39,6 +61,15 @@ class ThreadedFileWriter
     uint BufUsedPriv(void) const;
     uint BufFreePriv(void) const;
 
+    void AllocBuffer(uint size);
+    void FreeBuffer(void);
+    bool SetDirectIOPriv(bool enable);
+    void DropDirectTailPriv(void);
+    bool WriteDirectTail(uint trpos, uint size, uint64_t offset);
+    void AddWriteLatency(uint64_t usec);
+    void AdaptBufferSizePriv(void);
+    void ResizeBufferPriv(uint newSize);
+
   private:
     // file info
     QString         filename;
@@ -55,6 +86,11 @@ class ThreadedFileWriter
     bool            in_dtor;
     bool            ignore_writes;
     long long       tfw_min_write_size;
+    bool            direct_io;   ///< file is open with O_DIRECT
+    /// bytes at rpos already written to disk by a flush in O_DIRECT mode,
+    /// they are written again as part of the next whole block
+    uint            direct_tail;
+    bool            disk_busy;   ///< DiskLoop() is writing out of buf
 
     // buffer position state
     volatile uint   rpos;    ///< points to end of data written to disk
@@ -65,6 +101,28 @@ class ThreadedFileWriter
     // buffer
     char           *buf;
     unsigned long   tfw_buf_size;
+    bool            buf_aligned; ///< buf allocated with posix_memalign()
+
+    // write latency histogram, bucket i counts writes that took
+    // less than 2^i microseconds; protected by buflock
+    uint            write_latency[24];
+    uint            write_count;
+
+    // adaptive buffer sizing state, protected by buflock
+    unsigned long   tfw_base_buf_size;       ///< smallest size to shrink to
+    long long       tfw_base_min_write_size; ///< min write size when idle
+    struct timeval  adapt_time;     ///< time of last sizing decision
+    uint            adapt_high_water; ///< max buffer use since then
+    uint            adapt_iobound;  ///< Write() waits since then
+    uint            adapt_idle;     ///< consecutive mostly idle intervals
+    uint64_t        adapt_bytes_in; ///< bytes added by Write() since then
+    uint64_t        adapt_bytes_out;///< bytes written to disk since then
+    uint64_t        adapt_usec_out; ///< time spent writing them
+
+    static QMutex   s_stats_lock;
+    static TFWStats s_stats;
+    static uint     s_write_latency[24];
+    static uint     s_write_count;
 
     // threads
     pthread_t       writer;
@@ -84,6 +142,10 @@ class ThreadedFileWriter
     static const uint TFW_MAX_WRITE_SIZE;
     /// Minimum to write to disk in a single write, when not flushing buffer.
     static const uint TFW_MIN_WRITE_SIZE;
+    /// Buffer, offset and size alignment needed for O_DIRECT writes.
+    static const uint TFW_DIRECT_ALIGN;
+    /// Largest size the buffer is allowed to grow to.
+    static const uint TFW_MAX_BUF_SIZE;
 };
 
 #endif
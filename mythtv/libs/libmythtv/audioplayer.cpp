@@ -10,7 +10,7 @@ AudioPlayer::AudioPlayer(MythPlayer *parent, bool muted)
     m_samplerate(44100), m_stretchfactor(1.0f), m_passthru(false),
     m_lock(QMutex::Recursive), m_muted_on_creation(muted), 
     m_main_device(QString::null), m_passthru_device(QString::null),
-    no_audio_in(false), no_audio_out(false)
+    no_audio_in(false), no_audio_out(false), m_listener(NULL)
 {
 }
 
@@ -336,8 +336,30 @@ bool AudioPlayer::CanDownmix(void)
     return m_audioOutput->CanDownmix();
 }
 
+/** \fn AudioPlayer::SetAudioDataListener(AudioDataListener*)
+ *  \brief Hands all decoded audio except passthrough data to listener,
+ *         even when no AudioOutput is open. Pass NULL to stop.
+ */
+void AudioPlayer::SetAudioDataListener(AudioDataListener *listener)
+{
+    QMutexLocker locker(&m_lock);
+    m_listener = listener;
+}
+
+bool AudioPlayer::HasAudioDataListener(void) const
+{
+    QMutexLocker locker(&m_lock);
+    return m_listener != NULL;
+}
+
 void AudioPlayer::AddAudioData(char *buffer, int len, int64_t timecode)
 {
+    m_lock.lock();
+    if (m_listener && !m_passthru)
+        m_listener->AddAudioData(buffer, len, timecode, m_format,
+                                 m_channels, m_samplerate);
+    m_lock.unlock();
+
     if (!m_audioOutput)
         return;
     if (m_parent->PrepareAudioSample(timecode) && !no_audio_out)
@@ -6,6 +6,22 @@
 class MythPlayer;
 class AudioOutput;
 
+/** \class AudioDataListener
+ *  \brief Receives the audio decoded for a MythPlayer, whether or not
+ *         there is an AudioOutput playing it.
+ */
+class MPUBLIC AudioDataListener
+{
+  public:
+    virtual ~AudioDataListener() {}
+
+    /// Called on the decoder thread with len bytes of interleaved
+    /// samples beginning at timecode (in ms).
+    virtual void AddAudioData(const char *buffer, int len, int64_t timecode,
+                              AudioFormat format, int channels,
+                              int samplerate) = 0;
+};
+
 class MPUBLIC AudioPlayer
 {
   public:
@@ -53,6 +69,8 @@ class MPUBLIC AudioPlayer
     MuteState IncrMuteState(void);
 
     void AddAudioData(char *buffer, int len, int64_t timecode);
+    void SetAudioDataListener(AudioDataListener *listener);
+    bool HasAudioDataListener(void) const;
     bool GetBufferStatus(uint &fill, uint &total);
     bool IsBufferAlmostFull(void);
 
@@ -66,12 +84,13 @@ class MPUBLIC AudioPlayer
     int          m_samplerate;
     float        m_stretchfactor;
     bool         m_passthru;
-    QMutex       m_lock;
+    mutable QMutex m_lock;
     bool         m_muted_on_creation;
     QString      m_main_device;
     QString      m_passthru_device;
     bool         no_audio_in;
     bool         no_audio_out;
+    AudioDataListener *m_listener;
 };
 
 #endif // AUDIOPLAYER_H
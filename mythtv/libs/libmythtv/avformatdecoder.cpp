@@ -79,6 +79,10 @@ static const float eps = 1E-5;
 
 static const int max_video_queue_size = 180;
 
+/// Largest gap between decoded frames, in frames, which is taken to be
+/// made of discarded non-reference frames (kAVSpecialDecode_SkipNonRef)
+static const long long kMaxSkippedNonRefFrames = 4;
+
 static int cc608_parity(uint8_t byte);
 static int cc608_good_parity(const int *parity_table, uint16_t data);
 static void cc608_build_parity_table(int *parity_table);
@@ -531,6 +535,15 @@ bool AvFormatDecoder::DoRewind(long long desiredFrame, bool discardFrames)
     return DoFastForward(desiredFrame, discardFrames);
 }
 
+long long AvFormatDecoder::GetSeekPosition(long long desiredFrame)
+{
+    // without a position map seeks are made by libavformat
+    if (recordingHasPositionMap || livetv)
+        return DecoderBase::GetSeekPosition(desiredFrame);
+
+    return -1;
+}
+
 bool AvFormatDecoder::DoFastForward(long long desiredFrame, bool discardFrames)
 {
     VERBOSE(VB_PLAYBACK, LOC +
@@ -1338,6 +1351,16 @@ void AvFormatDecoder::InitVideoCodec(AVStream *stream, AVCodecContext *enc,
         {
             enc->skip_idct = AVDISCARD_ALL;
         }
+
+        // Only the luma plane is wanted, decoders built with gray
+        // support skip the chroma IDCT and motion compensation.
+        if (special_decode & kAVSpecialDecode_GrayOnly)
+            enc->flags |= CODEC_FLAG_GRAY;
+
+        // Frames nothing else references (e.g. most B frames) are not
+        // decoded at all, see ProcessVideoPacket() for the numbering.
+        if (special_decode & kAVSpecialDecode_SkipNonRef)
+            enc->skip_frame = AVDISCARD_NONREF;
     }
 
     if (selectedStream)
@@ -3063,18 +3086,34 @@ bool AvFormatDecoder::ProcessVideoPacket(AVStream *curstream, AVPacket *pkt)
         tmppicture.linesize[2] = picframe->pitches[2];
 
         QSize dim = get_video_dim(*context);
-        sws_ctx = sws_getCachedContext(sws_ctx, context->width,
-                                       context->height, context->pix_fmt,
-                                       context->width, context->height,
-                                       PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
-                                       NULL, NULL, NULL);
-        if (!sws_ctx)
+        if ((special_decode & kAVSpecialDecode_GrayOnly) &&
+            ((PIX_FMT_YUV420P  == context->pix_fmt) ||
+             (PIX_FMT_YUVJ420P == context->pix_fmt)))
         {
-            VERBOSE(VB_IMPORTANT, LOC_ERR + "Failed to allocate sws context");
-            return false;
+            // The chroma planes are not wanted, just copy the luma plane
+            for (int y = 0; y < dim.height(); y++)
+            {
+                memcpy(tmppicture.data[0] + y * tmppicture.linesize[0],
+                       mpa_pic.data[0] + y * mpa_pic.linesize[0],
+                       context->width);
+            }
+        }
+        else
+        {
+            sws_ctx = sws_getCachedContext(sws_ctx, context->width,
+                                           context->height, context->pix_fmt,
+                                           context->width, context->height,
+                                           PIX_FMT_YUV420P, SWS_FAST_BILINEAR,
+                                           NULL, NULL, NULL);
+            if (!sws_ctx)
+            {
+                VERBOSE(VB_IMPORTANT, LOC_ERR +
+                        "Failed to allocate sws context");
+                return false;
+            }
+            sws_scale(sws_ctx, mpa_pic.data, mpa_pic.linesize, 0,
+                      dim.height(), tmppicture.data, tmppicture.linesize);
         }
-        sws_scale(sws_ctx, mpa_pic.data, mpa_pic.linesize, 0, dim.height(),
-                  tmppicture.data, tmppicture.linesize);
 
 
         if (xf)
@@ -3180,6 +3219,17 @@ bool AvFormatDecoder::ProcessVideoPacket(AVStream *curstream, AVPacket *pkt)
     }
 */
 
+    // Frames skipped by the decoder still count, so that frame numbers
+    // match the position map. Repeated fields add half a frame at most.
+    if ((special_decode & kAVSpecialDecode_SkipNonRef) && lastvpts > 0 &&
+        temppts > lastvpts && fps > 0)
+    {
+        long long skipped =
+            (long long)floor((temppts - lastvpts) * fps / 1000.0 + 0.25) - 1;
+        if (skipped > 0 && skipped <= kMaxSkippedNonRefFrames)
+            framesPlayed += skipped;
+    }
+
     picframe->interlaced_frame = mpa_pic.interlaced_frame;
     picframe->top_field_first  = mpa_pic.top_field_first;
     picframe->repeat_pict      = mpa_pic.repeat_pict;
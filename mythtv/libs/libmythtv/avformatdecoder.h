@@ -155,6 +155,7 @@ class AvFormatDecoder : public DecoderBase
     virtual long long GetChapter(int chapter);
     virtual bool DoRewind(long long desiredFrame, bool doflush = true);
     virtual bool DoFastForward(long long desiredFrame, bool doflush = true);
+    virtual long long GetSeekPosition(long long desiredFrame);
 
     virtual int64_t NormalizeVideoTimecode(int64_t timecode);
     virtual int64_t NormalizeVideoTimecode(AVStream *st, int64_t timecode);
@@ -135,6 +135,33 @@ bool CommBreakMap::IsInCommBreak(uint64_t frameNumber)
     return false;
 }
 
+/// Finds the next commercial break starting at or after framesPlayed and
+/// the frame a skip over it would land on.
+bool CommBreakMap::GetNextSkip(uint64_t framesPlayed, double video_frame_rate,
+                               uint64_t &breakStart, uint64_t &jumpToFrame)
+{
+    QMutexLocker locker(&commBreakMapLock);
+    if (!hascommbreaktable)
+        return false;
+
+    frm_dir_map_t::Iterator it = commBreakMap.lowerBound(framesPlayed);
+    while (it != commBreakMap.end() && *it != MARK_COMM_START)
+        ++it;
+    if (it == commBreakMap.end())
+        return false;
+
+    breakStart = it.key();
+
+    while (it != commBreakMap.end() && *it != MARK_COMM_END)
+        ++it;
+    if (it == commBreakMap.end())
+        return false;
+
+    uint64_t rewind = (uint64_t)(commrewindamount * video_frame_rate);
+    jumpToFrame = (it.key() > rewind) ? it.key() - rewind : 0;
+    return true;
+}
+
 void CommBreakMap::SetMap(const frm_dir_map_t &newMap, uint64_t framesPlayed)
 {
     QMutexLocker locker(&commBreakMapLock);
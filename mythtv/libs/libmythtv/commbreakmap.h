@@ -27,6 +27,8 @@ class CommBreakMap
     void LoadMap(PlayerContext *player_ctx, uint64_t framesPlayed);
 
     bool IsInCommBreak(uint64_t frameNumber);
+    bool GetNextSkip(uint64_t framesPlayed, double video_frame_rate,
+                     uint64_t &breakStart, uint64_t &jumpToFrame);
     bool AutoCommercialSkip(uint64_t &jumpToFrame, uint64_t framesPlayed,
                             double video_frame_rate, uint64_t totalFrames,
                             QString &comm_msg);
@@ -447,6 +447,27 @@ bool DecoderBase::FindPosition(long long desired_value, bool search_adjusted,
     return false;
 }
 
+/** \fn DecoderBase::GetSeekPosition(long long)
+ *  \brief Returns the stream position a seek to desiredFrame would
+ *         resume reading from, or -1 if it can not be determined
+ *         without seeking.
+ */
+long long DecoderBase::GetSeekPosition(long long desiredFrame)
+{
+    if (ringBuffer->IsDVD() || ringBuffer->IsBD() || !GetPositionMapSize())
+        return -1;
+
+    int pre_idx, post_idx;
+    FindPosition(desiredFrame, hasKeyFrameAdjustTable, pre_idx, post_idx);
+
+    QMutexLocker locker(&m_positionMapLock);
+    uint pos_idx = min(pre_idx, post_idx);
+    while (pos_idx < m_positionMap.size() && m_positionMap[pos_idx].pos < 0)
+        pos_idx++;
+
+    return (pos_idx < m_positionMap.size()) ? m_positionMap[pos_idx].pos : -1;
+}
+
 uint64_t DecoderBase::SavePositionMapDelta(uint64_t first, uint64_t last)
 {
     MythTimer ttm, ctm, stm;
@@ -48,6 +48,7 @@ class DeleteMap
 
     void TrackerReset(uint64_t frame, uint64_t total);
     bool TrackerWantsToJump(uint64_t frame, uint64_t total, uint64_t &to);
+    uint64_t TrackerNextCutStart(void) const { return m_nextCutStart; }
 
   private:
     void Add(uint64_t frame, MarkTypes type);
@@ -10,6 +10,7 @@
 #include "mpegtables.h"
 #include "mpegstreamdata.h"
 #include "dtvrecorder.h"
+#include "inlinecommflagger.h"
 #include "tv_rec.h"
 #include "mythverbose.h"
 
@@ -56,6 +57,9 @@ DTVRecorder::DTVRecorder(TVRec *rec) :
     _buffer(0),                     _buffer_size(0),
     // keyframe TS buffer
     _buffer_packets(false),
+    _queued_write(NULL),            _queued_write_size(0),
+    // commercial flagging while recording
+    _comm_flagger(NULL),            _comm_flagger_pmt_version(-1),
     // statistics
     _frames_seen_count(0),          _frames_written_count(0)
 {
@@ -65,6 +69,7 @@ DTVRecorder::DTVRecorder(TVRec *rec) :
 
 DTVRecorder::~DTVRecorder()
 {
+    FinishInlineCommFlagging();
     SetStreamData(NULL);
 }
 
@@ -114,14 +119,19 @@ void DTVRecorder::SetOption(const QString &name, int value)
  */
 void DTVRecorder::FinishRecording(void)
 {
+    FlushQueuedWrite();
+
     if (ringBuffer)
     {
         if (_payload_buffer.size())
         {
-            ringBuffer->Write(&_payload_buffer[0], _payload_buffer.size());
+            WriteToRingBuffer(&_payload_buffer[0], _payload_buffer.size());
             _payload_buffer.clear();
         }
         ringBuffer->WriterFlush();
+
+        VERBOSE(VB_RECORD, LOC + QString("Disk write latency: %1")
+                .arg(ringBuffer->GetWriterStats()));
     }
 
     if (curRecording)
@@ -130,6 +140,8 @@ void DTVRecorder::FinishRecording(void)
             curRecording->SaveFilesize(ringBuffer->GetRealFileSize());
         SavePositionMap(true);
     }
+
+    FinishInlineCommFlagging();
 //     positionMapLock.lock();
 //     positionMap.clear();
 //     positionMapDelta.clear();
@@ -206,17 +218,135 @@ void DTVRecorder::BufferedWrite(const TSPacket &tspacket)
         return;
     }
 
-    // We are free to write the packet, but if we have buffered packet[s]
-    // we have to write them first...
+    // We are free to write the packet, but if we have queued or
+    // buffered packet[s] we have to write them first...
+    FlushQueuedWrite();
+
     if (!_payload_buffer.empty())
     {
-        if (ringBuffer)
-            ringBuffer->Write(&_payload_buffer[0], _payload_buffer.size());
+        WriteToRingBuffer(&_payload_buffer[0], _payload_buffer.size());
         _payload_buffer.clear();
     }
 
-    if (ringBuffer)
-        ringBuffer->Write(tspacket.data(), TSPacket::SIZE);
+    WriteToRingBuffer(tspacket.data(), TSPacket::SIZE);
+}
+
+/** \fn DTVRecorder::QueueWrite(const unsigned char*,uint)
+ *  \brief Queues data for writing without copying it.
+ *
+ *   When several recorders share one stream handler they are all handed
+ *   packets straight out of the handler's read buffer. Rather than
+ *   writing every packet to the RingBuffer on its own, consecutive
+ *   packets are only referenced here and written as one extent when the
+ *   run ends, or when FlushQueuedWrite() is called before the shared
+ *   buffer is reused.
+ */
+void DTVRecorder::QueueWrite(const unsigned char *data, uint size)
+{
+    if (_queued_write && (_queued_write + _queued_write_size == data))
+    {
+        _queued_write_size += size;
+        return;
+    }
+
+    FlushQueuedWrite();
+
+    _queued_write      = data;
+    _queued_write_size = size;
+}
+
+void DTVRecorder::FlushQueuedWrite(void)
+{
+    if (_queued_write)
+        WriteToRingBuffer(_queued_write, _queued_write_size);
+
+    _queued_write      = NULL;
+    _queued_write_size = 0;
+}
+
+/** \fn DTVRecorder::WriteToRingBuffer(const unsigned char*,uint)
+ *  \brief Writes TS packets to the RingBuffer, and hands them to the
+ *         commercial flagger when flagging while recording.
+ */
+void DTVRecorder::WriteToRingBuffer(const unsigned char *data, uint size)
+{
+    if (!ringBuffer)
+        return;
+
+    ringBuffer->Write(data, size);
+
+    if (_comm_flagger)
+    {
+        UpdateCommFlaggerStreams();
+        _comm_flagger->AddData(data, size);
+    }
+}
+
+/** \fn DTVRecorder::EnableInlineCommFlagging(void)
+ *  \brief Flags commercials from the TS packets written to the recording
+ *         instead of with a separate commercial flagging job.
+ *
+ *   This must be called after SetRecording() and before the recorder
+ *   is started, so the frame numbers match those of the file. After
+ *   FinishRecording() the flagger saves the break list with the
+ *   recording on its own thread, or queues a commercial flagging job
+ *   if it could not analyze the recording.
+ */
+void DTVRecorder::EnableInlineCommFlagging(void)
+{
+    if (_comm_flagger || !curRecording)
+        return;
+
+    VERBOSE(VB_RECORD, LOC + "Flagging commercials while recording");
+
+    _comm_flagger             = new InlineCommFlagger(*curRecording);
+    _comm_flagger_pmt_version = -1;
+
+    curRecording->SaveCommFlagged(COMM_FLAG_PROCESSING);
+}
+
+/// Tells the commercial flagger which streams to analyze whenever
+/// the PMT written to the recording changes.
+void DTVRecorder::UpdateCommFlaggerStreams(void)
+{
+    if (!_stream_data)
+        return;
+
+    int version = _stream_data->VersionPMTSingleProgram();
+    const ProgramMapTable *pmt = _stream_data->PMTSingleProgram();
+    if (!pmt || (version == _comm_flagger_pmt_version))
+        return;
+
+    _comm_flagger_pmt_version = version;
+
+    uint video_pid = 0, video_type = 0, audio_pid = 0, audio_type = 0;
+    for (uint i = 0; i < pmt->StreamCount(); i++)
+    {
+        uint type = pmt->StreamType(i);
+        if (!video_pid && StreamID::IsVideo(type))
+        {
+            video_pid  = pmt->StreamPID(i);
+            video_type = type;
+        }
+        else if (!audio_pid && StreamID::IsAudio(type))
+        {
+            audio_pid  = pmt->StreamPID(i);
+            audio_type = type;
+        }
+    }
+
+    _comm_flagger->SetStreams(video_pid, video_type, audio_pid, audio_type);
+}
+
+/// Hands the rest of the flagging over to the flagger's own thread,
+/// the flagger deletes itself when it is done.
+void DTVRecorder::FinishInlineCommFlagging(void)
+{
+    if (!_comm_flagger)
+        return;
+
+    _comm_flagger->Finish(_frames_written_count);
+    _comm_flagger = NULL;
 }
 
 static const uint frameRateMap[16] = {
@@ -469,7 +599,7 @@ void DTVRecorder::HandleKeyframe(uint64_t frameNum, int64_t extra)
     {
         long long startpos = ringBuffer->GetWritePosition();
         // FIXME: handle keyframes with start code spanning over two ts packets
-        startpos += _payload_buffer.size() - extra;
+        startpos += _queued_write_size + _payload_buffer.size() - extra;
 
         // Don't put negative offsets into the database, they get munged into
         // MAX_INT64 - offset, which is an exceedingly large number, and
@@ -585,8 +715,8 @@ bool DTVRecorder::FindH264Keyframes(const TSPacket *tspacket)
 
         uint32_t bytes_used = m_h264_parser.addBytes(
             tspacket->data() + i, TSPacket::SIZE - i,
-            ringBuffer->GetWritePosition() + _payload_buffer.size()
-            );
+            ringBuffer->GetWritePosition() + _queued_write_size +
+            _payload_buffer.size());
         i += (bytes_used - 1);
 
         if (m_h264_parser.stateChanged())
@@ -815,6 +945,7 @@ void DTVRecorder::FindPSKeyFrames(const uint8_t *buffer, uint len)
         {
             // We are free to write the packet, but if we have
             // buffered packet[s] we have to write them first...
+            FlushQueuedWrite();
             if (!_payload_buffer.empty())
             {
                 if (ringBuffer)
@@ -19,6 +19,7 @@ using namespace std;
 
 class MPEGStreamData;
 class TSPacket;
+class InlineCommFlagger;
 class QTime;
 
 class DTVRecorder: public RecorderBase
@@ -47,6 +48,8 @@ class DTVRecorder: public RecorderBase
 
     virtual void Reset();
 
+    void EnableInlineCommFlagging(void);
+
   protected:
     void FinishRecording(void);
     void ResetForNewFile(void);
@@ -55,6 +58,13 @@ class DTVRecorder: public RecorderBase
 
     void BufferedWrite(const TSPacket &tspacket);
 
+    void QueueWrite(const unsigned char *data, uint size);
+    void FlushQueuedWrite(void);
+    void WriteToRingBuffer(const unsigned char *data, uint size);
+
+    void UpdateCommFlaggerStreams(void);
+    void FinishInlineCommFlagging(void);
+
     // MPEG TS "audio only" support
     bool FindAudioKeyframes(const TSPacket *tspacket);
 
@@ -115,6 +125,15 @@ class DTVRecorder: public RecorderBase
     bool                  _buffer_packets;
     vector<unsigned char> _payload_buffer;
 
+    // zero copy writes from a buffer shared with other recorders,
+    // only valid until the owner of the buffer calls FlushQueuedWrite()
+    const unsigned char  *_queued_write;
+    uint                  _queued_write_size;
+
+    // commercial flagging while recording
+    InlineCommFlagger    *_comm_flagger;
+    int                   _comm_flagger_pmt_version;
+
     // statistics
     unsigned long long _frames_seen_count;
     unsigned long long _frames_written_count;
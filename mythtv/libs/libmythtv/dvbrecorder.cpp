@@ -555,11 +555,14 @@ void DVBRecorder::BufferedWrite(const TSPacket &tspacket)
     // we have to write them first...
     if (!_payload_buffer.empty())
     {
-        if (ringBuffer)
-            ringBuffer->Write(&_payload_buffer[0], _payload_buffer.size());
+        FlushQueuedWrite();
+        WriteToRingBuffer(&_payload_buffer[0], _payload_buffer.size());
         _payload_buffer.clear();
     }
 
-    if (ringBuffer)
-        ringBuffer->Write(tspacket.data(), TSPacket::SIZE);
+    // The packet lives in the stream handler's read buffer, which is
+    // shared with every other recorder on this multiplex, so only
+    // reference it; MPEGStreamData::ProcessData() calls FlushTSPackets()
+    // before the buffer is reused.
+    QueueWrite(tspacket.data(), TSPacket::SIZE);
 }
@@ -85,6 +85,7 @@ class DVBRecorder :
 
     // TSPacketListener
     bool ProcessTSPacket(const TSPacket &tspacket);
+    void FlushTSPackets(void) { FlushQueuedWrite(); }
 
     // TSPacketListenerAV
     bool ProcessVideoTSPacket(const TSPacket& tspacket);
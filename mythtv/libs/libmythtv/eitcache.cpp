@@ -83,29 +83,6 @@ static inline bool modified(uint64_t sig)
     return sig >> 63;
 }
 
-static void replace_in_db(int chanid, uint eventid, uint64_t sig)
-{
-
-    MSqlQuery query(MSqlQuery::InitCon());
-
-    QString qstr =
-        "REPLACE INTO eit_cache "
-        "       ( chanid,  eventid,  tableid,  version,  endtime) "
-        "VALUES (:CHANID, :EVENTID, :TABLEID, :VERSION, :ENDTIME)";
-
-    query.prepare(qstr);
-    query.bindValue(":CHANID",   chanid);
-    query.bindValue(":EVENTID",  eventid);
-    query.bindValue(":TABLEID",  extract_table_id(sig));
-    query.bindValue(":VERSION",  extract_version(sig));
-    query.bindValue(":ENDTIME",  extract_endtime(sig));
-
-    if (!query.exec())
-        MythDB::DBError("Error updating eitcache", query);
-
-    return;
-}
-
 static void delete_in_db(uint endtime)
 {
     VERBOSE(VB_EIT, LOC + "Deleting old cache entries from the database");
@@ -273,17 +250,26 @@ void EITCache::WriteChannelToDB(uint chanid)
     uint size    = eventMap->size();
     uint updated = 0;
 
+    MSqlQuery query(MSqlQuery::InitCon());
+    MSqlBulkInsert bulk(query, "REPLACE INTO eit_cache",
+                        QStringList() << "chanid" << "eventid" << "tableid"
+                                      << "version" << "endtime");
+
     event_map_t::iterator it = eventMap->begin();
     while (it != eventMap->end())
     {
         if (modified(*it) && extract_endtime(*it) > lastPruneTime)
         {
-            replace_in_db(chanid, it.key(), *it);
+            bulk.AddRow(QVariantList() << chanid << it.key()
+                        << extract_table_id(*it) << extract_version(*it)
+                        << extract_endtime(*it));
             updated++;
             *it &= ~(uint64_t)0 >> 1; // mark as synced
         }
         it++;
     }
+
+    bulk.Flush();
     unlock_channel(chanid, updated);
 
     if (updated)
@@ -478,11 +478,9 @@ void HDHRRecorder::BufferedWrite(const TSPacket &tspacket)
     // we have to write them first...
     if (!_payload_buffer.empty())
     {
-        if (ringBuffer)
-            ringBuffer->Write(&_payload_buffer[0], _payload_buffer.size());
+        WriteToRingBuffer(&_payload_buffer[0], _payload_buffer.size());
         _payload_buffer.clear();
     }
 
-    if (ringBuffer)
-        ringBuffer->Write(tspacket.data(), TSPacket::SIZE);
+    WriteToRingBuffer(tspacket.data(), TSPacket::SIZE);
 }
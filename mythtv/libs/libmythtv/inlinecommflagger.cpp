@@ -0,0 +1,957 @@
+// -*- Mode: c++ -*-
+
+#include <cmath>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include "inlinecommflagger.h"
+#include "mpegtables.h"
+#include "recordinginfo.h"
+#include "jobqueue.h"
+#include "remoteutil.h"
+#include "mythcorecontext.h"
+#include "mythverbose.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+}
+
+#define LOC      QString("InlineCommFlag(%1): ").arg(m_key)
+#define LOC_WARN QString("InlineCommFlag(%1) Warning: ").arg(m_key)
+
+/// Data the flagger may fall behind the recorder by before giving up
+const uint InlineCommFlagger::kMaxQueuedBytes = 32 * 1024 * 1024;
+/// Packets are handed to the flagging thread in chunks of this size
+const uint InlineCommFlagger::kChunkSize      = TSPacket::SIZE * 256;
+
+/// Percentage of the frames written which must be analyzed for the
+/// break list to be kept, frames before the first keyframe can't be
+static const int     kMinCoverage     = 90;
+
+/// lowres decoding factor used for MPEG-2 video
+static const int     kLowRes          = 2;
+/// Number of rows and columns sampled when looking for blank frames
+static const int     kSampleLines     = 128;
+/// RMS sample value below which an audio frame is silent
+static const int     kSilenceLevel    = 128;
+/// How far apart a blank frame and silence may be and still coincide
+static const int64_t kSilenceSlack    = 90000 / 4;
+/// How long video may be ahead of audio before blank frames are used alone
+static const int64_t kAudioTimeout    = 10 * 90000;
+/// Spots in a break closer together than this are in the same break
+static const int64_t kMaxBreakGap     = 15 * 90000;
+/// A first break starting within this of the start begins at frame 0
+static const int64_t kLeadIn          = 30 * 90000;
+static const int64_t kPTSWrap         = (int64_t)1 << 33;
+
+/// Commercial lengths in seconds and how close a gap between separators
+/// must be to one to be taken for a commercial, see
+/// ClassicCommDetector::BuildBlankFrameCommList()
+static const struct { int length; float tolerance; } kSpotLengths[] =
+{
+    {   5, 0.37f }, {  10, 0.43f }, {  15, 0.53f }, {  20, 0.57f },
+    {  30, 0.60f }, {  40, 0.10f }, {  45, 0.10f }, {  60, 0.67f },
+    {  90, 0.67f }, { 120, 0.67f },
+};
+static const uint kSpotLengthCount =
+    sizeof(kSpotLengths) / sizeof(kSpotLengths[0]);
+/// No separators further apart than this are the ends of a commercial
+static const int64_t kMaxSpotLength   = 121 * 90000;
+
+static bool is_spot_length(int64_t gap)
+{
+    float secs = gap / 90000.0f;
+    for (uint i = 0; i < kSpotLengthCount; i++)
+    {
+        if (fabsf(secs - kSpotLengths[i].length) < kSpotLengths[i].tolerance)
+            return true;
+    }
+    return false;
+}
+
+InlineCommFlagger::InlineCommFlagger(const ProgramInfo &pginfo) :
+    m_key(pginfo.MakeUniqueKey()),
+    m_chanid(pginfo.GetChanID()),
+    m_recstartts(pginfo.GetRecordingStartTime()),
+    m_queuedBytes(0),
+    m_finishing(false),             m_framesWritten(0),
+    m_overflowed(false),
+    m_updateRequested(false),
+    m_frame(NULL),                  m_samples(NULL),
+    m_lastPts(AV_NOPTS_VALUE),      m_firstVideoPts(AV_NOPTS_VALUE),
+    m_lastVideoPts(AV_NOPTS_VALUE), m_videoFrameDuration(3003),
+    m_audioEndPts(AV_NOPTS_VALUE),  m_framesAnalyzed(0),
+    m_lastFrame(-1),
+    m_commBreakMapChanged(false)
+{
+    m_border =
+        gCoreContext->GetNumSetting("CommDetectBorder", 20);
+    m_maxDiff =
+        gCoreContext->GetNumSetting("CommDetectBlankFrameMaxDiff", 25);
+    m_darkBrightness =
+        gCoreContext->GetNumSetting("CommDetectDarkBrightness", 80);
+    m_dimBrightness =
+        gCoreContext->GetNumSetting("CommDetectDimBrightness", 120);
+    m_minBreakLength =
+        gCoreContext->GetNumSetting("CommDetectMinCommBreakLength", 60);
+
+    m_pending.reserve(kChunkSize + TSPacket::SIZE);
+
+    {
+        QMutexLocker locker(avcodeclock);
+        avcodec_init();
+        avcodec_register_all();
+    }
+
+    // The recorder threads have no event loop, COMMFLAG_REQUEST events
+    // are handled by the application's.
+    moveToThread(QCoreApplication::instance()->thread());
+    gCoreContext->addListener(this);
+
+    // Nobody waits for the thread, see Finish()
+    connect(this, SIGNAL(finished()), this, SLOT(deleteLater()));
+
+    start();
+}
+
+InlineCommFlagger::~InlineCommFlagger()
+{
+    gCoreContext->removeListener(this);
+
+    if (isRunning())
+    {
+        m_lock.lock();
+        m_finishing = true;
+        m_overflowed = true;
+        m_wait.wakeAll();
+        m_lock.unlock();
+        wait();
+    }
+}
+
+/** \fn InlineCommFlagger::SetStreams(uint,uint,uint,uint)
+ *  \brief Sets the PIDs and stream types of the video and audio stream
+ *         to analyze, applies to the data added after this call.
+ */
+void InlineCommFlagger::SetStreams(uint video_pid, uint video_type,
+                                   uint audio_pid, uint audio_type)
+{
+    FlushPending();
+
+    Chunk chunk;
+    chunk.streams    = true;
+    chunk.video_pid  = video_pid;
+    chunk.video_type = video_type;
+    chunk.audio_pid  = audio_pid;
+    chunk.audio_type = audio_type;
+    QueueChunk(chunk);
+}
+
+/** \fn InlineCommFlagger::AddData(const unsigned char*,uint)
+ *  \brief Adds TS packets written to the recording. This never blocks
+ *         on the flagging thread.
+ */
+void InlineCommFlagger::AddData(const unsigned char *data, uint size)
+{
+    m_pending.append((const char*) data, size);
+    if ((uint)m_pending.size() >= kChunkSize)
+        FlushPending();
+}
+
+void InlineCommFlagger::FlushPending(void)
+{
+    if (m_pending.isEmpty())
+        return;
+
+    Chunk chunk;
+    chunk.data = m_pending;
+    m_pending = QByteArray();
+    m_pending.reserve(kChunkSize + TSPacket::SIZE);
+    QueueChunk(chunk);
+}
+
+void InlineCommFlagger::QueueChunk(const Chunk &chunk)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (m_overflowed || m_finishing)
+        return;
+
+    if (m_queuedBytes + chunk.data.size() > kMaxQueuedBytes)
+    {
+        VERBOSE(VB_IMPORTANT, LOC_WARN +
+                "Flagging has fallen too far behind the recording, "
+                "giving up.");
+        m_overflowed = true;
+        m_queue.clear();
+        m_queuedBytes = 0;
+        m_wait.wakeAll();
+        return;
+    }
+
+    m_queue.push_back(chunk);
+    m_queuedBytes += chunk.data.size();
+    m_wait.wakeAll();
+}
+
+/** \fn InlineCommFlagger::Finish(long long)
+ *  \brief Tells the flagging thread the recording is done, without
+ *         waiting for it to analyze the data still queued.
+ *
+ *   The thread saves the result, see SaveResult(), and then the flagger
+ *   deletes itself, so it must not be used after this call.
+ *  \param framesWritten number of frames in the recording, 0 if unknown
+ */
+void InlineCommFlagger::Finish(long long framesWritten)
+{
+    FlushPending();
+
+    QMutexLocker locker(&m_lock);
+    m_framesWritten = framesWritten;
+    m_finishing = true;
+    m_wait.wakeAll();
+}
+
+void InlineCommFlagger::GetCommBreakMap(frm_dir_map_t &map) const
+{
+    QMutexLocker locker(&m_lock);
+    map = m_commBreakMap;
+}
+
+void InlineCommFlagger::customEvent(QEvent *e)
+{
+    if ((MythEvent::Type)(e->type()) != MythEvent::MythEventMessage)
+        return;
+
+    MythEvent *me = (MythEvent *)e;
+    QStringList tokens = me->Message().simplified()
+        .split(" ", QString::SkipEmptyParts);
+
+    // The master passes requests on to slave backends as LOCAL_ events
+    if ((tokens.size() < 2) || ((tokens[0] != "COMMFLAG_REQUEST") &&
+                                (tokens[0] != "LOCAL_COMMFLAG_REQUEST")))
+        return;
+
+    uint chanid = 0;
+    QDateTime recstartts;
+    ProgramInfo::ExtractKey(tokens[1], chanid, recstartts);
+    if ((chanid != m_chanid) || (recstartts != m_recstartts))
+        return;
+
+    QMutexLocker locker(&m_lock);
+    m_updateRequested = true;
+    m_wait.wakeAll();
+}
+
+void InlineCommFlagger::run(void)
+{
+    VERBOSE(VB_COMMFLAG, LOC + "Starting");
+
+    m_frame   = avcodec_alloc_frame();
+    m_samples = (int16_t*) av_malloc(AVCODEC_MAX_AUDIO_FRAME_SIZE);
+
+    QMutexLocker locker(&m_lock);
+    while (true)
+    {
+        // The recorder may still be adding data, so don't go away
+        // before it is done with us.
+        if (m_overflowed)
+        {
+            if (m_finishing)
+                break;
+            m_wait.wait(&m_lock);
+            continue;
+        }
+
+        if (m_updateRequested || m_commBreakMapChanged)
+        {
+            m_updateRequested     = false;
+            m_commBreakMapChanged = false;
+            locker.unlock();
+            SendCommBreakMap();
+            locker.relock();
+            continue;
+        }
+
+        if (m_queue.empty())
+        {
+            if (m_finishing)
+                break;
+            m_wait.wait(&m_lock);
+            continue;
+        }
+
+        Chunk chunk = m_queue.takeFirst();
+        m_queuedBytes -= chunk.data.size();
+        locker.unlock();
+
+        if (chunk.streams)
+        {
+            OpenStreams(chunk);
+        }
+        else
+        {
+            ProcessData(chunk.data);
+            DecideBlankRuns(false);
+        }
+
+        locker.relock();
+    }
+    bool overflowed = m_overflowed;
+    long long framesWritten = m_framesWritten;
+    locker.unlock();
+
+    if (!overflowed)
+    {
+        Drain();
+        DecideBlankRuns(true);
+        SendCommBreakMap();
+    }
+
+    CloseStreams();
+
+    av_free(m_frame);
+    m_frame = NULL;
+    av_free(m_samples);
+    m_samples = NULL;
+
+    VERBOSE(VB_COMMFLAG, LOC + QString("Done, analyzed %1 of %2 frames")
+            .arg(m_framesAnalyzed).arg(framesWritten));
+
+    SaveResult(!overflowed && (m_framesAnalyzed > 0) &&
+               (m_framesAnalyzed * 100 >= framesWritten * kMinCoverage));
+}
+
+/** \fn InlineCommFlagger::SaveResult(bool)
+ *  \brief Saves the break list with the recording, or queues a commercial
+ *         flagging job for it when the recording was not analyzed.
+ *
+ *   The job TVRec queued to run after the recording, in case the backend
+ *   went away before we got here, is removed or replaced.
+ */
+void InlineCommFlagger::SaveResult(bool analyzed)
+{
+    RecordingInfo recinfo(m_chanid, m_recstartts);
+    if (!recinfo.GetChanID())
+        return;
+
+    bool queued = JobQueue::IsJobQueued(JOB_COMMFLAG, m_chanid, m_recstartts);
+
+    if (analyzed)
+    {
+        frm_dir_map_t breaks;
+        GetCommBreakMap(breaks);
+
+        VERBOSE(VB_COMMFLAG, LOC + QString("Flagged %1 commercial breaks "
+                                           "while recording")
+                .arg(breaks.size() / 2));
+
+        recinfo.SaveMarkupFlag(MARK_UPDATED_CUT);
+        recinfo.SaveCommBreakList(breaks);
+        recinfo.SaveCommFlagged(COMM_FLAG_DONE);
+
+        if (queued)
+        {
+            JobQueue::DeleteJob(
+                JobQueue::GetJobID(JOB_COMMFLAG, m_chanid, m_recstartts));
+        }
+        return;
+    }
+
+    VERBOSE(VB_IMPORTANT, LOC_WARN + "Could not flag commercials while "
+            "recording, falling back on a commercial flagging job.");
+    recinfo.SaveCommFlagged(COMM_FLAG_NOT_FLAGGED);
+
+    // TVRec::TeardownRecorder() runs no jobs for very short recordings,
+    // otherwise this replaces the job queued to run later
+    if (m_recstartts.secsTo(QDateTime::currentDateTime()) >= 120)
+    {
+        JobQueue::QueueRecordingJobs(recinfo, JOB_COMMFLAG);
+    }
+    else if (queued)
+    {
+        JobQueue::DeleteJob(
+            JobQueue::GetJobID(JOB_COMMFLAG, m_chanid, m_recstartts));
+    }
+}
+
+void InlineCommFlagger::OpenStreams(const Chunk &chunk)
+{
+    if ((chunk.video_pid == m_video.pid) && (chunk.audio_pid == m_audio.pid))
+        return;
+
+    Drain();
+    CloseStreams();
+
+    if (chunk.video_pid)
+        OpenStream(m_video, chunk.video_pid, chunk.video_type, true);
+    if (chunk.audio_pid)
+        OpenStream(m_audio, chunk.audio_pid, chunk.audio_type, false);
+
+    VERBOSE(VB_COMMFLAG, LOC + QString("Video PID 0x%1%2, audio PID 0x%3%4")
+            .arg(m_video.pid, 0, 16).arg(m_video.ctx ? "" : " (unused)")
+            .arg(m_audio.pid, 0, 16).arg(m_audio.ctx ? "" : " (unused)"));
+}
+
+bool InlineCommFlagger::OpenStream(ElementaryStream &es, uint pid,
+                                   uint type, bool video)
+{
+    CodecID id = CODEC_ID_NONE;
+    switch (type)
+    {
+        case StreamID::MPEG1Video:
+        case StreamID::MPEG2Video:
+        case StreamID::OpenCableVideo:
+            id = CODEC_ID_MPEG2VIDEO;
+            break;
+        case StreamID::H264Video:
+            id = CODEC_ID_H264;
+            break;
+        case StreamID::MPEG1Audio:
+        case StreamID::MPEG2Audio:
+            id = CODEC_ID_MP2;
+            break;
+        case StreamID::AC3Audio:
+            id = CODEC_ID_AC3;
+            break;
+        case StreamID::AACAudio:
+            id = CODEC_ID_AAC;
+            break;
+        default:
+            break;
+    }
+
+    es.pid = pid;
+
+    AVCodec *codec = (id == CODEC_ID_NONE) ? NULL : avcodec_find_decoder(id);
+    if (!codec)
+    {
+        VERBOSE(VB_COMMFLAG, LOC + QString("Can not decode stream type %1")
+                .arg(StreamID::toString(type)));
+        return false;
+    }
+
+    es.ctx    = avcodec_alloc_context();
+    es.parser = av_parser_init(id);
+    es.pts    = AV_NOPTS_VALUE;
+    es.synced = false;
+
+    if (video)
+    {
+        // Only the luma matters and blank frames survive downscaling
+        es.ctx->flags           |= CODEC_FLAG_GRAY;
+        es.ctx->lowres           = min(kLowRes, (int)codec->max_lowres);
+        es.ctx->skip_loop_filter = AVDISCARD_ALL;
+    }
+
+    QMutexLocker locker(avcodeclock);
+    if (!es.parser || (avcodec_open(es.ctx, codec) < 0))
+    {
+        VERBOSE(VB_IMPORTANT, LOC_WARN + QString("Could not open %1 decoder")
+                .arg(codec->name));
+        if (es.parser)
+            av_parser_close(es.parser);
+        av_free(es.ctx);
+        es.ctx    = NULL;
+        es.parser = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void InlineCommFlagger::CloseStreams(void)
+{
+    CloseStream(m_video);
+    CloseStream(m_audio);
+}
+
+void InlineCommFlagger::CloseStream(ElementaryStream &es)
+{
+    if (es.ctx)
+    {
+        QMutexLocker locker(avcodeclock);
+        avcodec_close(es.ctx);
+        av_free(es.ctx);
+    }
+    if (es.parser)
+        av_parser_close(es.parser);
+
+    es = ElementaryStream();
+}
+
+void InlineCommFlagger::ProcessData(const QByteArray &data)
+{
+    const unsigned char *buf = (const unsigned char*) data.constData();
+    uint len = data.size();
+
+    for (uint i = 0; i + TSPacket::SIZE <= len;)
+    {
+        if (buf[i] != SYNC_BYTE)
+        {
+            i++;
+            continue;
+        }
+        ProcessPacket(buf + i);
+        i += TSPacket::SIZE;
+    }
+}
+
+void InlineCommFlagger::ProcessPacket(const unsigned char *pkt)
+{
+    uint pid   = ((pkt[1] & 0x1f) << 8) | pkt[2];
+    bool video = m_video.ctx && (pid == m_video.pid);
+    bool audio = m_audio.ctx && (pid == m_audio.pid);
+
+    // skip other PIDs, packets with errors, scrambled or without payload
+    if ((!video && !audio) || (pkt[1] & 0x80) || (pkt[3] & 0xc0) ||
+        !(pkt[3] & 0x10))
+    {
+        return;
+    }
+
+    ElementaryStream &es = (video) ? m_video : m_audio;
+
+    uint offset = 4;
+    if (pkt[3] & 0x20)
+        offset += 1 + pkt[4];
+    if (offset >= TSPacket::SIZE)
+        return;
+
+    const unsigned char *payload = pkt + offset;
+    uint len = TSPacket::SIZE - offset;
+
+    if (pkt[1] & 0x40)
+    {
+        // strip the PES header, keeping the PTS for the parser
+        es.synced = (len >= 9) && !payload[0] && !payload[1] &&
+            (payload[2] == 0x01) && (9u + payload[8] <= len);
+        if (!es.synced)
+            return;
+
+        if ((payload[7] & 0x80) && (len >= 14))
+        {
+            int64_t pts =
+                ((int64_t)(payload[ 9] & 0x0e) << 29) |
+                ((int64_t)(payload[10]       ) << 22) |
+                ((int64_t)(payload[11] & 0xfe) << 14) |
+                ((int64_t)(payload[12]       ) <<  7) |
+                ((int64_t)(payload[13]       ) >>  1);
+            es.pts = Unwrap(pts);
+
+            // The recorder starts the file on a keyframe, whose PES
+            // comes first, so this is the pts of its frame 0.
+            if (video && (m_firstVideoPts == (int64_t)AV_NOPTS_VALUE))
+                m_firstVideoPts = es.pts;
+        }
+
+        uint header_len = 9 + payload[8];
+        payload += header_len;
+        len     -= header_len;
+    }
+
+    if (es.synced && len)
+        ParsePayload(es, payload, len, video);
+}
+
+/** \fn InlineCommFlagger::ParsePayload(ElementaryStream&,const unsigned char*,uint,bool)
+ *  \brief Splits elementary stream data into frames and decodes them.
+ *
+ *   An empty buffer flushes the last frame out of the parser.
+ */
+void InlineCommFlagger::ParsePayload(
+    ElementaryStream &es, const unsigned char *buf, uint len, bool video)
+{
+    bool flush = !len;
+    while (len || flush)
+    {
+        uint8_t *out = NULL;
+        int outsize  = 0;
+        int used = av_parser_parse2(es.parser, es.ctx, &out, &outsize,
+                                    buf, len, es.pts, AV_NOPTS_VALUE, 0);
+        es.pts = AV_NOPTS_VALUE;
+        flush  = false;
+
+        if ((used < 0) || (!used && !outsize))
+            break;
+
+        buf += used;
+        len -= used;
+
+        if (outsize <= 0)
+            continue;
+
+        if (video)
+            DecodeVideo(out, outsize, es.parser->pts);
+        else
+            DecodeAudio(out, outsize, es.parser->pts);
+    }
+}
+
+bool InlineCommFlagger::DecodeVideo(uint8_t *buf, int size, int64_t pts)
+{
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = buf;
+    pkt.size = size;
+
+    int got_picture = 0;
+    m_video.ctx->reordered_opaque = pts;
+    int ret = avcodec_decode_video2(m_video.ctx, m_frame, &got_picture, &pkt);
+    if ((ret < 0) || !got_picture)
+        return false;
+
+    pts = m_frame->reordered_opaque;
+    if (pts == (int64_t)AV_NOPTS_VALUE)
+    {
+        pts = (m_lastVideoPts == (int64_t)AV_NOPTS_VALUE) ? m_lastPts :
+            m_lastVideoPts + m_videoFrameDuration;
+    }
+    else if ((m_lastVideoPts != (int64_t)AV_NOPTS_VALUE) &&
+             (pts > m_lastVideoPts) && (pts - m_lastVideoPts < 90000 / 10))
+    {
+        m_videoFrameDuration = pts - m_lastVideoPts;
+    }
+
+    AddVideoFrame(IsBlank(m_frame), pts);
+
+    return true;
+}
+
+void InlineCommFlagger::DecodeAudio(uint8_t *buf, int size, int64_t pts)
+{
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    pkt.data = buf;
+    pkt.size = size;
+
+    if (pts == (int64_t)AV_NOPTS_VALUE)
+        pts = m_audioEndPts;
+
+    while (pkt.size > 0)
+    {
+        int data_size = AVCODEC_MAX_AUDIO_FRAME_SIZE;
+        int ret = avcodec_decode_audio3(m_audio.ctx, m_samples,
+                                        &data_size, &pkt);
+        if (ret <= 0)
+            break;
+        pkt.data += ret;
+        pkt.size -= ret;
+
+        const AVCodecContext *ctx = m_audio.ctx;
+        if ((data_size <= 0) || (ctx->channels <= 0) ||
+            (ctx->sample_rate <= 0) || (ctx->sample_fmt != SAMPLE_FMT_S16))
+        {
+            continue;
+        }
+
+        int count = data_size / sizeof(int16_t);
+        int64_t sum = 0;
+        for (int i = 0; i < count; i++)
+            sum += m_samples[i] * m_samples[i];
+        bool silent = sum < (int64_t)kSilenceLevel * kSilenceLevel * count;
+
+        int64_t duration = (int64_t)(count / ctx->channels) * 90000 /
+            ctx->sample_rate;
+        if (pts != (int64_t)AV_NOPTS_VALUE)
+        {
+            AddAudioFrame(silent, pts, pts + duration);
+            pts += duration;
+        }
+    }
+}
+
+/// Decodes the frames still held by the parsers and decoders.
+void InlineCommFlagger::Drain(void)
+{
+    if (m_video.ctx)
+    {
+        ParsePayload(m_video, NULL, 0, true);
+        for (uint i = 0; (i < 32) && DecodeVideo(NULL, 0, AV_NOPTS_VALUE); i++)
+            ;
+    }
+
+    if (m_audio.ctx)
+        ParsePayload(m_audio, NULL, 0, false);
+}
+
+/// Extends a 33 bit PTS to 64 bits, relative to the last PTS seen.
+int64_t InlineCommFlagger::Unwrap(int64_t pts)
+{
+    if (m_lastPts == (int64_t)AV_NOPTS_VALUE)
+    {
+        m_lastPts = pts;
+        return pts;
+    }
+
+    int64_t delta = pts - (m_lastPts & (kPTSWrap - 1));
+    if (delta > kPTSWrap / 2)
+        delta -= kPTSWrap;
+    else if (delta < -kPTSWrap / 2)
+        delta += kPTSWrap;
+
+    pts = m_lastPts + delta;
+    m_lastPts = max(m_lastPts, pts);
+    return pts;
+}
+
+/** \fn InlineCommFlagger::IsBlank(const AVFrame*) const
+ *  \brief Returns true if the frame is blank or dark, using the same
+ *         non-aggressive test as ClassicCommDetector.
+ */
+bool InlineCommFlagger::IsBlank(const AVFrame *frame) const
+{
+    // the context dimensions are those of the lowres picture
+    int width  = m_video.ctx->width;
+    int height = m_video.ctx->height;
+    int border = m_border >> m_video.ctx->lowres;
+
+    if ((width <= 2 * border) || (height <= 2 * border))
+        return false;
+
+    int xstep = max(1, (width  - 2 * border) / kSampleLines);
+    int ystep = max(1, (height - 2 * border) / kSampleLines);
+
+    int min = 255, max = 0;
+    long long total = 0;
+    int count = 0;
+    for (int y = border; y < height - border; y += ystep)
+    {
+        const unsigned char *row = frame->data[0] + y * frame->linesize[0];
+        for (int x = border; x < width - border; x += xstep)
+        {
+            int pixel = row[x];
+            if (pixel < min)
+                min = pixel;
+            if (pixel > max)
+                max = pixel;
+            total += pixel;
+            count++;
+        }
+    }
+
+    int avg = total / count;
+
+    return (((max - min) <= m_maxDiff) ||
+            (max < m_darkBrightness) ||
+            ((max < m_dimBrightness) && (avg < min + 10)));
+}
+
+/** \fn InlineCommFlagger::AddVideoFrame(bool,int64_t)
+ *  \brief Records a decoded frame, numbered by its pts rather than by
+ *         how many frames were decoded.
+ *
+ *   Frames the decoder drops or can't decode, like those before the
+ *   first keyframe it sees, would otherwise shift the marks against the
+ *   frame numbers the recorder writes to the position map.
+ */
+void InlineCommFlagger::AddVideoFrame(bool blank, int64_t pts)
+{
+    m_framesAnalyzed++;
+
+    if (m_firstVideoPts == (int64_t)AV_NOPTS_VALUE)
+        m_firstVideoPts = pts;
+    m_lastVideoPts = pts;
+
+    long long frame = (pts - m_firstVideoPts + m_videoFrameDuration / 2) /
+        m_videoFrameDuration;
+    frame = max(frame, 0LL);
+    m_lastFrame = max(m_lastFrame, frame);
+
+    if (!blank)
+        return;
+
+    if (!m_blankRuns.empty() && (frame >= m_blankRuns.back().start) &&
+        (frame <= m_blankRuns.back().end + 1))
+    {
+        if (frame > m_blankRuns.back().end)
+        {
+            m_blankRuns.back().end    = frame;
+            m_blankRuns.back().endPts = pts;
+        }
+        return;
+    }
+
+    BlankRun run;
+    run.start    = run.end    = frame;
+    run.startPts = run.endPts = pts;
+    m_blankRuns.push_back(run);
+}
+
+void InlineCommFlagger::AddAudioFrame(
+    bool silent, int64_t start_pts, int64_t end_pts)
+{
+    m_audioEndPts = max(m_audioEndPts, end_pts);
+
+    if (!silent)
+        return;
+
+    if (!m_silences.empty() &&
+        (start_pts <= m_silences.back().endPts + kSilenceSlack / 4))
+    {
+        m_silences.back().endPts = max(m_silences.back().endPts, end_pts);
+        return;
+    }
+
+    BlankRun silence;
+    silence.start    = silence.end = 0;
+    silence.startPts = start_pts;
+    silence.endPts   = end_pts;
+    m_silences.push_back(silence);
+}
+
+/** \fn InlineCommFlagger::DecideBlankRuns(bool)
+ *  \brief Turns the blank frame runs which coincide with silence into
+ *         separators, once the audio for them has been analyzed.
+ *
+ *   Without a usable audio stream, or once the video is well ahead of
+ *   the audio, blank frames alone are used.
+ */
+void InlineCommFlagger::DecideBlankRuns(bool finishing)
+{
+    bool changed = false;
+
+    while (!m_blankRuns.empty())
+    {
+        const BlankRun &run = m_blankRuns.front();
+        if (!finishing && (run.end >= m_lastFrame))
+            break; // still growing
+
+        int64_t start = run.startPts - kSilenceSlack;
+        int64_t end   = run.endPts + m_videoFrameDuration + kSilenceSlack;
+        bool have_audio = m_audio.ctx && (m_audioEndPts >= end);
+        bool audio_late = !m_audio.ctx || finishing ||
+            (m_lastVideoPts > end + kAudioTimeout);
+
+        if (!have_audio && !audio_late)
+            break;
+
+        bool separator = true;
+        if (have_audio)
+        {
+            while (!m_silences.empty() && (m_silences.front().endPts < start))
+                m_silences.pop_front();
+
+            separator = false;
+            QList<BlankRun>::const_iterator it = m_silences.begin();
+            for (; it != m_silences.end() && !separator; ++it)
+                separator = ((*it).startPts <= end);
+        }
+
+        if (separator)
+        {
+            Separator sep;
+            sep.start = run.start;
+            sep.end   = run.end;
+            sep.pts   = (run.startPts + run.endPts) / 2;
+            m_separators.push_back(sep);
+            changed = true;
+        }
+
+        m_blankRuns.pop_front();
+    }
+
+    if (changed)
+        BuildCommBreakMap();
+}
+
+/** \fn InlineCommFlagger::BuildCommBreakMap(void)
+ *  \brief Builds the commercial break list from the separators found
+ *         so far.
+ *
+ *   Gaps between separators of a typical commercial length are taken
+ *   for commercials, commercials close together are merged into breaks
+ *   and breaks shorter than CommDetectMinCommBreakLength are dropped.
+ */
+void InlineCommFlagger::BuildCommBreakMap(void)
+{
+    const QList<Separator> &seps = m_separators;
+    int count = seps.size();
+
+    // find the commercials, as pairs of separator indexes
+    vector<pair<int,int> > spots;
+    for (int i = 0; i + 1 < count;)
+    {
+        int x = i + 1;
+        for (; x < count; x++)
+        {
+            int64_t gap = seps[x].pts - seps[i].pts;
+            if (gap > kMaxSpotLength)
+                x = count;
+            else if (is_spot_length(gap))
+                break;
+        }
+
+        if (x < count)
+        {
+            spots.push_back(make_pair(i, x));
+            i = x;
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    // and merge them into breaks
+    frm_dir_map_t map;
+    for (uint i = 0; i < spots.size();)
+    {
+        int first = spots[i].first;
+        int last  = spots[i].second;
+        for (i++; (i < spots.size()) &&
+                 (seps[spots[i].first].pts - seps[last].pts < kMaxBreakGap);
+             i++)
+        {
+            last = spots[i].second;
+        }
+
+        if (seps[last].pts - seps[first].pts <
+            (int64_t)m_minBreakLength * 90000)
+        {
+            continue;
+        }
+
+        long long start = seps[first].start;
+        if (map.empty() && (seps[first].pts - m_firstVideoPts < kLeadIn))
+            start = 0;
+
+        map[start]          = MARK_COMM_START;
+        map[seps[last].end] = MARK_COMM_END;
+    }
+
+    QMutexLocker locker(&m_lock);
+    if (map != m_commBreakMap)
+    {
+        m_commBreakMap = map;
+        m_commBreakMapChanged = true;
+    }
+}
+
+/** \fn InlineCommFlagger::SendCommBreakMap(void)
+ *  \brief Sends the current break list to the frontends watching the
+ *         recording, in the same format mythcommflag does.
+ */
+void InlineCommFlagger::SendCommBreakMap(void)
+{
+    frm_dir_map_t map;
+    GetCommBreakMap(map);
+
+    QString message = "COMMFLAG_UPDATE ";
+    message += m_key;
+
+    frm_dir_map_t::const_iterator it = map.begin();
+    for (; it != map.end(); ++it)
+    {
+        message += (it == map.begin()) ? " " : ",";
+        message += QString("%1:%2").arg(it.key()).arg(*it);
+    }
+
+    VERBOSE(VB_COMMFLAG, LOC + QString("Sending update: %1").arg(message));
+
+    RemoteSendMessage(message);
+}
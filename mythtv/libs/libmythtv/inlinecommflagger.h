@@ -0,0 +1,180 @@
+// -*- Mode: c++ -*-
+#ifndef INLINE_COMM_FLAGGER_H_
+#define INLINE_COMM_FLAGGER_H_
+
+#include <stdint.h>
+
+#include <QWaitCondition>
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+#include <QThread>
+#include <QMutex>
+#include <QList>
+
+#include "programtypes.h"
+
+class ProgramInfo;
+class QEvent;
+struct AVCodecContext;
+struct AVCodecParserContext;
+struct AVFrame;
+
+/** \class InlineCommFlagger
+ *  \brief Flags commercials while a recording is being made, from the
+ *         transport stream the recorder writes to disk.
+ *
+ *   DTVRecorder hands every TS packet it writes to AddData(). The
+ *   flagger demuxes the video and first audio stream on its own thread,
+ *   decodes the video at reduced resolution in gray and the audio, and
+ *   looks for blank frames accompanied by silence. Commercial breaks are
+ *   built from the gaps between those separators the same way
+ *   ClassicCommDetector::BuildBlankFrameCommList() does.
+ *
+ *   A COMMFLAG_REQUEST for the recording is answered with a
+ *   COMMFLAG_UPDATE carrying the current break list, just like a
+ *   mythcommflag job flagging a recording in progress does. An update is
+ *   also sent whenever the list changes.
+ *
+ *   The recorder never waits on the flagger. If the flagger falls too
+ *   far behind, the data is dropped. After Finish() the flagging thread
+ *   analyzes what is still queued on its own. It then saves the break
+ *   list, or queues the regular commercial flagging job when it did not
+ *   analyze nearly every frame written, and deletes itself.
+ */
+class InlineCommFlagger : public QThread
+{
+    Q_OBJECT
+
+  public:
+    InlineCommFlagger(const ProgramInfo &pginfo);
+    ~InlineCommFlagger();
+
+    void SetStreams(uint video_pid, uint video_type,
+                    uint audio_pid, uint audio_type);
+    void AddData(const unsigned char *data, uint size);
+    void Finish(long long framesWritten);
+
+    void GetCommBreakMap(frm_dir_map_t &map) const;
+
+  protected:
+    virtual void run(void); // QThread
+    virtual void customEvent(QEvent *e); // QObject
+
+  private:
+    class Chunk
+    {
+      public:
+        Chunk() : streams(false), video_pid(0), video_type(0),
+                  audio_pid(0), audio_type(0) {}
+        QByteArray data;
+        bool       streams;   ///< true if this changes the streams instead
+        uint       video_pid;
+        uint       video_type;
+        uint       audio_pid;
+        uint       audio_type;
+    };
+
+    class ElementaryStream
+    {
+      public:
+        ElementaryStream() :
+            pid(0), ctx(NULL), parser(NULL), pts(0), synced(false) {}
+        uint                  pid;
+        AVCodecContext       *ctx;
+        AVCodecParserContext *parser;
+        int64_t               pts;    ///< PES pts not yet handed to parser
+        bool                  synced; ///< seen a PES start
+    };
+
+    class BlankRun
+    {
+      public:
+        long long start;
+        long long end;
+        int64_t   startPts;
+        int64_t   endPts;
+    };
+
+    class Separator
+    {
+      public:
+        long long start;
+        long long end;
+        int64_t   pts;
+    };
+
+    void QueueChunk(const Chunk &chunk);
+    void FlushPending(void);
+
+    void OpenStreams(const Chunk &chunk);
+    void CloseStreams(void);
+    bool OpenStream(ElementaryStream &es, uint pid, uint type, bool video);
+    void CloseStream(ElementaryStream &es);
+
+    void ProcessData(const QByteArray &data);
+    void ProcessPacket(const unsigned char *pkt);
+    void ParsePayload(ElementaryStream &es, const unsigned char *buf,
+                      uint len, bool video);
+    bool DecodeVideo(uint8_t *buf, int size, int64_t pts);
+    void DecodeAudio(uint8_t *buf, int size, int64_t pts);
+    void Drain(void);
+
+    int64_t Unwrap(int64_t pts);
+    bool IsBlank(const AVFrame *frame) const;
+    void AddVideoFrame(bool blank, int64_t pts);
+    void AddAudioFrame(bool silent, int64_t start_pts, int64_t end_pts);
+    void DecideBlankRuns(bool finishing);
+    void BuildCommBreakMap(void);
+    void SendCommBreakMap(void);
+    void SaveResult(bool analyzed);
+
+    // set at construction
+    QString                 m_key;
+    uint                    m_chanid;
+    QDateTime               m_recstartts;
+
+    // settings
+    int                     m_border;
+    int                     m_maxDiff;
+    int                     m_darkBrightness;
+    int                     m_dimBrightness;
+    int                     m_minBreakLength;
+
+    // data handed over by the recorder
+    mutable QMutex          m_lock;
+    QWaitCondition          m_wait;
+    QList<Chunk>            m_queue;
+    uint                    m_queuedBytes;
+    bool                    m_finishing;
+    long long               m_framesWritten;  ///< set by Finish()
+    bool                    m_overflowed;
+    bool                    m_updateRequested;
+    QByteArray              m_pending;  ///< only used by the recorder
+
+    // the rest is only used by the flagging thread
+    ElementaryStream        m_video;
+    ElementaryStream        m_audio;
+    AVFrame                *m_frame;
+    int16_t                *m_samples;
+    int64_t                 m_lastPts;
+    int64_t                 m_firstVideoPts;  ///< pts of frame 0
+    int64_t                 m_lastVideoPts;
+    int64_t                 m_videoFrameDuration;
+    int64_t                 m_audioEndPts;
+    long long               m_framesAnalyzed;
+    long long               m_lastFrame;      ///< highest frame number seen
+
+    QList<BlankRun>         m_blankRuns;    ///< not yet decided
+    QList<BlankRun>         m_silences;     ///< silent audio, pts only
+    QList<Separator>        m_separators;
+
+    // guarded by m_lock
+    frm_dir_map_t           m_commBreakMap;
+    bool                    m_commBreakMapChanged;
+
+    static const uint       kMaxQueuedBytes;
+    static const uint       kChunkSize;
+};
+
+#endif // INLINE_COMM_FLAGGER_H_
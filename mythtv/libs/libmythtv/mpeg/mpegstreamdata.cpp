@@ -2,6 +2,7 @@
 // Copyright (c) 2003-2004, Daniel Thor Kristjansson
 
 #include <algorithm> // for find & max
+#include <cstring>   // for memchr
 using namespace std;
 
 // POSIX headers
@@ -42,6 +43,32 @@ void init_sections(sections_t &sect, uint last_section)
 #endif
 }
 
+bool TSPacketListener::ProcessTSPackets(const TSPacket *tspackets, uint count)
+{
+    bool ok = true;
+    for (uint i = 0; i < count; i++)
+        ok &= ProcessTSPacket(tspackets[i]);
+    return ok;
+}
+
+bool TSPacketListenerAV::ProcessVideoTSPackets(
+    const TSPacket *tspackets, uint count)
+{
+    bool ok = true;
+    for (uint i = 0; i < count; i++)
+        ok &= ProcessVideoTSPacket(tspackets[i]);
+    return ok;
+}
+
+bool TSPacketListenerAV::ProcessAudioTSPackets(
+    const TSPacket *tspackets, uint count)
+{
+    bool ok = true;
+    for (uint i = 0; i < count; i++)
+        ok &= ProcessAudioTSPacket(tspackets[i]);
+    return ok;
+}
+
 const unsigned char MPEGStreamData::bit_sel[8] =
 {
     0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80,
@@ -84,6 +111,7 @@ MPEGStreamData::MPEGStreamData(int desiredProgram, bool cacheTables)
 
     // MS Windows doesn't like bzero()..
     memset(_si_time_offsets, 0, sizeof(_si_time_offsets));
+    memset(_pid_flags, 0, sizeof(_pid_flags));
 
     AddListeningPID(MPEG_PAT_PID);
 }
@@ -188,8 +216,10 @@ void MPEGStreamData::Reset(int desiredProgram)
     _pids_notlistening.clear();
     _pids_writing.clear();
     _pids_audio.clear();
+    memset(_pid_flags, 0, sizeof(_pid_flags));
 
-    _pid_video_single_program = _pid_pmt_single_program = 0xffffffff;
+    SetVideoPIDSingleProgram(0xffffffff);
+    _pid_pmt_single_program = 0xffffffff;
 
     _pat_version.clear();
     _pat_section_seen.clear();
@@ -619,11 +649,12 @@ bool MPEGStreamData::CreatePMTSingleProgram(const ProgramMapTable &pmt)
     }
 
     _pids_audio.clear();
+    ClearPIDFlags(kPIDFlagAudio);
     for (uint i = 0; i < audioPIDs.size(); i++)
         AddAudioPID(audioPIDs[i]);
 
     if (videoPIDs.size() >= 1)
-        _pid_video_single_program = videoPIDs[0];
+        SetVideoPIDSingleProgram(videoPIDs[0]);
     for (uint i = 1; i < videoPIDs.size(); i++)
         AddWritingPID(videoPIDs[i]);
 
@@ -935,6 +966,7 @@ void MPEGStreamData::HandleTSTables(const TSPacket* tspacket)
 int MPEGStreamData::ProcessData(const unsigned char *buffer, int len)
 {
     int pos = 0;
+    int remainder = -1;
     bool resync = false;
 
     while (pos + 187 < len) // while we have a whole packet left
@@ -943,31 +975,117 @@ int MPEGStreamData::ProcessData(const unsigned char *buffer, int len)
         {
             int newpos = ResyncStream(buffer, pos+1, len);
             if (newpos == -1)
-                return len - pos;
+            {
+                remainder = len - pos;
+                break;
+            }
             if (newpos == -2)
-                return TSPacket::SIZE;
+            {
+                remainder = TSPacket::SIZE;
+                break;
+            }
 
             pos = newpos;
         }
 
+        // Find how many whole packets from here on are still in sync
+        // so they can be handed over as one batch.
+        uint max_cnt = (len - pos) / TSPacket::SIZE;
+        uint cnt = 1;
+        const unsigned char *sync = &buffer[pos + TSPacket::SIZE];
+        for (; cnt < max_cnt && *sync == SYNC_BYTE; cnt++)
+            sync += TSPacket::SIZE;
+
         const TSPacket *pkt = reinterpret_cast<const TSPacket*>(&buffer[pos]);
-        if (ProcessTSPacket(*pkt))
+        uint done = ProcessTSPackets(pkt, cnt);
+
+        pos += done * TSPacket::SIZE; // Advance past processed TS packets
+
+        // Let it resync in case of dropped bytes
+        resync = (done < cnt);
+    }
+
+    // Listeners may only reference packets in this buffer until now
+    for (uint j = 0; j < _ts_av_listeners.size(); j++)
+        _ts_av_listeners[j]->FlushTSPackets();
+    for (uint j = 0; j < _ts_writing_listeners.size(); j++)
+        _ts_writing_listeners[j]->FlushTSPackets();
+
+    return (remainder < 0) ? len - pos : remainder;
+}
+
+/** \fn MPEGStreamData::ProcessTSPackets(const TSPacket*, uint)
+ *  \brief Processes a batch of consecutive, in sync, TS packets.
+ *
+ *   Runs of clean packets on the same audio, video or writing-only PID
+ *   are handed to the listeners as one span, everything else goes
+ *   through ProcessTSPacket() one packet at a time.
+ *
+ *  \return number of packets processed before one was rejected.
+ */
+uint MPEGStreamData::ProcessTSPackets(const TSPacket *tspackets, uint count)
+{
+    static const uint kSpanFlags =
+        kPIDFlagVideo | kPIDFlagAudio | kPIDFlagWriting;
+    static const uint kSinglePacketFlags =
+        kPIDFlagEncTest | kPIDFlagListening;
+
+    uint i = 0;
+    while (i < count)
+    {
+        const uint pid   = tspackets[i].PID();
+        const uint flags = _pid_flags[pid];
+
+        uint run = 0;
+        if ((flags & kSpanFlags) && !(flags & kSinglePacketFlags))
         {
-            pos += TSPacket::SIZE; // Advance to next TS packet
-            resync = false;
+            while ((i + run < count) &&
+                   (tspackets[i + run].PID() == pid) &&
+                   !tspackets[i + run].TransportError() &&
+                   !tspackets[i + run].Scrambled() &&
+                   tspackets[i + run].HasPayload())
+            {
+                run++;
+            }
+        }
+
+        if (run < 2)
+        {
+            if (!ProcessTSPacket(tspackets[i]))
+                return i;
+            i++;
+            continue;
+        }
+
+        const TSPacket *span = &tspackets[i];
+        if (flags & kPIDFlagVideo)
+        {
+            for (uint j = 0; j < _ts_av_listeners.size(); j++)
+                _ts_av_listeners[j]->ProcessVideoTSPackets(span, run);
+        }
+        else if (flags & kPIDFlagAudio)
+        {
+            for (uint j = 0; j < _ts_av_listeners.size(); j++)
+                _ts_av_listeners[j]->ProcessAudioTSPackets(span, run);
+        }
+        else
+        {
+            for (uint j = 0; j < _ts_writing_listeners.size(); j++)
+                _ts_writing_listeners[j]->ProcessTSPackets(span, run);
         }
-        else // Let it resync in case of dropped bytes
-            resync = true;
+
+        i += run;
     }
 
-    return len - pos;
+    return count;
 }
 
 bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
 {
     bool ok = !tspacket.TransportError();
+    const uint flags = _pid_flags[tspacket.PID()];
 
-    if (IsEncryptionTestPID(tspacket.PID()))
+    if (flags & kPIDFlagEncTest)
     {
         ProcessEncryptedPacket(tspacket);
     }
@@ -977,7 +1095,7 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
 
     if (!tspacket.Scrambled() && tspacket.HasPayload())
     {
-        if (IsVideoPID(tspacket.PID()))
+        if (flags & kPIDFlagVideo)
         {
             for (uint j = 0; j < _ts_av_listeners.size(); j++)
                 _ts_av_listeners[j]->ProcessVideoTSPacket(tspacket);
@@ -985,7 +1103,7 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
             return true;
         }
 
-        if (IsAudioPID(tspacket.PID()))
+        if (flags & kPIDFlagAudio)
         {
             for (uint j = 0; j < _ts_av_listeners.size(); j++)
                 _ts_av_listeners[j]->ProcessAudioTSPacket(tspacket);
@@ -993,18 +1111,18 @@ bool MPEGStreamData::ProcessTSPacket(const TSPacket& tspacket)
             return true;
         }
 
-        if (IsWritingPID(tspacket.PID()) && _ts_writing_listeners.size())
+        if ((flags & kPIDFlagWriting) && _ts_writing_listeners.size())
         {
             for (uint j = 0; j < _ts_writing_listeners.size(); j++)
                 _ts_writing_listeners[j]->ProcessTSPacket(tspacket);
         }
 
-        if (IsListeningPID(tspacket.PID()))
+        if (flags & kPIDFlagListening)
         {
             HandleTSTables(&tspacket);
         }
     }
-    else if (!tspacket.Scrambled() && IsWritingPID(tspacket.PID()))
+    else if (!tspacket.Scrambled() && (flags & kPIDFlagWriting))
     {
         // PCRPID and other streams we're writing may not have payload...
         for (uint j = 0; j < _ts_writing_listeners.size(); j++)
@@ -1019,43 +1137,42 @@ int MPEGStreamData::ResyncStream(const unsigned char *buffer, int curr_pos,
 {
     // Search for two sync bytes 188 bytes apart,
     int pos = curr_pos;
-    int nextpos = pos + TSPacket::SIZE;
-    if (nextpos >= len)
+    if (pos + (int)TSPacket::SIZE >= len)
         return -1; // not enough bytes; caller should try again
 
-    while (buffer[pos] != SYNC_BYTE || buffer[nextpos] != SYNC_BYTE)
+    // memchr() is vectorized by the C library, so use it to skip
+    // to each sync byte candidate rather than testing byte by byte.
+    const int last = len - TSPacket::SIZE;
+    while (pos < last)
     {
+        const void *sync = memchr(&buffer[pos], SYNC_BYTE, last - pos);
+        if (!sync)
+            break;
+
+        pos = (const unsigned char*) sync - buffer;
+        if (buffer[pos + TSPacket::SIZE] == SYNC_BYTE)
+            return pos;
         pos++;
-        nextpos++;
-        if (nextpos == len)
-            return -2; // not found
     }
 
-    return pos;
-}
-
-bool MPEGStreamData::IsListeningPID(uint pid) const
-{
-    pid_map_t::const_iterator it = _pids_listening.find(pid);
-    return it != _pids_listening.end();
-}
-
-bool MPEGStreamData::IsNotListeningPID(uint pid) const
-{
-    pid_map_t::const_iterator it = _pids_notlistening.find(pid);
-    return it != _pids_notlistening.end();
+    return -2; // not found
 }
 
-bool MPEGStreamData::IsWritingPID(uint pid) const
+/** \fn MPEGStreamData::ClearPIDFlags(uint)
+ *  \brief Clears the given PIDFlag bits for every PID in the table.
+ */
+void MPEGStreamData::ClearPIDFlags(uint flag)
 {
-    pid_map_t::const_iterator it = _pids_writing.find(pid);
-    return it != _pids_writing.end();
+    const unsigned char mask = ~flag;
+    for (uint pid = 0; pid < kPIDFlagTableSize; pid++)
+        _pid_flags[pid] &= mask;
 }
 
-bool MPEGStreamData::IsAudioPID(uint pid) const
+void MPEGStreamData::SetVideoPIDSingleProgram(uint pid)
 {
-    pid_map_t::const_iterator it = _pids_audio.find(pid);
-    return it != _pids_audio.end();
+    ClearPIDFlag(_pid_video_single_program, kPIDFlagVideo);
+    _pid_video_single_program = pid;
+    SetPIDFlag(_pid_video_single_program, kPIDFlagVideo);
 }
 
 uint MPEGStreamData::GetPIDs(pid_map_t &pids) const
@@ -1605,6 +1722,7 @@ void MPEGStreamData::AddEncryptionTestPID(uint pnum, uint pid, bool isvideo)
     AddListeningPID(pid);
 
     _encryption_pid_to_info[pid] = CryptInfo((isvideo) ? 10000 : 500, 8);
+    SetPIDFlag(pid, kPIDFlagEncTest);
 
     _encryption_pid_to_pnums[pid].push_back(pnum);
     _encryption_pnum_to_pids[pnum].push_back(pid);
@@ -1644,6 +1762,7 @@ void MPEGStreamData::RemoveEncryptionTestPIDs(uint pnum)
             {
                 _encryption_pid_to_pnums.remove(pid);
                 _encryption_pid_to_info.remove(pid);
+                ClearPIDFlag(pid, kPIDFlagEncTest);
             }
         }
     }
@@ -1653,12 +1772,7 @@ void MPEGStreamData::RemoveEncryptionTestPIDs(uint pnum)
 
 bool MPEGStreamData::IsEncryptionTestPID(uint pid) const
 {
-    QMutexLocker locker(&_encryption_lock);
-
-    QMap<uint, CryptInfo>::const_iterator it =
-        _encryption_pid_to_info.find(pid);
-
-    return it != _encryption_pid_to_info.end();
+    return HasPIDFlag(pid, kPIDFlagEncTest);
 }
 
 void MPEGStreamData::TestDecryption(const ProgramMapTable *pmt)
@@ -1692,6 +1806,7 @@ void MPEGStreamData::ResetDecryptionMonitoringState(void)
     _encryption_pid_to_info.clear();
     _encryption_pid_to_pnums.clear();
     _encryption_pnum_to_pids.clear();
+    ClearPIDFlags(kPIDFlagEncTest);
 }
 
 bool MPEGStreamData::IsProgramDecrypted(uint pnum) const
@@ -83,6 +83,17 @@ typedef enum
 } PIDPriority;
 typedef QMap<uint, PIDPriority> pid_map_t;
 
+/// Bit flags kept per PID in MPEGStreamData::_pid_flags
+typedef enum
+{
+    kPIDFlagListening    = 0x01,
+    kPIDFlagNotListening = 0x02,
+    kPIDFlagWriting      = 0x04,
+    kPIDFlagAudio        = 0x08,
+    kPIDFlagEncTest      = 0x10,
+    kPIDFlagVideo        = 0x20,
+} PIDFlag;
+
 class MPEGStreamData : public EITSource
 {
   public:
@@ -112,34 +123,52 @@ class MPEGStreamData : public EITSource
     virtual bool HandleTables(uint pid, const PSIPTable &psip);
     virtual void HandleTSTables(const TSPacket* tspacket);
     virtual bool ProcessTSPacket(const TSPacket& tspacket);
+    virtual uint ProcessTSPackets(const TSPacket *tspackets, uint count);
     virtual int  ProcessData(const unsigned char *buffer, int len);
     inline  void HandleAdaptationFieldControl(const TSPacket* tspacket);
 
     // Listening
     virtual void AddListeningPID(
         uint pid, PIDPriority priority = kPIDPriorityNormal)
-        { _pids_listening[pid] = priority; }
+        { _pids_listening[pid] = priority; SetPIDFlag(pid, kPIDFlagListening); }
     virtual void AddNotListeningPID(uint pid)
-        { _pids_notlistening[pid] = kPIDPriorityNormal; }
+    {
+        _pids_notlistening[pid] = kPIDPriorityNormal;
+        SetPIDFlag(pid, kPIDFlagNotListening);
+    }
     virtual void AddWritingPID(
         uint pid, PIDPriority priority = kPIDPriorityHigh)
-        { _pids_writing[pid] = priority; }
+        { _pids_writing[pid] = priority; SetPIDFlag(pid, kPIDFlagWriting); }
     virtual void AddAudioPID(
         uint pid, PIDPriority priority = kPIDPriorityHigh)
-        { _pids_audio[pid] = priority; }
+        { _pids_audio[pid] = priority; SetPIDFlag(pid, kPIDFlagAudio); }
 
-    virtual void RemoveListeningPID(uint pid) { _pids_listening.remove(pid);  }
+    virtual void RemoveListeningPID(uint pid)
+        { _pids_listening.remove(pid); ClearPIDFlag(pid, kPIDFlagListening); }
     virtual void RemoveNotListeningPID(uint pid)
-        { _pids_notlistening.remove(pid); }
-    virtual void RemoveWritingPID(uint pid) { _pids_writing.remove(pid);    }
-    virtual void RemoveAudioPID(uint pid)   { _pids_audio.remove(pid);      }
-
-    virtual bool IsListeningPID(uint pid) const;
-    virtual bool IsNotListeningPID(uint pid) const;
-    virtual bool IsWritingPID(uint pid) const;
+    {
+        _pids_notlistening.remove(pid);
+        ClearPIDFlag(pid, kPIDFlagNotListening);
+    }
+    virtual void RemoveWritingPID(uint pid)
+        { _pids_writing.remove(pid); ClearPIDFlag(pid, kPIDFlagWriting); }
+    virtual void RemoveAudioPID(uint pid)
+        { _pids_audio.remove(pid); ClearPIDFlag(pid, kPIDFlagAudio); }
+
+    virtual bool IsListeningPID(uint pid) const
+        { return HasPIDFlag(pid, kPIDFlagListening); }
+    virtual bool IsNotListeningPID(uint pid) const
+        { return HasPIDFlag(pid, kPIDFlagNotListening); }
+    virtual bool IsWritingPID(uint pid) const
+        { return HasPIDFlag(pid, kPIDFlagWriting); }
     bool IsVideoPID(uint pid) const
         { return _pid_video_single_program == pid; }
-    virtual bool IsAudioPID(uint pid) const;
+    virtual bool IsAudioPID(uint pid) const
+        { return HasPIDFlag(pid, kPIDFlagAudio); }
+
+    /// \brief Returns the PIDFlag bits currently set for this PID
+    uint GetPIDFlags(uint pid) const
+        { return (pid < kPIDFlagTableSize) ? _pid_flags[pid] : 0; }
 
     const pid_map_t& ListeningPIDs(void) const
         { return _pids_listening; }
@@ -304,6 +333,22 @@ class MPEGStreamData : public EITSource
 
     void UpdateTimeOffset(uint64_t si_utc_time);
 
+    // PID classification table
+    void SetPIDFlag(uint pid, uint flag)
+    {
+        if (pid < kPIDFlagTableSize)
+            _pid_flags[pid] |= flag;
+    }
+    void ClearPIDFlag(uint pid, uint flag)
+    {
+        if (pid < kPIDFlagTableSize)
+            _pid_flags[pid] &= ~flag;
+    }
+    bool HasPIDFlag(uint pid, uint flag) const
+        { return (pid < kPIDFlagTableSize) && (_pid_flags[pid] & flag); }
+    void ClearPIDFlags(uint flag);
+    void SetVideoPIDSingleProgram(uint pid);
+
     // Caching
     void IncrementRefCnt(const PSIPTable *psip) const;
     virtual bool DeleteCachedTable(PSIPTable *psip) const;
@@ -332,6 +377,12 @@ class MPEGStreamData : public EITSource
     pid_map_t _pids_writing;
     pid_map_t _pids_audio;
 
+    /// Per PID bitmask of PIDFlag values, mirrors the maps above and
+    /// the encryption test PIDs so ProcessTSPacket() needs only one
+    /// indexed load per packet to classify it.
+    static const uint kPIDFlagTableSize = 0x2000;
+    unsigned char             _pid_flags[kPIDFlagTableSize];
+
     // Encryption monitoring
     mutable QMutex            _encryption_lock;
     QMap<uint, CryptInfo>     _encryption_pid_to_info;
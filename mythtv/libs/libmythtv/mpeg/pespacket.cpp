@@ -12,11 +12,19 @@ extern "C" {
 #include "libavutil/bswap.h"
 }
 
+// POSIX headers
+#include <pthread.h>
+#include <stdlib.h>  // posix_memalign
+
+#include <algorithm>
 #include <vector>
-#include <map>
 
 using namespace std;
 
+// Qt headers
+#include <QAtomicInt>
+#include <QMutex>
+
 // return true if complete or broken
 bool PESPacket::AddTSPacket(const TSPacket* packet, bool &broken)
 {
@@ -211,135 +219,357 @@ float SequenceHeader::aspect(bool mpeg1) const
 // Memory allocator to avoid malloc global lock and waste less memory. //
 /////////////////////////////////////////////////////////////////////////
 
-static vector<unsigned char*> mem188;
-static vector<unsigned char*> free188;
-static map<unsigned char*, bool> alloc188;
+// Blocks of up to 4096 bytes are carved out of slabs, larger ones come
+// straight from malloc(). Every slab is aligned to its size, so the slab
+// a block belongs to is found by masking its address. Whether a pointer
+// handed to pes_free() is a slab block at all is decided from a registry
+// of slab addresses, never by looking at memory the pointer may not own.
+//
+// Free blocks are kept in intrusive lists, one per slab. Each thread owns
+// a small cache per size class, which is refilled from and drained to the
+// slabs in batches, so the pool lock is only taken once every kPESBatch
+// allocations instead of on every call. Each thread also keeps a copy of
+// the slab registry, which it refreshes when the registry's generation
+// changes, so pes_free() does not take a lock to look a pointer up.
+//
+// A slab whose blocks are all free again is given back to the system,
+// as long as the other slabs of its size class have as many free blocks,
+// so a pool hovering around a slab boundary does not keep reallocating.
+
+#define PES_ALIGNMENT   16
+#define PES_SLAB_SIZE   (256 * 1024)
+
+enum
+{
+    kPESClass188     = 0,
+    kPESClass4096    = 1,
+    kPESClassCount   = 2,
+};
+
+static const uint     kPESBlockSize[kPESClassCount]  = { 188, 4096 };
+static const uint     kPESBatch                      = 32;
 
-static vector<unsigned char*> mem4096;
-static vector<unsigned char*> free4096;
-static map<unsigned char*, bool> alloc4096;
+typedef struct pes_free_block
+{
+    struct pes_free_block *next;
+} PESFreeBlock;
 
-#define BLOCKS188 512
-static unsigned char* get_188_block()
+/// Bookkeeping at the start of every slab, followed by its blocks
+typedef struct pes_slab
 {
-    if (free188.empty())
+    uint          size_class;
+    uint          stride;    ///< bytes from one block to the next
+    uint          blocks;    ///< blocks in this slab
+    uint          free_cnt;  ///< blocks on free_list
+    PESFreeBlock *free_list;
+} PESSlab;
+
+static const uint kPESSlabHeaderSize =
+    (sizeof(PESSlab) + PES_ALIGNMENT - 1) & ~(PES_ALIGNMENT - 1);
+
+static inline PESSlab *pes_block_slab(void *ptr)
+{
+    return (PESSlab*) ((quintptr) ptr & ~(quintptr) (PES_SLAB_SIZE - 1));
+}
+
+class PESBlockPool
+{
+  public:
+    PESBlockPool() : free_cnt(0)
     {
-        mem188.push_back((unsigned char*) malloc(188 * BLOCKS188));
-        free188.reserve(BLOCKS188);
-        unsigned char* block_start = mem188.back();
-        for (uint i = 0; i < BLOCKS188; ++i)
-            free188.push_back(i*188 + block_start);
+        memset(&stats, 0, sizeof(stats));
     }
 
-    unsigned char *ptr = free188.back();
-    free188.pop_back();
-    alloc188[ptr] = true;
-    return ptr;
-}
-#undef BLOCKS188
+    QMutex           lock;
+    uint             free_cnt;  ///< free blocks in all slabs
+    vector<PESSlab*> slabs;
+    PESAllocStats    stats;
+};
+
+static PESBlockPool     pes_pools[kPESClassCount];
+static QMutex           pes_large_lock;
+static uint64_t         pes_large_allocs = 0;
+static pthread_key_t    pes_cache_key;
+static pthread_once_t   pes_cache_once = PTHREAD_ONCE_INIT;
+
+// Registry of slab addresses, taken after a pool lock, never before one
+static QMutex           pes_slab_lock;
+static vector<quintptr> pes_slab_bases;       ///< sorted
+static QAtomicInt       pes_slab_generation;  ///< bumped on every change
+
+class PESThreadCache
+{
+  public:
+    PESThreadCache() : slab_generation(-1)
+    {
+        memset(free_list, 0, sizeof(free_list));
+        memset(free_cnt,  0, sizeof(free_cnt));
+    }
+
+    PESFreeBlock    *free_list[kPESClassCount];
+    uint             free_cnt[kPESClassCount];
+    vector<quintptr> slab_bases;       ///< copy of pes_slab_bases
+    int              slab_generation;  ///< of the copy
+};
 
-static bool is_188_block(unsigned char* ptr)
+static void pes_register_slab(PESSlab *slab, bool add)
 {
-    return alloc188.find(ptr) != alloc188.end();
+    QMutexLocker locker(&pes_slab_lock);
+    quintptr base = (quintptr) slab;
+    vector<quintptr>::iterator it =
+        lower_bound(pes_slab_bases.begin(), pes_slab_bases.end(), base);
+    if (add)
+        pes_slab_bases.insert(it, base);
+    else if (it != pes_slab_bases.end() && *it == base)
+        pes_slab_bases.erase(it);
+    pes_slab_generation.fetchAndAddOrdered(1);
 }
 
-static void return_188_block(unsigned char* ptr)
+/// Returns the slab ptr was carved from, or NULL if it is not a slab block
+static PESSlab *pes_find_slab(PESThreadCache *cache, unsigned char *ptr)
 {
-    alloc188.erase(ptr);
-    free188.push_back(ptr);
-    // free the allocator only if more than 1 block was used
-    if (alloc188.empty() && mem188.size() > 1)
+    if (cache->slab_generation != (int) pes_slab_generation)
+    {
+        QMutexLocker locker(&pes_slab_lock);
+        cache->slab_bases      = pes_slab_bases;
+        cache->slab_generation = pes_slab_generation;
+    }
+
+    PESSlab *slab = pes_block_slab(ptr);
+    if (!binary_search(cache->slab_bases.begin(), cache->slab_bases.end(),
+                       (quintptr) slab))
     {
-        vector<unsigned char*>::iterator it;
-        for (it = mem188.begin(); it != mem188.end(); ++it)
-            free(*it);
-        mem188.clear();
-        free188.clear();
-        //cerr<<"freeing all 188 blocks"<<endl;
+        return NULL;
     }
+
+    return slab;
 }
 
-#define BLOCKS4096 128
-static unsigned char* get_4096_block()
+static PESSlab *pes_new_slab(uint sc)
 {
-    if (free4096.empty())
+    void *mem = NULL;
+    if (posix_memalign(&mem, PES_SLAB_SIZE, PES_SLAB_SIZE))
+        return NULL;
+
+    PESSlab *slab    = (PESSlab*) mem;
+    slab->size_class = sc;
+    slab->stride     = (kPESBlockSize[sc] + PES_ALIGNMENT - 1) &
+        ~(PES_ALIGNMENT - 1);
+    slab->blocks     = (PES_SLAB_SIZE - kPESSlabHeaderSize) / slab->stride;
+    slab->free_cnt   = slab->blocks;
+    slab->free_list  = NULL;
+
+    unsigned char *data = ((unsigned char*) mem) + kPESSlabHeaderSize;
+    for (uint i = slab->blocks; i > 0; i--)
     {
-        mem4096.push_back((unsigned char*) malloc(4096 * BLOCKS4096));
-        free4096.reserve(BLOCKS4096);
-        unsigned char* block_start = mem4096.back();
-        for (uint i = 0; i < BLOCKS4096; ++i)
-            free4096.push_back(i*4096 + block_start);
+        PESFreeBlock *blk = (PESFreeBlock*) (data + (i - 1) * slab->stride);
+        blk->next         = slab->free_list;
+        slab->free_list   = blk;
     }
 
-    unsigned char *ptr = free4096.back();
-    free4096.pop_back();
-    alloc4096[ptr] = true;
-    return ptr;
+    pes_register_slab(slab, true);
+
+    return slab;
 }
-#undef BLOCKS4096
 
-static bool is_4096_block(unsigned char* ptr)
+/// Gives a slab with no blocks in use back to the system.
+/// WARNING: Must be called with the pool lock held.
+static void pes_release_slab(PESBlockPool &pool, PESSlab *slab)
 {
-    return alloc4096.find(ptr) != alloc4096.end();
+    vector<PESSlab*>::iterator it =
+        find(pool.slabs.begin(), pool.slabs.end(), slab);
+    if (it != pool.slabs.end())
+        pool.slabs.erase(it);
+
+    pool.free_cnt           -= slab->blocks;
+    pool.stats.slabs--;
+    pool.stats.total_blocks -= slab->blocks;
+    pool.stats.releases++;
+
+    pes_register_slab(slab, false);
+    free(slab);
 }
 
-static void return_4096_block(unsigned char* ptr)
+/// Moves up to cnt blocks from the thread cache back to their slabs
+static void pes_drain_cache(PESThreadCache *cache, uint sc, uint cnt)
 {
-    alloc4096.erase(ptr);
-    free4096.push_back(ptr);
-
-#if 0 // enable this to debug memory leaks
-        cerr<<alloc4096.size()<<" 4096 blocks remain"<<endl;
-        map<unsigned char*, bool>::iterator it;
-        for (it = alloc4096.begin(); it != alloc4096.end(); ++it)
+    PESBlockPool &pool = pes_pools[sc];
+    QMutexLocker locker(&pool.lock);
+    for (uint i = 0; i < cnt && cache->free_list[sc]; i++)
+    {
+        PESFreeBlock *blk    = cache->free_list[sc];
+        cache->free_list[sc] = blk->next;
+        cache->free_cnt[sc]--;
+
+        PESSlab *slab   = pes_block_slab(blk);
+        blk->next       = slab->free_list;
+        slab->free_list = blk;
+        slab->free_cnt++;
+        pool.free_cnt++;
+
+        if ((slab->free_cnt == slab->blocks) &&
+            (pool.free_cnt - slab->free_cnt >= slab->blocks))
         {
-            TSPacket *ts = (TSPacket*) it->first;
-            cerr<<QString("PES Packet: pid(0x%1)").arg(ts->PID(),0,16);
-            if (ts->PID() == 0x1ffb)
-            {
-                cerr<<QString(" tid(0x%1) ext(0x%2)")
-                    .arg(PSIPTable::View(*ts).TableID(),0,16)
-                    .arg(PSIPTable::View(*ts).TableIDExtension(),0,16);
-            }
-            cerr<<endl;
+            pes_release_slab(pool, slab);
         }
-#endif
+    }
+    pool.stats.drains++;
+    pool.stats.free_blocks = pool.free_cnt;
+}
+
+static void pes_delete_cache(void *ptr)
+{
+    PESThreadCache *cache = (PESThreadCache*) ptr;
+    for (uint sc = 0; sc < kPESClassCount; sc++)
+        pes_drain_cache(cache, sc, cache->free_cnt[sc]);
+    delete cache;
+}
 
-    // free the allocator only if more than 1 block was used
-    if (alloc4096.empty() && mem4096.size() > 1)
+static void pes_create_cache_key(void)
+{
+    pthread_key_create(&pes_cache_key, pes_delete_cache);
+}
+
+static PESThreadCache *pes_get_cache(void)
+{
+    pthread_once(&pes_cache_once, pes_create_cache_key);
+    PESThreadCache *cache =
+        (PESThreadCache*) pthread_getspecific(pes_cache_key);
+    if (!cache)
     {
-        vector<unsigned char*>::iterator it;
-        for (it = mem4096.begin(); it != mem4096.end(); ++it)
-            free(*it);
-        mem4096.clear();
-        free4096.clear();
-        //cerr<<"freeing all 4096 blocks"<<endl;
+        cache = new PESThreadCache();
+        pthread_setspecific(pes_cache_key, cache);
     }
+    return cache;
 }
 
-static QMutex pes_alloc_mutex;
+/// Moves a batch of blocks from a slab to the thread cache, carving up
+/// a new slab first if none has a free block.
+static void pes_refill_cache(PESThreadCache *cache, uint sc)
+{
+    PESBlockPool &pool = pes_pools[sc];
+    QMutexLocker locker(&pool.lock);
+
+    // Use the fullest slab, so the others get a chance to empty out
+    PESSlab *slab = NULL;
+    vector<PESSlab*>::const_iterator it = pool.slabs.begin();
+    for (; it != pool.slabs.end(); ++it)
+    {
+        if ((*it)->free_cnt && (!slab || (*it)->free_cnt < slab->free_cnt))
+            slab = *it;
+    }
+
+    if (!slab)
+    {
+        slab = pes_new_slab(sc);
+        if (!slab)
+            return;
+        pool.slabs.push_back(slab);
+        pool.free_cnt += slab->blocks;
+        pool.stats.slabs++;
+        pool.stats.total_blocks += slab->blocks;
+    }
+
+    for (uint i = 0; i < kPESBatch && slab->free_list; i++)
+    {
+        PESFreeBlock *blk    = slab->free_list;
+        slab->free_list      = blk->next;
+        slab->free_cnt--;
+        pool.free_cnt--;
+        blk->next            = cache->free_list[sc];
+        cache->free_list[sc] = blk;
+        cache->free_cnt[sc]++;
+    }
+
+    pool.stats.refills++;
+    pool.stats.free_blocks = pool.free_cnt;
+    pool.stats.max_in_use  = max(pool.stats.max_in_use,
+                                 pool.stats.total_blocks - pool.free_cnt);
+}
 
 unsigned char *pes_alloc(uint size)
 {
-    QMutexLocker locker(&pes_alloc_mutex);
 #ifndef USING_VALGRIND
-    if (size <= 188)
-        return get_188_block();
-    else if (size <= 4096)
-        return get_4096_block();
+    if (size <= kPESBlockSize[kPESClass4096])
+    {
+        uint sc = (size <= kPESBlockSize[kPESClass188]) ?
+            kPESClass188 : kPESClass4096;
+
+        PESThreadCache *cache = pes_get_cache();
+        if (!cache->free_list[sc])
+            pes_refill_cache(cache, sc);
+
+        PESFreeBlock *blk = cache->free_list[sc];
+        if (blk)
+        {
+            cache->free_list[sc] = blk->next;
+            cache->free_cnt[sc]--;
+            return (unsigned char*) blk;
+        }
+    }
 #endif // USING_VALGRIND
+
+    QMutexLocker locker(&pes_large_lock);
+    pes_large_allocs++;
+
     return (unsigned char*) malloc(size);
 }
 
 void pes_free(unsigned char *ptr)
 {
-    QMutexLocker locker(&pes_alloc_mutex);
+    if (!ptr)
+        return;
+
 #ifndef USING_VALGRIND
-    if (is_188_block(ptr))
-        return_188_block(ptr);
-    else if (is_4096_block(ptr))
-        return_4096_block(ptr);
-    else
+    PESThreadCache *cache = pes_get_cache();
+    PESSlab *slab = pes_find_slab(cache, ptr);
+    if (slab)
+    {
+        const uint sc        = slab->size_class;
+        PESFreeBlock *blk    = (PESFreeBlock*) ptr;
+        blk->next            = cache->free_list[sc];
+        cache->free_list[sc] = blk;
+        cache->free_cnt[sc]++;
+
+        // don't let one thread hoard blocks freed on behalf of others
+        if (cache->free_cnt[sc] >= 2 * kPESBatch)
+            pes_drain_cache(cache, sc, kPESBatch);
+        return;
+    }
 #endif // USING_VALGRIND
-        free(ptr);
+
+    free(ptr);
+}
+
+/** \fn pes_alloc_stats(uint)
+ *  \brief Returns a snapshot of the slab allocator statistics for the
+ *         size class serving allocations of up to block_size bytes.
+ *
+ *   Blocks sitting in per thread caches are counted as in use.
+ */
+PESAllocStats pes_alloc_stats(uint block_size)
+{
+    PESAllocStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    if (block_size > kPESBlockSize[kPESClass4096])
+    {
+        QMutexLocker locker(&pes_large_lock);
+        stats.block_size   = block_size;
+        stats.large_allocs = pes_large_allocs;
+        return stats;
+    }
+
+    uint sc = (block_size <= kPESBlockSize[kPESClass188]) ?
+        kPESClass188 : kPESClass4096;
+
+    PESBlockPool &pool = pes_pools[sc];
+    QMutexLocker locker(&pool.lock);
+    stats = pool.stats;
+    stats.block_size = kPESBlockSize[sc];
+
+    QMutexLocker large_locker(&pes_large_lock);
+    stats.large_allocs = pes_large_allocs;
+
+    return stats;
 }
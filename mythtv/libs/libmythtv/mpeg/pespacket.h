@@ -8,14 +8,30 @@
   max length of private_section = 4096 bytes
 */
 
+// POSIX
+#include <stdint.h>  // uint64_t
+
 #include <vector>
 using namespace std;
 
 #include "tspacket.h"
 #include "mythverbose.h"
 
-unsigned char *pes_alloc(uint size);
-void pes_free(unsigned char *ptr);
+/// Statistics for one size class of the pes_alloc() slab allocator
+typedef struct
+{
+    uint     block_size;   ///< usable bytes per block
+    uint     slabs;        ///< slabs currently allocated
+    uint     total_blocks; ///< blocks in those slabs
+    uint     free_blocks;  ///< free blocks in those slabs
+    uint     max_in_use;   ///< high water mark of blocks outside the slabs
+    uint64_t refills;      ///< thread cache refills from the slabs
+    uint64_t drains;       ///< thread cache returns to the slabs
+    uint64_t releases;     ///< empty slabs given back to the system
+    uint64_t large_allocs; ///< allocations too big for any size class
+} PESAllocStats;
+
+PESAllocStats pes_alloc_stats(uint block_size);
 
 /** \class PESPacket
  *  \brief Allows us to transform TS packets to PES packets, which
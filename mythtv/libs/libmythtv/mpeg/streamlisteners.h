@@ -51,6 +51,13 @@ class TSPacketListener
 {
   public:
     virtual bool ProcessTSPacket(const TSPacket& tspacket) = 0;
+    /// Processes a run of consecutive packets which all share one PID,
+    /// by default this just calls ProcessTSPacket() on each packet.
+    virtual bool ProcessTSPackets(const TSPacket *tspackets, uint count);
+    /// Called once the buffer holding the packets passed in since the
+    /// last call is about to be reused, listeners that only kept
+    /// references to packets must consume them now.
+    virtual void FlushTSPackets(void) { }
 
   protected:
     virtual ~TSPacketListener() { }
@@ -61,6 +68,12 @@ class TSPacketListenerAV
   public:
     virtual bool ProcessVideoTSPacket(const TSPacket& tspacket) = 0;
     virtual bool ProcessAudioTSPacket(const TSPacket& tspacket) = 0;
+    /// Processes a run of consecutive video packets sharing one PID
+    virtual bool ProcessVideoTSPackets(const TSPacket *tspackets, uint count);
+    /// Processes a run of consecutive audio packets sharing one PID
+    virtual bool ProcessAudioTSPackets(const TSPacket *tspackets, uint count);
+    /// See TSPacketListener::FlushTSPackets()
+    virtual void FlushTSPackets(void) { }
 
   protected:
     virtual ~TSPacketListenerAV() { }
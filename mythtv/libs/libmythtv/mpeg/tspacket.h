@@ -4,6 +4,7 @@
 #define _TS_PACKET_H_
 
 #include <cstdlib>
+#include <new>
 #include "mythcontext.h"
 using namespace std;
 
@@ -13,6 +14,10 @@ using namespace std;
 #define AUDIO_PID(bp) ((bp)+4)
 #define SYNC_BYTE     0x0047
 
+// Slab allocator shared by TSPacket, PESPacket and PSIPTable
+unsigned char *pes_alloc(uint size);
+void pes_free(unsigned char *ptr);
+
 /** \class TSHeader
  *  \brief Used to access header of a TSPacket.
  *
@@ -130,6 +135,16 @@ class TSPacket : public TSHeader
     /* note: payload is intenionally left uninitialized */
     TSPacket() : TSHeader() { }
 
+    static void *operator new(size_t size)
+    {
+        void *ptr = pes_alloc(size);
+        if (!ptr)
+            throw std::bad_alloc();
+        return ptr;
+    }
+    static void operator delete(void *ptr)
+        { pes_free(static_cast<unsigned char*>(ptr)); }
+
     static TSPacket* CreatePayloadOnlyPacket()
     {
         TSPacket *pkt = new TSPacket();
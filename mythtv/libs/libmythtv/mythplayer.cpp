@@ -188,7 +188,8 @@ MythPlayer::MythPlayer(bool muted)
       postfilt_width(0),            postfilt_height(0),
       videoFilters(NULL),           FiltMan(new FilterManager()),
 
-      forcePositionMapSync(false),  pausedBeforeEdit(false),
+      forcePositionMapSync(false),  prefetchSkipStart(0),
+      pausedBeforeEdit(false),
       speedBeforeEdit(1.0f),
       // Playback (output) speed control
       decoder_lock(QMutex::Recursive),
@@ -2603,6 +2604,10 @@ void MythPlayer::EventLoop(void)
     if (jumpchapter != 0)
         DoJumpChapter(jumpchapter);
 
+    // Start reading the data at the next skip target before we get there
+    if (ffrew_skip == 1)
+        PrefetchNextSkip();
+
     // Handle commercial skipping
     if (commBreakMap.GetSkipCommercials() != 0 && (ffrew_skip == 1))
     {
@@ -2846,7 +2851,8 @@ void MythPlayer::DecoderLoop(bool pause)
             continue;
         }
 
-        DecodeType dt = (audio.HasAudioOut() && normal_speed) ?
+        DecodeType dt = ((audio.HasAudioOut() ||
+                          audio.HasAudioDataListener()) && normal_speed) ?
             kDecodeAV : kDecodeVideo;
         //if (noVideoTracks && audio.HasAudioOut())
         //    dt = kDecodeAudio;
@@ -3411,6 +3417,41 @@ void MythPlayer::DoJumpToFrame(uint64_t frame, bool override_seeks,
         DoRewind(framesPlayed - frame, override_seeks, seeks_wanted);
 }
 
+/** \fn MythPlayer::PrefetchNextSkip(void)
+ *  \brief Tells the RingBuffer where the next cut or commercial skip
+ *         will land once it is less than 30 seconds away, so the
+ *         data there can be read before the jump is made.
+ */
+void MythPlayer::PrefetchNextSkip(void)
+{
+    if (!decoder || !player_ctx->buffer || livetv)
+        return;
+
+    uint64_t start  = totalFrames;
+    uint64_t jumpto = totalFrames;
+    if (!deleteMap.IsEmpty())
+        start = deleteMap.TrackerNextCutStart();
+    else if (!commBreakMap.GetNextSkip(framesPlayed, video_frame_rate,
+                                       start, jumpto))
+        return;
+
+    if ((start >= totalFrames) || (start == prefetchSkipStart) ||
+        (start > framesPlayed + (uint64_t)(30 * video_frame_rate)))
+        return;
+
+    prefetchSkipStart = start;
+
+    if (!deleteMap.IsEmpty())
+        jumpto = deleteMap.GetNearestMark(start, totalFrames, true);
+
+    if (jumpto >= totalFrames)
+        return;
+
+    long long pos = decoder->GetSeekPosition(jumpto);
+    if (pos >= 0)
+        player_ctx->buffer->SetPrefetchHint(pos);
+}
+
 void MythPlayer::WaitForSeek(uint64_t frame, bool override_seeks,
                              bool seeks_wanted)
 {
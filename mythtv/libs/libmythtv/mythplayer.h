@@ -486,6 +486,7 @@ class MPUBLIC MythPlayer
                   bool seeks_wanted = false);
     void DoJumpToFrame(uint64_t frame, bool override_seeks = false,
                        bool seeks_wanted = false);
+    void PrefetchNextSkip(void);
 
     // Private seeking stuff
     void WaitForSeek(uint64_t frame, bool override_seeks = false,
@@ -666,6 +667,8 @@ class MPUBLIC MythPlayer
     // Commercial filtering
     CommBreakMap   commBreakMap;
     bool       forcePositionMapSync;
+    /// Start of the break or cut whose skip target was last prefetched
+    uint64_t   prefetchSkipStart;
     // Manual editing
     DeleteMap  deleteMap;
     bool       pausedBeforeEdit;
@@ -6,6 +6,9 @@
 #include <algorithm>
 using namespace std;
 
+// Qt headers
+#include <QHash>
+
 // MythTV headers
 #include "channelutil.h"
 #include "mythdb.h"
@@ -26,6 +29,9 @@ static const char *roles[] =
     "presenter", "commentator", "guest",
 };
 
+/// Most names looked up by one people query in DBPerson::InsertDB()
+static const uint kMaxPeopleLookup = 100;
+
 DBPerson::DBPerson(const DBPerson &other) :
     role(other.role), name(other.name)
 {
@@ -69,6 +75,80 @@ uint DBPerson::InsertDB(MSqlQuery &query, uint chanid,
     return InsertCreditsDB(query, personid, chanid, starttime);
 }
 
+/** \brief Inserts the people and credits of a program with a few
+ *         multi-row statements instead of three queries per person.
+ *  \return number of credits inserted
+ */
+uint DBPerson::InsertDB(MSqlQuery &query, const vector<DBPerson> &credits,
+                        uint chanid, const QDateTime &starttime)
+{
+    if (credits.empty())
+        return 0;
+
+    {
+        MSqlBulkInsert people(query, "INSERT IGNORE INTO people",
+                              QStringList() << "name");
+        for (uint i = 0; i < credits.size(); i++)
+            people.AddRow(QVariantList() << credits[i].name);
+        if (!people.Flush())
+            return 0;
+    }
+
+    // Look the names up in chunks, so the statement stays well within
+    // max_allowed_packet and full chunks share one cached statement.
+    QHash<QString, uint> personids;
+    for (uint start = 0; start < credits.size(); start += kMaxPeopleLookup)
+    {
+        uint count = min((uint)credits.size() - start, kMaxPeopleLookup);
+
+        QStringList holders;
+        for (uint i = 0; i < count; i++)
+            holders << "?";
+
+        query.prepare("SELECT person, name "
+                      "FROM people "
+                      "WHERE name IN (" + holders.join(",") + ")",
+                      count == kMaxPeopleLookup);
+        for (uint i = 0; i < count; i++)
+            query.bindValue(i, credits[start + i].name);
+
+        if (!query.exec())
+        {
+            MythDB::DBError("get_people", query);
+            return 0;
+        }
+
+        while (query.next())
+            personids[query.value(1).toString().toLower()] =
+                query.value(0).toUInt();
+    }
+
+    // Names the collation matched differently are looked up one by one
+    vector<uint> unmatched;
+    uint inserted = 0;
+    {
+        MSqlBulkInsert bulk(query, "REPLACE INTO credits",
+                            QStringList() << "person" << "chanid"
+                                          << "starttime" << "role");
+        for (uint i = 0; i < credits.size(); i++)
+        {
+            uint personid = personids.value(credits[i].name.toLower());
+            if (personid)
+                bulk.AddRow(QVariantList() << personid << chanid
+                            << starttime << credits[i].GetRole());
+            else
+                unmatched.push_back(i);
+        }
+        bulk.Flush();
+        inserted = bulk.GetRowCount();
+    }
+
+    for (uint i = 0; i < unmatched.size(); i++)
+        inserted += credits[unmatched[i]].InsertDB(query, chanid, starttime);
+
+    return inserted;
+}
+
 uint DBPerson::GetPersonDB(MSqlQuery &query) const
 {
     query.prepare(
@@ -579,10 +659,7 @@ uint DBEvent::UpdateDB(
     }
 
     if (credits)
-    {
-        for (uint i = 0; i < credits->size(); i++)
-            (*credits)[i].InsertDB(query, chanid, starttime);
-    }
+        DBPerson::InsertDB(query, *credits, chanid, starttime);
 
     return 1;
 }
@@ -743,10 +820,7 @@ uint DBEvent::InsertDB(MSqlQuery &query, uint chanid) const
     }
 
     if (credits)
-    {
-        for (uint i = 0; i < credits->size(); i++)
-            (*credits)[i].InsertDB(query, chanid, starttime);
-    }
+        DBPerson::InsertDB(query, *credits, chanid, starttime);
 
     return 1;
 }
@@ -876,27 +950,21 @@ uint ProgInfo::InsertDB(MSqlQuery &query, uint chanid) const
         return 0;
     }
 
-    QList<EventRating>::const_iterator j = ratings.begin();
-    for (; j != ratings.end(); ++j)
+    if (!ratings.empty())
     {
-        query.prepare(
-            "INSERT INTO programrating "
-            "       ( chanid, starttime, system, rating) "
-            "VALUES (:CHANID, :START,    :SYS,  :RATING)");
-        query.bindValue(":CHANID", chanid);
-        query.bindValue(":START",  starttime);
-        query.bindValue(":SYS",    (*j).system);
-        query.bindValue(":RATING", (*j).rating);
-
-        if (!query.exec())
-            MythDB::DBError("programrating insert", query);
+        MSqlBulkInsert bulk(query, "INSERT INTO programrating",
+                            QStringList() << "chanid" << "starttime"
+                                          << "system" << "rating");
+        QList<EventRating>::const_iterator j = ratings.begin();
+        for (; j != ratings.end(); ++j)
+        {
+            bulk.AddRow(QVariantList() << chanid << starttime
+                        << (*j).system << (*j).rating);
+        }
     }
 
     if (credits)
-    {
-        for (uint i = 0; i < credits->size(); ++i)
-            (*credits)[i].InsertDB(query, chanid, starttime);
-    }
+        DBPerson::InsertDB(query, *credits, chanid, starttime);
 
     return 1;
 }
@@ -47,6 +47,8 @@ class MPUBLIC DBPerson
 
     uint InsertDB(MSqlQuery &query, uint chanid,
                   const QDateTime &starttime) const;
+    static uint InsertDB(MSqlQuery &query, const vector<DBPerson> &credits,
+                         uint chanid, const QDateTime &starttime);
 
   private:
     uint GetPersonDB(MSqlQuery &query) const;
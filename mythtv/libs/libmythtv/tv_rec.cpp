@@ -26,6 +26,7 @@ using namespace std;
 #include "recordingrule.h"
 #include "eitscanner.h"
 #include "RingBuffer.h"
+#include "ThreadedFileWriter.h"
 #include "storagegroup.h"
 #include "remoteutil.h"
 #include "tvremoteutil.h"
@@ -74,8 +75,11 @@ QMap<uint,TVRec*> TVRec::cards;
 
 static bool is_dishnet_eit(uint cardid);
 static QString load_profile(QString,void*,RecordingInfo*,RecordingProfile&);
+static int get_jobs(const RecordingInfo *rec, RecordingProfile &profile);
+static bool is_on_line_comm(int jobs, bool transcode_bfr_comm);
 static int init_jobs(const RecordingInfo *rec, RecordingProfile &profile,
-                     bool on_host, bool transcode_bfr_comm, bool on_line_comm);
+                     bool on_host, bool transcode_bfr_comm, bool on_line_comm,
+                     bool in_recorder_comm = false);
 
 /** \class TVRec
  *  \brief This is the coordinating class of the \ref recorder_subsystem.
@@ -111,7 +115,8 @@ TVRec::TVRec(int capturecardnum)
       recorder_thread(pthread_t()),
       // Configuration variables from database
       transcodeFirst(false),
-      earlyCommFlag(false),         runJobOnHostOnly(false),
+      earlyCommFlag(false),         inlineCommFlag(false),
+      runJobOnHostOnly(false),
       eitCrawlIdleStart(60),        eitTransportTimeout(5*60),
       audioSampleRateDB(0),
       overRecordSecNrml(0),         overRecordSecCat(0),
@@ -259,6 +264,7 @@ bool TVRec::Init(void)
     transcodeFirst    =
         gCoreContext->GetNumSetting("AutoTranscodeBeforeAutoCommflag", 0);
     earlyCommFlag     = gCoreContext->GetNumSetting("AutoCommflagWhileRecording", 0);
+    inlineCommFlag    = gCoreContext->GetNumSetting("AutoCommflagInRecorder", 0);
     runJobOnHostOnly  = gCoreContext->GetNumSetting("JobsRunOnRecordHost", 0);
     eitTransportTimeout=gCoreContext->GetNumSetting("EITTransportTimeout", 5) * 60;
     eitCrawlIdleStart = gCoreContext->GetNumSetting("EITCrawIdleStart", 60);
@@ -3968,8 +3974,7 @@ MPEGStreamData *TVRec::TuningSignalCheck(void)
     return streamData;
 }
 
-static int init_jobs(const RecordingInfo *rec, RecordingProfile &profile,
-                      bool on_host, bool transcode_bfr_comm, bool on_line_comm)
+static int get_jobs(const RecordingInfo *rec, RecordingProfile &profile)
 {
     if (!rec)
         return 0; // no jobs for Live TV recordings..
@@ -3988,13 +3993,43 @@ static int init_jobs(const RecordingInfo *rec, RecordingProfile &profile,
     if ((!autoTrans) || (autoTrans->getValue().toInt() == 0))
         JobQueue::RemoveJobsFromMask(JOB_TRANSCODE, jobs);
 
-    // is commercial flagging enabled, and is on-line comm flagging enabled?
-    bool rt = JobQueue::JobIsInMask(JOB_COMMFLAG, jobs) && on_line_comm;
+    return jobs;
+}
+
+/// Returns true if commercial flagging may be done while recording.
+static bool is_on_line_comm(int jobs, bool transcode_bfr_comm)
+{
+    // is commercial flagging enabled?
+    bool rt = JobQueue::JobIsInMask(JOB_COMMFLAG, jobs);
     // also, we either need transcoding to be disabled or
     // we need to be allowed to commercial flag before transcoding?
     rt &= JobQueue::JobIsNotInMask(JOB_TRANSCODE, jobs) ||
         !transcode_bfr_comm;
-    if (rt)
+    return rt;
+}
+
+static int init_jobs(const RecordingInfo *rec, RecordingProfile &profile,
+                      bool on_host, bool transcode_bfr_comm, bool on_line_comm,
+                      bool in_recorder_comm)
+{
+    int jobs = get_jobs(rec, profile);
+
+    if (in_recorder_comm)
+    {
+        // The recorder flags commercials, see
+        // DTVRecorder::EnableInlineCommFlagging(). In case the backend
+        // goes away before the flagger is done, a regular job is queued
+        // to run well after the recording ends. The flagger removes it.
+        QString host = (on_host) ? gCoreContext->GetHostName() : "";
+        JobQueue::QueueJob(JOB_COMMFLAG,
+                           rec->GetChanID(),
+                           rec->GetRecordingStartTime(), "", "",
+                           host, 0, JOB_QUEUED,
+                           rec->GetRecordingEndTime().addSecs(30 * 60));
+
+        JobQueue::RemoveJobsFromMask(JOB_COMMFLAG, jobs);
+    }
+    else if (on_line_comm && is_on_line_comm(jobs, transcode_bfr_comm))
     {
         // queue up real-time (i.e. on-line) commercial flagging.
         QString host = (on_host) ? gCoreContext->GetHostName() : "";
@@ -4088,6 +4123,11 @@ void TVRec::TuningNewRecorder(MPEGStreamData *streamData)
             ClearFlags(kFlagPendingActions);
             goto err_ret;
         }
+        if (write && ThreadedFileWriter::IsDirectIOStorageGroup(
+                rec->GetStorageGroup()))
+        {
+            ringBuffer->SetWriterDirectIO(true);
+        }
     }
 
     if (!ringBuffer)
@@ -4140,6 +4180,15 @@ void TVRec::TuningNewRecorder(MPEGStreamData *streamData)
     if (rec)
         recorder->SetRecording(rec);
 
+    // flag commercials in the recorder rather than with a job?
+    bool in_recorder_comm = false;
+    if (!tvchain && rec && inlineCommFlag && GetDTVRecorder() &&
+        is_on_line_comm(get_jobs(rec, profile), transcodeFirst))
+    {
+        GetDTVRecorder()->EnableInlineCommFlagging();
+        in_recorder_comm = true;
+    }
+
     // Setup for framebuffer capture devices..
     if (channel)
     {
@@ -4170,7 +4219,8 @@ void TVRec::TuningNewRecorder(MPEGStreamData *streamData)
 
     if (!tvchain)
         autoRunJobs = init_jobs(rec, profile, runJobOnHostOnly,
-                                transcodeFirst, earlyCommFlag);
+                                transcodeFirst, earlyCommFlag,
+                                in_recorder_comm);
 
     ClearFlags(kFlagNeedToStartRecorder);
     return;
@@ -4476,6 +4526,9 @@ bool TVRec::GetProgramRingBufferForLiveTV(RecordingInfo **pginfo,
         return false;
     }
 
+    if (ThreadedFileWriter::IsDirectIOStorageGroup(prog->GetStorageGroup()))
+        (*rb)->SetWriterDirectIO(true);
+
     *pginfo = prog;
     return true;
 }
@@ -332,6 +332,7 @@ class MPUBLIC TVRec : public SignalMonitorListener
     // Configuration variables from database
     bool    transcodeFirst;
     bool    earlyCommFlag;
+    bool    inlineCommFlag;
     bool    runJobOnHostOnly;
     int     eitCrawlIdleStart;
     int     eitTransportTimeout;
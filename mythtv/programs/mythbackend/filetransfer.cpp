@@ -1,3 +1,19 @@
+// ANSI C headers
+#include <cerrno>
+#include <ctime>
+
+// POSIX headers
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "mythconfig.h"
+#if !( CONFIG_DARWIN || CONFIG_CYGWIN || defined(__FreeBSD__) || defined(USING_MINGW))
+#define USE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QFileInfo>
@@ -7,22 +23,35 @@
 #include "util.h"
 #include "mythsocket.h"
 #include "programinfo.h"
+#include "mythverbose.h"
+#include "compat.h"
+
+#ifndef O_LARGEFILE
+#define O_LARGEFILE 0
+#endif
 
 FileTransfer::FileTransfer(QString &filename, MythSocket *remote,
                            bool usereadahead, int timeout_ms) :
     readthreadlive(true), readsLocked(false),
     rbuffer(new RingBuffer(filename, false, usereadahead, timeout_ms)),
-    sock(remote), ateof(false), lock(QMutex::NonRecursive),
+    sock(remote), ateof(false),
+    sendfd(-1), sendpos(0), sendfileold(false),
+    lock(QMutex::NonRecursive),
     refLock(QMutex::NonRecursive), refCount(0), writemode(false)
 {
     pginfo = new ProgramInfo(filename);
     pginfo->MarkAsInUse(true, kFileTransferInUseID);
+
+    if (rbuffer->IsOpen())
+        OpenSendFile(filename);
 }
 
 FileTransfer::FileTransfer(QString &filename, MythSocket *remote, bool write) :
     readthreadlive(true), readsLocked(false),
     rbuffer(new RingBuffer(filename, write)),
-    sock(remote), ateof(false), lock(QMutex::NonRecursive),
+    sock(remote), ateof(false),
+    sendfd(-1), sendpos(0), sendfileold(false),
+    lock(QMutex::NonRecursive),
     refLock(QMutex::NonRecursive), refCount(0), writemode(write)
 {
     pginfo = new ProgramInfo(filename);
@@ -42,6 +71,12 @@ FileTransfer::~FileTransfer()
         rbuffer = NULL;
     }
 
+    if (sendfd >= 0)
+    {
+        close(sendfd);
+        sendfd = -1;
+    }
+
     if (pginfo)
     {
         pginfo->MarkAsInUse(false, kFileTransferInUseID);
@@ -49,6 +84,39 @@ FileTransfer::~FileTransfer()
     }
 }
 
+/** \fn FileTransfer::OpenSendFile(const QString&)
+ *  \brief Opens the file a second time so blocks can be sent to the
+ *         client with sendfile(), without copying them through
+ *         userspace. Files which are not regular files keep being
+ *         read through the RingBuffer.
+ */
+void FileTransfer::OpenSendFile(const QString &filename)
+{
+#ifdef USE_SENDFILE
+    QByteArray fname = filename.toLocal8Bit();
+    sendfd = open(fname.constData(), O_RDONLY|O_LARGEFILE);
+
+    struct stat st;
+    if ((sendfd >= 0) && ((fstat(sendfd, &st) < 0) || !S_ISREG(st.st_mode)))
+    {
+        close(sendfd);
+        sendfd = -1;
+    }
+
+    if (sendfd < 0)
+        return;
+
+    // same test the RingBuffer uses to decide whether
+    // the file may still be growing
+    sendfileold = (time(NULL) - st.st_mtime) > 60;
+
+    VERBOSE(VB_FILE, QString("FileTransfer: Using sendfile() for %1%2")
+            .arg(filename).arg(sendfileold ? "" : " (growing)"));
+#else
+    (void) filename;
+#endif
+}
+
 void FileTransfer::UpRef(void)
 {
     QMutexLocker locker(&refLock);
@@ -128,6 +196,16 @@ int FileTransfer::RequestBlock(int size)
     while (readsLocked)
         readsUnlockedCond.wait(&lock, 100 /*ms*/);
 
+    if (sendfd >= 0)
+    {
+        tot = SendBlock(size);
+
+        if (pginfo)
+            pginfo->UpdateInUseMark();
+
+        return tot;
+    }
+
     requestBuffer.resize(max((size_t)max(size,0) + 128, requestBuffer.size()));
     char *buf = &requestBuffer[0];
     while (tot < size && !rbuffer->GetStopReads() && readthreadlive)
@@ -156,6 +234,65 @@ int FileTransfer::RequestBlock(int size)
     return (ret < 0) ? -1 : tot;
 }
 
+/** \fn FileTransfer::SendBlock(int)
+ *  \brief Sends up to size bytes from the current position to the
+ *         client's data socket with sendfile().
+ *
+ *   As in RingBuffer::safe_read(), at the end of a file which may still
+ *   be growing we wait up to 2.4 seconds for more data to be written.
+ *
+ *   WARNING: Must be called with lock held.
+ *
+ *  \return bytes sent, or -1 on error
+ */
+int FileTransfer::SendBlock(int size)
+{
+#ifdef USE_SENDFILE
+    int  tot     = 0;
+    uint zerocnt = 0;
+    uint busycnt = 0;
+
+    while (tot < size && !rbuffer->GetStopReads() && readthreadlive)
+    {
+        __off64_t offset = sendpos;
+        ssize_t ret = sendfile64(sock->socket(), sendfd, &offset, size - tot);
+
+        if (ret > 0)
+        {
+            tot    += ret;
+            sendpos = offset;
+            busycnt = 0;
+            continue;
+        }
+
+        if (ret < 0)
+        {
+            // the socket is non-blocking, wait for room like writeData()
+            if (((errno == EAGAIN) || (errno == EINTR)) && (++busycnt < 5000))
+            {
+                usleep(1000);
+                continue;
+            }
+
+            VERBOSE(VB_IMPORTANT, QString("FileTransfer: sendfile() of %1 "
+                    "bytes at %2 failed").arg(size - tot).arg(sendpos) + ENO);
+            return -1;
+        }
+
+        // at the end of the file
+        if (sendfileold || (tot > 0) || (++zerocnt >= 40))
+            break;
+
+        usleep(60000);
+    }
+
+    return tot;
+#else
+    (void) size;
+    return -1;
+#endif
+}
+
 int FileTransfer::WriteBlock(int size)
 {
     if (!writemode || !rbuffer)
@@ -203,15 +340,34 @@ long long FileTransfer::Seek(long long curpos, long long pos, int whence)
 
     Pause();
 
-    if (whence == SEEK_CUR)
+    long long ret = -1;
+
+    if (sendfd >= 0)
     {
-        long long desired = curpos + pos;
-        long long realpos = rbuffer->GetReadPosition();
+        QMutexLocker locker(&lock);
 
-        pos = desired - realpos;
+        if (whence == SEEK_SET)
+            ret = pos;
+        else if (whence == SEEK_CUR)
+            ret = curpos + pos;
+        else if (whence == SEEK_END)
+            ret = lseek64(sendfd, pos, SEEK_END);
+
+        if (ret >= 0)
+            sendpos = ret;
     }
+    else
+    {
+        if (whence == SEEK_CUR)
+        {
+            long long desired = curpos + pos;
+            long long realpos = rbuffer->GetReadPosition();
 
-    long long ret = rbuffer->Seek(pos, whence);
+            pos = desired - realpos;
+        }
+
+        ret = rbuffer->Seek(pos, whence);
+    }
 
     Unpause();
 
@@ -235,6 +391,9 @@ void FileTransfer::SetTimeout(bool fast)
         pginfo->UpdateInUseMark();
 
     rbuffer->SetTimeout(fast);
+
+    QMutexLocker locker(&lock);
+    sendfileold = fast;
 }
 
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -52,6 +52,9 @@ class FileTransfer
   private:
    ~FileTransfer();
 
+    void OpenSendFile(const QString &filename);
+    int SendBlock(int size);
+
     volatile bool  readthreadlive;
     bool           readsLocked;
     QWaitCondition readsUnlockedCond;
@@ -63,6 +66,13 @@ class FileTransfer
 
     vector<char> requestBuffer;
 
+    /// File descriptor for sending with sendfile(), or -1 to
+    /// read through rbuffer.
+    int sendfd;
+    long long sendpos;
+    /// Don't wait for more data at the end of the file
+    bool sendfileold;
+
     QMutex lock;
     QMutex refLock;
     int refCount;
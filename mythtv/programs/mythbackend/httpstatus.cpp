@@ -36,6 +36,7 @@
 #include "scheduler.h"
 #include "mainserver.h"
 #include "cardutil.h"
+#include "ThreadedFileWriter.h"
 
 /////////////////////////////////////////////////////////////////////////////
 //
@@ -323,11 +324,13 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
     QDomElement storage = pDoc->createElement("Storage"    );
     QDomElement load    = pDoc->createElement("Load"       );
     QDomElement guide   = pDoc->createElement("Guide"      );
+    QDomElement writers = pDoc->createElement("WriteBuffers");
 
     root.appendChild (mInfo  );
     mInfo.appendChild(storage);
     mInfo.appendChild(load   );
     mInfo.appendChild(guide  );
+    mInfo.appendChild(writers);
 
     // drive space   ---------------------
 
@@ -423,6 +426,19 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
         load.setAttribute("avg3", rgdAverages[2]);
     }
 
+    // recording write buffers ---------------------
+
+    TFWStats tfwStats = ThreadedFileWriter::GetStats();
+
+    writers.setAttribute("ioBound"  , tfwStats.iobound_events       );
+    writers.setAttribute("highWater", tfwStats.max_buf_used  >> 10  );
+    writers.setAttribute("maxSize"  , tfwStats.max_buf_size  >> 10  );
+    writers.setAttribute("grows"    , tfwStats.buf_grows            );
+    writers.setAttribute("shrinks"  , tfwStats.buf_shrinks          );
+    writers.setAttribute("writeP50" , tfwStats.write_p50            );
+    writers.setAttribute("writeP95" , tfwStats.write_p95            );
+    writers.setAttribute("writeP99" , tfwStats.write_p99            );
+
     // Guide Data ---------------------
 
     QDateTime GuideDataThrough;
@@ -457,6 +473,37 @@ void HttpStatus::FillStatusXML( QDomDocument *pDoc )
     QDomText dataDirectMessage = pDoc->createTextNode(gCoreContext->GetSetting("DataDirectMessage"));
     guide.appendChild(dataDirectMessage);
 
+    // Protocol request latencies ---------------------
+
+    if (m_pMainServer)
+    {
+        QDomElement requests = pDoc->createElement("Requests");
+        root.appendChild(requests);
+
+        QMap<QString, RequestStats> stats = m_pMainServer->GetRequestStats();
+        QMap<QString, RequestStats>::const_iterator it = stats.begin();
+        for (; it != stats.end(); ++it)
+        {
+            QDomElement command = pDoc->createElement("Command");
+            requests.appendChild(command);
+
+            command.setAttribute("name" , it.key());
+            command.setAttribute("count", (*it).count);
+            command.setAttribute("avgMs", (*it).count ?
+                (uint)((*it).totalMs / (*it).count) : 0U);
+            command.setAttribute("maxMs", (*it).maxMs);
+
+            for (uint i = 0; i < RequestStats::kNumBuckets; i++)
+            {
+                QDomElement bucket = pDoc->createElement("Latency");
+                command.appendChild(bucket);
+
+                bucket.setAttribute("range", RequestStats::BucketName(i));
+                bucket.setAttribute("count", (*it).buckets[i]);
+            }
+        }
+    }
+
     // Add Miscellaneous information
 
     QString info_script = gCoreContext->GetSetting("MiscStatusScript");
@@ -668,6 +715,13 @@ void HttpStatus::PrintStatus( QTextStream &os, QDomDocument *pDoc )
     if (!node.isNull())
         PrintMachineInfo( os, node.toElement());
 
+    // Protocol request latencies --------------
+
+    node = docElem.namedItem( "Requests" );
+
+    if (!node.isNull())
+        PrintRequestStats( os, node.toElement());
+
     // Miscellaneous information ---------------
 
     node = docElem.namedItem( "Miscellaneous" );
@@ -1279,6 +1333,43 @@ int HttpStatus::PrintMachineInfo( QTextStream &os, QDomElement info )
 
     os << "      </ul>\r\n";
 
+    // recording write buffers ---------------------
+
+    node = info.namedItem( "WriteBuffers" );
+
+    if (!node.isNull())
+    {
+        QDomElement e = node.toElement();
+
+        if (!e.isNull())
+        {
+            QLocale c(QLocale::C);
+
+            os << "      Recording Write Buffers:<br />\r\n"
+               << "      <ul>\r\n"
+               << "        <li>IO bound waits: "
+               << c.toString(e.attribute("ioBound", "0").toInt())
+               << "</li>\r\n"
+               << "        <li>Buffer High Water Mark: "
+               << c.toString(e.attribute("highWater", "0").toInt())
+               << " KB</li>\r\n"
+               << "        <li>Largest Buffer: "
+               << c.toString(e.attribute("maxSize", "0").toInt())
+               << " KB</li>\r\n"
+               << "        <li>Buffers Grown / Shrunk: "
+               << e.attribute("grows", "0") << " / "
+               << e.attribute("shrinks", "0") << "</li>\r\n"
+               << "        <li>Disk Write Latency (p50 / p95 / p99): "
+               << c.toString(e.attribute("writeP50", "0").toInt() / 1000.0,
+                             'f', 1) << " / "
+               << c.toString(e.attribute("writeP95", "0").toInt() / 1000.0,
+                             'f', 1) << " / "
+               << c.toString(e.attribute("writeP99", "0").toInt() / 1000.0,
+                             'f', 1) << " ms</li>\r\n"
+               << "      </ul>\r\n";
+        }
+    }
+
     // Guide Info ---------------------
 
     node = info.namedItem( "Guide" );
@@ -1347,6 +1438,50 @@ int HttpStatus::PrintMachineInfo( QTextStream &os, QDomElement info )
     return( 1 );
 }
 
+int HttpStatus::PrintRequestStats( QTextStream &os, QDomElement requests )
+{
+    if (requests.isNull() || !requests.hasChildNodes())
+        return( 0 );
+
+    os << "  <div class=\"content\">\r\n"
+       << "    <h2>Protocol Requests</h2>\r\n"
+       << "    <table summary=\"Protocol request latencies\">\r\n"
+       << "      <tr><th>Command</th><th>Count</th><th>Average</th>"
+       << "<th>Maximum</th>";
+
+    QDomElement first = requests.firstChildElement( "Command" );
+    QDomElement range = first.firstChildElement( "Latency" );
+    for (; !range.isNull(); range = range.nextSiblingElement( "Latency" ))
+        os << "<th>" << HTTPRequest::Encode( range.attribute( "range" ))
+           << "</th>";
+
+    os << "</tr>\r\n";
+
+    QDomElement e = requests.firstChildElement( "Command" );
+    for (; !e.isNull(); e = e.nextSiblingElement( "Command" ))
+    {
+        os << "      <tr><td>" << HTTPRequest::Encode( e.attribute( "name" ))
+           << "</td>"
+           << "<td>" << e.attribute( "count", "0" ) << "</td>"
+           << "<td>" << e.attribute( "avgMs", "0" ) << " ms</td>"
+           << "<td>" << e.attribute( "maxMs", "0" ) << " ms</td>";
+
+        QDomElement bucket = e.firstChildElement( "Latency" );
+        for (; !bucket.isNull();
+             bucket = bucket.nextSiblingElement( "Latency" ))
+        {
+            os << "<td>" << bucket.attribute( "count", "0" ) << "</td>";
+        }
+
+        os << "</tr>\r\n";
+    }
+
+    os << "    </table>\r\n"
+       << "  </div>\r\n";
+
+    return( 1 );
+}
+
 int HttpStatus::PrintMiscellaneousInfo( QTextStream &os, QDomElement info )
 {
     if (info.isNull())
@@ -64,6 +64,7 @@ class HttpStatus : public HttpServerExtension
         int     PrintScheduled    ( QTextStream &os, QDomElement scheduled );
         int     PrintJobQueue     ( QTextStream &os, QDomElement jobs );
         int     PrintMachineInfo  ( QTextStream &os, QDomElement info );
+        int     PrintRequestStats ( QTextStream &os, QDomElement requests );
         int     PrintMiscellaneousInfo ( QTextStream &os, QDomElement info );
 
     public:
@@ -495,6 +495,13 @@ int handle_command(const MythCommandLineParser &cmdline)
 
         print_verbose_messages |= VB_SCHEDULE;
         sched->PrintList(true);
+
+        if (cmdline.IsTestSchedulerEnabled())
+        {
+            cout << "Scheduler phase times: "
+                 << sched->GetPhaseTimes().toLocal8Bit().constData() << endl;
+        }
+
         return BACKEND_EXIT_OK;
     }
 
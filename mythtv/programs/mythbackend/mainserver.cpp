@@ -36,6 +36,7 @@ using namespace std;
 #include <QUrl>
 #include <QTcpServer>
 #include <QTimer>
+#include <QSet>
 
 #include "previewgeneratorqueue.h"
 #include "exitcodes.h"
@@ -72,6 +73,13 @@ using namespace std;
 #define PRT_TIMEOUT 10
 /** Number of threads in process request thread pool at startup. */
 #define PRT_STARTUP_THREAD_COUNT 5
+/** Most REQUEST_BLOCKs a client may keep in flight on a file transfer. */
+#define FT_MAX_PIPELINE_DEPTH 8
+/** Milliseconds to wait for each slave's reply to a fanned out request. */
+#define SLAVE_REQUEST_TIMEOUT kMythSocketLongTimeout
+/** Most recordings sent to a slave in one FILL_PROGRAM_INFO_LIST request,
+ *  so each reply arrives well within SLAVE_REQUEST_TIMEOUT. */
+#define SLAVE_FILL_CHUNK_SIZE 50
 
 #define LOC      QString("MainServer: ")
 #define LOC_WARN QString("MainServer, Warning: ")
@@ -118,6 +126,73 @@ int delete_file_immediately(const QString &filename,
 
 QMutex MainServer::truncate_and_close_lock;
 const uint MainServer::kMasterServerReconnectTimeout = 1000; //ms
+/// Number of changed recordings remembered for QUERY_RECORDING_CHANGES
+const uint MainServer::kMaxRecordingListChanges = 2000;
+
+const uint RequestStats::kNumBuckets;
+/// Upper bounds in ms of all but the last RequestStats bucket
+static const uint kRequestLatencyBounds[RequestStats::kNumBuckets - 1] =
+    { 10, 50, 250, 1000, 5000 };
+
+void RequestStats::Add(uint ms)
+{
+    uint bucket = 0;
+    while (bucket < kNumBuckets - 1 && ms >= kRequestLatencyBounds[bucket])
+        bucket++;
+
+    buckets[bucket]++;
+    count++;
+    totalMs += ms;
+    maxMs = max(maxMs, ms);
+}
+
+QString RequestStats::BucketName(uint bucket)
+{
+    if (bucket < kNumBuckets - 1)
+        return QString("<%1 ms").arg(kRequestLatencyBounds[bucket]);
+    return QString(">=%1 ms").arg(kRequestLatencyBounds[kNumBuckets - 2]);
+}
+
+/// Protocol commands given their own request stats, others count as OTHER
+static const char *kRequestStatsCommands[] =
+{
+    "ALLOW_SHUTDOWN", "ANN", "BACKEND_MESSAGE", "BLOCK_SHUTDOWN",
+    "CHECK_RECORDING", "DELETE_FILE", "DELETE_RECORDING", "DONE",
+    "DOWNLOAD_FILE", "DOWNLOAD_FILE_NOW", "FILL_PROGRAM_INFO",
+    "FILL_PROGRAM_INFO_LIST", "FORCE_DELETE_RECORDING", "FORGET_RECORDING",
+    "FREE_TUNER", "GET_FREE_RECORDER", "GET_FREE_RECORDER_COUNT",
+    "GET_FREE_RECORDER_LIST", "GET_NEXT_FREE_RECORDER",
+    "GET_RECORDER_FROM_NUM", "GET_RECORDER_NUM", "GO_TO_SLEEP", "LOCK_TUNER",
+    "MESSAGE", "MYTH_PROTO_VERSION", "OK", "QUERY_BOOKMARK",
+    "QUERY_CHECKFILE", "QUERY_COMMBREAK", "QUERY_CUTLIST",
+    "QUERY_FILETRANSFER", "QUERY_FILE_EXISTS", "QUERY_FILE_HASH",
+    "QUERY_FREE_SPACE", "QUERY_FREE_SPACE_LIST", "QUERY_FREE_SPACE_SUMMARY",
+    "QUERY_GENPIXMAP2", "QUERY_GETALLPENDING", "QUERY_GETALLSCHEDULED",
+    "QUERY_GETCONFLICTING", "QUERY_GETEXPIRING", "QUERY_GUIDEDATATHROUGH",
+    "QUERY_HOSTNAME", "QUERY_ISRECORDING", "QUERY_IS_ACTIVE_BACKEND",
+    "QUERY_LOAD", "QUERY_MEMSTATS", "QUERY_PIXMAP_GET_IF_MODIFIED",
+    "QUERY_PIXMAP_LASTMODIFIED", "QUERY_RECORDER", "QUERY_RECORDING",
+    "QUERY_RECORDINGS", "QUERY_RECORDING_CHANGES", "QUERY_REMOTEENCODER",
+    "QUERY_SETTING", "QUERY_SG_FILEQUERY", "QUERY_SG_GETFILELIST",
+    "QUERY_TIME_ZONE", "QUERY_UPTIME", "REFRESH_BACKEND",
+    "RESCHEDULE_RECORDINGS", "SET_BOOKMARK", "SET_CHANNEL_INFO",
+    "SET_NEXT_LIVETV_DIR", "SET_SETTING", "SHUTDOWN_NOW", "STOP_RECORDING",
+    "UNDELETE_RECORDING"
+};
+
+/// Adds the time taken by a protocol command to MainServer's request stats
+class RequestTimer
+{
+  public:
+    RequestTimer(MainServer *ms, const QString &command) :
+        m_ms(ms), m_command(command) { m_timer.start(); }
+   ~RequestTimer() { m_ms->AddRequestTime(m_command, m_timer.elapsed()); }
+
+  private:
+    MainServer *m_ms;
+    QString     m_command;
+    QTime       m_timer;
+};
 
 class ProcessRequestThread : public QThread
 {
@@ -156,7 +231,9 @@ class ProcessRequestThread : public QThread
             if (!socket)
                 continue;
 
-            parent->ProcessRequest(socket);
+            do
+                parent->ProcessRequest(socket);
+            while (parent->HasQueuedRequest(socket));
             socket->DownRef();
             socket = NULL;
             parent->MarkUnused(this);
@@ -180,7 +257,9 @@ MainServer::MainServer(bool master, int port,
     encoderList(tvList), mythserver(NULL), masterServerReconnect(NULL),
     masterServer(NULL), ismaster(master), masterBackendOverride(false),
     m_sched(sched), m_expirer(expirer), deferredDeleteTimer(NULL),
-    autoexpireUpdateTimer(NULL), m_exitCode(BACKEND_EXIT_OK)
+    autoexpireUpdateTimer(NULL), m_exitCode(BACKEND_EXIT_OK),
+    m_recChangesInstance(QDateTime::currentDateTime().toTime_t()),
+    m_recChangesGeneration(0), m_recChangesForgotten(0)
 {
     PreviewGeneratorQueue::CreatePreviewGeneratorQueue(
         PreviewGenerator::kLocalAndRemote, ~0, 0);
@@ -271,6 +350,21 @@ void MainServer::readyRead(MythSocket *sock)
     if (expecting_reply)
         return;
 
+    {
+        // Only one worker handles a connection at a time, so replies go
+        // out in request order and a slow request does not tie up more
+        // workers waiting on the socket lock. The busy worker picks up
+        // the new request when it is done, see HasQueuedRequest().
+        QMutexLocker locker(&m_requestSocketsLock);
+        QHash<MythSocket*, bool>::iterator it = m_requestSockets.find(sock);
+        if (it != m_requestSockets.end())
+        {
+            *it = true;
+            return;
+        }
+        m_requestSockets[sock] = false;
+    }
+
     ProcessRequestThread *prt = NULL;
     {
         QMutexLocker locker(&threadPoolLock);
@@ -312,6 +406,52 @@ void MainServer::ProcessRequest(MythSocket *sock)
     sock->Unlock();
 }
 
+/** \fn MainServer::HasQueuedRequest(MythSocket*)
+ *  \brief Called by a worker when it has handled a request, returns true
+ *         if readyRead() was signalled for the socket meanwhile and the
+ *         worker should handle the next request too.
+ */
+bool MainServer::HasQueuedRequest(MythSocket *sock)
+{
+    QMutexLocker locker(&m_requestSocketsLock);
+    QHash<MythSocket*, bool>::iterator it = m_requestSockets.find(sock);
+    if (it != m_requestSockets.end() && *it)
+    {
+        *it = false;
+        return true;
+    }
+    m_requestSockets.remove(sock);
+    return false;
+}
+
+void MainServer::AddRequestTime(const QString &command, uint ms)
+{
+    static QSet<QString> known;
+    QMutexLocker locker(&m_requestStatsLock);
+    if (known.isEmpty())
+    {
+        uint count = sizeof(kRequestStatsCommands) / sizeof(char*);
+        for (uint i = 0; i < count; i++)
+            known.insert(kRequestStatsCommands[i]);
+    }
+
+    // Don't let clients pick the keys, they end up on the status page
+    if (known.contains(command))
+        m_requestStats[command].Add(ms);
+    else
+        m_requestStats["OTHER"].Add(ms);
+}
+
+/** \fn MainServer::GetRequestStats(void) const
+ *  \brief Returns the latency histograms of the protocol commands
+ *         handled so far, for the status page.
+ */
+QMap<QString, RequestStats> MainServer::GetRequestStats(void) const
+{
+    QMutexLocker locker(&m_requestStatsLock);
+    return m_requestStats;
+}
+
 void MainServer::ProcessRequestWork(MythSocket *sock)
 {
     QStringList listline;
@@ -324,6 +464,7 @@ void MainServer::ProcessRequestWork(MythSocket *sock)
     QStringList tokens = line.split(' ', QString::SkipEmptyParts);
     QString command = tokens[0];
     //cerr << "command='" << command << "'\n";
+    RequestTimer timer(this, command);
     if (command == "MYTH_PROTO_VERSION")
     {
         if (tokens.size() < 2)
@@ -359,7 +500,16 @@ void MainServer::ProcessRequestWork(MythSocket *sock)
         if (tokens.size() != 2)
             VERBOSE(VB_IMPORTANT, "Bad QUERY_RECORDINGS query");
         else
-            HandleQueryRecordings(tokens[1], pbs);
+            HandleQueryRecordings(tokens[1], pbs,
+                                  listline.size() > 1 &&
+                                  listline[1] == "BINARY");
+    }
+    else if (command == "QUERY_RECORDING_CHANGES")
+    {
+        if (tokens.size() != 3)
+            VERBOSE(VB_IMPORTANT, "Bad QUERY_RECORDING_CHANGES query");
+        else
+            HandleQueryRecordingChanges(tokens, pbs);
     }
     else if (command == "QUERY_RECORDING")
     {
@@ -580,6 +730,10 @@ void MainServer::ProcessRequestWork(MythSocket *sock)
     {
         HandleFillProgramInfo(listline, pbs);
     }
+    else if (command == "FILL_PROGRAM_INFO_LIST")
+    {
+        HandleFillProgramInfoList(listline, pbs);
+    }
     else if (command == "LOCK_TUNER")
     {
         if (tokens.size() == 1)
@@ -1029,6 +1183,9 @@ void MainServer::customEvent(QEvent *e)
             }
         }
 
+        if (me->Message().left(21) == "RECORDING_LIST_CHANGE")
+            LogRecordingListChange(*me);
+
         if (me->Message().left(13) == "DOWNLOAD_FILE")
         {
             QStringList extraDataList = me->ExtraDataList();
@@ -1080,6 +1237,16 @@ void MainServer::customEvent(QEvent *e)
             sendGlobal = true;
         }
 
+        // Commercials may be flagged by the recorder on a slave, see
+        // InlineCommFlagger. Slaves don't get our events, so pass flagging
+        // requests on as LOCAL_ ones, which slaves don't send back to us.
+        QStringList slavecast;
+        if (ismaster && broadcast[1].startsWith("COMMFLAG_REQUEST "))
+        {
+            slavecast = broadcast;
+            slavecast[1].prepend("LOCAL_");
+        }
+
         QSet<PlaybackSock*> sentSet;
 
         bool isSystemEvent = broadcast[1].startsWith("SYSTEM_EVENT ");
@@ -1111,6 +1278,10 @@ void MainServer::customEvent(QEvent *e)
                 if (pbs->isSlaveBackend())
                     reallysendit = true;
             }
+            else if (!slavecast.empty() && pbs->isSlaveBackend())
+            {
+                reallysendit = true;
+            }
             else if (pbs->wantsEvents())
             {
                 reallysendit = true;
@@ -1142,7 +1313,12 @@ void MainServer::customEvent(QEvent *e)
                 sock->Lock();
 
                 if (sock->socket() >= 0)
-                    sock->writeStringList(broadcast);
+                {
+                    if (!slavecast.empty() && pbs->isSlaveBackend())
+                        sock->writeStringList(slavecast);
+                    else
+                        sock->writeStringList(broadcast);
+                }
 
                 sock->Unlock();
             }
@@ -1521,12 +1697,26 @@ void MainServer::SendResponse(MythSocket *socket, QStringList &commands)
  * The \e type parameter can be either "Play", "Recording" or "Delete".
  * Returns programinfo (title, subtitle, description, category, chanid,
  * channum, callsign, channel.name, fileURL, \e et \e cetera)
+ *
+ * When the request carries a second "BINARY" element the reply is
+ * "BINARY", the number of programs, a ProgramListToBinary() payload and
+ * the instance and generation of the list for QUERY_RECORDING_CHANGES
+ * instead. Older backends ignore the extra element and answer with the
+ * string list encoding, which the client still accepts.
  */
-void MainServer::HandleQueryRecordings(QString type, PlaybackSock *pbs)
+void MainServer::HandleQueryRecordings(QString type, PlaybackSock *pbs,
+                                       bool binary)
 {
     MythSocket *pbssock = pbs->getSocket();
     QString playbackhost = pbs->getHostname();
 
+    // Changes logged while the list is loaded are sent again by
+    // QUERY_RECORDING_CHANGES, which is harmless.
+    m_recChangesLock.lock();
+    QString instance   = QString::number(m_recChangesInstance);
+    QString generation = QString::number(m_recChangesGeneration);
+    m_recChangesLock.unlock();
+
     QMap<QString,ProgramInfo*> recMap;
     if (m_sched)
         recMap = m_sched->GetRecording();
@@ -1547,102 +1737,326 @@ void MainServer::HandleQueryRecordings(QString type, PlaybackSock *pbs)
     QStringList outputlist(QString::number(destination.size()));
     QMap<QString, QString> backendIpMap;
     QMap<QString, QString> backendPortMap;
-    QString ip   = gCoreContext->GetSetting("BackendServerIP");
-    QString port = gCoreContext->GetSetting("BackendServerPort");
+
+    QSet<ProgramInfo*> slaveFilled;
+    FillSlaveProgramInfo(destination, playbackhost, slaveFilled);
 
     ProgramList::iterator it = destination.begin();
     for (it = destination.begin(); it != destination.end(); ++it)
     {
         ProgramInfo *proginfo = *it;
-        PlaybackSock *slave = NULL;
+        if (!slaveFilled.contains(proginfo))
+            FillRecordingURL(proginfo, playbackhost,
+                             backendIpMap, backendPortMap);
 
-        if (proginfo->GetHostname() != gCoreContext->GetHostName())
-            slave = GetSlaveByHostname(proginfo->GetHostname());
+        if (!binary)
+            proginfo->ToStringList(outputlist);
+    }
+
+    if (binary)
+    {
+        outputlist.clear();
+        outputlist << "BINARY" << QString::number(destination.size())
+                   << ProgramListToBinary(destination)
+                   << instance << generation;
+    }
+
+    SendResponse(pbssock, outputlist);
+}
+
+/** \fn MainServer::FillRecordingURL(ProgramInfo*,const QString&,
+                                     QMap<QString,QString>&,
+                                     QMap<QString,QString>&)
+ *  \brief Sets the pathname of a recording to the URL a frontend on
+ *         \p playbackhost should play it from, filling in the file size
+ *         from the backend holding it when it is not yet known.
+ */
+void MainServer::FillRecordingURL(
+    ProgramInfo *proginfo, const QString &playbackhost,
+    QMap<QString, QString> &backendIpMap,
+    QMap<QString, QString> &backendPortMap)
+{
+    QString ip   = gCoreContext->GetSetting("BackendServerIP");
+    QString port = gCoreContext->GetSetting("BackendServerPort");
+    PlaybackSock *slave = NULL;
 
-        if ((proginfo->GetHostname() == gCoreContext->GetHostName()) ||
-            (!slave && masterBackendOverride))
+    if (proginfo->GetHostname() != gCoreContext->GetHostName())
+        slave = GetSlaveByHostname(proginfo->GetHostname());
+
+    if ((proginfo->GetHostname() == gCoreContext->GetHostName()) ||
+        (!slave && masterBackendOverride))
+    {
+        proginfo->SetPathname(QString("myth://") + ip + ':' + port +
+                              '/' + proginfo->GetBasename());
+        if (!proginfo->GetFilesize())
         {
-            proginfo->SetPathname(QString("myth://") + ip + ':' + port +
-                                  '/' + proginfo->GetBasename());
-            if (!proginfo->GetFilesize())
+            QString tmpURL = GetPlaybackURL(proginfo);
+            if (tmpURL.startsWith('/'))
             {
-                QString tmpURL = GetPlaybackURL(proginfo);
-                if (tmpURL.startsWith('/'))
+                QFile checkFile(tmpURL);
+                if (!tmpURL.isEmpty() && checkFile.exists())
                 {
-                    QFile checkFile(tmpURL);
-                    if (!tmpURL.isEmpty() && checkFile.exists())
+                    proginfo->SetFilesize(checkFile.size());
+                    if (proginfo->GetRecordingEndTime() <
+                        QDateTime::currentDateTime())
                     {
-                        proginfo->SetFilesize(checkFile.size());
-                        if (proginfo->GetRecordingEndTime() <
-                            QDateTime::currentDateTime())
-                        {
-                            proginfo->SaveFilesize(proginfo->GetFilesize());
-                        }
+                        proginfo->SaveFilesize(proginfo->GetFilesize());
                     }
                 }
             }
         }
-        else if (!slave)
+    }
+    else if (!slave)
+    {
+        proginfo->SetPathname(GetPlaybackURL(proginfo));
+        if (proginfo->GetPathname().isEmpty())
         {
-            proginfo->SetPathname(GetPlaybackURL(proginfo));
-            if (proginfo->GetPathname().isEmpty())
-            {
-                VERBOSE(VB_IMPORTANT, LOC +
-                        QString("HandleQueryRecordings() "
-                                "Couldn't find backend for:\n\t\t\t%1")
-                        .arg(proginfo->toString(ProgramInfo::kTitleSubtitle)));
+            VERBOSE(VB_IMPORTANT, LOC +
+                    QString("FillRecordingURL() "
+                            "Couldn't find backend for:\n\t\t\t%1")
+                    .arg(proginfo->toString(ProgramInfo::kTitleSubtitle)));
 
-                proginfo->SetFilesize(0);
-                proginfo->SetPathname("file not found");
-            }
+            proginfo->SetFilesize(0);
+            proginfo->SetPathname("file not found");
         }
-        else
+    }
+    else
+    {
+        if (!proginfo->GetFilesize())
         {
-            if (!proginfo->GetFilesize())
+            if (!slave->FillProgramInfo(*proginfo, playbackhost))
             {
-                if (!slave->FillProgramInfo(*proginfo, playbackhost))
-                {
-                    VERBOSE(VB_IMPORTANT,
-                            "MainServer::HandleQueryRecordings()"
-                            "\n\t\t\tCould not fill program info "
-                            "from backend");
-                }
-                else
-                {
-                    if (proginfo->GetRecordingEndTime() <
-                        QDateTime::currentDateTime())
-                    {
-                        proginfo->SaveFilesize(proginfo->GetFilesize());
-                    }
-                }
+                VERBOSE(VB_IMPORTANT,
+                        "MainServer::FillRecordingURL()"
+                        "\n\t\t\tCould not fill program info "
+                        "from backend");
             }
             else
             {
-                ProgramInfo *p = proginfo;
-                if (!backendIpMap.contains(p->GetHostname()))
-                    backendIpMap[p->GetHostname()] =
-                        gCoreContext->GetSettingOnHost("BackendServerIp",
-                                                   p->GetHostname());
-                if (!backendPortMap.contains(p->GetHostname()))
-                    backendPortMap[p->GetHostname()] =
-                        gCoreContext->GetSettingOnHost("BackendServerPort",
-                                                   p->GetHostname());
-                p->SetPathname(QString("myth://") +
-                               backendIpMap[p->GetHostname()] + ":" +
-                               backendPortMap[p->GetHostname()] + "/" +
-                               p->GetBasename());
+                if (proginfo->GetRecordingEndTime() <
+                    QDateTime::currentDateTime())
+                {
+                    proginfo->SaveFilesize(proginfo->GetFilesize());
+                }
             }
         }
+        else
+        {
+            ProgramInfo *p = proginfo;
+            if (!backendIpMap.contains(p->GetHostname()))
+                backendIpMap[p->GetHostname()] =
+                    gCoreContext->GetSettingOnHost("BackendServerIp",
+                                               p->GetHostname());
+            if (!backendPortMap.contains(p->GetHostname()))
+                backendPortMap[p->GetHostname()] =
+                    gCoreContext->GetSettingOnHost("BackendServerPort",
+                                               p->GetHostname());
+            p->SetPathname(QString("myth://") +
+                           backendIpMap[p->GetHostname()] + ":" +
+                           backendPortMap[p->GetHostname()] + "/" +
+                           p->GetBasename());
+        }
+    }
+
+    if (slave)
+        slave->DownRef();
+}
+
+/**
+ * \addtogroup myth_network_protocol
+ * \par        QUERY_RECORDING_CHANGES \e instance \e generation
+ * Returns the recordings which changed since \e generation of the
+ * recording list of backend run \e instance, both as returned by an
+ * earlier QUERY_RECORDING_CHANGES or binary QUERY_RECORDINGS reply.
+ * The reply is "CHANGES", the current instance and generation, the
+ * number of deleted recordings followed by their keys, then the number
+ * of added or updated recordings followed by their programinfo. A backend
+ * going offline is logged once, and all of its recordings are sent as
+ * updated. When the changes are no longer known the reply is "FULL",
+ * the current instance and generation, and the client must reload the
+ * whole list.
+ */
+void MainServer::HandleQueryRecordingChanges(QStringList &commands,
+                                             PlaybackSock *pbs)
+{
+    MythSocket *pbssock = pbs->getSocket();
+    uint instance   = commands[1].toUInt();
+    uint generation = commands[2].toUInt();
+
+    QStringList changed;
+    QStringList outputlist;
+
+    m_recChangesLock.lock();
+    if (instance != m_recChangesInstance ||
+        generation < m_recChangesForgotten ||
+        generation > m_recChangesGeneration)
+    {
+        outputlist << "FULL";
+    }
+    else
+    {
+        outputlist << "CHANGES";
+        QMap<uint, QString>::const_iterator it =
+            m_recChangesByGeneration.upperBound(generation);
+        for (; it != m_recChangesByGeneration.end(); ++it)
+            changed << *it;
+    }
+    outputlist << QString::number(m_recChangesInstance)
+               << QString::number(m_recChangesGeneration);
+    m_recChangesLock.unlock();
+
+    if (outputlist[0] == "FULL")
+    {
+        SendResponse(pbssock, outputlist);
+        return;
+    }
+
+    QString playbackhost = pbs->getHostname();
+    QMap<QString, QString> backendIpMap;
+    QMap<QString, QString> backendPortMap;
+    QDateTime rectime = QDateTime::currentDateTime().addSecs(
+        -gCoreContext->GetNumSetting("RecordOverTime"));
+
+    // Expand the host markers into the recordings of those hosts
+    QStringList keys;
+    QSet<QString> seen;
+    QStringList::const_iterator it = changed.begin();
+    for (; it != changed.end(); ++it)
+    {
+        if (!(*it).startsWith("HOST "))
+        {
+            if (!seen.contains(*it))
+                keys << *it;
+            seen.insert(*it);
+            continue;
+        }
 
-        if (slave)
-            slave->DownRef();
+        MSqlQuery query(MSqlQuery::InitCon());
+        query.prepare("SELECT chanid, starttime FROM recorded "
+                      "WHERE hostname = :HOSTNAME");
+        query.bindValue(":HOSTNAME", (*it).mid(5));
+        if (!query.exec())
+        {
+            MythDB::DBError("HandleQueryRecordingChanges", query);
+            SendResponse(pbssock, QStringList() << "FULL"
+                         << outputlist[1] << outputlist[2]);
+            return;
+        }
 
-        proginfo->ToStringList(outputlist);
+        while (query.next())
+        {
+            QString key = ProgramInfo::MakeUniqueKey(
+                query.value(0).toUInt(), query.value(1).toDateTime());
+            if (!seen.contains(key))
+                keys << key;
+            seen.insert(key);
+        }
+    }
+
+    QStringList deleted;
+    QStringList updated;
+    uint updatedCount = 0;
+
+    for (it = keys.begin(); it != keys.end(); ++it)
+    {
+        uint      chanid;
+        QDateTime recstartts;
+        if (!ProgramInfo::ExtractKey(*it, chanid, recstartts))
+            continue;
+
+        ProgramInfo pginfo(chanid, recstartts);
+        if (!pginfo.GetChanID())
+        {
+            deleted << *it;
+            continue;
+        }
+
+        if (m_sched && pginfo.GetRecordingEndTime() > rectime)
+            pginfo.SetRecordingStatus(m_sched->GetRecStatus(pginfo));
+
+        FillRecordingURL(&pginfo, playbackhost, backendIpMap, backendPortMap);
+        pginfo.ToStringList(updated);
+        updatedCount++;
     }
 
+    outputlist << QString::number(deleted.size()) << deleted;
+    outputlist << QString::number(updatedCount) << updated;
+
     SendResponse(pbssock, outputlist);
 }
 
+/** \fn MainServer::LogRecordingListChange(const MythEvent&)
+ *  \brief Records the recordings named by a RECORDING_LIST_CHANGE event
+ *         in the change log served by HandleQueryRecordingChanges().
+ *
+ *   ADD, DELETE and UPDATE events name one recording. HOST events name
+ *   a backend whose recordings all changed, they are logged as a single
+ *   "HOST <hostname>" entry which HandleQueryRecordingChanges() expands.
+ *   Any other form of the event does not say what changed, so the log
+ *   is forgotten and every client has to reload its list.
+ */
+void MainServer::LogRecordingListChange(const MythEvent &event)
+{
+    QStringList tokens = event.Message().simplified().split(" ");
+    QString action = (tokens.size() >= 2) ? tokens[1] : QString();
+
+    if ((action == "ADD" || action == "DELETE") && tokens.size() >= 4)
+    {
+        MarkRecordingChanged(ProgramInfo::MakeUniqueKey(
+            tokens[2].toUInt(),
+            QDateTime::fromString(tokens[3], Qt::ISODate)));
+        return;
+    }
+
+    if (action == "UPDATE")
+    {
+        ProgramInfo evinfo(event.ExtraDataList());
+        if (evinfo.GetChanID())
+        {
+            MarkRecordingChanged(evinfo.MakeUniqueKey());
+            return;
+        }
+    }
+    else if (action == "HOST" && tokens.size() >= 3)
+    {
+        MarkRecordingChanged(QString("HOST %1").arg(tokens[2]));
+        return;
+    }
+
+    QMutexLocker locker(&m_recChangesLock);
+    m_recChangesGeneration++;
+    m_recChangesForgotten = m_recChangesGeneration;
+    m_recChanges.clear();
+    m_recChangesByGeneration.clear();
+}
+
+/** \fn MainServer::MarkRecordingChanged(const QString&)
+ *  \brief Gives a recording, or a "HOST <hostname>" marker, the next
+ *         recording list generation, dropping the oldest changes once
+ *         kMaxRecordingListChanges are kept.
+ */
+void MainServer::MarkRecordingChanged(const QString &key)
+{
+    QMutexLocker locker(&m_recChangesLock);
+
+    QHash<QString, uint>::iterator it = m_recChanges.find(key);
+    if (it != m_recChanges.end())
+        m_recChangesByGeneration.remove(*it);
+
+    m_recChangesGeneration++;
+    m_recChanges[key] = m_recChangesGeneration;
+    m_recChangesByGeneration[m_recChangesGeneration] = key;
+
+    while ((uint)m_recChangesByGeneration.size() > kMaxRecordingListChanges)
+    {
+        QMap<uint, QString>::iterator oldest =
+            m_recChangesByGeneration.begin();
+        m_recChangesForgotten = oldest.key();
+        m_recChanges.remove(*oldest);
+        m_recChangesByGeneration.erase(oldest);
+    }
+}
+
 /**
  * \addtogroup myth_network_protocol
  * \par        QUERY_RECORDING BASENAME \e basename
@@ -1693,6 +2107,28 @@ void MainServer::HandleQueryRecording(QStringList &slist, PlaybackSock *pbs)
     SendResponse(pbssock, strlist);
 }
 
+/// Sets the pathname and file size of a recording held by this backend
+/// as seen from \p playbackhost.
+void MainServer::FillLocalProgramInfo(ProgramInfo &pginfo,
+                                      const QString &playbackhost)
+{
+    if (!pginfo.HasPathname())
+        return;
+
+    QString lpath = GetPlaybackURL(&pginfo);
+    QString ip    = gCoreContext->GetSetting("BackendServerIP");
+    QString port  = gCoreContext->GetSetting("BackendServerPort");
+
+    if (playbackhost == gCoreContext->GetHostName())
+        pginfo.SetPathname(lpath);
+    else
+        pginfo.SetPathname(QString("myth://") + ip + ":" + port + "/" +
+                           pginfo.GetBasename());
+
+    const QFileInfo info(lpath);
+    pginfo.SetFilesize(info.size());
+}
+
 void MainServer::HandleFillProgramInfo(QStringList &slist, PlaybackSock *pbs)
 {
     MythSocket *pbssock = pbs->getSocket();
@@ -1702,29 +2138,180 @@ void MainServer::HandleFillProgramInfo(QStringList &slist, PlaybackSock *pbs)
     QStringList::const_iterator it = slist.begin() + 2;
     ProgramInfo pginfo(it, slist.end());
 
-    if (pginfo.HasPathname())
+    FillLocalProgramInfo(pginfo, playbackhost);
+
+    QStringList strlist;
+
+    pginfo.ToStringList(strlist);
+
+    SendResponse(pbssock, strlist);
+}
+
+/**
+ * \addtogroup myth_network_protocol
+ * \par        FILL_PROGRAM_INFO_LIST \e playbackhost \e count \e programinfo...
+ * Fills in the pathname and file size of \e count recordings, like
+ * FILL_PROGRAM_INFO does for one. Returns \e count and the programinfo.
+ */
+void MainServer::HandleFillProgramInfoList(QStringList &slist,
+                                           PlaybackSock *pbs)
+{
+    MythSocket *pbssock = pbs->getSocket();
+
+    QStringList strlist;
+
+    if (slist.size() < 3)
     {
-        QString lpath = GetPlaybackURL(&pginfo);
-        QString ip    = gCoreContext->GetSetting("BackendServerIP");
-        QString port  = gCoreContext->GetSetting("BackendServerPort");
+        strlist << "0";
+        SendResponse(pbssock, strlist);
+        return;
+    }
 
-        if (playbackhost == gCoreContext->GetHostName())
-            pginfo.SetPathname(lpath);
-        else
-            pginfo.SetPathname(QString("myth://") + ip + ":" + port + "/" +
-                               pginfo.GetBasename());
+    QString playbackhost = slist[1];
+    uint count = slist[2].toUInt();
 
-        const QFileInfo info(lpath);
-        pginfo.SetFilesize(info.size());
+    if ((uint)slist.size() < 3 + count * NUMPROGRAMLINES)
+    {
+        VERBOSE(VB_IMPORTANT, "Bad FILL_PROGRAM_INFO_LIST request");
+        count = 0;
     }
 
-    QStringList strlist;
+    strlist << QString::number(count);
 
-    pginfo.ToStringList(strlist);
+    QStringList::const_iterator it = slist.begin() + 3;
+    for (uint i = 0; i < count; i++)
+    {
+        ProgramInfo pginfo(it, slist.end());
+        FillLocalProgramInfo(pginfo, playbackhost);
+        pginfo.ToStringList(strlist);
+    }
 
     SendResponse(pbssock, strlist);
 }
 
+/** \fn MainServer::FillSlaveProgramInfo(ProgramList&, const QString&,
+                                         QSet<ProgramInfo*>&)
+ *  \brief Asks the slave backends holding recordings of unknown size to
+ *         fill them in, with requests of up to SLAVE_FILL_CHUNK_SIZE
+ *         recordings.
+ *
+ *   Each round sends one request to every slave with recordings left, so
+ *   no pool thread sits waiting on a slave which is busy with another
+ *   chunk. A slave which does not answer is not asked again, and one too
+ *   old to know FILL_PROGRAM_INFO_LIST is asked one recording at a time.
+ *  \param handled receives the recordings which were sent to a slave,
+ *                 whether or not it answered
+ */
+void MainServer::FillSlaveProgramInfo(ProgramList &list,
+                                      const QString &playbackhost,
+                                      QSet<ProgramInfo*> &handled)
+{
+    QMap<QString, vector<ProgramInfo*> > byHost;
+
+    ProgramList::iterator it = list.begin();
+    for (; it != list.end(); ++it)
+    {
+        if ((*it)->GetHostname() != gCoreContext->GetHostName() &&
+            !(*it)->GetFilesize())
+        {
+            byHost[(*it)->GetHostname()].push_back(*it);
+        }
+    }
+
+    QMap<PlaybackSock*, vector<ProgramInfo*> > todo;
+    QMap<QString, vector<ProgramInfo*> >::iterator hit = byHost.begin();
+    for (; hit != byHost.end(); ++hit)
+    {
+        PlaybackSock *slave = GetSlaveByHostname(hit.key());
+        if (slave)
+            todo[slave] = *hit;
+    }
+
+    QList<PlaybackSock*> oldSlaves;
+    QDateTime now = QDateTime::currentDateTime();
+
+    while (!todo.empty())
+    {
+        vector<SlaveRequest>          requests;
+        vector< vector<ProgramInfo*> > requested;
+
+        QMap<PlaybackSock*, vector<ProgramInfo*> >::iterator tit;
+        for (tit = todo.begin(); tit != todo.end(); ++tit)
+        {
+            uint end = min((uint)(*tit).size(), (uint)SLAVE_FILL_CHUNK_SIZE);
+            vector<ProgramInfo*> chunk((*tit).begin(), (*tit).begin() + end);
+            (*tit).erase((*tit).begin(), (*tit).begin() + end);
+
+            requests.push_back(PlaybackSock::FillProgramInfoRequest(
+                                   tit.key(), chunk, playbackhost));
+            requested.push_back(chunk);
+        }
+
+        PlaybackSock::SendReceiveAll(requests, SLAVE_REQUEST_TIMEOUT);
+
+        for (uint i = 0; i < requests.size(); i++)
+        {
+            PlaybackSock *slave = requests[i].sock;
+
+            if (requests[i].ok && requests[i].reply[0] == "UNKNOWN_COMMAND")
+            {
+                // Filled in one at a time below
+                oldSlaves.push_back(slave);
+                todo.remove(slave);
+                continue;
+            }
+
+            if (!PlaybackSock::FillProgramInfoReply(requests[i], requested[i]))
+            {
+                VERBOSE(VB_IMPORTANT, LOC_ERR +
+                        QString("Could not fill program info from %1")
+                        .arg(slave->getHostname()));
+            }
+
+            vector<ProgramInfo*>::iterator pit = requested[i].begin();
+            for (; pit != requested[i].end(); ++pit)
+            {
+                handled.insert(*pit);
+                if ((*pit)->GetFilesize() &&
+                    (*pit)->GetRecordingEndTime() < now)
+                {
+                    (*pit)->SaveFilesize((*pit)->GetFilesize());
+                }
+            }
+
+            // After a timeout leave the rest to FillRecordingURL()
+            if (!requests[i].ok || todo[slave].empty())
+            {
+                todo.remove(slave);
+                slave->DownRef();
+            }
+        }
+    }
+
+    QList<PlaybackSock*>::iterator sit = oldSlaves.begin();
+    for (; sit != oldSlaves.end(); ++sit)
+    {
+        PlaybackSock *slave = *sit;
+        vector<ProgramInfo*> &rest = byHost[slave->getHostname()];
+        // byHost still lists every recording of this slave; skip the
+        // ones an earlier round already filled in.
+        vector<ProgramInfo*>::iterator pit = rest.begin();
+        for (; pit != rest.end(); ++pit)
+        {
+            if (handled.contains(*pit))
+                continue;
+
+            handled.insert(*pit);
+            if (slave->FillProgramInfo(**pit, playbackhost) &&
+                (*pit)->GetFilesize() && (*pit)->GetRecordingEndTime() < now)
+            {
+                (*pit)->SaveFilesize((*pit)->GetFilesize());
+            }
+        }
+        slave->DownRef();
+    }
+}
+
 void *MainServer::SpawnDeleteThread(void *param)
 {
     DeleteStruct *ds = (DeleteStruct *)param;
@@ -4230,10 +4817,20 @@ void MainServer::BackendQueryDiskSpace(QStringList &strlist, bool consolidated,
 
         sockListLock.unlock();
 
+        vector<SlaveRequest> requests;
         for (list<PlaybackSock *>::iterator p = localPlaybackList.begin() ;
              p != localPlaybackList.end() ; ++p) {
-            (*p)->GetDiskSpace(strlist);
-            (*p)->DownRef();
+            requests.push_back(
+                SlaveRequest(*p, QStringList("QUERY_FREE_SPACE")));
+        }
+
+        PlaybackSock::SendReceiveAll(requests, SLAVE_REQUEST_TIMEOUT);
+
+        for (uint i = 0; i < requests.size(); i++)
+        {
+            if (requests[i].ok)
+                strlist += requests[i].reply;
+            requests[i].sock->DownRef();
         }
     }
 
@@ -4881,6 +5478,14 @@ void MainServer::HandleFileTransferQuery(QStringList &slist,
         ft->SetTimeout(fast);
         retlist << "ok";
     }
+    else if (command == "SET_PIPELINE")
+    {
+        // Commands on a socket are handled one at a time in the order
+        // they arrive, so queued REQUEST_BLOCKs are served back to back
+        // and their data and replies go out in request order.
+        int depth = max(1, min(slist[2].toInt(), FT_MAX_PIPELINE_DEPTH));
+        retlist << QString::number(depth);
+    }
     else
     {
         VERBOSE(VB_IMPORTANT, QString("Unknown command: %1").arg(command));
@@ -5490,7 +6095,8 @@ void MainServer::connectionClosed(MythSocket *socket)
                 MythEvent me(message);
                 gCoreContext->dispatch(me);
 
-                MythEvent me2("RECORDING_LIST_CHANGE");
+                MythEvent me2(QString("RECORDING_LIST_CHANGE HOST %1")
+                              .arg(pbs->getHostname()));
                 gCoreContext->dispatch(me2);
 
                 SendMythSystemEvent(QString("SLAVE_DISCONNECTED HOSTNAME %1")
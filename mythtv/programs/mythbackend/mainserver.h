@@ -6,8 +6,10 @@
 #include <QMutex>
 #include <QHash>
 #include <QMap>
+#include <QSet>
 
 #include <vector>
+#include <stdint.h>
 using namespace std;
 
 #include "tv.h"
@@ -28,8 +30,33 @@ using namespace std;
 class ProcessRequestThread;
 class QUrl;
 class MythServer;
+class MythEvent;
 class QTimer;
 
+/** \class RequestStats
+ *  \brief Latency histogram of one protocol command, see
+ *         MainServer::GetRequestStats().
+ */
+class RequestStats
+{
+  public:
+    static const uint kNumBuckets = 6;
+
+    RequestStats() : count(0), totalMs(0), maxMs(0)
+    {
+        for (uint i = 0; i < kNumBuckets; i++)
+            buckets[i] = 0;
+    }
+
+    void Add(uint ms);
+    static QString BucketName(uint bucket);
+
+    uint     count;
+    uint64_t totalMs;
+    uint     maxMs;
+    uint     buckets[kNumBuckets];
+};
+
 class MainServer : public QObject, public MythSocketCBs
 {
     Q_OBJECT
@@ -46,8 +73,12 @@ class MainServer : public QObject, public MythSocketCBs
     void ShutSlaveBackendsDown(QString &haltcmd);
 
     void ProcessRequest(MythSocket *sock);
+    bool HasQueuedRequest(MythSocket *sock);
     void MarkUnused(ProcessRequestThread *prt);
 
+    void AddRequestTime(const QString &command, uint ms);
+    QMap<QString, RequestStats> GetRequestStats(void) const;
+
     void readyRead(MythSocket *socket);
     void connectionClosed(MythSocket *socket);
     void connectionFailed(MythSocket *socket) { (void)socket; }
@@ -93,7 +124,15 @@ class MainServer : public QObject, public MythSocketCBs
     bool HandleDeleteFile(QStringList &slist, PlaybackSock *pbs);
     bool HandleDeleteFile(QString filename, QString storagegroup,
                           PlaybackSock *pbs = NULL);
-    void HandleQueryRecordings(QString type, PlaybackSock *pbs);
+    void HandleQueryRecordings(QString type, PlaybackSock *pbs,
+                               bool binary = false);
+    void HandleQueryRecordingChanges(QStringList &commands,
+                                     PlaybackSock *pbs);
+    void FillRecordingURL(ProgramInfo *proginfo, const QString &playbackhost,
+                          QMap<QString, QString> &backendIpMap,
+                          QMap<QString, QString> &backendPortMap);
+    void LogRecordingListChange(const MythEvent &event);
+    void MarkRecordingChanged(const QString &key);
     void HandleQueryRecording(QStringList &slist, PlaybackSock *pbs);
     void HandleStopRecording(QStringList &slist, PlaybackSock *pbs);
     void DoHandleStopRecording(RecordingInfo &recinfo, PlaybackSock *pbs);
@@ -142,6 +181,11 @@ class MainServer : public QObject, public MythSocketCBs
     void HandleIsRecording(QStringList &slist, PlaybackSock *pbs);
     void HandleCheckRecordingActive(QStringList &slist, PlaybackSock *pbs);
     void HandleFillProgramInfo(QStringList &slist, PlaybackSock *pbs);
+    void HandleFillProgramInfoList(QStringList &slist, PlaybackSock *pbs);
+    void FillLocalProgramInfo(ProgramInfo &pginfo,
+                              const QString &playbackhost);
+    void FillSlaveProgramInfo(ProgramList &list, const QString &playbackhost,
+                              QSet<ProgramInfo*> &handled);
     void HandleSetChannelInfo(QStringList &slist, PlaybackSock *pbs);
     void HandleRemoteEncoder(QStringList &slist, QStringList &commands,
                              PlaybackSock *pbs);
@@ -224,6 +268,13 @@ class MainServer : public QObject, public MythSocketCBs
     QWaitCondition threadPoolCond;
     MythDeque<ProcessRequestThread *> threadPool;
 
+    /// Sockets a worker is handling -> whether more requests arrived
+    QMutex                      m_requestSocketsLock;
+    QHash<MythSocket*, bool>    m_requestSockets;
+
+    mutable QMutex              m_requestStatsLock;
+    QMap<QString, RequestStats> m_requestStats;
+
     bool masterBackendOverride;
 
     Scheduler *m_sched;
@@ -253,7 +304,22 @@ class MainServer : public QObject, public MythSocketCBs
     typedef QHash<QString,QString> RequestedBy;
     RequestedBy                m_previewRequestedBy;
 
+    /// Recording list change log, see HandleQueryRecordingChanges()
+    QMutex                     m_recChangesLock;
+    /// Identifies this run of the backend, generations restart with it
+    uint                       m_recChangesInstance;
+    /// Generation of the most recent change
+    uint                       m_recChangesGeneration;
+    /// Newest generation whose changes are no longer in the log
+    uint                       m_recChangesForgotten;
+    /// ProgramInfo::MakeUniqueKey() or "HOST <hostname>" -> generation
+    /// of its last change
+    QHash<QString, uint>       m_recChanges;
+    /// generation -> key in m_recChanges, oldest first
+    QMap<uint, QString>        m_recChangesByGeneration;
+
     static const uint kMasterServerReconnectTimeout;
+    static const uint kMaxRecordingListChanges;
 };
 
 #endif
@@ -1,4 +1,6 @@
 #include <QStringList>
+#include <QWaitCondition>
+#include <QThreadPool>
 
 using namespace std;
 
@@ -7,6 +9,7 @@ using namespace std;
 #include "mainserver.h"
 
 #include "mythcorecontext.h"
+#include "mythtimer.h"
 #include "util.h"
 #include "inputinfo.h"
 #include "decodeencode.h"
@@ -14,6 +17,58 @@ using namespace std;
 #define LOC QString("PlaybackSock: ")
 #define LOC_ERR QString("PlaybackSock, Error: ")
 
+/// Most slave requests of a SendReceiveAll() fan-out run at once
+static const int kMaxFanOutThreads = 16;
+
+/// Counts the outstanding requests of one SendReceiveAll() call
+class FanOutState
+{
+  public:
+    FanOutState(uint count) : pending(count) {}
+
+    QMutex         lock;
+    QWaitCondition done;
+    uint           pending;
+};
+
+class SlaveRequestRunner : public QRunnable
+{
+  public:
+    SlaveRequestRunner(SlaveRequest &request, uint timeout_ms,
+                       FanOutState &state) :
+        m_request(request), m_timeout(timeout_ms), m_state(state) {}
+
+    void run(void)
+    {
+        m_request.reply = m_request.request;
+        m_request.ok = m_request.sock->SendReceiveStringList(
+            m_request.reply, m_request.minReplyLength, m_timeout);
+
+        QMutexLocker locker(&m_state.lock);
+        m_state.pending--;
+        m_state.done.wakeAll();
+    }
+
+  private:
+    SlaveRequest &m_request;
+    uint          m_timeout;
+    FanOutState  &m_state;
+};
+
+static QThreadPool *fan_out_pool(void)
+{
+    static QMutex lock;
+    static QThreadPool *pool = NULL;
+
+    QMutexLocker locker(&lock);
+    if (!pool)
+    {
+        pool = new QThreadPool();
+        pool->setMaxThreadCount(kMaxFanOutThreads);
+    }
+    return pool;
+}
+
 PlaybackSock::PlaybackSock(MainServer *parent, MythSocket *lsock,
                            QString lhostname, PlaybackSockEventsMode eventsMode)
 {
@@ -28,6 +83,7 @@ PlaybackSock::PlaybackSock(MainServer *parent, MythSocket *lsock,
     ip = "";
     backend = false;
     expectingreply = false;
+    staleReplies = 0;
 
     disconnected = false;
     blockshutdown = true;
@@ -89,11 +145,103 @@ PlaybackSockEventsMode PlaybackSock::eventsMode(void) const
     return m_eventsMode;
 }
 
+/** \fn PlaybackSock::SendReceiveAll(vector<SlaveRequest>&, uint)
+ *  \brief Sends each request to its backend and waits for all the replies,
+ *         so the total wait is that of the slowest backend rather than
+ *         the sum of all of them.
+ *
+ *   Requests to the same backend are still answered one at a time, so
+ *   send at most one per backend; the rest would only hold pool threads
+ *   waiting on its socket. The caller must hold a reference on every
+ *   PlaybackSock.
+ *  \param timeout_ms how long to wait for each reply, 0 for the default
+ */
+void PlaybackSock::SendReceiveAll(vector<SlaveRequest> &requests,
+                                  uint timeout_ms)
+{
+    if (requests.empty())
+        return;
+
+    if (requests.size() == 1)
+    {
+        SlaveRequest &request = requests[0];
+        request.reply = request.request;
+        request.ok = request.sock->SendReceiveStringList(
+            request.reply, request.minReplyLength, timeout_ms);
+        return;
+    }
+
+    FanOutState state(requests.size());
+    QThreadPool *pool = fan_out_pool();
+
+    vector<SlaveRequest>::iterator it = requests.begin();
+    for (; it != requests.end(); ++it)
+        pool->start(new SlaveRequestRunner(*it, timeout_ms, state));
+
+    QMutexLocker locker(&state.lock);
+    while (state.pending)
+        state.done.wait(&state.lock);
+}
+
+/** \brief Waits up to \p timeout_ms for the start of a reply on \p sock.
+ *
+ *   Unlike MythSocket::readStringList() this leaves the socket open when
+ *   the time is up, so one slow request does not disconnect the slave.
+ */
+static bool wait_for_reply(MythSocket *sock, uint timeout_ms)
+{
+    MythTimer timer;
+    timer.start();
+
+    while (sock->waitForMore(5) < 8)
+    {
+        if (sock->state() != MythSocket::Connected ||
+            timer.elapsed() >= (int)timeout_ms)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/** \fn PlaybackSock::ReadReply(QStringList&, uint)
+ *  \brief Reads the next reply from the slave, dispatching any
+ *         BACKEND_MESSAGE which arrives ahead of it. Call with sockLock held.
+ */
+bool PlaybackSock::ReadReply(QStringList &strlist, uint timeout_ms)
+{
+    while (true)
+    {
+        if (!wait_for_reply(sock, timeout_ms) ||
+            !sock->readStringList(strlist, timeout_ms))
+        {
+            return false;
+        }
+
+        if (strlist.empty() || strlist[0] != "BACKEND_MESSAGE")
+            return true;
+
+        // oops, not for us
+        if (strlist.size() >= 2)
+        {
+            QString message = strlist[1];
+            strlist.pop_front();
+            strlist.pop_front();
+            MythEvent me(message, strlist);
+            gCoreContext->dispatch(me);
+        }
+    }
+}
+
 bool PlaybackSock::SendReceiveStringList(
-    QStringList &strlist, uint min_reply_length)
+    QStringList &strlist, uint min_reply_length, uint timeout_ms)
 {
     bool ok = false;
 
+    if (!timeout_ms)
+        timeout_ms = kMythSocketLongTimeout;
+
     sock->Lock();
     sock->UpRef();
 
@@ -102,23 +250,23 @@ bool PlaybackSock::SendReceiveStringList(
         expectingreply = true;
 
         sock->writeStringList(strlist);
-        ok = sock->readStringList(strlist);
 
-        while (ok && strlist[0] == "BACKEND_MESSAGE")
+        // Replies to requests which timed out earlier arrive first,
+        // skip them so they are not taken as the answer to this one.
+        ok = true;
+        while (ok && staleReplies)
         {
-            // oops, not for us
-            if (strlist.size() >= 2)
-            {
-                QString message = strlist[1];
-                strlist.pop_front();
-                strlist.pop_front();
-                MythEvent me(message, strlist);
-                gCoreContext->dispatch(me);
-            }
-
-            ok = sock->readStringList(strlist);
+            ok = ReadReply(strlist, timeout_ms);
+            if (ok)
+                staleReplies--;
         }
 
+        if (ok)
+            ok = ReadReply(strlist, timeout_ms);
+
+        if (!ok && sock->state() == MythSocket::Connected)
+            staleReplies++;
+
         expectingreply = false;
     }
 
@@ -235,6 +383,56 @@ bool PlaybackSock::FillProgramInfo(ProgramInfo &pginfo,
     return false;
 }
 
+/** \fn PlaybackSock::FillProgramInfoRequest(PlaybackSock*,
+                                            const vector<ProgramInfo*>&,
+                                            const QString&)
+ *  \brief Builds one FILL_PROGRAM_INFO_LIST request asking \p slave to
+ *         fill in all the recordings in \p list, for SendReceiveAll().
+ */
+SlaveRequest PlaybackSock::FillProgramInfoRequest(
+    PlaybackSock *slave, const vector<ProgramInfo*> &list,
+    const QString &playbackhost)
+{
+    QStringList strlist( QString("FILL_PROGRAM_INFO_LIST") );
+    strlist << playbackhost << QString::number(list.size());
+
+    vector<ProgramInfo*>::const_iterator it = list.begin();
+    for (; it != list.end(); ++it)
+        (*it)->ToStringList(strlist);
+
+    return SlaveRequest(slave, strlist, 1);
+}
+
+/** \fn PlaybackSock::FillProgramInfoReply(const SlaveRequest&,
+                                          vector<ProgramInfo*>&)
+ *  \brief Applies the reply to a FillProgramInfoRequest() to the
+ *         recordings it was built from.
+ *  \return true iff every recording was filled in
+ */
+bool PlaybackSock::FillProgramInfoReply(
+    const SlaveRequest &request, vector<ProgramInfo*> &list)
+{
+    if (!request.ok || request.reply[0].toUInt() != list.size() ||
+        (uint)request.reply.size() < 1 + list.size() * NUMPROGRAMLINES)
+    {
+        return false;
+    }
+
+    bool ok = true;
+    QStringList::const_iterator sit = request.reply.begin() + 1;
+    vector<ProgramInfo*>::iterator it = list.begin();
+    for (; it != list.end(); ++it)
+    {
+        ProgramInfo tmp(sit, request.reply.end());
+        if (tmp.HasPathname() || tmp.GetChanID())
+            (*it)->clone(tmp, true);
+        else
+            ok = false;
+    }
+
+    return ok;
+}
+
 QStringList PlaybackSock::GetSGFileList(QString &host, QString &groupname,
                                       QString &directory, bool fileNamesOnly)
 {
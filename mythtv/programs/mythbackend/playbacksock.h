@@ -15,6 +15,24 @@ using namespace std;
 class MythSocket;
 class MainServer;
 class ProgramInfo;
+class PlaybackSock;
+
+/** \class SlaveRequest
+ *  \brief One request of a PlaybackSock::SendReceiveAll() fan-out.
+ */
+class SlaveRequest
+{
+  public:
+    SlaveRequest(PlaybackSock *s, const QStringList &req,
+                 uint min_reply_length = 0) :
+        sock(s), request(req), minReplyLength(min_reply_length), ok(false) {}
+
+    PlaybackSock *sock;
+    QStringList   request;
+    uint          minReplyLength;
+    QStringList   reply;          ///< set by SendReceiveAll()
+    bool          ok;             ///< set by SendReceiveAll()
+};
 
 typedef enum {
     kPBSEvents_None       = 0,
@@ -25,6 +43,8 @@ typedef enum {
 
 class PlaybackSock
 {
+    friend class SlaveRequestRunner;
+
   public:
     PlaybackSock(MainServer *parent, MythSocket *lsock,
                  QString lhostname, PlaybackSockEventsMode eventsMode);
@@ -65,6 +85,11 @@ class PlaybackSock
     int CheckRecordingActive(const ProgramInfo *pginfo);
     int DeleteRecording(const ProgramInfo *pginfo, bool forceMetadataDelete = false);
     bool FillProgramInfo(ProgramInfo &pginfo, const QString &playbackhost);
+    static SlaveRequest FillProgramInfoRequest(
+        PlaybackSock *slave, const vector<ProgramInfo*> &list,
+        const QString &playbackhost);
+    static bool FillProgramInfoReply(
+        const SlaveRequest &request, vector<ProgramInfo*> &list);
     QStringList GetSGFileList(QString &host, QString &groupname,
                               QString &directory, bool fileNamesOnly);
     QStringList GetSGFileQuery(QString &host, QString &groupname,
@@ -101,8 +126,13 @@ class PlaybackSock
 
     QStringList ForwardRequest(const QStringList&);
 
+    static void SendReceiveAll(vector<SlaveRequest> &requests,
+                               uint timeout_ms = 0);
+
   private:
-    bool SendReceiveStringList(QStringList &strlist, uint min_reply_length = 0);
+    bool SendReceiveStringList(QStringList &strlist, uint min_reply_length = 0,
+                               uint timeout_ms = 0);
+    bool ReadReply(QStringList &strlist, uint timeout_ms);
 
     MythSocket *sock;
     QString hostname;
@@ -118,6 +148,8 @@ class PlaybackSock
 
     bool expectingreply;
     bool disconnected;
+    /// Replies still owed for requests which timed out, under sockLock
+    uint staleReplies;
 
     int refCount;
 
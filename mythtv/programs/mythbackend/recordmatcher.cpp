@@ -0,0 +1,486 @@
+// Qt headers
+#include <QStringList>
+
+// MythTV headers
+#include "recordmatcher.h"
+#include "mythverbose.h"
+#include "mythdb.h"
+
+RecordMatcher::RecordMatcher(const MSqlQueryInfo &dbConn,
+                             const QString &recordTable) :
+    m_dbConn(dbConn), m_recordTable(recordTable), m_needText(false),
+    m_needFullTitles(false)
+{
+}
+
+/** \fn RecordMatcher::CanMatch(RecSearchType, const QString&)
+ *  \brief Returns true if a rule with this search type and phrase can be
+ *         evaluated in memory with the same result as the SQL match.
+ *
+ *   Title and keyword phrases are matched with LIKE '%phrase%', so a
+ *   phrase which itself contains LIKE wildcards or escapes is left to
+ *   the database. Empty phrases are reported as invalid by the SQL path.
+ */
+bool RecordMatcher::CanMatch(RecSearchType searchtype, const QString &phrase)
+{
+    switch (searchtype)
+    {
+        case kNoSearch:
+        case kManualSearch:
+            return true;
+        case kTitleSearch:
+        case kKeywordSearch:
+            return !phrase.isEmpty() && !phrase.contains('%') &&
+                !phrase.contains('_') && !phrase.contains('\\');
+        default:
+            return false;
+    }
+}
+
+/** \fn RecordMatcher::Fold(const QString&)
+ *  \brief Folds a string for comparison the way the utf8_general_ci
+ *         collation of the program table does.
+ *
+ *   That collation ignores case and accents, so "Café" equals "cafe".
+ *   Accents are removed by decomposing the string and dropping the
+ *   combining marks, and the German sharp s compares equal to 's'.
+ */
+QString RecordMatcher::Fold(const QString &str)
+{
+    bool ascii = true;
+    for (int i = 0; ascii && i < str.length(); i++)
+        ascii = str[i].unicode() < 0x80;
+    if (ascii)
+        return str.toLower();
+
+    QString norm = str.normalized(QString::NormalizationForm_D);
+    QString folded;
+    folded.reserve(norm.length());
+    for (int i = 0; i < norm.length(); i++)
+    {
+        QChar::Category cat = norm[i].category();
+        if (cat == QChar::Mark_NonSpacing ||
+            cat == QChar::Mark_SpacingCombining ||
+            cat == QChar::Mark_Enclosing)
+        {
+            continue;
+        }
+        if (norm[i].unicode() == 0x00DF)
+            folded += QChar('s');
+        else
+            folded += norm[i].toLower();
+    }
+    return folded;
+}
+
+/** \brief Returns the key used to compare titles and callsigns with '=',
+ *         which ignores trailing spaces in MySQL.
+ */
+static QString title_key(const QString &folded)
+{
+    int len = folded.length();
+    while (len > 0 && folded[len - 1] == ' ')
+        len--;
+    return folded.left(len);
+}
+
+/** \fn RecordMatcher::LoadRules(int)
+ *  \brief Loads the rules this matcher can handle.
+ *  \param recordid rule to load, or -1 for all rules
+ */
+bool RecordMatcher::LoadRules(int recordid)
+{
+    m_rules.clear();
+    m_manualRules.clear();
+    m_needText = false;
+    m_needFullTitles = false;
+
+    MSqlQuery query(m_dbConn);
+    query.prepare(QString("SELECT recordid, type, search, title, "
+                          "description, station, starttime, startdate, "
+                          "dupin "
+                          "FROM %1 WHERE (recordid = %2 OR %3 = -1)")
+                  .arg(m_recordTable).arg(recordid).arg(recordid));
+
+    if (!query.exec())
+    {
+        MythDB::DBError("RecordMatcher::LoadRules", query);
+        return false;
+    }
+
+    while (query.next())
+    {
+        RecSearchType search = RecSearchType(query.value(2).toInt());
+        QString phrase = query.value(4).toString();
+
+        if (!CanMatch(search, phrase))
+            continue;
+
+        Rule rule;
+        rule.recordid  = query.value(0).toInt();
+        rule.type      = RecordingType(query.value(1).toInt());
+        rule.search    = search;
+        rule.station   = title_key(Fold(query.value(5).toString()));
+        rule.starttime = query.value(6).toTime();
+        rule.startdate = query.value(7).toDate();
+        rule.dupin     = query.value(8).toInt();
+
+        if (search == kNoSearch)
+            rule.key = title_key(Fold(query.value(3).toString()));
+        else if (search != kManualSearch)
+            rule.key = Fold(phrase);
+
+        if (search == kManualSearch)
+            m_manualRules.push_back(rule.recordid);
+        else if (search == kKeywordSearch)
+            m_needText = true;
+        else if (search == kTitleSearch)
+            m_needFullTitles = true;
+
+        m_rules.push_back(rule);
+    }
+
+    return true;
+}
+
+/** \fn RecordMatcher::LoadPrograms(void)
+ *  \brief Loads the guide data on visible channels and builds the indexes
+ *         used by Match().
+ *
+ *   When only a single plain title or manual rule is loaded just the
+ *   programs it can match are read. Subtitles and descriptions are only
+ *   read for the programs whose text contains a keyword rule's phrase,
+ *   see LoadText().
+ */
+bool RecordMatcher::LoadPrograms(void)
+{
+    m_programs.clear();
+    m_callsigns.clear();
+    m_byTitle.clear();
+    m_byFullTitle.clear();
+    m_byManualId.clear();
+    m_byChanId.clear();
+    m_guide.clear();
+
+    if (m_rules.empty())
+        return true;
+
+    MSqlQuery query(m_dbConn);
+    query.prepare("SELECT chanid, callsign FROM channel WHERE visible = 1");
+    if (!query.exec())
+    {
+        MythDB::DBError("RecordMatcher::LoadPrograms", query);
+        return false;
+    }
+
+    while (query.next())
+    {
+        m_callsigns[query.value(0).toUInt()] =
+            title_key(Fold(query.value(1).toString()));
+    }
+
+    TextMap text;
+    if (m_needText && !LoadText(text))
+        return false;
+
+    QString filter;
+    if (m_rules.size() == 1 && m_rules[0].search == kNoSearch)
+        filter = "AND program.title = :TITLE AND program.manualid = 0 ";
+    else if (m_rules.size() == 1 && m_rules[0].search == kManualSearch)
+        filter = "AND program.manualid = :MANUALID ";
+
+    query.prepare(QString(
+        "SELECT program.chanid, program.starttime, program.title, "
+        "       program.manualid, program.previouslyshown, "
+        "       program.generic, program.first "
+        "FROM program INNER JOIN channel "
+        "     ON channel.chanid = program.chanid "
+        "WHERE channel.visible = 1 ") + filter);
+
+    if (filter.contains(":TITLE"))
+        query.bindValue(":TITLE", m_rules[0].key);
+    else if (filter.contains(":MANUALID"))
+        query.bindValue(":MANUALID", m_rules[0].recordid);
+
+    if (!query.exec())
+    {
+        MythDB::DBError("RecordMatcher::LoadPrograms", query);
+        return false;
+    }
+
+    if (query.size() > 0)
+        m_programs.reserve(query.size());
+
+    while (query.next())
+    {
+        Program prog;
+        prog.chanid          = query.value(0).toUInt();
+        prog.starttime       = query.value(1).toDateTime();
+        prog.title           = Fold(query.value(2).toString());
+        prog.manualid        = query.value(3).toInt();
+        prog.previouslyshown = query.value(4).toInt();
+        prog.generic         = query.value(5).toInt() > 0;
+        prog.first           = query.value(6).toInt();
+        if (!prog.manualid && !text.empty())
+        {
+            TextMap::const_iterator tit = text.find(
+                qMakePair(prog.chanid, prog.starttime.toTime_t()));
+            if (tit != text.end())
+            {
+                prog.subtitle    = (*tit).first;
+                prog.description = (*tit).second;
+            }
+        }
+
+        int idx = m_programs.size();
+        m_programs.push_back(prog);
+
+        if (prog.manualid)
+        {
+            m_byManualId[prog.manualid].push_back(idx);
+            continue;
+        }
+
+        m_byTitle[title_key(prog.title)].push_back(idx);
+        if (m_needFullTitles)
+            m_byFullTitle[prog.title].push_back(idx);
+        m_byChanId[prog.chanid].push_back(idx);
+        m_guide.push_back(idx);
+    }
+
+    return true;
+}
+
+/** \fn RecordMatcher::LoadText(TextMap&)
+ *  \brief Reads the folded subtitle and description of the guide programs
+ *         whose subtitle or description contains the phrase of a keyword
+ *         rule, so the text of the whole guide need not be read.
+ *
+ *   The database compares with the same collation as the SQL match, and
+ *   every other program can only match a keyword rule by its title.
+ */
+bool RecordMatcher::LoadText(TextMap &text)
+{
+    QStringList clauses;
+    vector<Rule>::const_iterator rit = m_rules.begin();
+    for (; rit != m_rules.end(); ++rit)
+    {
+        if ((*rit).search != kKeywordSearch)
+            continue;
+        QString key = QString(":KEY%1").arg(clauses.size());
+        clauses << QString("program.subtitle LIKE %1 OR "
+                           "program.description LIKE %2").arg(key).arg(key);
+    }
+
+    MSqlQuery query(m_dbConn);
+    query.prepare(
+        "SELECT program.chanid, program.starttime, "
+        "       program.subtitle, program.description "
+        "FROM program INNER JOIN channel "
+        "     ON channel.chanid = program.chanid "
+        "WHERE channel.visible = 1 AND program.manualid = 0 AND "
+        "      (" + clauses.join(" OR ") + ")");
+
+    uint i = 0;
+    for (rit = m_rules.begin(); rit != m_rules.end(); ++rit)
+    {
+        if ((*rit).search == kKeywordSearch)
+            query.bindValue(QString(":KEY%1").arg(i++),
+                            QString("%%1%").arg((*rit).key));
+    }
+
+    if (!query.exec())
+    {
+        MythDB::DBError("RecordMatcher::LoadText", query);
+        return false;
+    }
+
+    while (query.next())
+    {
+        text[qMakePair(query.value(0).toUInt(),
+                       query.value(1).toDateTime().toTime_t())] =
+            qMakePair(Fold(query.value(2).toString()),
+                      Fold(query.value(3).toString()));
+    }
+
+    return true;
+}
+
+/** \fn RecordMatcher::IsMatch(const Rule&, const Program&) const
+ *  \brief Evaluates the recordmatch conditions of Scheduler::UpdateMatches()
+ *         for a single rule and program.
+ */
+bool RecordMatcher::IsMatch(const Rule &rule, const Program &prog) const
+{
+    switch (rule.search)
+    {
+        case kNoSearch:
+            if (prog.manualid || title_key(prog.title) != rule.key)
+                return false;
+            break;
+        case kTitleSearch:
+            if (prog.manualid || !prog.title.contains(rule.key))
+                return false;
+            break;
+        case kKeywordSearch:
+            if (prog.manualid ||
+                !(prog.title.contains(rule.key) ||
+                  prog.subtitle.contains(rule.key) ||
+                  prog.description.contains(rule.key)))
+                return false;
+            break;
+        case kManualSearch:
+            if (prog.manualid != rule.recordid)
+                return false;
+            break;
+        default:
+            return false;
+    }
+
+    if ((rule.dupin & kDupsExRepeats) && prog.previouslyshown)
+        return false;
+    if ((rule.dupin & kDupsExGeneric) && prog.generic)
+        return false;
+    if ((rule.dupin & kDupsFirstNew) && (prog.previouslyshown || !prog.first))
+        return false;
+
+    QHash<uint, QString>::const_iterator chan = m_callsigns.find(prog.chanid);
+    if (chan == m_callsigns.end())
+        return false;
+
+    switch (rule.type)
+    {
+        case kAllRecord:
+        case kFindOneRecord:
+        case kFindDailyRecord:
+        case kFindWeeklyRecord:
+            return true;
+        default:
+            break;
+    }
+
+    if (*chan != rule.station)
+        return false;
+    if (rule.type == kChannelRecord)
+        return true;
+
+    if (rule.starttime != prog.starttime.time())
+        return false;
+    if (rule.type == kTimeslotRecord)
+        return true;
+
+    if (rule.startdate.dayOfWeek() != prog.starttime.date().dayOfWeek())
+        return false;
+    if (rule.type == kWeekslotRecord)
+        return true;
+
+    return (rule.startdate == prog.starttime.date() &&
+            rule.type != kNotRecording);
+}
+
+void RecordMatcher::MatchCandidates(const Rule &rule,
+                                    const IndexList &candidates)
+{
+    IndexList::const_iterator it = candidates.begin();
+    for (; it != candidates.end(); ++it)
+    {
+        if (!IsMatch(rule, m_programs[*it]))
+            continue;
+
+        RuleMatch match;
+        match.recordid = rule.recordid;
+        match.prog     = *it;
+        match.manualid = (rule.search == kManualSearch) ? rule.recordid : 0;
+        m_matches.push_back(match);
+    }
+}
+
+/** \fn RecordMatcher::Match(void)
+ *  \brief Matches every loaded rule against the loaded programs.
+ *
+ *   Plain title and manual rules use the title and manualid indexes,
+ *   title searches scan the distinct untrimmed titles, and keyword
+ *   searches scan either the rule's channels or the whole guide.
+ *  \return number of matches found
+ */
+uint RecordMatcher::Match(void)
+{
+    m_matches.clear();
+
+    vector<Rule>::const_iterator rit = m_rules.begin();
+    for (; rit != m_rules.end(); ++rit)
+    {
+        const Rule &rule = *rit;
+
+        if (rule.search == kNoSearch)
+        {
+            QHash<QString, IndexList>::const_iterator it =
+                m_byTitle.find(rule.key);
+            if (it != m_byTitle.end())
+                MatchCandidates(rule, *it);
+        }
+        else if (rule.search == kManualSearch)
+        {
+            QHash<int, IndexList>::const_iterator it =
+                m_byManualId.find(rule.recordid);
+            if (it != m_byManualId.end())
+                MatchCandidates(rule, *it);
+        }
+        else if (rule.search == kTitleSearch)
+        {
+            // LIKE keeps trailing spaces, so a phrase ending in one can
+            // only be found in the untrimmed title.
+            QHash<QString, IndexList>::const_iterator it =
+                m_byFullTitle.begin();
+            for (; it != m_byFullTitle.end(); ++it)
+            {
+                if (it.key().contains(rule.key))
+                    MatchCandidates(rule, *it);
+            }
+        }
+        else if (rule.type == kAllRecord || rule.type == kFindOneRecord ||
+                 rule.type == kFindDailyRecord ||
+                 rule.type == kFindWeeklyRecord)
+        {
+            MatchCandidates(rule, m_guide);
+        }
+        else
+        {
+            QHash<uint, QString>::const_iterator it = m_callsigns.begin();
+            for (; it != m_callsigns.end(); ++it)
+            {
+                if (*it != rule.station)
+                    continue;
+                QHash<uint, IndexList>::const_iterator cit =
+                    m_byChanId.find(it.key());
+                if (cit != m_byChanId.end())
+                    MatchCandidates(rule, *cit);
+            }
+        }
+    }
+
+    return m_matches.size();
+}
+
+/** \fn RecordMatcher::StoreMatches(void)
+ *  \brief Writes the matches found by Match() to the recordmatch table
+ *         using multi-row INSERTs.
+ */
+bool RecordMatcher::StoreMatches(void)
+{
+    MSqlQuery query(m_dbConn);
+    MSqlBulkInsert bulk(query, "INSERT INTO recordmatch",
+                        QStringList() << "recordid" << "chanid"
+                                      << "starttime" << "manualid");
+
+    vector<RuleMatch>::const_iterator it = m_matches.begin();
+    for (; it != m_matches.end(); ++it)
+    {
+        const Program &prog = m_programs[(*it).prog];
+        if (!bulk.AddRow(QVariantList() << (*it).recordid << prog.chanid
+                         << prog.starttime << (*it).manualid))
+            return false;
+    }
+
+    return bulk.Flush();
+}
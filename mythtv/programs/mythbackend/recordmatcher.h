@@ -0,0 +1,114 @@
+#ifndef RECORDMATCHER_H_
+#define RECORDMATCHER_H_
+
+// C++ headers
+#include <vector>
+using namespace std;
+
+// Qt headers
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+// MythTV headers
+#include "recordingtypes.h"
+#include "mythdbcon.h"
+
+/** \class RecordMatcher
+ *  \brief Matches recording rules against the program guide in memory.
+ *
+ *   This evaluates the same rules as the recordmatch INSERT ... SELECT
+ *   queries built by Scheduler::UpdateMatches() for plain title, title
+ *   search, keyword search and manual rules. The guide is loaded once
+ *   into indexed tables so each rule only looks at its candidate
+ *   programs. Power and people searches, and searches whose phrase uses
+ *   SQL wildcards, are left to the database; see CanMatch().
+ */
+class RecordMatcher
+{
+  public:
+    RecordMatcher(const MSqlQueryInfo &dbConn, const QString &recordTable);
+
+    static bool CanMatch(RecSearchType searchtype, const QString &phrase);
+
+    bool LoadRules(int recordid);
+    bool LoadPrograms(void);
+    uint Match(void);
+    bool StoreMatches(void);
+
+    /// recordids of the loaded manual rules, whose program rows must be
+    /// created by Scheduler::UpdateManuals() before LoadPrograms()
+    const vector<int> &GetManualRules(void) const { return m_manualRules; }
+
+    uint GetRuleCount(void)    const { return m_rules.size();    }
+    uint GetProgramCount(void) const { return m_programs.size(); }
+    uint GetMatchCount(void)   const { return m_matches.size();  }
+
+  private:
+    class Rule
+    {
+      public:
+        int            recordid;
+        RecordingType  type;
+        RecSearchType  search;
+        QString        key;       ///< folded title or search phrase
+        QString        station;   ///< folded callsign, trailing spaces removed
+        QTime          starttime;
+        QDate          startdate;
+        int            dupin;
+    };
+
+    class Program
+    {
+      public:
+        uint      chanid;
+        QDateTime starttime;
+        QString   title;          ///< folded
+        QString   subtitle;       ///< folded, see LoadText()
+        QString   description;    ///< folded, see LoadText()
+        int       manualid;
+        bool      previouslyshown;
+        bool      generic;
+        bool      first;
+    };
+
+    class RuleMatch
+    {
+      public:
+        int recordid;
+        int prog;
+        int manualid;
+    };
+
+    typedef QVector<int> IndexList;
+    /// (chanid, start time_t) -> folded subtitle and description
+    typedef QHash<QPair<uint, uint>, QPair<QString, QString> > TextMap;
+
+    static QString Fold(const QString &str);
+
+    bool LoadText(TextMap &text);
+    void MatchCandidates(const Rule &rule, const IndexList &candidates);
+    bool IsMatch(const Rule &rule, const Program &prog) const;
+
+    MSqlQueryInfo   m_dbConn;
+    QString         m_recordTable;
+
+    vector<Rule>    m_rules;
+    vector<int>     m_manualRules;
+    bool            m_needText;
+    bool            m_needFullTitles;
+
+    vector<Program> m_programs;
+    QHash<uint, QString>   m_callsigns;   ///< visible chanid -> station key
+    QHash<QString, IndexList> m_byTitle;  ///< title_key() -> programs
+    QHash<QString, IndexList> m_byFullTitle; ///< folded title -> programs
+    QHash<int, IndexList>  m_byManualId;  ///< manualid -> programs
+    QHash<uint, IndexList> m_byChanId;    ///< chanid -> non manual programs
+    IndexList              m_guide;       ///< all non manual programs
+
+    vector<RuleMatch> m_matches;
+};
+
+#endif
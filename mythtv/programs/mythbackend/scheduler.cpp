@@ -18,6 +18,7 @@ using namespace std;
 #include <sys/time.h>
 #include <sys/types.h>
 
+#include <QCryptographicHash>
 #include <QStringList>
 #include <QDateTime>
 #include <QRegExp>
@@ -26,6 +27,7 @@ using namespace std;
 #include <QMap>
 
 #include "scheduler.h"
+#include "recordmatcher.h"
 #include "encoderlink.h"
 #include "mainserver.h"
 #include "remoteutil.h"
@@ -53,6 +55,7 @@ Scheduler::Scheduler(bool runthread, QMap<int, EncoderLink *> *tvList,
     schedLock(),
     reclist_changed(false),
     specsched(master_sched),
+    masterSched(master_sched),
     schedMoveHigher(false),
     schedulingEnabled(true),
     m_tvList(tvList),
@@ -64,11 +67,24 @@ Scheduler::Scheduler(bool runthread, QMap<int, EncoderLink *> *tvList,
     error(0),
     livetvTime(QDateTime()),
     livetvpriority(0),
-    prefinputpri(0)
+    prefinputpri(0),
+    placementOpenEnd(-1),
+    placementMoveHigher(false),
+    candidatesSaved(false),
+    previewRecordID(-1)
 {
+    reclistIndexDirty = true;
+
     if (master_sched)
+    {
         master_sched->getAllPending(&reclist);
 
+        // Start from the master's placements, so a preview only has to
+        // place the conflict groups touched by the rule being edited.
+        placementCache = master_sched->GetPlacementCache(
+            placementOpenEnd, placementMoveHigher);
+    }
+
     // Only the master scheduler should use SchedCon()
     if (runthread)
         dbConn = MSqlQuery::SchedCon();
@@ -120,6 +136,12 @@ Scheduler::~Scheduler()
         worklist.pop_back();
     }
 
+    while (!candidates.empty())
+    {
+        delete candidates.back();
+        candidates.pop_back();
+    }
+
     if (threadrunning)
     {
         pthread_cancel(schedThread);
@@ -341,28 +363,52 @@ bool Scheduler::FillRecordList(bool doLock)
     schedMoveHigher = (bool)gCoreContext->GetNumSetting("SchedMoveHigher");
     schedTime = QDateTime::currentDateTime();
 
+    QTime timer;
+    timer.start();
+    phaseTimes.clear();
+
     VERBOSE(VB_SCHEDULE, "BuildWorkList...");
     BuildWorkList();
+    AddPhaseTime("BuildWorkList", timer);
     if (doLock)
         schedLock.unlock();
     VERBOSE(VB_SCHEDULE, "AddNewRecords...");
     AddNewRecords();
+    AddPhaseTime("AddNewRecords", timer);
     VERBOSE(VB_SCHEDULE, "AddNotListed...");
     AddNotListed();
+    AddPhaseTime("AddNotListed", timer);
+    if (!specsched)
+        SaveCandidates();
+    else if (previewRecordID > 0)
+    {
+        VERBOSE(VB_SCHEDULE, "AddMasterCandidates...");
+        AddMasterCandidates();
+        AddPhaseTime("AddMasterCandidates", timer);
+    }
 
     VERBOSE(VB_SCHEDULE, "Sort by time...");
     SORT_RECLIST(worklist, comp_overlap);
     VERBOSE(VB_SCHEDULE, "PruneOverlaps...");
     PruneOverlaps();
+    AddPhaseTime("PruneOverlaps", timer);
 
     VERBOSE(VB_SCHEDULE, "Sort by priority...");
     SORT_RECLIST(worklist, comp_priority);
+    VERBOSE(VB_SCHEDULE, "ReusePlacements...");
+    ReusePlacements();
+    AddPhaseTime("ReusePlacements", timer);
     VERBOSE(VB_SCHEDULE, "BuildListMaps...");
     BuildListMaps();
+    AddPhaseTime("BuildListMaps", timer);
     VERBOSE(VB_SCHEDULE, "SchedNewRecords...");
     SchedNewRecords();
+    AddPhaseTime("SchedNewRecords", timer);
+    VERBOSE(VB_SCHEDULE, "SavePlacements...");
+    SavePlacements();
     VERBOSE(VB_SCHEDULE, "SchedPreserveLiveTV...");
     SchedPreserveLiveTV();
+    AddPhaseTime("SchedPreserveLiveTV", timer);
     VERBOSE(VB_SCHEDULE, "ClearListMaps...");
     ClearListMaps();
     if (doLock)
@@ -372,18 +418,55 @@ bool Scheduler::FillRecordList(bool doLock)
     SORT_RECLIST(worklist, comp_redundant);
     VERBOSE(VB_SCHEDULE, "PruneRedundants...");
     PruneRedundants();
+    AddPhaseTime("PruneRedundants", timer);
 
     VERBOSE(VB_SCHEDULE, "Sort by time...");
     SORT_RECLIST(worklist, comp_recstart);
     VERBOSE(VB_SCHEDULE, "ClearWorkList...");
     bool res = ClearWorkList();
+    AddPhaseTime("ClearWorkList", timer);
+
+    VERBOSE(VB_SCHEDULE, LOC + "Phase times: " + GetPhaseTimes());
 
     return res;
 }
 
+void Scheduler::AddPhaseTime(const QString &phase, QTime &timer)
+{
+    phaseTimes.push_back(qMakePair(phase, timer.restart()));
+}
+
+/** \fn Scheduler::GetPhaseTimes(void) const
+ *  \brief Returns the time spent in each phase of the last
+ *         FillRecordList(), for --testsched and the scheduler log.
+ */
+QString Scheduler::GetPhaseTimes(void) const
+{
+    QStringList times;
+    int total = 0;
+
+    QList<QPair<QString, int> >::const_iterator it = phaseTimes.begin();
+    for (; it != phaseTimes.end(); ++it)
+    {
+        times << QString("%1 %2ms").arg((*it).first).arg((*it).second);
+        total += (*it).second;
+    }
+    times << QString("total %1ms").arg(total);
+
+    return times.join(", ");
+}
+
 /** \fn Scheduler::FillRecordListFromDB(int)
  *  \param recordid Record ID of recording that has changed,
+ *                  0 if only priorities have changed,
  *                  or -1 if anything might have been changed.
+ *
+ *   For a what-if preview this runs on a worker thread alongside the
+ *   live scheduler, and no table is copied. When one rule has changed
+ *   only that rule is matched, into an empty temporary recordmatch, and
+ *   the showings of every other rule are taken from the master's last
+ *   run, see AddMasterCandidates(). When no rule has changed the
+ *   master's recordmatch is read as it is.
  */
 void Scheduler::FillRecordListFromDB(int recordid)
 {
@@ -391,32 +474,26 @@ void Scheduler::FillRecordListFromDB(int recordid)
     float matchTime, placeTime;
 
     MSqlQuery query(dbConn);
-    QString thequery;
-    QString where = "";
-
-    // This will cause our temp copy of recordmatch to be empty
-    if (recordid == -1)
-        where = "WHERE recordid IS NULL ";
 
-    thequery = QString("CREATE TEMPORARY TABLE recordmatch ") +
-                           "SELECT * FROM recordmatch " + where + "; ";
+    previewRecordID = recordid;
 
-    query.prepare(thequery);
-    recordmatchLock.lock();
-    bool ok = query.exec();
-    recordmatchLock.unlock();
-    if (!ok)
+    if (recordid != 0)
     {
-        MythDB::DBError("FillRecordListFromDB", query);
-        return;
-    }
+        // Shadow recordmatch with an empty table of the same layout
+        query.prepare("CREATE TEMPORARY TABLE recordmatch "
+                      "SELECT * FROM recordmatch WHERE recordid IS NULL;");
+        if (!query.exec())
+        {
+            MythDB::DBError("FillRecordListFromDB", query);
+            return;
+        }
 
-    thequery = "ALTER TABLE recordmatch ADD INDEX (recordid);";
-    query.prepare(thequery);
-    if (!query.exec())
-    {
-        MythDB::DBError("FillRecordListFromDB", query);
-        return;
+        query.prepare("ALTER TABLE recordmatch ADD INDEX (recordid);");
+        if (!query.exec())
+        {
+            MythDB::DBError("FillRecordListFromDB", query);
+            return;
+        }
     }
 
     gettimeofday(&fillstart, NULL);
@@ -431,12 +508,15 @@ void Scheduler::FillRecordListFromDB(int recordid)
     placeTime = ((fillend.tv_sec - fillstart.tv_sec ) * 1000000 +
                  (fillend.tv_usec - fillstart.tv_usec)) / 1000000.0;
 
-    MSqlQuery queryDrop(dbConn);
-    queryDrop.prepare("DROP TABLE recordmatch;");
-    if (!queryDrop.exec())
+    if (recordid != 0)
     {
-        MythDB::DBError("FillRecordListFromDB", queryDrop);
-        return;
+        MSqlQuery queryDrop(dbConn);
+        queryDrop.prepare("DROP TABLE recordmatch;");
+        if (!queryDrop.exec())
+        {
+            MythDB::DBError("FillRecordListFromDB", queryDrop);
+            return;
+        }
     }
 
     QString msg;
@@ -457,6 +537,7 @@ void Scheduler::FillRecordListFromMaster(void)
     RecordingList::iterator it = schedList.begin();
     for (; it != schedList.end(); ++it)
         reclist.push_back(*it);
+    reclistIndexDirty = true;
 }
 
 void Scheduler::PrintList(RecList &list, bool onlyFutureRecordings)
@@ -579,6 +660,7 @@ void Scheduler::UpdateRecStatus(uint cardid, uint chanid,
             p->GetScheduledStartTime() == startts)
         {
             p->SetRecordingEndTime(recendts);
+            reclistIndexDirty = true;
 
             if (p->GetRecordingStatus() != recstatus)
             {
@@ -628,6 +710,7 @@ bool Scheduler::ChangeRecordingEnd(RecordingInfo *oldp, RecordingInfo *newp)
     oldp->SetRecordingRuleType(newp->GetRecordingRuleType());
     oldp->SetRecordingRuleID(newp->GetRecordingRuleID());
     oldp->SetRecordingEndTime(newp->GetRecordingEndTime());
+    reclistIndexDirty = true;
 
     if (specsched)
     {
@@ -652,6 +735,7 @@ bool Scheduler::ChangeRecordingEnd(RecordingInfo *oldp, RecordingInfo *newp)
         oldp->SetRecordingRuleType(oldrectype);
         oldp->SetRecordingRuleID(oldrecordid);
         oldp->SetRecordingEndTime(oldrecendts);
+        reclistIndexDirty = true;
     }
     else
     {
@@ -662,6 +746,7 @@ bool Scheduler::ChangeRecordingEnd(RecordingInfo *oldp, RecordingInfo *newp)
             if (recp->IsSameTimeslot(*oldp))
             {
                 *recp = *oldp;
+                reclistIndexDirty = true;
                 break;
             }
         }
@@ -730,6 +815,7 @@ void Scheduler::SlaveConnected(RecordingList &slavelist)
         {
             reclist.push_back(new RecordingInfo(*sp));
             reclist_changed = true;
+            reclistIndexDirty = true;
             sp->AddHistory(false);
             VERBOSE(VB_IMPORTANT, QString("adding %1/%2/\"%3\" as recording")
                     .arg(sp->GetCardID())
@@ -805,10 +891,96 @@ bool Scheduler::ClearWorkList(void)
         reclist.push_back(p);
         worklist.pop_front();
     }
+    reclistIndexDirty = true;
 
     return true;
 }
 
+void RecOverlapIndex::Clear(void)
+{
+    m_order.clear();
+    m_start.clear();
+    m_end.clear();
+    m_maxEnd.clear();
+}
+
+/** \fn RecOverlapIndex::Build(const RecList&)
+ *  \brief Sorts the entries of list by start time and builds a segment
+ *         tree holding the latest end time of each range of them.
+ */
+void RecOverlapIndex::Build(const RecList &list)
+{
+    Clear();
+
+    vector<pair<uint, uint> > starts;
+    starts.reserve(list.size());
+    for (uint i = 0; i < list.size(); i++)
+        starts.push_back(
+            make_pair(list[i]->GetRecordingStartTime().toTime_t(), i));
+    sort(starts.begin(), starts.end());
+
+    uint count = starts.size();
+    if (!count)
+        return;
+
+    m_order.resize(count);
+    m_start.resize(count);
+    m_end.resize(count);
+    for (uint i = 0; i < count; i++)
+    {
+        m_order[i] = starts[i].second;
+        m_start[i] = starts[i].first;
+        m_end[i]   = list[m_order[i]]->GetRecordingEndTime().toTime_t();
+    }
+
+    uint size = 1;
+    while (size < count)
+        size <<= 1;
+
+    m_maxEnd.assign(2 * size, 0);
+    for (uint i = 0; i < count; i++)
+        m_maxEnd[size + i] = m_end[i];
+    for (uint i = size - 1; i > 0; i--)
+        m_maxEnd[i] = max(m_maxEnd[2 * i], m_maxEnd[2 * i + 1]);
+}
+
+void RecOverlapIndex::Collect(uint node, uint lo, uint hi, uint limit,
+                              uint start, vector<uint> &positions) const
+{
+    if (lo >= limit || m_maxEnd[node] < start)
+        return;
+
+    if (hi - lo == 1)
+    {
+        positions.push_back(m_order[lo]);
+        return;
+    }
+
+    uint mid = (lo + hi) / 2;
+    Collect(2 * node,     lo,  mid, limit, start, positions);
+    Collect(2 * node + 1, mid, hi,  limit, start, positions);
+}
+
+/** \fn RecOverlapIndex::Find(const QDateTime&,const QDateTime&,vector<uint>&) const
+ *  \brief Returns the list positions, in list order, of the entries
+ *         which start no later than end and end no earlier than start.
+ *
+ *   The range is inclusive so the result is a superset of the conflicts
+ *   for every SchedOpenEnd mode, the caller checks each one.
+ */
+void RecOverlapIndex::Find(const QDateTime &start, const QDateTime &end,
+                           vector<uint> &positions) const
+{
+    if (m_order.empty())
+        return;
+
+    uint limit = upper_bound(m_start.begin(), m_start.end(),
+                             end.toTime_t()) - m_start.begin();
+
+    Collect(1, 0, m_maxEnd.size() / 2, limit, start.toTime_t(), positions);
+    sort(positions.begin(), positions.end());
+}
+
 static void erase_nulls(RecList &reclist)
 {
     RecIter it = reclist.begin();
@@ -864,16 +1036,393 @@ void Scheduler::BuildListMaps(void)
             recordidlistmap[p->GetRecordingRuleID()].push_back(p);
         }
     }
+
+    QMap<int, RecList>::const_iterator it = cardlistmap.begin();
+    for (; it != cardlistmap.end(); ++it)
+        cardindexmap[it.key()].Build(*it);
 }
 
 void Scheduler::ClearListMaps(void)
 {
     cardlistmap.clear();
+    cardindexmap.clear();
     titlelistmap.clear();
     recordidlistmap.clear();
     cache_is_same_program.clear();
 }
 
+static uint group_find(vector<uint> &parent, uint i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+static void group_join(vector<uint> &parent, uint a, uint b)
+{
+    a = group_find(parent, a);
+    b = group_find(parent, b);
+    if (a != b)
+        parent[std::max(a, b)] = std::min(a, b);
+}
+
+class comp_group_start
+{
+  public:
+    comp_group_start(const RecList &list) : m_list(list) {}
+    bool operator()(uint a, uint b) const
+    {
+        return (m_list[a]->GetRecordingStartTime() <
+                m_list[b]->GetRecordingStartTime());
+    }
+  private:
+    const RecList &m_list;
+};
+
+/// Everything SchedNewRecords() looks at when placing a showing.
+static QString placement_signature(const RecordingInfo *p,
+                                   const QDateTime &pendingTime)
+{
+    return (QStringList()
+        << QString::number(p->GetRecordingRuleID())
+        << QString::number(p->GetParentRecordingRuleID())
+        << QString::number(p->GetFindID())
+        << QString::number(p->GetRecordingRuleType())
+        << QString::number(p->GetChanID())
+        << p->GetChannelSchedulingID()
+        << p->GetScheduledStartTime().toString(Qt::ISODate)
+        << p->GetRecordingStartTime().toString(Qt::ISODate)
+        << p->GetRecordingEndTime().toString(Qt::ISODate)
+        << QString::number(p->GetCardID())
+        << QString::number(p->GetInputID())
+        << QString::number(p->GetSourceID())
+        << QString::number(p->GetRecordingPriority())
+        << QString::number(p->GetRecordingStatus())
+        << QString::number(p->GetDuplicateCheckMethod())
+        << QString::number(p->GetRecordingStartTime() < pendingTime)
+        << p->GetTitle() << p->GetSubtitle() << p->GetDescription()
+        << p->GetProgramID() << p->GetCategoryType()).join("\t");
+}
+
+/** \fn Scheduler::ReusePlacements(void)
+ *  \brief Splits the worklist into independent conflict groups and
+ *         restores the placement of groups that have not changed since
+ *         the last run.
+ *
+ *   Two showings are in the same group if they share a title, a rule
+ *   or a parent rule, or if they overlap in time on cards that can
+ *   conflict with each other. SchedNewRecords() never lets a showing
+ *   affect one in another group, so a group whose showings are exactly
+ *   the same as last time gets the same result and is skipped. Groups
+ *   with a showing about to start are always placed again, since they
+ *   also update recPendingList and depend on schedTime.
+ */
+void Scheduler::ReusePlacements(void)
+{
+    placementGroups.clear();
+    placementReused.clear();
+
+    int openEnd = gCoreContext->GetNumSetting("SchedOpenEnd", 0);
+    if (openEnd != placementOpenEnd || schedMoveHigher != placementMoveHigher)
+    {
+        QMutexLocker locker(&placementLock);
+        placementCache.clear();
+        placementOpenEnd = openEnd;
+        placementMoveHigher = schedMoveHigher;
+    }
+
+    uint count = worklist.size();
+    vector<uint> parent(count);
+    for (uint i = 0; i < count; i++)
+        parent[i] = i;
+
+    // Showings of the same title or rule can replace each other
+    QMap<QString, uint> firstByTitle;
+    QMap<uint, uint> firstByRule;
+    for (uint i = 0; i < count; i++)
+    {
+        const RecordingInfo *p = worklist[i];
+
+        QMap<QString, uint>::const_iterator t =
+            firstByTitle.find(p->GetTitle());
+        if (t == firstByTitle.end())
+            firstByTitle[p->GetTitle()] = i;
+        else
+            group_join(parent, *t, i);
+
+        QMap<uint, uint>::const_iterator r =
+            firstByRule.find(p->GetRecordingRuleID());
+        if (r == firstByRule.end())
+            firstByRule[p->GetRecordingRuleID()] = i;
+        else
+            group_join(parent, *r, i);
+    }
+
+    for (uint i = 0; i < count; i++)
+    {
+        QMap<uint, uint>::const_iterator r =
+            firstByRule.find(worklist[i]->GetParentRecordingRuleID());
+        if (r != firstByRule.end())
+            group_join(parent, *r, i);
+    }
+
+    // Cards which share an input group can conflict with each other,
+    // a showing without a card conflicts with everything
+    QMap<uint, QSet<uint> > cardInputs;
+    bool cardless = false;
+    for (uint i = 0; i < count; i++)
+    {
+        if (worklist[i]->GetCardID())
+            cardInputs[worklist[i]->GetCardID()]
+                .insert(worklist[i]->GetInputID());
+        else
+            cardless = true;
+    }
+
+    QList<uint> cards = cardInputs.keys();
+    vector<uint> cardparent(cards.size());
+    for (uint a = 0; a < cardparent.size(); a++)
+        cardparent[a] = a;
+
+    for (uint a = 0; a < cardparent.size(); a++)
+    {
+        for (uint b = a + 1; b < cardparent.size(); b++)
+        {
+            bool shared = cardless;
+            QSet<uint>::const_iterator ia = cardInputs[cards[a]].begin();
+            for (; !shared && ia != cardInputs[cards[a]].end(); ++ia)
+            {
+                QSet<uint>::const_iterator ib = cardInputs[cards[b]].begin();
+                for (; !shared && ib != cardInputs[cards[b]].end(); ++ib)
+                    shared = igrp.GetSharedInputGroup(*ia, *ib);
+            }
+            if (shared)
+                group_join(cardparent, a, b);
+        }
+    }
+
+    QMap<uint, vector<uint> > domains;
+    for (uint i = 0; i < count; i++)
+    {
+        uint domain = 0;
+        if (!cardless)
+            domain = group_find(cardparent,
+                                cards.indexOf(worklist[i]->GetCardID()));
+        domains[domain].push_back(i);
+    }
+
+    QMap<uint, vector<uint> >::iterator dit = domains.begin();
+    for (; dit != domains.end(); ++dit)
+    {
+        vector<uint> &order = *dit;
+        stable_sort(order.begin(), order.end(), comp_group_start(worklist));
+
+        QDateTime lastEnd;
+        for (uint k = 0; k < order.size(); k++)
+        {
+            const RecordingInfo *p = worklist[order[k]];
+            if (k && p->GetRecordingStartTime() <= lastEnd)
+                group_join(parent, order[k - 1], order[k]);
+            if (!k || p->GetRecordingEndTime() > lastEnd)
+                lastEnd = p->GetRecordingEndTime();
+        }
+    }
+
+    // Fingerprint each group and restore the unchanged ones
+    QDateTime pendingTime = schedTime.addSecs(90);
+    QMap<uint, QList<QPair<QString, RecordingInfo*> > > groups;
+    for (uint i = 0; i < count; i++)
+    {
+        groups[group_find(parent, i)].push_back(
+            qMakePair(placement_signature(worklist[i], pendingTime),
+                      worklist[i]));
+    }
+
+    uint reusedGroups = 0;
+    QMap<uint, QList<QPair<QString, RecordingInfo*> > >::iterator git;
+    for (git = groups.begin(); git != groups.end(); ++git)
+    {
+        QList<QPair<QString, RecordingInfo*> > &members = *git;
+        qSort(members);
+
+        QCryptographicHash hash(QCryptographicHash::Md5);
+        bool pending = false;
+        RecList items;
+        for (int j = 0; j < members.size(); j++)
+        {
+            hash.addData(members[j].first.toUtf8());
+            hash.addData("\n", 1);
+            items.push_back(members[j].second);
+            pending |= (members[j].second->GetRecordingStartTime() <
+                        pendingTime);
+        }
+
+        QByteArray key = pending ? QByteArray() : hash.result();
+        placementGroups.push_back(PlacementGroup(key, items));
+
+        if (key.isEmpty())
+            continue;
+
+        PlacementCache::const_iterator it = placementCache.find(key);
+        if (it == placementCache.end() || (*it).size() != (int)items.size())
+            continue;
+
+        for (uint j = 0; j < items.size(); j++)
+        {
+            items[j]->SetRecordingStatus((*it)[j]);
+            placementReused.insert(items[j]);
+        }
+        reusedGroups++;
+    }
+
+    VERBOSE(VB_SCHEDULE, QString("Reusing placement of %1 of %2 conflict "
+                                 "groups (%3 of %4 showings)")
+            .arg(reusedGroups).arg(placementGroups.size())
+            .arg(placementReused.size()).arg(count));
+}
+
+/** \fn Scheduler::SavePlacements(void)
+ *  \brief Remembers the placement of each conflict group built by
+ *         ReusePlacements() for the next run.
+ */
+void Scheduler::SavePlacements(void)
+{
+    PlacementCache cache;
+
+    QList<PlacementGroup>::const_iterator it = placementGroups.begin();
+    for (; it != placementGroups.end(); ++it)
+    {
+        if ((*it).first.isEmpty())
+            continue;
+
+        QList<RecStatusType> &statuses = cache[(*it).first];
+        RecConstIter i = (*it).second.begin();
+        for (; i != (*it).second.end(); ++i)
+            statuses.push_back((*i)->GetRecordingStatus());
+    }
+
+    {
+        QMutexLocker locker(&placementLock);
+        placementCache = cache;
+    }
+    placementGroups.clear();
+    placementReused.clear();
+}
+
+/** \fn Scheduler::GetPlacementCache(int&,bool&) const
+ *  \brief Returns a snapshot of the placements saved by the last run,
+ *         and the settings they were computed with.
+ *
+ *   This may be called from any thread, the copy is implicitly shared
+ *   so it is cheap to take while the scheduler thread is placing.
+ */
+Scheduler::PlacementCache Scheduler::GetPlacementCache(
+    int &openEnd, bool &moveHigher) const
+{
+    QMutexLocker locker(&placementLock);
+    openEnd = placementOpenEnd;
+    moveHigher = placementMoveHigher;
+    return placementCache;
+}
+
+/** \fn Scheduler::SaveCandidates(void)
+ *  \brief Keeps a copy of the showings found by AddNewRecords() and
+ *         AddNotListed(), so a preview need only match the rule it
+ *         changes. See AddMasterCandidates().
+ */
+void Scheduler::SaveCandidates(void)
+{
+    RecList saved;
+
+    RecConstIter it = worklist.begin();
+    for (; it != worklist.end(); ++it)
+    {
+        // Recordings in progress come from BuildWorkList()
+        if ((*it)->GetRecordingStatus() == rsRecording ||
+            (*it)->GetRecordingStatus() == rsTuning)
+            continue;
+        saved.push_back(new RecordingInfo(**it));
+    }
+
+    {
+        QMutexLocker locker(&placementLock);
+        candidates.swap(saved);
+        candidatesSaved = true;
+    }
+
+    while (!saved.empty())
+    {
+        delete saved.back();
+        saved.pop_back();
+    }
+}
+
+/** \fn Scheduler::GetCandidates(RecList&, int) const
+ *  \brief Appends a copy of the showings saved by the last run, except
+ *         those of rule \p recordid. May be called from any thread.
+ *  \return false if no run has saved its showings yet
+ */
+bool Scheduler::GetCandidates(RecList &list, int recordid) const
+{
+    QMutexLocker locker(&placementLock);
+
+    RecConstIter it = candidates.begin();
+    for (; it != candidates.end(); ++it)
+    {
+        if ((int)(*it)->GetRecordingRuleID() != recordid)
+            list.push_back(new RecordingInfo(**it));
+    }
+
+    return candidatesSaved;
+}
+
+/** \fn Scheduler::AddMasterCandidates(void)
+ *  \brief Adds the master's showings of every rule but the one being
+ *         previewed to the worklist.
+ *
+ *   Which showings a rule matches and their status before placement
+ *   depend only on that rule, so they need not be found again.
+ */
+void Scheduler::AddMasterCandidates(void)
+{
+    RecList recording;
+    RecConstIter it = worklist.begin();
+    for (; it != worklist.end(); ++it)
+    {
+        if ((*it)->GetRecordingStatus() == rsRecording ||
+            (*it)->GetRecordingStatus() == rsTuning)
+            recording.push_back(*it);
+    }
+
+    RecList list;
+    if (!masterSched->GetCandidates(list, previewRecordID))
+    {
+        VERBOSE(VB_IMPORTANT, LOC_WARN + "The scheduler has not run yet, "
+                "the preview only shows the rule being edited");
+    }
+
+    RecIter i = list.begin();
+    for (; i != list.end(); ++i)
+    {
+        // Same check as AddNewRecords(), against recordings that may
+        // have started since the master's run.
+        RecConstIter r = recording.begin();
+        for (; r != recording.end(); ++r)
+        {
+            if ((*i)->IsSameTimeslot(**r))
+                break;
+        }
+
+        if (r != recording.end())
+            delete *i;
+        else
+            worklist.push_back(*i);
+    }
+}
+
 bool Scheduler::IsSameProgram(
     const RecordingInfo *a, const RecordingInfo *b) const
 {
@@ -890,94 +1439,109 @@ bool Scheduler::IsSameProgram(
     return cache_is_same_program[X] = a->IsSameProgram(*b);
 }
 
-bool Scheduler::FindNextConflict(
-    const RecList     &cardlist,
+/** \fn Scheduler::IsConflict(const RecordingInfo*,const RecordingInfo*,int) const
+ *  \brief Returns true if q is recording and would conflict with p.
+ */
+bool Scheduler::IsConflict(
     const RecordingInfo *p,
-    RecConstIter      &j,
-    int               openEnd) const
+    const RecordingInfo *q,
+    int                 openEnd) const
 {
     bool is_conflict_dbg = false;
 
-    for ( ; j != cardlist.end(); ++j)
-    {
-        const RecordingInfo *q = *j;
+    if (p == q)
+        return false;
 
-        if (p == q)
-            continue;
+    if (!Recording(q))
+        return false;
 
-        if (!Recording(q))
-            continue;
+    if (is_conflict_dbg)
+        cout << QString("\n  comparing with '%1' ").arg(q->GetTitle())
+            .toLocal8Bit().constData();
 
+    if (p->GetCardID() != 0 && (p->GetCardID() != q->GetCardID()) &&
+        !igrp.GetSharedInputGroup(p->GetInputID(), q->GetInputID()))
+    {
         if (is_conflict_dbg)
-            cout << QString("\n  comparing with '%1' ").arg(q->GetTitle())
-                .toLocal8Bit().constData();
+            cout << "  cardid== ";
+        return false;
+    }
 
-        if (p->GetCardID() != 0 && (p->GetCardID() != q->GetCardID()) &&
-            !igrp.GetSharedInputGroup(p->GetInputID(), q->GetInputID()))
+    if (openEnd == 2 || (openEnd == 1 && p->GetChanID() != q->GetChanID()))
+    {
+        if (p->GetRecordingEndTime() < q->GetRecordingStartTime() ||
+            p->GetRecordingStartTime() > q->GetRecordingEndTime())
         {
             if (is_conflict_dbg)
-                cout << "  cardid== ";
-            continue;
-        }
-
-        if (openEnd == 2 || (openEnd == 1 && p->GetChanID() != q->GetChanID()))
-        {
-            if (p->GetRecordingEndTime() < q->GetRecordingStartTime() ||
-                p->GetRecordingStartTime() > q->GetRecordingEndTime())
-            {
-                if (is_conflict_dbg)
-                    cout << "  no-overlap ";
-                continue;
-            }
-        }
-        else
-        {
-            if (p->GetRecordingEndTime() <= q->GetRecordingStartTime() ||
-                p->GetRecordingStartTime() >= q->GetRecordingEndTime())
-            {
-                if (is_conflict_dbg)
-                    cout << "  no-overlap ";
-                continue;
-            }
+                cout << "  no-overlap ";
+            return false;
         }
-
-        if (is_conflict_dbg)
-            cout << "\n" <<
-                (QString("  cardid's: %1, %2 ")
-                 .arg(p->GetCardID()).arg(q->GetCardID()) +
-                 QString("Shared input group: %1 ")
-                 .arg(igrp.GetSharedInputGroup(
-                          p->GetInputID(), q->GetInputID())) +
-                 QString("mplexid's: %1, %2")
-                 .arg(p->QueryMplexID()).arg(q->QueryMplexID()))
-                .toLocal8Bit().constData();
-
-        // if two inputs are in the same input group we have a conflict
-        // unless the programs are on the same multiplex.
-        if (p->GetCardID() && (p->GetCardID() != q->GetCardID()) &&
-            igrp.GetSharedInputGroup(p->GetInputID(), q->GetInputID()))
+    }
+    else
+    {
+        if (p->GetRecordingEndTime() <= q->GetRecordingStartTime() ||
+            p->GetRecordingStartTime() >= q->GetRecordingEndTime())
         {
-            uint p_mplexid = p->QueryMplexID();
-            if (p_mplexid && (p_mplexid == q->QueryMplexID()))
-                continue;
+            if (is_conflict_dbg)
+                cout << "  no-overlap ";
+            return false;
         }
+    }
 
-        if (is_conflict_dbg)
-            cout << "\n  Found conflict" << endl;
-
-        return true;
+    if (is_conflict_dbg)
+        cout << "\n" <<
+            (QString("  cardid's: %1, %2 ")
+             .arg(p->GetCardID()).arg(q->GetCardID()) +
+             QString("Shared input group: %1 ")
+             .arg(igrp.GetSharedInputGroup(
+                      p->GetInputID(), q->GetInputID())) +
+             QString("mplexid's: %1, %2")
+             .arg(p->QueryMplexID()).arg(q->QueryMplexID()))
+            .toLocal8Bit().constData();
+
+    // if two inputs are in the same input group we have a conflict
+    // unless the programs are on the same multiplex.
+    if (p->GetCardID() && (p->GetCardID() != q->GetCardID()) &&
+        igrp.GetSharedInputGroup(p->GetInputID(), q->GetInputID()))
+    {
+        uint p_mplexid = p->QueryMplexID();
+        if (p_mplexid && (p_mplexid == q->QueryMplexID()))
+            return false;
     }
 
     if (is_conflict_dbg)
-        cout << "\n  No conflict" << endl;
+        cout << "\n  Found conflict" << endl;
+
+    return true;
+}
+
+bool Scheduler::FindNextConflict(
+    const RecList     &cardlist,
+    const RecordingInfo *p,
+    RecConstIter      &j,
+    int               openEnd) const
+{
+    for ( ; j != cardlist.end(); ++j)
+    {
+        if (IsConflict(p, *j, openEnd))
+            return true;
+    }
 
     return false;
 }
 
+/** \fn Scheduler::FindConflict(const QMap<int, RecList>&,const RecordingInfo*,int,bool) const
+ *  \brief Returns the first showing in reclists that conflicts with p.
+ *
+ *   If use_index is true reclists must be cardlistmap, and the per card
+ *   interval indexes built by BuildListMaps() are used to only look at
+ *   the overlapping showings.
+ */
 const RecordingInfo *Scheduler::FindConflict(
     const QMap<int, RecList> &reclists,
     const RecordingInfo        *p,
-    int openend) const
+    int openend,
+    bool use_index) const
 {
     bool is_conflict_dbg = false;
 
@@ -991,6 +1555,22 @@ const RecordingInfo *Scheduler::FindConflict(
         }
 
         const RecList &cardlist = *it;
+
+        QMap<int, RecOverlapIndex>::const_iterator idx =
+            cardindexmap.find(it.key());
+        if (use_index && idx != cardindexmap.end())
+        {
+            vector<uint> hits;
+            (*idx).Find(p->GetRecordingStartTime(),
+                        p->GetRecordingEndTime(), hits);
+            for (uint i = 0; i < hits.size(); i++)
+            {
+                if (IsConflict(p, cardlist[hits[i]], openend))
+                    return cardlist[hits[i]];
+            }
+            continue;
+        }
+
         RecConstIter k = cardlist.begin();
         if (FindNextConflict(cardlist, p, k, openend))
         {
@@ -1001,6 +1581,36 @@ const RecordingInfo *Scheduler::FindConflict(
     return NULL;
 }
 
+/** \fn Scheduler::FindOverlapping(const RecordingInfo*,RecList&) const
+ *  \brief Collects the showings of cardlistmap which overlap p in time,
+ *         in cardlistmap order, for use with FindNextConflict().
+ */
+void Scheduler::FindOverlapping(
+    const RecordingInfo *p, RecList &overlapping) const
+{
+    QMap<int, RecList>::const_iterator it = cardlistmap.begin();
+    for (; it != cardlistmap.end(); ++it)
+    {
+        const RecList &cardlist = *it;
+
+        QMap<int, RecOverlapIndex>::const_iterator idx =
+            cardindexmap.find(it.key());
+        if (idx == cardindexmap.end())
+        {
+            RecConstIter k = cardlist.begin();
+            for (; k != cardlist.end(); ++k)
+                overlapping.push_back(*k);
+            continue;
+        }
+
+        vector<uint> hits;
+        (*idx).Find(p->GetRecordingStartTime(),
+                    p->GetRecordingEndTime(), hits);
+        for (uint i = 0; i < hits.size(); i++)
+            overlapping.push_back(cardlist[hits[i]]);
+    }
+}
+
 void Scheduler::MarkOtherShowings(RecordingInfo *p)
 {
     RecList *showinglist = &titlelistmap[p->GetTitle()];
@@ -1149,7 +1759,7 @@ bool Scheduler::TryAnotherShowing(RecordingInfo *p, bool samePriority,
             }
         }
 
-        const RecordingInfo *conflict = FindConflict(cardlistmap, q);
+        const RecordingInfo *conflict = FindConflict(cardlistmap, q, 0, true);
         if (conflict)
         {
             PrintRec(conflict, "        !");
@@ -1222,12 +1832,17 @@ void Scheduler::SchedNewRecords(void)
     while (i != worklist.end())
     {
         RecordingInfo *p = *i;
-        if (p->GetRecordingStatus() == rsRecording ||
-            p->GetRecordingStatus() == rsTuning)
+        if (placementReused.contains(p))
+        {
+            // already placed by ReusePlacements()
+        }
+        else if (p->GetRecordingStatus() == rsRecording ||
+                 p->GetRecordingStatus() == rsTuning)
             MarkOtherShowings(p);
         else if (p->GetRecordingStatus() == rsUnknown)
         {
-            const RecordingInfo *conflict = FindConflict(cardlistmap, p, openEnd);
+            const RecordingInfo *conflict =
+                FindConflict(cardlistmap, p, openEnd, true);
             if (!conflict)
             {
                 p->SetRecordingStatus(rsWillRecord);
@@ -1279,13 +1894,7 @@ void Scheduler::MoveHigherRecords(bool move_this)
         MarkOtherShowings(p);
 
         RecList cardlist;
-        QMap<int, RecList>::const_iterator it = cardlistmap.begin();
-        for (; it != cardlistmap.end(); ++it)
-        {
-            RecConstIter it2 = (*it).begin();
-            for (; it2 != (*it).end(); ++it2)
-                cardlist.push_back(*it2);
-        }
+        FindOverlapping(p, cardlist);
         RecConstIter k = cardlist.begin();
         for ( ; FindNextConflict(cardlist, p, k ); ++k)
         {
@@ -1319,13 +1928,7 @@ void Scheduler::MoveHigherRecords(bool move_this)
             MarkOtherShowings(p);
 
         RecList cardlist;
-        QMap<int, RecList>::const_iterator it = cardlistmap.begin();
-        for (; it != cardlistmap.end(); ++it)
-        {
-            RecConstIter it2 = (*it).begin();
-            for (; it2 != (*it).end(); ++it2)
-                cardlist.push_back(*it2);
-        }
+        FindOverlapping(p, cardlist);
 
         RecConstIter k = cardlist.begin();
         for ( ; FindNextConflict(cardlist, p, k); ++k)
@@ -1497,11 +2100,21 @@ void Scheduler::getConflicting(RecordingInfo *pginfo, RecList *retlist)
 {
     QMutexLocker lockit(&schedLock);
 
-    RecConstIter i = reclist.begin();
-    for (; FindNextConflict(reclist, pginfo, i); ++i)
+    if (reclistIndexDirty)
     {
-        const RecordingInfo *p = *i;
-        retlist->push_back(new RecordingInfo(*p));
+        reclistIndex.Build(reclist);
+        reclistIndexDirty = false;
+    }
+
+    vector<uint> hits;
+    reclistIndex.Find(pginfo->GetRecordingStartTime(),
+                      pginfo->GetRecordingEndTime(), hits);
+
+    for (uint i = 0; i < hits.size(); i++)
+    {
+        const RecordingInfo *p = reclist[hits[i]];
+        if (IsConflict(pginfo, p))
+            retlist->push_back(new RecordingInfo(*p));
     }
 }
 
@@ -1631,6 +2244,7 @@ void Scheduler::AddRecording(const RecordingInfo &pi)
     RecordingInfo * new_pi = new RecordingInfo(pi);
     reclist.push_back(new_pi);
     reclist_changed = true;
+    reclistIndexDirty = true;
 
     // Save rsRecording recstatus to DB
     // This allows recordings to resume on backend restart
@@ -2132,6 +2746,7 @@ void Scheduler::RunScheduler(void)
             recstartts.setTime
                 (QTime(recstartts.time().hour(), recstartts.time().minute()));
             nextRecording->SetRecordingStartTime(recstartts);
+            reclistIndexDirty = true;
 
             details = QString("%1: channel %2 on cardid %3, sourceid %4")
                       .arg(nextRecording->toString(ProgramInfo::kTitleSubtitle))
@@ -2795,9 +3410,15 @@ void Scheduler::UpdateManuals(int recordid)
     }
 }
 
+/** \fn Scheduler::BuildNewRecordsQueries(int,QStringList&,QStringList&,MSqlBindings&,bool)
+ *  \brief Builds the FROM and WHERE clauses used to fill recordmatch.
+ *  \param skipInMemory if true, skip the rules RecordMatcher has already
+ *                      matched and only build clauses for the rest
+ */
 void Scheduler::BuildNewRecordsQueries(int recordid, QStringList &from,
                                        QStringList &where,
-                                       MSqlBindings &bindings)
+                                       MSqlBindings &bindings,
+                                       bool skipInMemory)
 {
     MSqlQuery result(dbConn);
     QString query;
@@ -2824,6 +3445,9 @@ void Scheduler::BuildNewRecordsQueries(int recordid, QStringList &from,
 
         RecSearchType searchtype = RecSearchType(result.value(1).toInt());
 
+        if (skipInMemory && RecordMatcher::CanMatch(searchtype, qphrase))
+            continue;
+
         if (qphrase.isEmpty() && searchtype != kManualSearch)
         {
             VERBOSE(VB_IMPORTANT, QString("Invalid search key in recordid %1")
@@ -2895,7 +3519,7 @@ void Scheduler::BuildNewRecordsQueries(int recordid, QStringList &from,
         count++;
     }
 
-    if (recordid == -1 || from.count() == 0)
+    if (!skipInMemory && (recordid == -1 || from.count() == 0))
     {
         QString recidmatch = "";
         if (recordid != -1)
@@ -2976,11 +3600,76 @@ void Scheduler::UpdateMatches(int recordid) {
             MythDB::DBError("UpdateMatches", query);
     }
 
+    bool inmemory = gCoreContext->GetNumSetting("SchedInMemoryMatch", 1);
+    double memtime = 0.0, sqltime = 0.0;
+    uint memrules = 0;
+
+    if (inmemory)
+    {
+        VERBOSE(VB_SCHEDULE, " |-- Start in-memory match...");
+
+        gettimeofday(&dbstart, NULL);
+        RecordMatcher matcher(dbConn, recordTable);
+        bool ok = matcher.LoadRules(recordid);
+
+        const vector<int> &manuals = matcher.GetManualRules();
+        for (uint i = 0; ok && i < manuals.size(); i++)
+            UpdateManuals(manuals[i]);
+
+        ok = ok && matcher.LoadPrograms();
+        gettimeofday(&dbend, NULL);
+        double loadtime = ((dbend.tv_sec  - dbstart.tv_sec) * 1000000 +
+                           (dbend.tv_usec - dbstart.tv_usec)) / 1000000.0;
+
+        if (ok)
+            matcher.Match();
+        ok = ok && matcher.StoreMatches();
+
+        gettimeofday(&dbend, NULL);
+        memtime = ((dbend.tv_sec  - dbstart.tv_sec) * 1000000 +
+                   (dbend.tv_usec - dbstart.tv_usec)) / 1000000.0;
+        memrules = matcher.GetRuleCount();
+
+        if (ok)
+        {
+            VERBOSE(VB_SCHEDULE, QString(" |-- %1 rules against %2 programs, "
+                                         "%3 results in %4 sec (%5 loading)")
+                    .arg(matcher.GetRuleCount())
+                    .arg(matcher.GetProgramCount())
+                    .arg(matcher.GetMatchCount())
+                    .arg(memtime).arg(loadtime));
+        }
+        else
+        {
+            VERBOSE(VB_IMPORTANT, LOC_WARN + "In-memory match failed, "
+                    "falling back to SQL for all rules");
+
+            // Discard any rows stored before the failure.
+            if (recordid == -1)
+                query.prepare("DELETE FROM recordmatch");
+            else
+            {
+                query.prepare("DELETE FROM recordmatch "
+                              "WHERE recordid = :RECORDID");
+                query.bindValue(":RECORDID", recordid);
+            }
+            if (!query.exec())
+            {
+                MythDB::DBError("UpdateMatches", query);
+                return;
+            }
+
+            inmemory = false;
+            memrules = 0;
+        }
+    }
+
     int clause;
     QStringList fromclauses, whereclauses;
     MSqlBindings bindings;
 
-    BuildNewRecordsQueries(recordid, fromclauses, whereclauses, bindings);
+    BuildNewRecordsQueries(recordid, fromclauses, whereclauses, bindings,
+                           inmemory);
 
     if (VERBOSE_LEVEL_CHECK(VB_SCHEDULE))
     {
@@ -3067,6 +3756,10 @@ void Scheduler::UpdateMatches(int recordid) {
         bool ok = result.exec();
         gettimeofday(&dbend, NULL);
 
+        double elapsed = ((dbend.tv_sec  - dbstart.tv_sec) * 1000000 +
+                          (dbend.tv_usec - dbstart.tv_usec)) / 1000000.0;
+        sqltime += elapsed;
+
         if (!ok)
         {
             MythDB::DBError("UpdateMatches3", result);
@@ -3074,13 +3767,14 @@ void Scheduler::UpdateMatches(int recordid) {
         }
 
         VERBOSE(VB_SCHEDULE, QString(" |-- %1 results in %2 sec.")
-                .arg(result.size())
-                .arg(((dbend.tv_sec  - dbstart.tv_sec) * 1000000 +
-                      (dbend.tv_usec - dbstart.tv_usec)) / 1000000.0));
+                .arg(result.size()).arg(elapsed));
 
     }
 
-    VERBOSE(VB_SCHEDULE, " +-- Done.");
+    VERBOSE(VB_SCHEDULE, QString(" +-- Done. In-memory: %1 rules in %2 sec, "
+                                 "SQL: %3 queries in %4 sec.")
+            .arg(memrules).arg(memtime)
+            .arg(fromclauses.count()).arg(sqltime));
 }
 
 void Scheduler::AddNewRecords(void)
@@ -3196,10 +3890,14 @@ void Scheduler::AddNewRecords(void)
         "(FIND_IN_SET('VISUALIMPAIR', program.audioprop) > 0) * %1").arg(adpriority);
 
     QString schedTmpRecord = recordTable;
+    QString schedTmpRecorded = "recorded";
 
     MSqlQuery result(dbConn);
 
-    if (schedTmpRecord == "record")
+    // The live scheduler copies record and recorded so that its long
+    // queries don't hold them locked from the frontends. A preview
+    // reads them as they are, it looks at few matches.
+    if (!specsched && schedTmpRecord == "record")
     {
         schedTmpRecord = "sched_temp_record";
 
@@ -3231,29 +3929,34 @@ void Scheduler::AddNewRecords(void)
         }
     }
 
-    result.prepare("DROP TABLE IF EXISTS sched_temp_recorded;");
-
-    if (!result.exec())
+    if (!specsched)
     {
-        MythDB::DBError("Dropping sched_temp_recorded table", result);
-        return;
-    }
+        schedTmpRecorded = "sched_temp_recorded";
 
-    result.prepare("CREATE TEMPORARY TABLE sched_temp_recorded "
-                       "LIKE recorded;");
+        result.prepare("DROP TABLE IF EXISTS sched_temp_recorded;");
 
-    if (!result.exec())
-    {
-        MythDB::DBError("Creating sched_temp_recorded table", result);
-        return;
-    }
+        if (!result.exec())
+        {
+            MythDB::DBError("Dropping sched_temp_recorded table", result);
+            return;
+        }
 
-    result.prepare("INSERT sched_temp_recorded SELECT * from recorded;");
+        result.prepare("CREATE TEMPORARY TABLE sched_temp_recorded "
+                           "LIKE recorded;");
 
-    if (!result.exec())
-    {
-        MythDB::DBError("Populating sched_temp_recorded table", result);
-        return;
+        if (!result.exec())
+        {
+            MythDB::DBError("Creating sched_temp_recorded table", result);
+            return;
+        }
+
+        result.prepare("INSERT sched_temp_recorded SELECT * from recorded;");
+
+        if (!result.exec())
+        {
+            MythDB::DBError("Populating sched_temp_recorded table", result);
+            return;
+        }
     }
 
     result.prepare(QString("SELECT recpriority, selectclause FROM %1;")
@@ -3335,7 +4038,7 @@ void Scheduler::AddNewRecords(void)
 "      ) "
 "     ) "
 "  ) "
-" LEFT JOIN sched_temp_recorded recorded ON "
+" LEFT JOIN RECORDEDTABLE recorded ON "
 "  ( "
 "    RECTABLE.dupmethod > 1 AND "
 "    recorded.duplicate <> 0 AND "
@@ -3377,6 +4080,7 @@ void Scheduler::AddNewRecords(void)
 " WHERE program.endtime >= NOW() - INTERVAL 1 DAY "
 );
     rmquery.replace("RECTABLE", schedTmpRecord);
+    rmquery.replace("RECORDEDTABLE", schedTmpRecorded);
 
     pwrpri.replace("program.","p.");
     pwrpri.replace("channel.","c.");
@@ -3426,15 +4130,27 @@ void Scheduler::AddNewRecords(void)
 
     VERBOSE(VB_SCHEDULE, QString(" |-- Start DB Query..."));
 
+    // A preview with no rule changed reads the master's recordmatch,
+    // whose duplicate columns its last run has already filled in.
+    bool liveMatches = specsched && previewRecordID == 0;
+
     gettimeofday(&dbstart, NULL);
-    result.prepare(rmquery);
-    if (!result.exec())
+    if (!liveMatches)
     {
-        MythDB::DBError("AddNewRecords recordmatch", result);
-        return;
+        result.prepare(rmquery);
+        if (!result.exec())
+        {
+            MythDB::DBError("AddNewRecords recordmatch", result);
+            return;
+        }
     }
     result.prepare(query);
-    if (!result.exec())
+    if (liveMatches)
+        masterSched->recordmatchLock.lock();
+    bool ok = result.exec();
+    if (liveMatches)
+        masterSched->recordmatchLock.unlock();
+    if (!ok)
     {
         MythDB::DBError("AddNewRecords", result);
         return;
@@ -3607,9 +4323,12 @@ void Scheduler::AddNewRecords(void)
             MythDB::DBError("AddNewRecords sched_temp_record", query);
     }
 
-    result.prepare("DROP TABLE IF EXISTS sched_temp_recorded;");
-    if (!result.exec())
-        MythDB::DBError("AddNewRecords drop table", query);
+    if (schedTmpRecorded == "sched_temp_recorded")
+    {
+        result.prepare("DROP TABLE IF EXISTS sched_temp_recorded;");
+        if (!result.exec())
+            MythDB::DBError("AddNewRecords drop table", query);
+    }
 }
 
 void Scheduler::AddNotListed(void) {
@@ -3642,14 +4361,24 @@ void Scheduler::AddNotListed(void) {
         .arg(kWeekslotRecord)
         .arg(kOverrideRecord);
 
+    // The other rules' showings come from AddMasterCandidates()
+    if (specsched && previewRecordID > 0)
+        query += QString(" AND RECTABLE.recordid = %1").arg(previewRecordID);
+
     query.replace("RECTABLE", recordTable);
 
     VERBOSE(VB_SCHEDULE, QString(" |-- Start DB Query..."));
 
+    bool liveMatches = specsched && previewRecordID == 0;
+
     gettimeofday(&dbstart, NULL);
     MSqlQuery result(dbConn);
     result.prepare(query);
+    if (liveMatches)
+        masterSched->recordmatchLock.lock();
     bool ok = result.exec();
+    if (liveMatches)
+        masterSched->recordmatchLock.unlock();
     gettimeofday(&dbend, NULL);
 
     if (!ok)
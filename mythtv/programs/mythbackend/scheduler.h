@@ -14,6 +14,10 @@ using namespace std;
 #include <QObject>
 #include <QString>
 #include <QMutex>
+#include <QTime>
+#include <QList>
+#include <QPair>
+#include <QSet>
 #include <QMap>
 
 // MythTV headers
@@ -33,6 +37,34 @@ typedef deque<RecordingInfo*> RecList;
 typedef RecList::const_iterator RecConstIter;
 typedef RecList::iterator RecIter;
 
+/** \class RecOverlapIndex
+ *  \brief Interval index over a RecList, used to find the entries whose
+ *         recording times overlap a given range without scanning the
+ *         whole list.
+ *
+ *   The index only depends on the recording start and end times, it must
+ *   be rebuilt when the list or those times change.
+ */
+class RecOverlapIndex
+{
+  public:
+    void Build(const RecList &list);
+    void Clear(void);
+    bool IsEmpty(void) const { return m_order.empty(); }
+
+    void Find(const QDateTime &start, const QDateTime &end,
+              vector<uint> &positions) const;
+
+  private:
+    void Collect(uint node, uint lo, uint hi, uint limit, uint start,
+                 vector<uint> &positions) const;
+
+    vector<uint> m_order;   ///< list positions sorted by start time
+    vector<uint> m_start;   ///< start time of each entry of m_order
+    vector<uint> m_end;     ///< end time of each entry of m_order
+    vector<uint> m_maxEnd;  ///< latest end time per segment tree node
+};
+
 class Scheduler : public QObject
 {
     Q_OBJECT
@@ -84,11 +116,16 @@ class Scheduler : public QObject
 
     int GetError(void) const { return error; }
 
+    QString GetPhaseTimes(void) const;
+
   protected:
     void RunScheduler(void);
     static void *SchedulerThread(void *param);
 
   private:
+    typedef QMap<QByteArray, QList<RecStatusType> > PlacementCache;
+    typedef QPair<QByteArray, RecList> PlacementGroup;
+
     QString recordTable;
     QString priorityTable;
 
@@ -102,20 +139,32 @@ class Scheduler : public QObject
     void AddNewRecords(void);
     void AddNotListed(void);
     void BuildNewRecordsQueries(int recordid, QStringList &from, QStringList &where,
-                                MSqlBindings &bindings);
+                                MSqlBindings &bindings,
+                                bool skipInMemory = false);
     void PruneOverlaps(void);
     void BuildListMaps(void);
     void ClearListMaps(void);
+    void ReusePlacements(void);
+    void SavePlacements(void);
+    void AddPhaseTime(const QString &phase, QTime &timer);
+    PlacementCache GetPlacementCache(int &openEnd, bool &moveHigher) const;
+    void SaveCandidates(void);
+    bool GetCandidates(RecList &list, int recordid) const;
+    void AddMasterCandidates(void);
 
     bool IsBusyRecording(const RecordingInfo *rcinfo);
 
     bool IsSameProgram(const RecordingInfo *a, const RecordingInfo *b) const;
 
+    bool IsConflict(const RecordingInfo *p, const RecordingInfo *q,
+                    int openEnd = 0) const;
     bool FindNextConflict(const RecList &cardlist,
                           const RecordingInfo *p, RecConstIter &iter,
                           int openEnd = 0) const;
+    void FindOverlapping(const RecordingInfo *p, RecList &overlapping) const;
     const RecordingInfo *FindConflict(const QMap<int, RecList> &reclists,
-                                    const RecordingInfo *p, int openEnd = 0) const;
+                                    const RecordingInfo *p, int openEnd = 0,
+                                    bool use_index = false) const;
     void MarkOtherShowings(RecordingInfo *p);
     void MarkShowingsList(RecList &showinglist, RecordingInfo *p);
     void BackupRecStatus(void);
@@ -156,6 +205,9 @@ class Scheduler : public QObject
     RecList worklist;
     RecList retrylist;
     QMap<int, RecList> cardlistmap;
+    QMap<int, RecOverlapIndex> cardindexmap;
+    RecOverlapIndex reclistIndex;
+    bool reclistIndexDirty;
     QMap<int, RecList> recordidlistmap;
     QMap<QString, RecList> titlelistmap;
     InputGroupMap igrp;
@@ -163,6 +215,7 @@ class Scheduler : public QObject
     bool reclist_changed;
 
     bool specsched;
+    Scheduler *masterSched;
     bool schedMoveHigher;
     bool schedulingEnabled;
     QMap<int, bool> schedAfterStartMap;
@@ -198,6 +251,24 @@ class Scheduler : public QObject
     typedef pair<const RecordingInfo*,const RecordingInfo*> IsSameKey;
     typedef QMap<IsSameKey,bool> IsSameCacheType;
     mutable IsSameCacheType cache_is_same_program;
+
+    // Placement of the previous run per conflict group, so groups that
+    // did not change need not be placed again. See ReusePlacements().
+    mutable QMutex placementLock;  ///< protects placementCache, candidates
+    PlacementCache placementCache;
+    QList<PlacementGroup> placementGroups;
+    QSet<const RecordingInfo*> placementReused;
+    int placementOpenEnd;
+    bool placementMoveHigher;
+
+    // Showings found by the last run before placement, see SaveCandidates()
+    RecList candidates;
+    bool candidatesSaved;
+    // Rule changed by the preview of FillRecordListFromDB()
+    int previewRecordID;
+
+    // Time spent in each phase of the last FillRecordList()
+    QList<QPair<QString, int> > phaseTimes;
 };
 
 #endif
@@ -0,0 +1,48 @@
+/*
+ * AudioAnalyzer
+ *
+ * Provide a generic interface for plugging in audio analysis algorithms.
+ */
+
+#ifndef __AUDIOANALYZER_H__
+#define __AUDIOANALYZER_H__
+
+/* Base class for commercial flagging audio analyzers. */
+
+#include "FrameAnalyzer.h"
+
+class AudioAnalyzer
+{
+public:
+    virtual ~AudioAnalyzer(void) { }
+
+    virtual const char *name(void) const = 0;
+
+    virtual enum FrameAnalyzer::analyzeFrameResult MythPlayerInited(
+            MythPlayer *player, long long nframes) {
+        (void)player;
+        (void)nframes;
+        return FrameAnalyzer::ANALYZE_OK;
+    };
+
+    /*
+     * Analyze audio played during video frame "frameno" (0-based): "nsamples"
+     * mono samples scaled to [-1.0, 1.0]. The audio of a frame may be handed
+     * over in several calls. Called on the player's decoder thread.
+     */
+    virtual enum FrameAnalyzer::analyzeFrameResult analyzeAudio(
+            const float *samples, int nsamples, long long frameno) = 0;
+
+    virtual int finished(long long nframes, bool final) {
+        (void)nframes;
+        (void)final;
+        return 0;
+    }
+    virtual int reportTime(void) const { return 0; }
+
+    virtual FrameAnalyzer::FrameMap GetMap(unsigned int) const = 0;
+};
+
+#endif  /* !__AUDIOANALYZER_H__ */
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -4,7 +4,6 @@
 
 // MythTV headers
 #include "mythcorecontext.h"    /* gContext */
-#include "decodeencode.h"           /* for absLongLong */
 #include "mythplayer.h"
 
 // Commercial Flagging headers
@@ -202,175 +201,6 @@ computeBlankMap(FrameAnalyzer::FrameMap *blankMap, long long nframes,
     }
 }
 
-void
-computeBreakMap(FrameAnalyzer::FrameMap *breakMap,
-        const FrameAnalyzer::FrameMap *blankMap, float fps, bool skipcommblanks,
-        int debugLevel)
-{
-    /*
-     * TUNABLE:
-     *
-     * Common commercial-break lengths.
-     */
-    static const struct {
-        int     len;    /* seconds */
-        int     delta;  /* seconds */
-    } breaktype[] = {
-        /* Sort by "len". */
-        { 15,   2 },
-        { 20,   2 },
-        { 30,   5 },
-        { 60,   5 },
-    };
-    static const unsigned int   nbreaktypes =
-        sizeof(breaktype)/sizeof(*breaktype);
-
-    /*
-     * TUNABLE:
-     *
-     * Shortest non-commercial length, used to coalesce consecutive commercial
-     * breaks that are usually identified due to in-commercial cuts.
-     */
-    static const int MINCONTENTLEN = (int)roundf(10 * fps);
-
-    breakMap->clear();
-    for (FrameAnalyzer::FrameMap::const_iterator iiblank = blankMap->begin();
-            iiblank != blankMap->end();
-            ++iiblank)
-    {
-        long long brkb = iiblank.key();
-        long long iilen = *iiblank;
-        long long start = brkb + iilen / 2;
-
-        for (unsigned int ii = 0; ii < nbreaktypes; ii++)
-        {
-            /* Look for next blank frame that is an acceptable distance away. */
-            FrameAnalyzer::FrameMap::const_iterator jjblank = iiblank;
-            for (++jjblank; jjblank != blankMap->end(); ++jjblank)
-            {
-                long long brke = jjblank.key();
-                long long jjlen = *jjblank;
-                long long end = brke + jjlen / 2;
-
-                long long testlen = (long long)roundf((end - start) / fps);
-                if (testlen > breaktype[ii].len + breaktype[ii].delta)
-                    break;      /* Too far ahead; break to next break length. */
-                if (absLongLong(testlen - breaktype[ii].len)
-                        > breaktype[ii].delta)
-                    continue;   /* Outside delta range; try next end-blank. */
-
-                /* Mark this commercial break. */
-                bool inserted = false;
-                for (unsigned int jj = 0;; jj++)
-                {
-                    long long newbrkb = brkb + jj;
-                    if (newbrkb >= brke)
-                    {
-                        VERBOSE(VB_COMMFLAG,
-                            QString("BF [%1,%2] ran out of slots")
-                                .arg(brkb).arg(brke - 1));
-                        break;
-                    }
-                    if (breakMap->find(newbrkb) == breakMap->end())
-                    {
-                        breakMap->insert(newbrkb, brke - newbrkb);
-                        inserted = true;
-                        break;
-                    }
-                }
-                if (inserted)
-                    break;  /* next break type */
-            }
-        }
-    }
-
-    if (debugLevel >= 1)
-    {
-        frameAnalyzerReportMap(breakMap, fps, "BF Break");
-        VERBOSE(VB_COMMFLAG, "BF coalescing overlapping/nearby breaks ...");
-    }
-
-    /*
-     * Coalesce overlapping or very-nearby breaks (handles cut-scenes within a
-     * commercial).
-     */
-    for (;;)
-    {
-        bool coalesced = false;
-        FrameAnalyzer::FrameMap::iterator iibreak = breakMap->begin();
-        while (iibreak != breakMap->end())
-        {
-            long long iib = iibreak.key();
-            long long iie = iib + *iibreak;
-
-            FrameAnalyzer::FrameMap::iterator jjbreak = iibreak;
-            ++jjbreak;
-            if (jjbreak == breakMap->end())
-                break;
-
-            long long jjb = jjbreak.key();
-            long long jje = jjb + *jjbreak;
-
-            if (jjb < iib)
-            {
-                /* (jjb,jje) is behind (iib,iie). */
-                ++iibreak;
-                continue;
-            }
-
-            if (iie + MINCONTENTLEN < jjb)
-            {
-                /* (jjb,jje) is too far ahead. */
-                ++iibreak;
-                continue;
-            }
-
-            /* Coalesce. */
-            if (jje > iie)
-            {
-                breakMap->remove(iib);             /* overlap */
-                breakMap->insert(iib, jje - iib);  /* overlap */
-            }
-            breakMap->erase(jjbreak);
-            coalesced = true;
-            iibreak = breakMap->find(iib);
-        }
-        if (!coalesced)
-            break;
-    }
-
-    /* Adjust for skipcommblanks configuration. */
-    FrameAnalyzer::FrameMap::iterator iibreak = breakMap->begin();
-    while (iibreak != breakMap->end())
-    {
-        long long iib = iibreak.key();
-        long long iie = iib + *iibreak;
-
-        if (!skipcommblanks)
-        {
-            /* Trim leading blanks from commercial break. */
-            FrameAnalyzer::FrameMap::const_iterator iiblank =
-                blankMap->find(iib);
-            FrameAnalyzer::FrameMap::iterator jjbreak = iibreak;
-            ++jjbreak;
-            iib += *iiblank;
-            breakMap->erase(iibreak);
-            breakMap->insert(iib, iie - iib);
-            iibreak = jjbreak;
-        }
-        else
-        {
-            /* Add trailing blanks to commercial break. */
-            ++iibreak;
-            FrameAnalyzer::FrameMap::const_iterator jjblank =
-                blankMap->find(iie);
-            iie += *jjblank;
-            breakMap->remove(iib);
-            breakMap->insert(iib, iie - iib);
-        }
-    }
-}
-
 };  /* namespace */
 
 BlankFrameDetector::BlankFrameDetector(HistogramAnalyzer *ha, QString debugdir)
@@ -573,7 +403,8 @@ BlankFrameDetector::computeForLogoSurplus(
     /*
      * Compute breaks (breakMap).
      */
-    computeBreakMap(&breakMap, &blankMap, fps, skipcommblanks, debugLevel);
+    computeBreakMap(&breakMap, &blankMap, fps, skipcommblanks, debugLevel,
+            "BF");
 
     /*
      * Expand blank-frame breaks to fully include overlapping logo breaks.
@@ -644,13 +475,62 @@ BlankFrameDetector::computeForLogoDeficit(
     return 0;
 }
 
+int
+BlankFrameDetector::computeForSilences(const FrameAnalyzer::FrameMap *silences)
+{
+    /*
+     * The blank frames between commercials usually come with silence; dark
+     * scenes within a program usually don't. Compute breaks from the blank
+     * frames accompanied by silence only, unless that finds no breaks at all
+     * (no usable audio, or a station that doesn't go silent).
+     */
+
+    /* TUNABLE: allowed audio/video skew (frames) */
+    const long long MAXSILENCESKEW = (long long)roundf(0.5 * fps);
+
+    FrameAnalyzer::FrameMap silentBlankMap;
+    FrameAnalyzer::FrameMap::const_iterator jj = silences->constBegin();
+    for (FrameAnalyzer::FrameMap::const_iterator ii = blankMap.constBegin();
+            ii != blankMap.constEnd();
+            ++ii)
+    {
+        long long iibb = ii.key() - MAXSILENCESKEW;
+        long long iiee = ii.key() + *ii + MAXSILENCESKEW;
+
+        while (jj != silences->constEnd() && jj.key() + *jj <= iibb)
+            ++jj;
+
+        /* Keep the dummy blank frame at the end. */
+        if (!*ii || (jj != silences->constEnd() && jj.key() < iiee))
+            silentBlankMap.insert(ii.key(), *ii);
+    }
+
+    VERBOSE(VB_COMMFLAG, QString("BlankFrameDetector adjusting for silences"
+                " (%1 of %2 blank sequences are silent)")
+            .arg(silentBlankMap.size()).arg(blankMap.size()));
+
+    computeBreakMap(&breakMap, &silentBlankMap, fps, skipcommblanks,
+            debugLevel, "BF");
+    if (breakMap.empty())
+    {
+        VERBOSE(VB_COMMFLAG, "BlankFrameDetector found no silent breaks;"
+                " ignoring silences");
+        computeBreakMap(&breakMap, &blankMap, fps, skipcommblanks,
+                debugLevel, "BF");
+    }
+
+    frameAnalyzerReportMap(&breakMap, fps, "BF Break");
+    return 0;
+}
+
 int
 BlankFrameDetector::computeBreaks(FrameAnalyzer::FrameMap *breaks)
 {
     if (breakMap.empty())
     {
         /* Compute breaks (breakMap). */
-        computeBreakMap(&breakMap, &blankMap, fps, skipcommblanks, debugLevel);
+        computeBreakMap(&breakMap, &blankMap, fps, skipcommblanks, debugLevel,
+            "BF");
         frameAnalyzerReportMap(&breakMap, fps, "BF Break");
     }
 
@@ -35,6 +35,7 @@ public:
     const FrameAnalyzer::FrameMap *getBlanks(void) const { return &blankMap; }
     int computeForLogoSurplus(const TemplateMatcher *tm);
     int computeForLogoDeficit(const TemplateMatcher *tm);
+    int computeForSilences(const FrameMap *silences);
     int computeBreaks(FrameMap *breaks);
 
 private:
@@ -11,6 +11,10 @@ using namespace std;
 
 // Qt headers
 #include <QString>
+#include <QVector>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 // MythTV headers
 #include "mythcontext.h"
@@ -122,7 +126,8 @@ ClassicCommDetector::ClassicCommDetector(SkipType commDetectMethod_in,
                                          const QDateTime& startedAt_in,
                                          const QDateTime& stopsAt_in,
                                          const QDateTime& recordingStartedAt_in,
-                                         const QDateTime& recordingStopsAt_in) :
+                                         const QDateTime& recordingStopsAt_in,
+                                         uint analysisThreads_in) :
 
 
     commDetectMethod(commDetectMethod_in),
@@ -147,7 +152,8 @@ ClassicCommDetector::ClassicCommDetector(SkipType commDetectMethod_in,
     stillRecording(recordingStopsAt > QDateTime::currentDateTime()),
     fullSpeed(fullSpeed_in),                   showProgress(showProgress_in),
     fps(0.0),                                  framesProcessed(0),
-    preRoll(0),                                postRoll(0)
+    preRoll(0),                                postRoll(0),
+    analysisThreads(analysisThreads_in),       analysisPool(NULL)
 {
     commDetectBorder =
         gCoreContext->GetNumSetting("CommDetectBorder", 20);
@@ -280,6 +286,13 @@ void ClassicCommDetector::deleteLater(void)
     if (logoDetector)
         logoDetector->deleteLater();
 
+    if (analysisPool)
+    {
+        MergeQueuedFrames(0);
+        delete analysisPool;
+        analysisPool = NULL;
+    }
+
     CommDetectorBase::deleteLater();
 }
 
@@ -395,6 +408,14 @@ bool ClassicCommDetector::go()
 
     SetVideoParams(aspect);
 
+    if (analysisThreads > 1 && !analysisPool)
+    {
+        VERBOSE(VB_COMMFLAG, QString("Analyzing frames with %1 threads")
+                .arg(analysisThreads));
+        analysisPool = new QThreadPool();
+        analysisPool->setMaxThreadCount(analysisThreads);
+    }
+
     emit breathe();
 
     while (!player->GetEof())
@@ -413,6 +434,8 @@ bool ClassicCommDetector::go()
         newAspect = player->GetVideoAspect();
         if (newAspect != aspect)
         {
+            // the change is marked on the last merged frame
+            MergeQueuedFrames(0);
             SetVideoParams(aspect);
             aspect = newAspect;
         }
@@ -425,6 +448,7 @@ bool ClassicCommDetector::go()
             if (m_bStop)
             {
                 player->DiscardVideoFrame(currentFrame);
+                MergeQueuedFrames(0);
                 return false;
             }
         }
@@ -561,6 +585,8 @@ bool ClassicCommDetector::go()
         player->DiscardVideoFrame(currentFrame);
     }
 
+    MergeQueuedFrames(0);
+
     if (showProgress)
     {
         float elapsed = flagTime.elapsed() / 1000.0;
@@ -721,25 +747,59 @@ void ClassicCommDetector::SetVideoParams(float aspect)
     }
 }
 
+/** \class FrameAnalysisTask
+ *  \brief Copy of the luma plane of a decoded frame, analyzed by
+ *         ClassicCommDetector::AnalyzeFrame() on a pool thread.
+ */
+class FrameAnalysisTask : public QRunnable
+{
+  public:
+    FrameAnalysisTask(ClassicCommDetector *detector, const VideoFrame *frame,
+                      long long frame_number, uint size, int aspect) :
+        m_detector(detector), m_frameNumber(frame_number),
+        m_buf(new unsigned char[size]), m_aspect(aspect), m_done(false)
+    {
+        memcpy(m_buf, frame->buf, size);
+        setAutoDelete(false);
+    }
+
+    ~FrameAnalysisTask()
+    {
+        delete [] m_buf;
+    }
+
+    virtual void run(void)
+    {
+        m_detector->AnalyzeFrame(m_buf, m_stats);
+
+        QMutexLocker locker(&m_lock);
+        m_done = true;
+        m_wait.wakeAll();
+    }
+
+    /// \brief Waits until run() has analyzed the frame.
+    void Wait(void)
+    {
+        QMutexLocker locker(&m_lock);
+        while (!m_done)
+            m_wait.wait(&m_lock);
+    }
+
+    ClassicCommDetector             *m_detector;
+    long long                        m_frameNumber;
+    unsigned char                   *m_buf;
+    int                              m_aspect;
+    ClassicCommDetector::FrameStats  m_stats;
+
+  private:
+    QMutex                           m_lock;
+    QWaitCondition                   m_wait;
+    bool                             m_done;
+};
+
 void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
                                        long long frame_number)
 {
-    int max = 0;
-    int min = 255;
-    int avg = 0;
-    unsigned char pixel;
-    int blankPixelsChecked = 0;
-    long long totBrightness = 0;
-    unsigned char *rowMax = new unsigned char[height];
-    unsigned char *colMax = new unsigned char[width];
-    memset(rowMax, 0, sizeof(*rowMax)*height);
-    memset(colMax, 0, sizeof(*colMax)*width);
-    int topDarkRow = commDetectBorder;
-    int bottomDarkRow = height - commDetectBorder - 1;
-    int leftDarkCol = commDetectBorder;
-    int rightDarkCol = width - commDetectBorder - 1;
-    FrameInfoEntry fInfo;
-
     if (!frame || !(frame->buf) || frame_number == -1 || frame->codec != FMT_YV12)
     {
         VERBOSE(VB_COMMFLAG, "CommDetect: Invalid video frame or codec, "
@@ -754,48 +814,69 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
         return;
     }
 
-    curFrameNumber = frame_number;
-    framePtr = frame->buf;
-
-    fInfo.minBrightness = -1;
-    fInfo.maxBrightness = -1;
-    fInfo.avgBrightness = -1;
-    fInfo.sceneChangePercent = -1;
-    fInfo.aspect = currentAspect;
-    fInfo.format = COMM_FORMAT_NORMAL;
-    fInfo.flagMask = 0;
-
-    int& flagMask = frameInfo[curFrameNumber].flagMask;
-
-    // Fill in dummy info records for skipped frames.
-    if (lastFrameNumber != (curFrameNumber - 1))
+    if (analysisPool)
     {
-        if (lastFrameNumber > 0)
-        {
-            fInfo.aspect = frameInfo[lastFrameNumber].aspect;
-            fInfo.format = frameInfo[lastFrameNumber].format;
-        }
-        fInfo.flagMask = COMM_FRAME_SKIPPED;
-
-        lastFrameNumber++;
-        while(lastFrameNumber < curFrameNumber)
-            frameInfo[lastFrameNumber++] = fInfo;
+        // Keep at most two frames per thread in flight, the oldest
+        // results are merged in frame order while the rest are analyzed.
+        MergeQueuedFrames(analysisThreads * 2 - 1);
 
-        fInfo.flagMask = 0;
+        FrameAnalysisTask *task = new FrameAnalysisTask(
+            this, frame, frame_number, width * height, currentAspect);
+        analysisQueue.push_back(task);
+        analysisPool->start(task);
+        return;
     }
-    lastFrameNumber = curFrameNumber;
 
-    frameInfo[curFrameNumber] = fInfo;
-
-    if (commDetectMethod & COMM_DETECT_BLANKS)
-        frameIsBlank = false;
+    FrameStats stats;
+    AnalyzeFrame(frame->buf, stats);
+    MergeFrame(frame_number, frame->buf, currentAspect, stats);
+}
 
-    if (commDetectMethod & COMM_DETECT_SCENE)
+/** \fn ClassicCommDetector::MergeQueuedFrames(uint)
+ *  \brief Merges analyzed frames, oldest first, until no more than
+ *         \p max_queued frames are waiting.
+ */
+void ClassicCommDetector::MergeQueuedFrames(uint max_queued)
+{
+    while ((uint)analysisQueue.size() > max_queued)
     {
-        sceneChangeDetector->processFrame(framePtr);
+        FrameAnalysisTask *task = analysisQueue.takeFirst();
+        task->Wait();
+        MergeFrame(task->m_frameNumber, task->m_buf, task->m_aspect,
+                   task->m_stats);
+        framePtr = NULL;
+        delete task;
     }
+}
 
-    stationLogoPresent = false;
+/** \fn ClassicCommDetector::AnalyzeFrame(unsigned char*, FrameStats&) const
+ *  \brief Computes the brightness, format, blank and logo state of a frame.
+ *
+ *   This only reads the detector's settings and the logo found before
+ *   flagging started, so it may run on several frames at once.
+ */
+void ClassicCommDetector::AnalyzeFrame(unsigned char *buf,
+                                       FrameStats &stats) const
+{
+    int max = 0;
+    int min = 255;
+    int avg = 0;
+    unsigned char pixel;
+    int blankPixelsChecked = 0;
+    long long totBrightness = 0;
+    QVector<unsigned char> rowMax(height, 0);
+    QVector<unsigned char> colMax(width, 0);
+    int topDarkRow = commDetectBorder;
+    int bottomDarkRow = height - commDetectBorder - 1;
+    int leftDarkCol = commDetectBorder;
+    int rightDarkCol = width - commDetectBorder - 1;
+
+    stats.minBrightness = -1;
+    stats.maxBrightness = -1;
+    stats.avgBrightness = -1;
+    stats.format = COMM_FORMAT_NORMAL;
+    stats.isBlank = false;
+    stats.logoPresent = false;
 
     for(int y = commDetectBorder; y < (height - commDetectBorder);
             y += vertSpacing)
@@ -803,7 +884,7 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
         for(int x = commDetectBorder; x < (width - commDetectBorder);
                 x += horizSpacing)
         {
-            pixel = framePtr[y * width + x];
+            pixel = buf[y * width + x];
 
             if (commDetectMethod & COMM_DETECT_BLANKS)
             {
@@ -853,8 +934,6 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
             if (rowMax[y] >= commDetectBoxBrightness)
                 bottomDarkRow = y;
 
-        delete[] rowMax;
-
         for(int x = commDetectBorder; x < (width - commDetectBorder);
                 x += horizSpacing)
         {
@@ -869,58 +948,118 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
             if (colMax[x] >= commDetectBoxBrightness)
                 rightDarkCol = x;
 
-        delete[] colMax;
-
         if ((topDarkRow > commDetectBorder) &&
             (topDarkRow < (height * .20)) &&
             (bottomDarkRow < (height - commDetectBorder)) &&
             (bottomDarkRow > (height * .80)))
         {
-            frameInfo[curFrameNumber].format = COMM_FORMAT_LETTERBOX;
+            stats.format = COMM_FORMAT_LETTERBOX;
         }
         else if ((leftDarkCol > commDetectBorder) &&
                  (leftDarkCol < (width * .20)) &&
                  (rightDarkCol < (width - commDetectBorder)) &&
                  (rightDarkCol > (width * .80)))
         {
-            frameInfo[curFrameNumber].format = COMM_FORMAT_PILLARBOX;
+            stats.format = COMM_FORMAT_PILLARBOX;
         }
         else
         {
-            frameInfo[curFrameNumber].format = COMM_FORMAT_NORMAL;
+            stats.format = COMM_FORMAT_NORMAL;
         }
 
         avg = totBrightness / blankPixelsChecked;
 
-        frameInfo[curFrameNumber].minBrightness = min;
-        frameInfo[curFrameNumber].maxBrightness = max;
-        frameInfo[curFrameNumber].avgBrightness = avg;
+        stats.minBrightness = min;
+        stats.maxBrightness = max;
+        stats.avgBrightness = avg;
 
-        totalMinBrightness += min;
-        commDetectDimAverage = min + 10;
+        int dimAverage = min + 10;
 
         // Is the frame really dark
         if (((max - min) <= commDetectBlankFrameMaxDiff) &&
             (max < commDetectDimBrightness))
-            frameIsBlank = true;
+            stats.isBlank = true;
 
         // Are we non-strict and the frame is blank
         if ((!aggressiveDetection) &&
             ((max - min) <= commDetectBlankFrameMaxDiff))
-            frameIsBlank = true;
+            stats.isBlank = true;
 
         // Are we non-strict and the frame is dark
         //                   OR the frame is dim and has a low avg brightness
         if ((!aggressiveDetection) &&
             ((max < commDetectDarkBrightness) ||
-             ((max < commDetectDimBrightness) && (avg < commDetectDimAverage))))
-            frameIsBlank = true;
+             ((max < commDetectDimBrightness) && (avg < dimAverage))))
+            stats.isBlank = true;
     }
 
     if ((logoInfoAvailable) && (commDetectMethod & COMM_DETECT_LOGO))
     {
-        stationLogoPresent =
-            logoDetector->doesThisFrameContainTheFoundLogo(framePtr);
+        stats.logoPresent =
+            logoDetector->doesThisFrameContainTheFoundLogo(buf);
+    }
+}
+
+/** \fn ClassicCommDetector::MergeFrame(long long, unsigned char*, int, const FrameStats&)
+ *  \brief Records the results of AnalyzeFrame() for a frame and runs the
+ *         scene change detection, which must see the frames in order.
+ */
+void ClassicCommDetector::MergeFrame(long long frame_number,
+                                     unsigned char *buf, int aspect,
+                                     const FrameStats &stats)
+{
+    FrameInfoEntry fInfo;
+
+    curFrameNumber = frame_number;
+    framePtr = buf;
+
+    fInfo.minBrightness = -1;
+    fInfo.maxBrightness = -1;
+    fInfo.avgBrightness = -1;
+    fInfo.sceneChangePercent = -1;
+    fInfo.aspect = aspect;
+    fInfo.format = COMM_FORMAT_NORMAL;
+    fInfo.flagMask = 0;
+
+    int& flagMask = frameInfo[curFrameNumber].flagMask;
+
+    // Fill in dummy info records for skipped frames.
+    if (lastFrameNumber != (curFrameNumber - 1))
+    {
+        if (lastFrameNumber > 0)
+        {
+            fInfo.aspect = frameInfo[lastFrameNumber].aspect;
+            fInfo.format = frameInfo[lastFrameNumber].format;
+        }
+        fInfo.flagMask = COMM_FRAME_SKIPPED;
+
+        lastFrameNumber++;
+        while(lastFrameNumber < curFrameNumber)
+            frameInfo[lastFrameNumber++] = fInfo;
+
+        fInfo.flagMask = 0;
+    }
+    lastFrameNumber = curFrameNumber;
+
+    frameInfo[curFrameNumber] = fInfo;
+
+    if (commDetectMethod & COMM_DETECT_SCENE)
+    {
+        sceneChangeDetector->processFrame(framePtr);
+    }
+
+    frameIsBlank = stats.isBlank;
+    stationLogoPresent = stats.logoPresent;
+
+    if (commDetectMethod & COMM_DETECT_BLANKS)
+    {
+        frameInfo[curFrameNumber].format = stats.format;
+        frameInfo[curFrameNumber].minBrightness = stats.minBrightness;
+        frameInfo[curFrameNumber].maxBrightness = stats.maxBrightness;
+        frameInfo[curFrameNumber].avgBrightness = stats.avgBrightness;
+
+        totalMinBrightness += stats.minBrightness;
+        commDetectDimAverage = stats.minBrightness + 10;
     }
 
 #if 0
@@ -962,7 +1101,7 @@ void ClassicCommDetector::ProcessFrame(VideoFrame *frame,
                                   frameInfo[curFrameNumber].flagMask ));
 
 #ifdef SHOW_DEBUG_WIN
-    comm_debug_show(frame->buf);
+    comm_debug_show(framePtr);
     getchar();
 #endif
 
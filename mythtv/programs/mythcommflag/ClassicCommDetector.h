@@ -7,6 +7,7 @@
 // Qt headers
 #include <QObject>
 #include <QMap>
+#include <QList>
 #include <QDateTime>
 
 // MythTV headers
@@ -16,9 +17,11 @@
 // Commercial Flagging headers
 #include "CommDetectorBase.h"
 
+class QThreadPool;
 class MythPlayer;
 class LogoDetectorBase;
 class SceneChangeDetectorBase;
+class FrameAnalysisTask;
 
 enum frameMaskValues {
     COMM_FRAME_SKIPPED       = 0x0001,
@@ -53,7 +56,8 @@ class ClassicCommDetector : public CommDetectorBase
                             const QDateTime& startedAt_in,
                             const QDateTime& stopsAt_in,
                             const QDateTime& recordingStartedAt_in,
-                            const QDateTime& recordingStopsAt_in);
+                            const QDateTime& recordingStopsAt_in,
+                            uint analysisThreads_in);
         virtual void deleteLater(void);
 
         bool go();
@@ -68,6 +72,7 @@ class ClassicCommDetector : public CommDetectorBase
         void logoDetectorBreathe();
 
         friend class ClassicLogoDetector;
+        friend class FrameAnalysisTask;
 
     protected:
         virtual ~ClassicCommDetector() {}
@@ -189,11 +194,33 @@ protected:
         long long postRoll;
 
 
+        /// Per frame results of AnalyzeFrame()
+        class FrameStats
+        {
+          public:
+            int  minBrightness;
+            int  maxBrightness;
+            int  avgBrightness;
+            int  format;
+            bool isBlank;
+            bool logoPresent;
+        };
+
         void Init();
         void SetVideoParams(float aspect);
         void ProcessFrame(VideoFrame *frame, long long frame_number);
+        void AnalyzeFrame(unsigned char *buf, FrameStats &stats) const;
+        void MergeFrame(long long frame_number, unsigned char *buf,
+                        int aspect, const FrameStats &stats);
+        void MergeQueuedFrames(uint max_queued);
         QMap<long long, FrameInfoEntry> frameInfo;
 
+        /// frames are analyzed on this many threads when more than one
+        uint analysisThreads;
+        QThreadPool *analysisPool;
+        /// frames being analyzed, in frame order
+        QList<FrameAnalysisTask*> analysisQueue;
+
 public slots:
         void sceneChangeDetectorHasNewInformation(unsigned int framenum, bool isSceneChange,float debugValue);
 };
@@ -29,7 +29,7 @@ ClassicLogoDetector::ClassicLogoDetector(ClassicCommDetector* commdetector,
                                          unsigned int xspacing_in,
                                          unsigned int yspacing_in)
     : LogoDetectorBase(w,h),
-      commDetector(commdetector),                       frameNumber(0),
+      commDetector(commdetector),
       previousFrameWasSceneChange(false),
       xspacing(xspacing_in),                            yspacing(yspacing_in),
       commDetectBorder(commdetectborder_in),            edgeMask(new EdgeMaskEntry[width * height]),
@@ -439,7 +439,7 @@ void ClassicLogoDetector::DumpLogo(bool fromCurrentFrame,
  * which are partially mods based on Myth's original commercial skip
  * code written by Chris Pinkham. */
 bool ClassicLogoDetector::doesThisFrameContainTheFoundLogo(
-    unsigned char* framePtr)
+    unsigned char* framePtr) const
 {
     int radius = 2;
     unsigned int x, y;
@@ -492,7 +492,6 @@ bool ClassicLogoDetector::doesThisFrameContainTheFoundLogo(
         }
     }
 
-    frameNumber++;
     double goodEdgeRatio = (double)goodEdges / (double)testEdges;
     double badEdgeRatio = (double)badEdges / (double)testNotEdges;
     if ((goodEdgeRatio > commDetectLogoGoodEdgeThreshold) &&
@@ -502,7 +501,8 @@ bool ClassicLogoDetector::doesThisFrameContainTheFoundLogo(
         return false;
 }
 
-bool ClassicLogoDetector::pixelInsideLogo(unsigned int x, unsigned int y)
+bool ClassicLogoDetector::pixelInsideLogo(
+    unsigned int x, unsigned int y) const
 {
     if (!logoInfoAvailable)
         return false;
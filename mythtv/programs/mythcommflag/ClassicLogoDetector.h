@@ -16,8 +16,8 @@ class ClassicLogoDetector : public LogoDetectorBase
     virtual void deleteLater(void);
 
     bool searchForLogo(MythPlayer* player);
-    bool doesThisFrameContainTheFoundLogo(unsigned char* frame);
-    bool pixelInsideLogo(unsigned int x, unsigned int y);
+    bool doesThisFrameContainTheFoundLogo(unsigned char* frame) const;
+    bool pixelInsideLogo(unsigned int x, unsigned int y) const;
 
     unsigned int getRequiredAvailableBufferForSearch();
 
@@ -31,7 +31,6 @@ class ClassicLogoDetector : public LogoDetectorBase
     void DetectEdges(VideoFrame *frame, EdgeMaskEntry *edges, int edgeDiff);
 
     ClassicCommDetector* commDetector;
-    unsigned int frameNumber;
     bool previousFrameWasSceneChange;
     unsigned int xspacing, yspacing;
     unsigned int commDetectBorder;
@@ -7,11 +7,15 @@
 
 // C++ headers
 #include <algorithm>
+#include <deque>
 using namespace std;
 
 // Qt headers
 #include <QDir>
 #include <QFileInfo>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 
 // MythTV headers
 #include "compat.h"
@@ -32,6 +36,7 @@ using namespace std;
 #include "SceneChangeDetector.h"
 #include "TemplateFinder.h"
 #include "TemplateMatcher.h"
+#include "SilenceDetector.h"
 
 namespace {
 
@@ -208,8 +213,343 @@ bool searchingForLogo(TemplateFinder *tf, const FrameAnalyzerItem &pass)
     return it != pass.end();
 }
 
+/*
+ * Runs the analyzers of a pass on copies of the decoded frames, in frame
+ * order, while the flagging thread decodes the following frames.
+ *
+ * The analyzers of a pass share per-frame state (e.g., the PGMConverter
+ * and HistogramAnalyzer caches), so frames are analyzed one at a time;
+ * only decoding runs ahead.
+ */
+class PassAnalysisThread : public QThread
+{
+  public:
+    PassAnalysisThread(FrameAnalyzerItem &pass,
+                       FrameAnalyzerItem &finishedAnalyzers,
+                       FrameAnalyzerItem &deadAnalyzers,
+                       TemplateFinder *logoFinder, uint depth) :
+        m_pass(pass), m_finishedAnalyzers(finishedAnalyzers),
+        m_deadAnalyzers(deadAnalyzers), m_logoFinder(logoFinder),
+        m_depth(max(depth, 1U)),
+        m_wanted(FrameAnalyzer::NEXTFRAME), m_busy(false),
+        m_passEmpty(pass.empty()),
+        m_searchingForLogo(searchingForLogo(logoFinder, pass)),
+        m_finish(false)
+    {
+    }
+
+    ~PassAnalysisThread()
+    {
+        Finish();
+    }
+
+    /*
+     * Queues a copy of a decoded frame, waiting while the queue is full.
+     * Returns the frame to decode next.
+     */
+    long long Add(const VideoFrame *frame)
+    {
+        VideoFrame *copy = new VideoFrame;
+        *copy = *frame;
+        copy->buf = new unsigned char[frame->size];
+        memcpy(copy->buf, frame->buf, frame->size);
+        copy->qscale_table = NULL;
+        copy->qstride = 0;
+
+        QMutexLocker locker(&m_lock);
+
+        while ((uint)m_queue.size() >= m_depth)
+            m_wait.wait(&m_lock);
+
+        m_queue.push_back(copy);
+        m_wait.wakeAll();
+
+        long long nextFrame = frame->frameNumber + 1;
+        if (m_wanted <= nextFrame)
+            return nextFrame;
+
+        /*
+         * The analyzers want to skip ahead. Let them see the queued frames
+         * before deciding where to seek.
+         */
+        while (m_busy || !m_queue.empty())
+            m_wait.wait(&m_lock);
+
+        return max(m_wanted, nextFrame);
+    }
+
+    /* Waits until all queued frames have been analyzed. */
+    void WaitIdle(void)
+    {
+        QMutexLocker locker(&m_lock);
+        while (m_busy || !m_queue.empty())
+            m_wait.wait(&m_lock);
+    }
+
+    /* Returns true while some analyzer of the pass wants more frames. */
+    bool Analyzing(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return !m_passEmpty;
+    }
+
+    /*
+     * Returns true while the logo finder is still in the pass. The pass
+     * is only changed by this thread, so don't look at it directly.
+     */
+    bool SearchingForLogo(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return m_searchingForLogo;
+    }
+
+    /* Analyzes the queued frames and stops the thread. */
+    void Finish(void)
+    {
+        m_lock.lock();
+        m_finish = true;
+        m_wait.wakeAll();
+        m_lock.unlock();
+
+        wait();
+    }
+
+  protected:
+    virtual void run(void)
+    {
+        QMutexLocker locker(&m_lock);
+
+        while (true)
+        {
+            while (m_queue.empty() && !m_finish)
+                m_wait.wait(&m_lock);
+
+            if (m_queue.empty())
+                break;
+
+            VideoFrame *frame = m_queue.front();
+            m_queue.pop_front();
+
+            /* Frames decoded before the analyzers asked to skip them. */
+            if (!m_passEmpty && (m_wanted == FrameAnalyzer::NEXTFRAME ||
+                                 frame->frameNumber >= m_wanted))
+            {
+                m_busy = true;
+                locker.unlock();
+
+                long long nextFrame = processFrame(
+                    m_pass, m_finishedAnalyzers, m_deadAnalyzers,
+                    frame, frame->frameNumber);
+
+                locker.relock();
+                m_busy = false;
+                m_wanted = nextFrame;
+                m_passEmpty = m_pass.empty();
+                m_searchingForLogo = searchingForLogo(m_logoFinder, m_pass);
+            }
+
+            delete [] frame->buf;
+            delete frame;
+
+            m_wait.wakeAll();
+        }
+    }
+
+  private:
+    FrameAnalyzerItem   &m_pass;
+    FrameAnalyzerItem   &m_finishedAnalyzers;
+    FrameAnalyzerItem   &m_deadAnalyzers;
+    TemplateFinder      *m_logoFinder;
+    uint                 m_depth;
+
+    QMutex               m_lock;
+    QWaitCondition       m_wait;
+    deque<VideoFrame*>   m_queue;
+    long long            m_wanted;
+    bool                 m_busy;
+    bool                 m_passEmpty;
+    bool                 m_searchingForLogo;
+    bool                 m_finish;
+};
+
+/* Downmixes interleaved samples to mono, scaled to [-1.0, 1.0]. */
+void toMono(float *out, const char *in, int nsamples, AudioFormat format,
+            int channels)
+{
+    for (int ii = 0; ii < nsamples; ii++)
+    {
+        float sum = 0;
+        for (int ch = 0; ch < channels; ch++)
+        {
+            int idx = ii * channels + ch;
+            switch (format)
+            {
+                case FORMAT_U8:
+                    sum += (((const uint8_t*)in)[idx] - 128) / 128.0f;
+                    break;
+                case FORMAT_S16:
+                    sum += ((const int16_t*)in)[idx] / 32768.0f;
+                    break;
+                case FORMAT_S24LSB:
+                    sum += ((const int32_t*)in)[idx] / 8388608.0f;
+                    break;
+                case FORMAT_S24:
+                case FORMAT_S32:
+                    sum += ((const int32_t*)in)[idx] / 2147483648.0f;
+                    break;
+                case FORMAT_FLT:
+                    sum += ((const float*)in)[idx];
+                    break;
+                default:
+                    break;
+            }
+        }
+        out[ii] = sum / channels;
+    }
+}
+
 };  // namespace
 
+/*
+ * Hands the audio decoded by the player to the audio analyzers, split up by
+ * video frame. The audio is decoded on the player's decoder thread, ahead of
+ * the frames being analyzed, so audio timecodes are mapped to frame numbers
+ * from the timecode of the latest frame seen by the flagging thread.
+ */
+class AudioAnalysisListener : public AudioDataListener
+{
+  public:
+    AudioAnalysisListener(AudioAnalyzerItem &analyzers) :
+        m_analyzers(analyzers), m_fps(0.0f), m_haveVideoPosition(false),
+        m_videoFrame(0), m_videoTimecode(0)
+    {
+    }
+
+    void MythPlayerInited(MythPlayer *player, long long nframes)
+    {
+        QMutexLocker locker(&m_lock);
+
+        m_fps = player->GetFrameRate();
+        m_haveVideoPosition = false;
+        m_active.clear();
+
+        AudioAnalyzerItem::iterator it = m_analyzers.begin();
+        for (; it != m_analyzers.end(); ++it)
+        {
+            FrameAnalyzer::analyzeFrameResult ares =
+                (*it)->MythPlayerInited(player, nframes);
+            if (ares == FrameAnalyzer::ANALYZE_OK ||
+                ares == FrameAnalyzer::ANALYZE_ERROR)
+            {
+                m_active.push_back(*it);
+            }
+        }
+    }
+
+    /* Called for each video frame by the flagging thread. */
+    void SetVideoPosition(long long frameno, int64_t timecode)
+    {
+        QMutexLocker locker(&m_lock);
+        m_videoFrame = frameno;
+        m_videoTimecode = timecode;
+        m_haveVideoPosition = true;
+    }
+
+    /* Returns true while some analyzer wants more audio. */
+    bool Analyzing(void)
+    {
+        QMutexLocker locker(&m_lock);
+        return !m_active.empty();
+    }
+
+    int Finished(long long nframes, bool final)
+    {
+        QMutexLocker locker(&m_lock);
+        AudioAnalyzerItem::iterator it = m_analyzers.begin();
+        for (; it != m_analyzers.end(); ++it)
+            (void)(*it)->finished(nframes, final);
+        return 0;
+    }
+
+    int ReportTime(void)
+    {
+        AudioAnalyzerItem::iterator it = m_analyzers.begin();
+        for (; it != m_analyzers.end(); ++it)
+            (void)(*it)->reportTime();
+        return 0;
+    }
+
+    virtual void AddAudioData(const char *buffer, int len, int64_t timecode,
+                              AudioFormat format, int channels,
+                              int samplerate)
+    {
+        int samplesize = channels * AudioOutputSettings::SampleSize(format);
+        if (samplesize <= 0 || samplerate <= 0 || len < samplesize)
+            return;
+        int nsamples = len / samplesize;
+
+        QMutexLocker locker(&m_lock);
+
+        if (!m_haveVideoPosition || m_active.empty())
+            return;
+
+        m_samples.resize(nsamples);
+        toMono(&m_samples[0], buffer, nsamples, format, channels);
+
+        /* Fractional frame number of the first sample. */
+        double pos = m_videoFrame +
+            (timecode - m_videoTimecode) * m_fps / 1000.0;
+        double framesPerSample = m_fps / samplerate;
+
+        int ii = 0;
+        while (ii < nsamples)
+        {
+            long long frameno = (long long)floor(pos + ii * framesPerSample);
+            int jj = (int)ceil((frameno + 1 - pos) / framesPerSample);
+            jj = min(max(jj, ii + 1), nsamples);
+
+            if (frameno >= 0)
+                Analyze(&m_samples[ii], jj - ii, frameno);
+            ii = jj;
+        }
+    }
+
+  private:
+    void Analyze(const float *samples, int nsamples, long long frameno)
+    {
+        AudioAnalyzerItem::iterator it = m_active.begin();
+        while (it != m_active.end())
+        {
+            FrameAnalyzer::analyzeFrameResult ares =
+                (*it)->analyzeAudio(samples, nsamples, frameno);
+
+            if (ares == FrameAnalyzer::ANALYZE_OK ||
+                ares == FrameAnalyzer::ANALYZE_ERROR)
+            {
+                ++it;
+                continue;
+            }
+
+            if (ares != FrameAnalyzer::ANALYZE_FINISHED)
+            {
+                VERBOSE(VB_COMMFLAG, QString("%1::analyzeAudio failed at"
+                            " frame %2").arg((*it)->name()).arg(frameno));
+            }
+            it = m_active.erase(it);
+        }
+    }
+
+    AudioAnalyzerItem   &m_analyzers;
+    AudioAnalyzerItem    m_active;
+
+    QMutex               m_lock;
+    float                m_fps;
+    bool                 m_haveVideoPosition;
+    long long            m_videoFrame;
+    int64_t              m_videoTimecode;
+    vector<float>        m_samples;
+};
+
 namespace commDetector2 {
 
 QString debugDirectory(int chanid, const QDateTime& recstartts)
@@ -326,17 +666,21 @@ CommDetector2::CommDetector2(
     const QDateTime   &endts_in,
     const QDateTime   &recstartts_in,
     const QDateTime   &recendts_in,
-    bool               useDB) :
+    bool               useDB,
+    uint               analysisThreads_in) :
     commDetectMethod((enum SkipTypes)(commDetectMethod_in & ~COMM_DETECT_2)),
     showProgress(showProgress_in),  fullSpeed(fullSpeed_in),
     player(player_in),
     startts(startts_in),            endts(endts_in),
     recstartts(recstartts_in),      recendts(recendts_in),
     isRecording(QDateTime::currentDateTime() < recendts),
+    analysisThreads(analysisThreads_in),
     sendBreakMapUpdates(false),     breakMapUpdateRequested(false),
     finished(false),                currentFrameNumber(0),
+    audioListener(NULL),
     logoFinder(NULL),               logoMatcher(NULL),
     blankFrameDetector(NULL),       sceneChangeDetector(NULL),
+    silenceDetector(NULL),
     debugdir("")
 {
     FrameAnalyzerItem        pass0, pass1;
@@ -437,6 +781,15 @@ CommDetector2::CommDetector2(
     if (histogramAnalyzer && logoFinder)
         histogramAnalyzer->setLogoState(logoFinder);
 
+    /*
+     * Look for silences and loudness steps, to confirm blank frames or to
+     * find breaks on their own. The audio is decoded along with the video
+     * anyway, so this costs next to nothing.
+     */
+    silenceDetector = new SilenceDetector();
+    audioAnalyzers.push_back(silenceDetector);
+    audioListener = new AudioAnalysisListener(audioAnalyzers);
+
     /* Aggregate them all together. */
     frameAnalyzers.push_back(pass0);
     frameAnalyzers.push_back(pass1);
@@ -519,9 +872,17 @@ int CommDetector2::computeBreaks(long long nframes)
     }
     else if (blankFrameDetector)
     {
+        if (silenceDetector && blankFrameDetector->computeForSilences(
+                    silenceDetector->getSilences()))
+            return -1;
         if (blankFrameDetector->computeBreaks(&breaks))
             return -1;
     }
+    else if (silenceDetector)
+    {
+        if (silenceDetector->computeBreaks(&breaks))
+            return -1;
+    }
 
     return 0;
 }
@@ -584,6 +945,15 @@ bool CommDetector2::go(void)
             return false;
         }
 
+        /* Listen to the audio while reading the recording the last time. */
+        AudioPlayer *audio = NULL;
+        if (passno + 1 == npasses && !audioAnalyzers.empty())
+        {
+            audioListener->MythPlayerInited(player, nframes);
+            audio = player->GetAudio();
+            audio->SetAudioDataListener(audioListener);
+        }
+
         player->DiscardVideoFrame(player->GetRawVideoFrame(0));
         long long nextFrame = -1;
         currentFrameNumber = 0;
@@ -594,10 +964,24 @@ bool CommDetector2::go(void)
         if (searchingForLogo(logoFinder, *currentPass))
             emit statusUpdate(QObject::tr("Performing Logo Identification"));
 
+        /*
+         * Decode ahead of the analyzers on another thread, unless flagging
+         * is paced by a recording in progress anyway.
+         */
+        PassAnalysisThread *analysis = NULL;
+        if (analysisThreads > 1 && !isRecording)
+        {
+            analysis = new PassAnalysisThread(*currentPass, finishedAnalyzers,
+                                              deadAnalyzers, logoFinder,
+                                              analysisThreads * 2);
+            analysis->start();
+        }
+
         clock.start();
         passTime.start();
         memset(&getframetime, 0, sizeof(getframetime));
-        while (!(*currentPass).empty() && !player->GetEof())
+        while (((analysis ? analysis->Analyzing() : !(*currentPass).empty()) ||
+                (audio && audioListener->Analyzing())) && !player->GetEof())
         {
             struct timeval start, end, elapsedtv;
 
@@ -605,6 +989,11 @@ bool CommDetector2::go(void)
             VideoFrame *currentFrame = player->GetRawVideoFrame(nextFrame);
             long long lastFrameNumber = currentFrameNumber;
             currentFrameNumber = currentFrame->frameNumber;
+            if (audio)
+            {
+                audioListener->SetVideoPosition(currentFrameNumber,
+                                                currentFrame->timecode);
+            }
             (void)gettimeofday(&end, NULL);
             timersub(&end, &start, &elapsedtv);
             timeradd(&getframetime, &elapsedtv, &getframetime);
@@ -626,6 +1015,9 @@ bool CommDetector2::go(void)
                 if (m_bStop)
                 {
                     player->DiscardVideoFrame(currentFrame);
+                    delete analysis;
+                    if (audio)
+                        audio->SetAudioDataListener(NULL);
                     return false;
                 }
             }
@@ -636,7 +1028,9 @@ bool CommDetector2::go(void)
                 sleep(1);
             }
 
-            if (!searchingForLogo(logoFinder, *currentPass) &&
+            bool logoSearch = analysis ? analysis->SearchingForLogo() :
+                searchingForLogo(logoFinder, *currentPass);
+            if (!logoSearch &&
                     needToReportState(showProgress, isRecording,
                         currentFrameNumber))
             {
@@ -644,9 +1038,16 @@ bool CommDetector2::go(void)
                         nframes, passno, npasses);
             }
 
-            nextFrame = processFrame(
-                *currentPass, finishedAnalyzers,
-                deadAnalyzers, currentFrame, currentFrameNumber);
+            if (analysis)
+            {
+                nextFrame = analysis->Add(currentFrame);
+            }
+            else
+            {
+                nextFrame = processFrame(
+                    *currentPass, finishedAnalyzers,
+                    deadAnalyzers, currentFrame, currentFrameNumber);
+            }
 
             if (((currentFrameNumber >= 1) &&
                  (((nextFrame * 10) / nframes) !=
@@ -682,6 +1083,8 @@ bool CommDetector2::go(void)
             {
                 frm_dir_map_t breakMap;
 
+                if (analysis)
+                    analysis->WaitIdle();
                 GetCommercialBreakList(breakMap);
 
                 frm_dir_map_t::const_iterator ii, jj;
@@ -708,6 +1111,11 @@ bool CommDetector2::go(void)
             player->DiscardVideoFrame(currentFrame);
         }
 
+        delete analysis;
+
+        if (audio)
+            audio->SetAudioDataListener(NULL);
+
         currentPass->insert(currentPass->end(),
                             finishedAnalyzers.begin(),
                             finishedAnalyzers.end());
@@ -717,11 +1125,15 @@ bool CommDetector2::go(void)
             currentFrameNumber = player->GetTotalFrameCount() - 1;
         if (passFinished(*currentPass, currentFrameNumber + 1, true))
             return false;
+        if (audio && audioListener->Finished(currentFrameNumber + 1, true))
+            return false;
 
         VERBOSE(VB_COMMFLAG, QString("NVP Time: GetRawVideoFrame=%1s")
                 .arg(strftimeval(&getframetime)));
         if (passReportTime(*currentPass))
             return false;
+        if (audio && audioListener->ReportTime())
+            return false;
     }
 
     if (showProgress)
@@ -754,6 +1166,9 @@ void CommDetector2::GetCommercialBreakList(frm_dir_map_t &marks)
             if (passFinished(*pass, currentFrameNumber + 1, false))
                 return;
         }
+
+        if (audioListener->Finished(currentFrameNumber + 1, false))
+            return;
     }
 
     if (computeBreaks(currentFrameNumber + 1))
@@ -868,6 +1283,7 @@ void CommDetector2::PrintFullMap(
     ostream &out, const frm_dir_map_t *comm_breaks, bool verbose) const
 {
     FrameAnalyzer::FrameMap logoMap, blankMap, blankBreakMap, sceneMap;
+    FrameAnalyzer::FrameMap silenceMap, silenceBreakMap;
     if (logoFinder)
         logoMap = logoFinder->GetMap(0);
 
@@ -880,6 +1296,12 @@ void CommDetector2::PrintFullMap(
     if (sceneChangeDetector)
         sceneMap = sceneChangeDetector->GetMap(0);
 
+    if (silenceDetector)
+    {
+        silenceBreakMap = silenceDetector->GetMap(0);
+        silenceMap      = silenceDetector->GetMap(1);
+    }
+
     out << "Logo Break Map" << endl;
     PrintReportMap(out, logoMap);
     out << "Blank Break Map" << endl;
@@ -888,6 +1310,10 @@ void CommDetector2::PrintFullMap(
     PrintReportMap(out, blankMap);
     out << "Scene Break Map" << endl;
     PrintReportMap(out, sceneMap);
+    out << "Silence Break Map" << endl;
+    PrintReportMap(out, silenceBreakMap);
+    out << "Silence Map" << endl;
+    PrintReportMap(out, silenceMap);
 }
 
 /* vim: set expandtab tabstop=4 shiftwidth=4: */
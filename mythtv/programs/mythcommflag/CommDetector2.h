@@ -14,12 +14,15 @@ using namespace std;
 // Commercial Flagging headers
 #include "CommDetectorBase.h"
 #include "FrameAnalyzer.h"
+#include "AudioAnalyzer.h"
 
 class MythPlayer;
 class TemplateFinder;
 class TemplateMatcher;
 class BlankFrameDetector;
 class SceneChangeDetector;
+class SilenceDetector;
+class AudioAnalysisListener;
 
 namespace commDetector2 {
 
@@ -33,6 +36,7 @@ QString strftimeval(const struct timeval *tv);
 
 typedef vector<FrameAnalyzer*>    FrameAnalyzerItem;
 typedef vector<FrameAnalyzerItem> FrameAnalyzerList;
+typedef vector<AudioAnalyzer*>    AudioAnalyzerItem;
 
 class CommDetector2 : public CommDetectorBase
 {
@@ -41,7 +45,8 @@ class CommDetector2 : public CommDetectorBase
         SkipType commDetectMethod,
         bool showProgress, bool fullSpeed, MythPlayer* player,
         int chanid, const QDateTime& startts, const QDateTime& endts,
-        const QDateTime& recstartts, const QDateTime& recendts, bool useDB);
+        const QDateTime& recstartts, const QDateTime& recendts, bool useDB,
+        uint analysisThreads);
     virtual bool go(void);
     virtual void GetCommercialBreakList(frm_dir_map_t &comms);
     virtual void recordingFinished(long long totalFileSize);
@@ -64,6 +69,7 @@ class CommDetector2 : public CommDetectorBase
     QDateTime               startts, endts, recstartts, recendts;
 
     bool                    isRecording;        /* current state */
+    uint                    analysisThreads;    /* >1 to decode ahead */
     bool                    sendBreakMapUpdates;
     bool                    breakMapUpdateRequested;
     bool                    finished;
@@ -72,6 +78,8 @@ class CommDetector2 : public CommDetectorBase
     FrameAnalyzerList       frameAnalyzers;     /* one list per scan of file */
     FrameAnalyzerList::iterator currentPass;
     FrameAnalyzerItem       finishedAnalyzers;
+    AudioAnalyzerItem       audioAnalyzers;     /* run during last pass */
+    AudioAnalysisListener   *audioListener;
 
     FrameAnalyzer::FrameMap breaks;
 
@@ -79,6 +87,7 @@ class CommDetector2 : public CommDetectorBase
     TemplateMatcher         *logoMatcher;
     BlankFrameDetector      *blankFrameDetector;
     SceneChangeDetector     *sceneChangeDetector;
+    SilenceDetector         *silenceDetector;
 
     QString                 debugdir;
 };
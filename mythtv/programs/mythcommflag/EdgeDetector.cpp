@@ -19,11 +19,98 @@ extern "C" {
 // Commercial Flagging headers
 #include "FrameAnalyzer.h"
 #include "EdgeDetector.h"
+#include "pgm.h"
+
+#ifdef PGM_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace edgeDetector {
 
 using namespace frameAnalyzer;
 
+static int
+row_spans(int rr, int ncols, int excluderow, int excludecol,
+        int excludewidth, int excludeheight, int spans[2][2])
+{
+    /*
+     * Split columns [0, ncols) of row "rr" into the (at most two) spans that
+     * lie outside of the excluded area; the same pixels rrccinrect() would
+     * let through.
+     */
+    int nspans, left, right;
+
+    if (rr < excluderow || rr >= excluderow + excludeheight ||
+            excludewidth <= 0)
+    {
+        spans[0][0] = 0;
+        spans[0][1] = ncols;
+        return 1;
+    }
+
+    left = min(max(0, excludecol), ncols);
+    right = min(max(0, excludecol + excludewidth), ncols);
+
+    nspans = 0;
+    if (left > 0)
+    {
+        spans[nspans][0] = 0;
+        spans[nspans][1] = left;
+        nspans++;
+    }
+    if (right < ncols)
+    {
+        spans[nspans][0] = right;
+        spans[nspans][1] = ncols;
+        nspans++;
+    }
+    return nspans;
+}
+
+static void
+sgm_row(unsigned int *sgm, const unsigned char *rr0, const unsigned char *rr1,
+        int cc1, int cc2)
+{
+    int cc, dx, dy;
+
+#ifdef PGM_SSE2
+    if (pgm_use_sse2())
+    {
+        const __m128i   zero = _mm_setzero_si128();
+
+        /* Reads up to rr0[cc + 8], which is still inside the row. */
+        for (cc = cc1; cc + 8 <= cc2; cc += 8)
+        {
+            __m128i nw = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(rr0 + cc)), zero);
+            __m128i ne = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(rr0 + cc + 1)), zero);
+            __m128i sw = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(rr1 + cc)), zero);
+            __m128i se = _mm_unpacklo_epi8(
+                    _mm_loadl_epi64((const __m128i *)(rr1 + cc + 1)), zero);
+            __m128i vdx = _mm_sub_epi16(se, nw);
+            __m128i vdy = _mm_sub_epi16(sw, ne);
+            __m128i lo = _mm_unpacklo_epi16(vdx, vdy);
+            __m128i hi = _mm_unpackhi_epi16(vdx, vdy);
+
+            /* dx * dx + dy * dy of each (dx, dy) pair */
+            _mm_storeu_si128((__m128i *)(sgm + cc), _mm_madd_epi16(lo, lo));
+            _mm_storeu_si128((__m128i *)(sgm + cc + 4),
+                    _mm_madd_epi16(hi, hi));
+        }
+        cc1 = cc;
+    }
+#endif /* PGM_SSE2 */
+
+    for (cc = cc1; cc < cc2; cc++)
+    {
+        dx = rr1[cc + 1] - rr0[cc];     /* southeast - northwest */
+        dy = rr1[cc] - rr0[cc + 1];     /* southwest - northeast */
+        sgm[cc] = dx * dx + dy * dy;
+    }
+}
+
 unsigned int *
 sgm_init_exclude(unsigned int *sgm, const AVPicture *src, int srcheight,
         int excluderow, int excludecol, int excludewidth, int excludeheight)
@@ -36,26 +123,20 @@ sgm_init_exclude(unsigned int *sgm, const AVPicture *src, int srcheight,
      * that pixel: how much it differs from its neighbors.
      */
     const int       srcwidth = src->linesize[0];
-    int             rr, cc, dx, dy, rr2, cc2;
-    unsigned char   *rr0, *rr1;
+    int             rr, rr2, cc2, nspans, ss;
+    int             spans[2][2];
 
     memset(sgm, 0, srcwidth * srcheight * sizeof(*sgm));
     rr2 = srcheight - 1;
     cc2 = srcwidth - 1;
     for (rr = 0; rr < rr2; rr++)
     {
-        for (cc = 0; cc < cc2; cc++)
-        {
-            if (!rrccinrect(rr, cc, excluderow, excludecol,
-                        excludewidth, excludeheight))
-            {
-                rr0 = &src->data[0][rr * srcwidth + cc];
-                rr1 = &src->data[0][(rr + 1) * srcwidth + cc];
-                dx = rr1[1] - rr0[0];   /* southeast - northwest */
-                dy = rr1[0] - rr0[1];   /* southwest - northeast */
-                sgm[rr * srcwidth + cc] = dx * dx + dy * dy;
-            }
-        }
+        nspans = row_spans(rr, cc2, excluderow, excludecol,
+                excludewidth, excludeheight, spans);
+        for (ss = 0; ss < nspans; ss++)
+            sgm_row(&sgm[rr * srcwidth], &src->data[0][rr * srcwidth],
+                    &src->data[0][(rr + 1) * srcwidth],
+                    spans[ss][0], spans[ss][1]);
     }
     return sgm;
 }
@@ -68,9 +149,40 @@ sgm_init(unsigned int *sgm, const AVPicture *src, int srcheight)
 }
 #endif /* LATER */
 
-static int sort_ascending(const void *aa, const void *bb)
+static void
+mark_row(unsigned char *dst, const unsigned int *sgm, int cc1, int cc2,
+        unsigned int thresholdval)
 {
-    return *(unsigned int*)aa - *(unsigned int*)bb;
+    int cc;
+
+#ifdef PGM_SSE2
+    if (pgm_use_sse2())
+    {
+        /* SGM values are at most 2 * 255 * 255, so signed compares do. */
+        const __m128i   threshold = _mm_set1_epi32((int)thresholdval - 1);
+
+        for (cc = cc1; cc + 16 <= cc2; cc += 16)
+        {
+            const __m128i *pp = (const __m128i *)(sgm + cc);
+            __m128i m0 = _mm_cmpgt_epi32(_mm_loadu_si128(pp + 0), threshold);
+            __m128i m1 = _mm_cmpgt_epi32(_mm_loadu_si128(pp + 1), threshold);
+            __m128i m2 = _mm_cmpgt_epi32(_mm_loadu_si128(pp + 2), threshold);
+            __m128i m3 = _mm_cmpgt_epi32(_mm_loadu_si128(pp + 3), threshold);
+
+            /* all-ones lanes saturate to UCHAR_MAX, the rest to 0 */
+            _mm_storeu_si128((__m128i *)(dst + cc),
+                    _mm_packs_epi16(_mm_packs_epi32(m0, m1),
+                        _mm_packs_epi32(m2, m3)));
+        }
+        cc1 = cc;
+    }
+#endif /* PGM_SSE2 */
+
+    for (cc = cc1; cc < cc2; cc++)
+    {
+        if (sgm[cc] >= thresholdval)
+            dst[cc] = UCHAR_MAX;
+    }
 }
 
 static int
@@ -91,8 +203,9 @@ edge_mark(AVPicture *dst, int dstheight,
 
     const int           dstwidth = dst->linesize[0];
     const int           padded_width = extraleft + dstwidth + extraright;
-    unsigned int        thresholdval;
-    int                 nn, dstnn, ii, rr, cc, first, last, last2;
+    unsigned int        thresholdval, nextval;
+    int                 nn, dstnn, ii, jj, rr, first, nspans, ss;
+    int                 spans[2][2];
 
     (void)extrabottom;  /* gcc */
 
@@ -105,14 +218,16 @@ edge_mark(AVPicture *dst, int dstheight,
     nn = 0;
     for (rr = 0; rr < dstheight; rr++)
     {
-        for (cc = 0; cc < dstwidth; cc++)
+        const unsigned int *sgmrow =
+            &sgm[(extratop + rr) * padded_width + extraleft];
+
+        nspans = row_spans(rr, dstwidth, excluderow, excludecol,
+                excludewidth, excludeheight, spans);
+        for (ss = 0; ss < nspans; ss++)
         {
-            if (!rrccinrect(rr, cc, excluderow, excludecol,
-                        excludewidth, excludeheight))
-            {
-                sgmsorted[nn++] = sgm[(extratop + rr) * padded_width +
-                    extraleft + cc];
-            }
+            memcpy(&sgmsorted[nn], &sgmrow[spans[ss][0]],
+                    (spans[ss][1] - spans[ss][0]) * sizeof(*sgmsorted));
+            nn += spans[ss][1] - spans[ss][0];
         }
     }
 
@@ -132,49 +247,49 @@ edge_mark(AVPicture *dst, int dstheight,
             return 0;
     }
 
-    qsort(sgmsorted, nn, sizeof(*sgmsorted), sort_ascending);
-
-    ii = percentile * nn / 100;
+    /*
+     * Only the value at the percentile, the number of smaller values and the
+     * next larger value are needed, so select instead of sorting.
+     */
+    ii = min(percentile * nn / 100, nn - 1);
+    nth_element(sgmsorted, sgmsorted + ii, sgmsorted + nn);
     thresholdval = sgmsorted[ii];
 
+    first = 0;
+    nextval = thresholdval;
+    for (jj = 0; jj < nn; jj++)
+    {
+        if (sgmsorted[jj] < thresholdval)
+            first++;
+        else if (sgmsorted[jj] > thresholdval &&
+                (nextval == thresholdval || sgmsorted[jj] < nextval))
+            nextval = sgmsorted[jj];
+    }
+
     /*
      * Try not to pick up too many edges, and eliminate degenerate edge-less
      * cases.
      */
-    for (first = ii; first > 0 && sgmsorted[first] == thresholdval; first--) ;
-    if (sgmsorted[first] != thresholdval)
-        first++;
     if (first * 100 / nn < MINTHRESHOLDPCT)
     {
-        unsigned int    newthresholdval;
-
-        last2 = nn - 1;
-        for (last = ii; last < last2 && sgmsorted[last] == thresholdval;
-                last++) ;
-        if (sgmsorted[last] != thresholdval)
-            last--;
-
-        newthresholdval = sgmsorted[min(last + 1, nn - 1)];
-        if (thresholdval == newthresholdval)
+        if (thresholdval == nextval)
         {
             /* Degenerate case; no edges (e.g., blank frame). */
             return 0;
         }
 
-        thresholdval = newthresholdval;
+        thresholdval = nextval;
     }
 
     /* sgm is a padded matrix; dst is the unpadded matrix. */
     for (rr = 0; rr < dstheight; rr++)
     {
-        for (cc = 0; cc < dstwidth; cc++)
-        {
-            if (!rrccinrect(rr, cc, excluderow, excludecol,
-                        excludewidth, excludeheight) &&
-                    sgm[(extratop + rr) * padded_width + extraleft + cc] >=
-                        thresholdval)
-                dst->data[0][rr * dstwidth + cc] = UCHAR_MAX;
-        }
+        nspans = row_spans(rr, dstwidth, excluderow, excludecol,
+                excludewidth, excludeheight, spans);
+        for (ss = 0; ss < nspans; ss++)
+            mark_row(&dst->data[0][rr * dstwidth],
+                    &sgm[(extratop + rr) * padded_width + extraleft],
+                    spans[ss][0], spans[ss][1], thresholdval);
     }
     return 0;
 }
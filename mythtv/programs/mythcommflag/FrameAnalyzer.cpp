@@ -1,4 +1,11 @@
+// ANSI C headers
+#include <cmath>
+
+// MythTV headers
 #include "mythverbose.h"
+#include "decodeencode.h"           /* for absLongLong */
+
+// Commercial Flagging headers
 #include "CommDetector2.h"
 #include "FrameAnalyzer.h"
 
@@ -256,6 +263,182 @@ removeShortSegments(FrameAnalyzer::FrameMap *breakMap, long long nframes,
     return removed;
 }
 
+void
+computeBreakMap(FrameAnalyzer::FrameMap *breakMap,
+        const FrameAnalyzer::FrameMap *blankMap, float fps, bool skipcommblanks,
+        int debugLevel, const char *comment)
+{
+    /*
+     * Pair up the separators of "blankMap" (blank frames, silences, ...)
+     * that are a common commercial-break length apart.
+     */
+
+    /*
+     * TUNABLE:
+     *
+     * Common commercial-break lengths.
+     */
+    static const struct {
+        int     len;    /* seconds */
+        int     delta;  /* seconds */
+    } breaktype[] = {
+        /* Sort by "len". */
+        { 15,   2 },
+        { 20,   2 },
+        { 30,   5 },
+        { 60,   5 },
+    };
+    static const unsigned int   nbreaktypes =
+        sizeof(breaktype)/sizeof(*breaktype);
+
+    /*
+     * TUNABLE:
+     *
+     * Shortest non-commercial length, used to coalesce consecutive commercial
+     * breaks that are usually identified due to in-commercial cuts.
+     */
+    static const int MINCONTENTLEN = (int)roundf(10 * fps);
+
+    breakMap->clear();
+    for (FrameAnalyzer::FrameMap::const_iterator iiblank = blankMap->begin();
+            iiblank != blankMap->end();
+            ++iiblank)
+    {
+        long long brkb = iiblank.key();
+        long long iilen = *iiblank;
+        long long start = brkb + iilen / 2;
+
+        for (unsigned int ii = 0; ii < nbreaktypes; ii++)
+        {
+            /* Look for next blank frame that is an acceptable distance away. */
+            FrameAnalyzer::FrameMap::const_iterator jjblank = iiblank;
+            for (++jjblank; jjblank != blankMap->end(); ++jjblank)
+            {
+                long long brke = jjblank.key();
+                long long jjlen = *jjblank;
+                long long end = brke + jjlen / 2;
+
+                long long testlen = (long long)roundf((end - start) / fps);
+                if (testlen > breaktype[ii].len + breaktype[ii].delta)
+                    break;      /* Too far ahead; break to next break length. */
+                if (absLongLong(testlen - breaktype[ii].len)
+                        > breaktype[ii].delta)
+                    continue;   /* Outside delta range; try next end-blank. */
+
+                /* Mark this commercial break. */
+                bool inserted = false;
+                for (unsigned int jj = 0;; jj++)
+                {
+                    long long newbrkb = brkb + jj;
+                    if (newbrkb >= brke)
+                    {
+                        VERBOSE(VB_COMMFLAG,
+                            QString("%1 [%2,%3] ran out of slots")
+                                .arg(comment).arg(brkb).arg(brke - 1));
+                        break;
+                    }
+                    if (breakMap->find(newbrkb) == breakMap->end())
+                    {
+                        breakMap->insert(newbrkb, brke - newbrkb);
+                        inserted = true;
+                        break;
+                    }
+                }
+                if (inserted)
+                    break;  /* next break type */
+            }
+        }
+    }
+
+    if (debugLevel >= 1)
+    {
+        frameAnalyzerReportMap(breakMap, fps,
+                QString("%1 Break").arg(comment).toAscii().constData());
+        VERBOSE(VB_COMMFLAG, QString("%1 coalescing overlapping/nearby"
+                    " breaks ...").arg(comment));
+    }
+
+    /*
+     * Coalesce overlapping or very-nearby breaks (handles cut-scenes within a
+     * commercial).
+     */
+    for (;;)
+    {
+        bool coalesced = false;
+        FrameAnalyzer::FrameMap::iterator iibreak = breakMap->begin();
+        while (iibreak != breakMap->end())
+        {
+            long long iib = iibreak.key();
+            long long iie = iib + *iibreak;
+
+            FrameAnalyzer::FrameMap::iterator jjbreak = iibreak;
+            ++jjbreak;
+            if (jjbreak == breakMap->end())
+                break;
+
+            long long jjb = jjbreak.key();
+            long long jje = jjb + *jjbreak;
+
+            if (jjb < iib)
+            {
+                /* (jjb,jje) is behind (iib,iie). */
+                ++iibreak;
+                continue;
+            }
+
+            if (iie + MINCONTENTLEN < jjb)
+            {
+                /* (jjb,jje) is too far ahead. */
+                ++iibreak;
+                continue;
+            }
+
+            /* Coalesce. */
+            if (jje > iie)
+            {
+                breakMap->remove(iib);             /* overlap */
+                breakMap->insert(iib, jje - iib);  /* overlap */
+            }
+            breakMap->erase(jjbreak);
+            coalesced = true;
+            iibreak = breakMap->find(iib);
+        }
+        if (!coalesced)
+            break;
+    }
+
+    /* Adjust for skipcommblanks configuration. */
+    FrameAnalyzer::FrameMap::iterator iibreak = breakMap->begin();
+    while (iibreak != breakMap->end())
+    {
+        long long iib = iibreak.key();
+        long long iie = iib + *iibreak;
+
+        if (!skipcommblanks)
+        {
+            /* Trim leading blanks from commercial break. */
+            FrameAnalyzer::FrameMap::const_iterator iiblank =
+                blankMap->find(iib);
+            FrameAnalyzer::FrameMap::iterator jjbreak = iibreak;
+            ++jjbreak;
+            iib += *iiblank;
+            breakMap->erase(iibreak);
+            breakMap->insert(iib, iie - iib);
+            iibreak = jjbreak;
+        }
+        else
+        {
+            /* Add trailing blanks to commercial break. */
+            ++iibreak;
+            FrameAnalyzer::FrameMap::const_iterator jjblank =
+                blankMap->find(iie);
+            iie += *jjblank;
+            breakMap->remove(iib);
+            breakMap->insert(iib, iie - iib);
+        }
+    }
+}
+
 FrameAnalyzer::FrameMap::const_iterator
 frameMapSearchForwards(const FrameAnalyzer::FrameMap *frameMap, long long mark,
     long long markend)
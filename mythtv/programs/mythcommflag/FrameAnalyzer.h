@@ -87,6 +87,10 @@ bool removeShortBreaks(FrameAnalyzer::FrameMap *breakMap, float fps,
 bool removeShortSegments(FrameAnalyzer::FrameMap *breakMap, long long nframes,
     float fps, int minseglen, bool verbose);
 
+void computeBreakMap(FrameAnalyzer::FrameMap *breakMap,
+        const FrameAnalyzer::FrameMap *blankMap, float fps,
+        bool skipcommblanks, int debugLevel, const char *comment);
+
 FrameAnalyzer::FrameMap::const_iterator frameMapSearchForwards(
         const FrameAnalyzer::FrameMap *frameMap, long long mark,
         long long markend);
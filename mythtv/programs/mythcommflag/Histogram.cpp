@@ -20,7 +20,11 @@ void Histogram::generateFromImage(unsigned char* frame, unsigned int frameWidth,
          unsigned int minScanY, unsigned int maxScanY, unsigned int XSpacing,
          unsigned int YSpacing)
 {
-    memset(data,0,sizeof(data));
+    // Count into several tables, so that runs of equal pixels don't make
+    // each increment wait for the previous one to be stored.
+    unsigned int counts[4][256];
+
+    memset(counts,0,sizeof(counts));
     numberOfSamples = 0;
 
     if (maxScanX > frameWidth-1)
@@ -30,11 +34,28 @@ void Histogram::generateFromImage(unsigned char* frame, unsigned int frameWidth,
         maxScanY = frameHeight-1;
 
     for(unsigned int y = minScanY; y < maxScanY; y += YSpacing)
-        for(unsigned int x = minScanX; x < maxScanX; x += XSpacing)
+    {
+        const unsigned char *row = frame + y * frameWidth;
+        unsigned int x = minScanX;
+
+        for(; x + 3 * XSpacing < maxScanX; x += 4 * XSpacing)
+        {
+            counts[0][row[x]]++;
+            counts[1][row[x + XSpacing]]++;
+            counts[2][row[x + 2 * XSpacing]]++;
+            counts[3][row[x + 3 * XSpacing]]++;
+            numberOfSamples += 4;
+        }
+
+        for(; x < maxScanX; x += XSpacing)
         {
-            data[frame[y * frameWidth + x]]++;
+            counts[0][row[x]]++;
             numberOfSamples++;
         }
+    }
+
+    for(int i = 0; i < 256; i++)
+        data[i] = counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i];
 }
 
 unsigned int Histogram::getAverageIntensity(void) const
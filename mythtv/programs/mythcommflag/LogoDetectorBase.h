@@ -14,8 +14,10 @@ class LogoDetectorBase : public QObject
         foundLogo(false), width(w),height(h) {};
 
     virtual bool searchForLogo(MythPlayer* player) = 0;
-    virtual bool doesThisFrameContainTheFoundLogo(unsigned char* frame) = 0;
-    virtual bool pixelInsideLogo(unsigned int x, unsigned int y) = 0;
+    /// Must not change the detector, it is called from several threads
+    virtual bool doesThisFrameContainTheFoundLogo(
+        unsigned char* frame) const = 0;
+    virtual bool pixelInsideLogo(unsigned int x, unsigned int y) const = 0;
     virtual unsigned int getRequiredAvailableBufferForSearch() = 0;
 
   signals:
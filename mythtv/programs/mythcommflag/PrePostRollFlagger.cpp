@@ -16,7 +16,7 @@ PrePostRollFlagger::PrePostRollFlagger(SkipType commDetectMethod,
                             const QDateTime& recordingStopsAt_in):
     ClassicCommDetector( commDetectMethod,  showProgress,  fullSpeed,
         player,          startedAt_in,      stopsAt_in,
-        recordingStartedAt_in,              recordingStopsAt_in),
+        recordingStartedAt_in,              recordingStopsAt_in, 1),
         myTotalFrames(0),                   closestAfterPre(0),
         closestBeforePre(0),                closestAfterPost(0),
         closestBeforePost(0)
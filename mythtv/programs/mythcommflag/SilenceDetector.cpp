@@ -0,0 +1,333 @@
+// ANSI C headers
+#include <cstring>
+#include <cmath>
+
+// C++ headers
+#include <algorithm>
+using namespace std;
+
+// MythTV headers
+#include "mythcorecontext.h"    /* gContext */
+#include "mythverbose.h"
+#include "mythplayer.h"
+
+// Commercial Flagging headers
+#include "CommDetector2.h"
+#include "FrameAnalyzer.h"
+#include "SilenceDetector.h"
+
+using namespace commDetector2;
+using namespace frameAnalyzer;
+
+namespace {
+
+/* Loudness (dBFS) of frames without any audio. */
+const float NOAUDIODB = -1000.0f;
+
+void
+computeLoudness(vector<float> *loudness, const vector<double> &energy,
+        const vector<int> &nsamples)
+{
+    for (unsigned int frameno = 0; frameno < loudness->size(); frameno++)
+    {
+        if (!nsamples[frameno])
+        {
+            (*loudness)[frameno] = NOAUDIODB;
+            continue;
+        }
+
+        /* RMS level; floor digital silence at -100 dBFS. */
+        double meansquare = energy[frameno] / nsamples[frameno];
+        (*loudness)[frameno] = 10 * log10(max(meansquare, 1e-10));
+    }
+}
+
+float
+computeThreshold(const vector<float> &loudness)
+{
+    /*
+     * TUNABLE:
+     *
+     * Frames quieter than MAXSILENCEDB, or SILENCEBELOWMEDIAN quieter than
+     * the median frame of the recording, are silent.
+     */
+    const float MAXSILENCEDB = -50.0f;
+    const float SILENCEBELOWMEDIAN = 30.0f;
+
+    vector<float> audible;
+    audible.reserve(loudness.size());
+    for (unsigned int frameno = 0; frameno < loudness.size(); frameno++)
+    {
+        if (loudness[frameno] > NOAUDIODB)
+            audible.push_back(loudness[frameno]);
+    }
+    if (audible.empty())
+        return MAXSILENCEDB;
+
+    vector<float>::iterator median = audible.begin() + audible.size() / 2;
+    nth_element(audible.begin(), median, audible.end());
+    return min(MAXSILENCEDB, *median - SILENCEBELOWMEDIAN);
+}
+
+bool
+isSilent(float loudness, float threshold)
+{
+    return loudness > NOAUDIODB && loudness < threshold;
+}
+
+void
+computeSilenceMap(FrameAnalyzer::FrameMap *silenceMap,
+        const vector<float> &loudness, float threshold, float fps)
+{
+    /*
+     * TUNABLE:
+     *
+     * Shortest silence worth considering; anything shorter is a pause in
+     * speech.
+     */
+    const long long MINSILENCELEN = max(1, (int)roundf(0.1 * fps));
+
+    const long long nframes = loudness.size();
+    long long segb = -1;
+
+    silenceMap->clear();
+    for (long long frameno = 0; frameno <= nframes; frameno++)
+    {
+        bool silent = frameno < nframes &&
+            isSilent(loudness[frameno], threshold);
+        if (silent && segb < 0)
+        {
+            segb = frameno;
+        }
+        else if (!silent && segb >= 0)
+        {
+            if (frameno - segb >= MINSILENCELEN)
+                silenceMap->insert(segb, frameno - segb);
+            segb = -1;
+        }
+    }
+}
+
+bool
+nearSilence(const FrameAnalyzer::FrameMap *silenceMap, long long frameno,
+        long long window)
+{
+    FrameAnalyzer::FrameMap::const_iterator next =
+        silenceMap->upperBound(frameno);
+    if (next != silenceMap->constEnd() && next.key() - frameno <= window)
+        return true;
+    if (next == silenceMap->constBegin())
+        return false;
+    --next;
+    return next.key() + *next + window >= frameno;
+}
+
+void
+computeStepMap(FrameAnalyzer::FrameMap *stepMap,
+        const vector<float> &loudness, float threshold, float fps,
+        const FrameAnalyzer::FrameMap *silenceMap)
+{
+    /*
+     * TUNABLE:
+     *
+     * A change of at least MINSTEPDB between the average loudness of the
+     * STEPWINDOW before and after a frame is a loudness step (commercials
+     * tend to be mastered louder than programs). Silent frames are left out
+     * of the averages; steps next to silences are already covered by them.
+     */
+    const float     MINSTEPDB = 9.0f;
+    const long long STEPWINDOW = max(1, (int)roundf(2 * fps));  /* frames */
+
+    const long long nframes = loudness.size();
+
+    stepMap->clear();
+    if (nframes < 2 * STEPWINDOW)
+        return;
+
+    /* Running sums of audible frames. */
+    vector<double> sum(nframes + 1, 0);
+    vector<long long> count(nframes + 1, 0);
+    for (long long frameno = 0; frameno < nframes; frameno++)
+    {
+        bool audible = loudness[frameno] >= threshold;
+        sum[frameno + 1] = sum[frameno] + (audible ? loudness[frameno] : 0);
+        count[frameno + 1] = count[frameno] + (audible ? 1 : 0);
+    }
+
+    vector<float> step(nframes, 0);
+    for (long long frameno = STEPWINDOW; frameno <= nframes - STEPWINDOW;
+            frameno++)
+    {
+        long long nbefore = count[frameno] - count[frameno - STEPWINDOW];
+        long long nafter = count[frameno + STEPWINDOW] - count[frameno];
+        if (nbefore < STEPWINDOW / 2 || nafter < STEPWINDOW / 2)
+            continue;
+
+        double before = (sum[frameno] - sum[frameno - STEPWINDOW]) / nbefore;
+        double after = (sum[frameno + STEPWINDOW] - sum[frameno]) / nafter;
+        step[frameno] = fabs(after - before);
+    }
+
+    /* Keep the largest step within each window. */
+    for (long long frameno = 0; frameno < nframes; frameno++)
+    {
+        if (step[frameno] < MINSTEPDB)
+            continue;
+
+        long long bb = max(0LL, frameno - STEPWINDOW);
+        long long ee = min(nframes, frameno + STEPWINDOW + 1);
+        bool peak = true;
+        for (long long ii = bb; ii < ee && peak; ii++)
+        {
+            peak = step[ii] < step[frameno] ||
+                (step[ii] == step[frameno] && ii >= frameno);
+        }
+
+        if (peak && !nearSilence(silenceMap, frameno, STEPWINDOW))
+            stepMap->insert(frameno, 0);
+    }
+}
+
+};  /* namespace */
+
+SilenceDetector::SilenceDetector(void)
+    : AudioAnalyzer()
+    , fps(0.0f)
+    , lastframeno(0)
+    , debugLevel(0)
+{
+    skipcommblanks = gCoreContext->GetNumSetting("CommSkipAllBlanks", 1) != 0;
+
+    memset(&analyze_time, 0, sizeof(analyze_time));
+
+    /*
+     * debugLevel:
+     *      0: no debugging
+     *      2: extra verbosity [O(nframes)]
+     */
+    debugLevel = gCoreContext->GetNumSetting("SilenceDetectorDebugLevel", 0);
+}
+
+enum FrameAnalyzer::analyzeFrameResult
+SilenceDetector::MythPlayerInited(MythPlayer *player, long long nframes)
+{
+    fps = player->GetFrameRate();
+
+    energy.clear();
+    nsamples.clear();
+    energy.reserve(nframes);
+    nsamples.reserve(nframes);
+    lastframeno = 0;
+
+    VERBOSE(VB_COMMFLAG, QString("SilenceDetector::MythPlayerInited %1 fps")
+            .arg(fps, 0, 'f', 2));
+
+    return FrameAnalyzer::ANALYZE_OK;
+}
+
+enum FrameAnalyzer::analyzeFrameResult
+SilenceDetector::analyzeAudio(const float *samples, int nn, long long frameno)
+{
+    /* Audio already analyzed, e.g., decoded again after a seek. */
+    if (frameno < lastframeno)
+        return FrameAnalyzer::ANALYZE_OK;
+
+    struct timeval start, end, elapsed;
+    (void)gettimeofday(&start, NULL);
+
+    if (frameno >= (long long)energy.size())
+    {
+        energy.resize(frameno + 1, 0);
+        nsamples.resize(frameno + 1, 0);
+    }
+
+    double sum = 0;
+    for (int ii = 0; ii < nn; ii++)
+        sum += samples[ii] * samples[ii];
+
+    energy[frameno] += sum;
+    nsamples[frameno] += nn;
+    lastframeno = frameno;
+
+    (void)gettimeofday(&end, NULL);
+    timersub(&end, &start, &elapsed);
+    timeradd(&analyze_time, &elapsed, &analyze_time);
+
+    return FrameAnalyzer::ANALYZE_OK;
+}
+
+int
+SilenceDetector::finished(long long nframes, bool final)
+{
+    (void)final;
+
+    nframes = min(nframes, (long long)energy.size());
+
+    vector<float> loudness(nframes);
+    computeLoudness(&loudness, energy, nsamples);
+    float threshold = computeThreshold(loudness);
+
+    computeSilenceMap(&silenceMap, loudness, threshold, fps);
+    computeStepMap(&stepMap, loudness, threshold, fps, &silenceMap);
+
+    separatorMap = silenceMap;
+    for (FrameAnalyzer::FrameMap::const_iterator ii = stepMap.constBegin();
+            ii != stepMap.constEnd();
+            ++ii)
+        separatorMap.insert(ii.key(), *ii);
+
+    FrameAnalyzer::FrameMap::const_iterator last = separatorMap.constEnd();
+    if (nframes && (last == separatorMap.constBegin() ||
+                (--last).key() + *last < nframes))
+    {
+        /*
+         * Didn't end on a silence, so add a dummy separator at the end (see
+         * BlankFrameDetector).
+         */
+        separatorMap.insert(nframes - 1, 0);
+    }
+
+    breakMap.clear();
+
+    VERBOSE(VB_COMMFLAG, QString("SilenceDetector::finished(%1): silence"
+                " below %2 dBFS, %3 silences, %4 loudness steps")
+            .arg(nframes).arg(threshold, 0, 'f', 1)
+            .arg(silenceMap.size()).arg(stepMap.size()));
+    if (debugLevel >= 2)
+    {
+        frameAnalyzerReportMapms(&silenceMap, fps, "SD Silence");
+        frameAnalyzerReportMap(&stepMap, fps, "SD Step");
+    }
+
+    return 0;
+}
+
+int
+SilenceDetector::computeBreaks(FrameAnalyzer::FrameMap *breaks)
+{
+    if (breakMap.empty())
+    {
+        /* Compute breaks (breakMap). */
+        computeBreakMap(&breakMap, &separatorMap, fps, skipcommblanks,
+                debugLevel, "SD");
+        frameAnalyzerReportMap(&breakMap, fps, "SD Break");
+    }
+
+    breaks->clear();
+    for (FrameAnalyzer::FrameMap::Iterator bb = breakMap.begin();
+            bb != breakMap.end();
+            ++bb)
+        breaks->insert(bb.key(), *bb);
+
+    return 0;
+}
+
+int
+SilenceDetector::reportTime(void) const
+{
+    VERBOSE(VB_COMMFLAG, QString("SD Time: analyze=%1s")
+            .arg(strftimeval(&analyze_time)));
+    return 0;
+}
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -0,0 +1,60 @@
+/*
+ * SilenceDetector
+ *
+ * Detect silences and loudness steps in the audio.
+ */
+
+#ifndef __SILENCEDETECTOR_H__
+#define __SILENCEDETECTOR_H__
+
+#include <sys/time.h>
+
+#include <vector>
+using namespace std;
+
+#include "AudioAnalyzer.h"
+
+class SilenceDetector : public AudioAnalyzer
+{
+public:
+    /* Ctor/dtor. */
+    SilenceDetector(void);
+
+    /* AudioAnalyzer interface. */
+    const char *name(void) const { return "SilenceDetector"; }
+    enum FrameAnalyzer::analyzeFrameResult MythPlayerInited(
+            MythPlayer *player, long long nframes);
+    enum FrameAnalyzer::analyzeFrameResult analyzeAudio(
+            const float *samples, int nsamples, long long frameno);
+    int finished(long long nframes, bool final);
+    int reportTime(void) const;
+    FrameAnalyzer::FrameMap GetMap(unsigned int index) const
+        { return index == 2 ? stepMap : index == 1 ? silenceMap : breakMap; }
+
+    /* SilenceDetector interface. */
+    const FrameAnalyzer::FrameMap *getSilences(void) const
+        { return &silenceMap; }
+    int computeBreaks(FrameAnalyzer::FrameMap *breaks);
+
+private:
+    float                   fps;
+    bool                    skipcommblanks;         /* skip commercial blanks */
+
+    /* per-frame sum of squares and number of samples */
+    vector<double>          energy;
+    vector<int>             nsamples;
+    long long               lastframeno;
+
+    FrameAnalyzer::FrameMap silenceMap;
+    FrameAnalyzer::FrameMap stepMap;
+    FrameAnalyzer::FrameMap separatorMap;           /* silences and steps */
+    FrameAnalyzer::FrameMap breakMap;
+
+    /* Debugging */
+    int                     debugLevel;
+    struct timeval          analyze_time;
+};
+
+#endif  /* !__SILENCEDETECTOR_H__ */
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
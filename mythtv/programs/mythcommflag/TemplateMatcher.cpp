@@ -27,11 +27,49 @@ using namespace std;
 #include "TemplateFinder.h"
 #include "TemplateMatcher.h"
 
+#ifdef PGM_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace commDetector2;
 using namespace frameAnalyzer;
 
 namespace {
 
+#ifdef PGM_SSE2
+int
+count_set_sse2(const unsigned char *pp, const unsigned char *andpp, int size)
+{
+    /*
+     * Return the number of non-zero bytes in "pp", only counting those
+     * whose counterpart in "andpp" is also non-zero when it is given.
+     */
+    const __m128i   zero = _mm_setzero_si128();
+    const __m128i   one = _mm_set1_epi8(1);
+    __m128i         sum = zero;
+    int             score, ii;
+
+    for (ii = 0; ii + 16 <= size; ii += 16)
+    {
+        __m128i unset = _mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(pp + ii)), zero);
+        if (andpp)
+            unset = _mm_or_si128(unset, _mm_cmpeq_epi8(
+                        _mm_loadu_si128((const __m128i *)(andpp + ii)), zero));
+        sum = _mm_add_epi64(sum,
+                _mm_sad_epu8(_mm_andnot_si128(unset, one), zero));
+    }
+
+    score = _mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+    for (; ii < size; ii++)
+    {
+        if (pp[ii] && (!andpp || andpp[ii]))
+            score++;
+    }
+    return score;
+}
+#endif /* PGM_SSE2 */
+
 int
 pgm_set(const AVPicture *pict, int height)
 {
@@ -39,6 +77,11 @@ pgm_set(const AVPicture *pict, int height)
     const int   size = height * width;
     int         score, ii;
 
+#ifdef PGM_SSE2
+    if (pgm_use_sse2())
+        return count_set_sse2(pict->data[0], NULL, size);
+#endif /* PGM_SSE2 */
+
     score = 0;
     for (ii = 0; ii < size; ii++)
         if (pict->data[0][ii])
@@ -61,6 +104,16 @@ pgm_match(const AVPicture *tmpl, const AVPicture *test, int height,
         return -1;
     }
 
+#ifdef PGM_SSE2
+    /* Without any jitter this is just an AND of the two images. */
+    if (!radius && pgm_use_sse2())
+    {
+        *pscore = count_set_sse2(tmpl->data[0], test->data[0],
+                height * width);
+        return 0;
+    }
+#endif /* PGM_SSE2 */
+
     score = 0;
     for (rr = 0; rr < height; rr++)
     {
@@ -0,0 +1,398 @@
+/*
+ * commflag-kernelbench
+ *
+ * Times the image kernels used by the CommDetector2 analyzers on a synthetic
+ * frame, and checks that their SSE2 versions give exactly the same output as
+ * the C versions.
+ *
+ * Usage: commflag-kernelbench [width height [iterations]]
+ *
+ * Exits with 0 when all outputs match, 1 on a mismatch and 2 on an error.
+ */
+
+// POSIX headers
+#include <sys/time.h> // for gettimeofday
+
+// ANSI C headers
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+// C++ headers
+#include <algorithm>
+using namespace std;
+
+// avlib/ffmpeg headers
+extern "C" {
+#include "libavcodec/avcodec.h"        // AVPicture
+}
+
+// Commercial Flagging headers
+#include "pgm.h"
+#include "EdgeDetector.h"
+#include "Histogram.h"
+
+using namespace edgeDetector;
+
+namespace {
+
+/* Same edge parameters as CannyEdgeDetector and TemplateFinder. */
+const double    SIGMA = 0.5;
+const int       TRUNCATION = 4;
+const int       PERCENTILE = 95;
+
+enum { KERNEL_CONVOLVE, KERNEL_SGM, KERNEL_EDGES, KERNEL_HISTOGRAM, NKERNELS };
+
+/* pgm_convolve_radial, sgm_init_exclude, edge_mark, Histogram */
+const char *kernelNames[NKERNELS] = {
+    "convolve",
+    "sgm",
+    "edge_mark",
+    "histogram",
+};
+
+struct Buffers
+{
+    AVPicture       s1, s2, convolved, edges;
+    unsigned int    *sgm;
+    unsigned int    *sgmsorted;
+};
+
+double *
+gaussian_mask(int *pradius)
+{
+    /* Same computation as CannyEdgeDetector::CannyEdgeDetector. */
+    const double    TWO_SIGMA2 = 2 * SIGMA * SIGMA;
+    const int       radius = max(2, (int)roundf(TRUNCATION * SIGMA));
+    double          *mask = new double[2 * radius + 1];
+    double          val, sum;
+    int             rr, ii;
+
+    mask[radius] = 1.0;
+    sum = 1.0;
+    for (rr = 1; rr <= radius; rr++)
+    {
+        val = exp(-(rr * rr) / TWO_SIGMA2);
+        mask[radius + rr] = val;
+        mask[radius - rr] = val;
+        sum += 2 * val;
+    }
+    for (ii = 0; ii < 2 * radius + 1; ii++)
+        mask[ii] /= sum;
+
+    *pradius = radius;
+    return mask;
+}
+
+void
+make_frame(AVPicture *pgm, int width, int height)
+{
+    /*
+     * A gradient with a few flat boxes and some noise, so that the edge
+     * detector has both strong and weak edges to sort.
+     */
+    unsigned int    seed = 12345;
+    int             rr, cc, bb;
+
+    for (rr = 0; rr < height; rr++)
+    {
+        for (cc = 0; cc < width; cc++)
+        {
+            int val = 16 + (rr * 96) / height + (cc * 64) / width;
+
+            for (bb = 0; bb < 6; bb++)
+            {
+                int top = (bb * height) / 7;
+                int left = ((bb * 5) % 7) * width / 8;
+                if (rr >= top && rr < top + height / 5 &&
+                        cc >= left && cc < left + width / 6)
+                    val = 40 + bb * 35;
+            }
+
+            seed = seed * 1103515245 + 12345;
+            val += (int)((seed >> 16) % 17) - 8;
+            pgm->data[0][rr * width + cc] =
+                (unsigned char)max(0, min(255, val));
+        }
+    }
+}
+
+int
+alloc_buffers(Buffers *bufs, int width, int height, int radius)
+{
+    const int   padded_width = width + 2 * radius;
+    const int   padded_height = height + 2 * radius;
+
+    memset(bufs, 0, sizeof(*bufs));
+    if (avpicture_alloc(&bufs->s1, PIX_FMT_GRAY8, padded_width, padded_height) ||
+        avpicture_alloc(&bufs->s2, PIX_FMT_GRAY8, padded_width, padded_height) ||
+        avpicture_alloc(&bufs->convolved, PIX_FMT_GRAY8,
+            padded_width, padded_height) ||
+        avpicture_alloc(&bufs->edges, PIX_FMT_GRAY8, width, height))
+    {
+        return -1;
+    }
+    bufs->sgm = new unsigned int[padded_width * padded_height];
+    bufs->sgmsorted = new unsigned int[width * height];
+    return 0;
+}
+
+void
+free_buffers(Buffers *bufs)
+{
+    avpicture_free(&bufs->edges);
+    avpicture_free(&bufs->convolved);
+    avpicture_free(&bufs->s2);
+    avpicture_free(&bufs->s1);
+    delete []bufs->sgmsorted;
+    delete []bufs->sgm;
+}
+
+double
+elapsed_ms(const struct timeval *start)
+{
+    struct timeval  now;
+
+    (void)gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000.0 +
+        (now.tv_usec - start->tv_usec) / 1000.0;
+}
+
+int
+run_kernels(const AVPicture *pgm, int width, int height,
+        const double *mask, int radius, Buffers *bufs, Histogram *histogram,
+        int iterations, double times[NKERNELS])
+{
+    /* Exclude a logo-sized area, as TemplateMatcher does. */
+    const int       excluderow = height / 12;
+    const int       excludecol = width * 3 / 4;
+    const int       excludewidth = width / 6;
+    const int       excludeheight = height / 8;
+    struct timeval  start;
+    int             ii;
+
+    memset(times, 0, NKERNELS * sizeof(*times));
+    for (ii = 0; ii < iterations; ii++)
+    {
+        (void)gettimeofday(&start, NULL);
+        if (pgm_convolve_radial(&bufs->convolved, &bufs->s1, &bufs->s2,
+                    pgm, height, mask, radius))
+            return -1;
+        times[KERNEL_CONVOLVE] += elapsed_ms(&start);
+
+        (void)gettimeofday(&start, NULL);
+        sgm_init_exclude(bufs->sgm, &bufs->convolved, height + 2 * radius,
+                excluderow + radius, excludecol + radius,
+                excludewidth, excludeheight);
+        times[KERNEL_SGM] += elapsed_ms(&start);
+
+        (void)gettimeofday(&start, NULL);
+        if (edge_mark_uniform_exclude(&bufs->edges, height, radius,
+                    bufs->sgm, bufs->sgmsorted, PERCENTILE,
+                    excluderow, excludecol, excludewidth, excludeheight))
+            return -1;
+        times[KERNEL_EDGES] += elapsed_ms(&start);
+
+        (void)gettimeofday(&start, NULL);
+        histogram->generateFromImage(pgm->data[0], width, height,
+                0, width, 0, height, 1, 1);
+        times[KERNEL_HISTOGRAM] += elapsed_ms(&start);
+    }
+
+    for (ii = 0; ii < NKERNELS; ii++)
+        times[ii] /= iterations;
+    return 0;
+}
+
+int
+count_diffs(const unsigned char *aa, const unsigned char *bb, int size)
+{
+    int ndiffs = 0;
+    for (int ii = 0; ii < size; ii++)
+        if (aa[ii] != bb[ii])
+            ndiffs++;
+    return ndiffs;
+}
+
+int
+check_histogram(const Histogram *histogram, const AVPicture *pgm,
+        int width, int height)
+{
+    /*
+     * Histogram has no SSE2 version; check its multi-table counting against
+     * a plain count over the same pixels instead.
+     */
+    long            counts[256];
+    long            nsamples = 0, sum = 0, value;
+    int             rr, cc, ii, ndiffs = 0;
+
+    memset(counts, 0, sizeof(counts));
+    for (rr = 0; rr < height - 1; rr++)
+    {
+        for (cc = 0; cc < width - 1; cc++)
+        {
+            counts[pgm->data[0][rr * width + cc]]++;
+            nsamples++;
+        }
+    }
+
+    for (ii = 0; ii < 256; ii++)
+        sum += counts[ii] * ii;
+    if (histogram->getAverageIntensity() != (unsigned int)(sum / nsamples))
+        ndiffs++;
+
+    for (int pct = 5; pct < 100; pct += 5)
+    {
+        const float percentage = pct / 100.0f;
+        unsigned int threshold = 0;
+
+        value = 0;
+        for (ii = 255; ii != 0; ii--)
+        {
+            if (value > percentage * nsamples)
+            {
+                threshold = ii;
+                break;
+            }
+            value += counts[ii];
+        }
+        if (histogram->getThresholdForPercentageOfPixels(percentage) !=
+                threshold)
+            ndiffs++;
+    }
+
+    return ndiffs;
+}
+
+void
+print_times(const char *label, const double times[NKERNELS])
+{
+    printf("%-6s", label);
+    for (int ii = 0; ii < NKERNELS; ii++)
+        printf(" %10.3f", times[ii]);
+    printf("  ms/frame\n");
+}
+
+};  /* namespace */
+
+int
+main(int argc, char **argv)
+{
+    int         width = 720, height = 480, iterations = 200;
+    int         radius, ii, ndiffs;
+    double      ctimes[NKERNELS], simdtimes[NKERNELS];
+    AVPicture   pgm;
+    Buffers     cbufs, simdbufs;
+    Histogram   chistogram, simdhistogram;
+
+    if (argc == 3 || argc == 4)
+    {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+        if (argc == 4)
+            iterations = atoi(argv[3]);
+    }
+    else if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s [width height [iterations]]\n", argv[0]);
+        return 2;
+    }
+
+    if (width < 16 || height < 16 || iterations < 1)
+    {
+        fprintf(stderr, "%s: need width, height >= 16 and iterations >= 1\n",
+                argv[0]);
+        return 2;
+    }
+
+    double *mask = gaussian_mask(&radius);
+
+    if (avpicture_alloc(&pgm, PIX_FMT_GRAY8, width, height) ||
+        alloc_buffers(&cbufs, width, height, radius) ||
+        alloc_buffers(&simdbufs, width, height, radius))
+    {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 2;
+    }
+    make_frame(&pgm, width, height);
+
+    printf("%dx%d, %d iterations\n", width, height, iterations);
+    printf("%-6s", "");
+    for (ii = 0; ii < NKERNELS; ii++)
+        printf(" %10.10s", kernelNames[ii]);
+    printf("\n");
+
+    pgm_set_use_sse2(0);
+    if (run_kernels(&pgm, width, height, mask, radius, &cbufs, &chistogram,
+                iterations, ctimes))
+    {
+        fprintf(stderr, "%s: C kernels failed\n", argv[0]);
+        return 2;
+    }
+    print_times("C", ctimes);
+
+    ndiffs = check_histogram(&chistogram, &pgm, width, height);
+    if (ndiffs)
+        printf("Histogram: %d values differ from a plain count\n", ndiffs);
+
+    if (!pgm_set_use_sse2(1))
+    {
+        printf("SSE2 is not built or not supported by this CPU, "
+                "only the C kernels were run\n");
+    }
+    else
+    {
+        const int   padded_size = (width + 2 * radius) * (height + 2 * radius);
+        int         kdiffs;
+
+        if (run_kernels(&pgm, width, height, mask, radius, &simdbufs,
+                    &simdhistogram, iterations, simdtimes))
+        {
+            fprintf(stderr, "%s: SSE2 kernels failed\n", argv[0]);
+            return 2;
+        }
+        print_times("SSE2", simdtimes);
+
+        printf("%-6s", "x");
+        for (ii = 0; ii < NKERNELS; ii++)
+            printf(" %10.2f", simdtimes[ii] > 0 ? ctimes[ii] / simdtimes[ii] : 0);
+        printf("\n");
+
+        kdiffs = count_diffs(cbufs.convolved.data[0],
+                simdbufs.convolved.data[0], padded_size);
+        if (kdiffs)
+            printf("pgm_convolve_radial: %d pixels differ\n", kdiffs);
+        ndiffs += kdiffs;
+
+        kdiffs = count_diffs((const unsigned char *)cbufs.sgm,
+                (const unsigned char *)simdbufs.sgm,
+                padded_size * sizeof(*cbufs.sgm));
+        if (kdiffs)
+            printf("sgm_init_exclude: %d bytes differ\n", kdiffs);
+        ndiffs += kdiffs;
+
+        kdiffs = count_diffs(cbufs.edges.data[0], simdbufs.edges.data[0],
+                width * height);
+        if (kdiffs)
+            printf("edge_mark: %d pixels differ\n", kdiffs);
+        ndiffs += kdiffs;
+
+        if (simdhistogram.calculateSimilarityWith(chistogram) != 1.0f)
+        {
+            printf("Histogram: differs between runs\n");
+            ndiffs++;
+        }
+    }
+
+    printf("%s\n", ndiffs ? "MISMATCH" : "all outputs match");
+
+    free_buffers(&simdbufs);
+    free_buffers(&cbufs);
+    avpicture_free(&pgm);
+    delete []mask;
+
+    return ndiffs ? 1 : 0;
+}
+
+/* vim: set expandtab tabstop=4 shiftwidth=4: */
@@ -0,0 +1,21 @@
+# Standalone benchmark of the commercial flagging image kernels. It is not
+# part of the normal build; build and run it from this directory with
+#   qmake kernelbench.pro && make -f Makefile.kernelbench
+#   ./commflag-kernelbench [width height [iterations]]
+
+include (../../settings.pro)
+include ( ../programs-libs.pro )
+
+TEMPLATE = app
+CONFIG += thread
+TARGET = commflag-kernelbench
+MAKEFILE = Makefile.kernelbench
+OBJECTS_DIR = kernelbench-obj
+
+QMAKE_CLEAN += $(TARGET)
+
+# Input
+HEADERS += pgm.h EdgeDetector.h Histogram.h
+
+SOURCES += pgm.cpp EdgeDetector.cpp Histogram.cpp
+SOURCES += kernelbench.cpp
@@ -12,6 +12,7 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 using namespace std;
 
 // Qt headers
@@ -20,6 +21,8 @@ using namespace std;
 #include <QRegExp>
 #include <QDir>
 #include <QEvent>
+#include <QThread>
+#include <QTime>
 
 // MythTV headers
 #include "util.h"
@@ -83,6 +86,9 @@ bool showPercentage = true;
 bool fullSpeed = true;
 bool rebuildSeekTable = false;
 bool beNice = true;
+int analysisThreads = 0;
+int decodeFlags = -1;
+int compareDecodeFlags = -1;
 bool inJobQueue = false;
 bool watchingRecording = false;
 CommDetectorBase* commDetector = NULL;
@@ -138,6 +144,39 @@ static QMap<QString,OutputMethod> *init_output_types(void)
     return tmp;
 }
 
+static QMap<QString,int> *init_decode_types();
+QMap<QString,int> *decodeTypes = init_decode_types();
+
+static QMap<QString,int> *init_decode_types(void)
+{
+    QMap<QString,int> *tmp = new QMap<QString,int>;
+    (*tmp)["full"]         = kAVSpecialDecode_None;
+    (*tmp)["none"]         = kAVSpecialDecode_None;
+    (*tmp)["lowres"]       = kAVSpecialDecode_LowRes;
+    (*tmp)["noloopfilter"] = kAVSpecialDecode_NoLoopFilter;
+    (*tmp)["gray"]         = kAVSpecialDecode_GrayOnly;
+    (*tmp)["nonref"]       = kAVSpecialDecode_SkipNonRef;
+    (*tmp)["fewblocks"]    = kAVSpecialDecode_FewBlocks;
+    return tmp;
+}
+
+/// Parses a comma separated --decode list, returns -1 on an unknown name
+static int parse_decode_flags(const QString &list)
+{
+    int flags = kAVSpecialDecode_None;
+    QStringList names = list.split(",", QString::SkipEmptyParts);
+    QStringList::const_iterator it = names.begin();
+    for (; it != names.end(); ++it)
+    {
+        QMap<QString,int>::const_iterator dit =
+            decodeTypes->find((*it).toLower());
+        if (dit == decodeTypes->end())
+            return -1;
+        flags |= *dit;
+    }
+    return flags;
+}
+
 static QString get_filename(ProgramInfo *program_info)
 {
     QString filename = program_info->GetPathname();
@@ -558,11 +597,32 @@ static void incomingCustomEvent(QEvent* e)
     }
 }
 
+/// Number of threads the detectors may analyze frames with
+static uint get_analysis_threads(void)
+{
+    if (analysisThreads > 0)
+        return analysisThreads;
+
+    // Only spread out over the CPUs when not asked to give up CPU time
+    return fullSpeed ? max(QThread::idealThreadCount(), 1) : 1;
+}
+
+/// What a flagging run found, used to compare decode modes
+class FlagResult
+{
+  public:
+    FlagResult() : flagged(false), totalFrames(0) {}
+
+    bool          flagged;
+    frm_dir_map_t breaks;
+    long long     totalFrames;
+};
+
 static int DoFlagCommercials(
     ProgramInfo *program_info,
     bool showPercentage, bool fullSpeed, bool inJobQueue,
     MythCommFlagPlayer* cfp, enum SkipTypes commDetectMethod,
-    const QString &outputfilename, bool useDB)
+    const QString &outputfilename, bool useDB, FlagResult *flagResult)
 {
     CommDetectorFactory factory;
     commDetector = factory.makeCommDetector(
@@ -572,7 +632,8 @@ static int DoFlagCommercials(
         program_info->GetScheduledStartTime(),
         program_info->GetScheduledEndTime(),
         program_info->GetRecordingStartTime(),
-        program_info->GetRecordingEndTime(), useDB);
+        program_info->GetRecordingEndTime(), useDB,
+        get_analysis_threads());
 
     if (inJobQueue && useDB)
     {
@@ -618,6 +679,13 @@ static int DoFlagCommercials(
         commDetector->GetCommercialBreakList(commBreakList);
         comms_found = commBreakList.size() / 2;
 
+        if (flagResult)
+        {
+            flagResult->flagged     = true;
+            flagResult->breaks      = commBreakList;
+            flagResult->totalFrames = cfp->GetTotalFrameCount();
+        }
+
         if (!dontSubmitCommbreakListToDB)
         {
             program_info->SaveMarkupFlag(MARK_UPDATED_CUT);
@@ -650,7 +718,8 @@ static int DoFlagCommercials(
 }
 
 static int FlagCommercials(
-    ProgramInfo *program_info, const QString &outputfilename, bool useDB)
+    ProgramInfo *program_info, const QString &outputfilename, bool useDB,
+    int decode = -1, FlagResult *flagResult = NULL)
 {
     global_program_info = program_info;
 
@@ -758,10 +827,11 @@ static int FlagCommercials(
 
     PlayerContext *ctx = new PlayerContext(kFlaggerInUseID);
 
+    /* the detectors only look at the luma plane. */
     AVSpecialDecode sp = (AVSpecialDecode)
         (kAVSpecialDecode_LowRes         |
-         kAVSpecialDecode_SingleThreaded |
-         kAVSpecialDecode_NoLoopFilter);
+         kAVSpecialDecode_NoLoopFilter   |
+         kAVSpecialDecode_GrayOnly);
 
     /* blank detector needs to be only sample center for this optimization. */
     if ((COMM_DETECT_BLANKS  == commDetectMethod) ||
@@ -770,6 +840,15 @@ static int FlagCommercials(
         sp = (AVSpecialDecode) (sp | kAVSpecialDecode_FewBlocks);
     }
 
+    if (decode < 0)
+        decode = decodeFlags;
+    if (decode >= 0)
+        sp = (AVSpecialDecode) decode;
+
+    /* let the decoder use threads too when analysis is spread out. */
+    if (get_analysis_threads() <= 1)
+        sp = (AVSpecialDecode) (sp | kAVSpecialDecode_SingleThreaded);
+
     ctx->SetSpecialDecode(sp);
 
     ctx->SetPlayingInfo(program_info);
@@ -837,7 +916,7 @@ static int FlagCommercials(
 
     breaksFound = DoFlagCommercials(
         program_info, showPercentage, fullSpeed, inJobQueue,
-        cfp, commDetectMethod, outputfilename, useDB);
+        cfp, commDetectMethod, outputfilename, useDB, flagResult);
 
     if (fakeJobID >= 0)
     {
@@ -855,6 +934,96 @@ static int FlagCommercials(
     return breaksFound;
 }
 
+/// Number of frames one break list calls commercial and the other does not
+static long long count_differing_frames(
+    const frm_dir_map_t &a, const frm_dir_map_t &b, long long totalFrames)
+{
+    bool in_a = false, in_b = false;
+    long long last = 0, diff = 0;
+
+    frm_dir_map_t::const_iterator ia = a.begin();
+    frm_dir_map_t::const_iterator ib = b.begin();
+    while (ia != a.end() || ib != b.end())
+    {
+        bool take_a = (ib == b.end()) ||
+            ((ia != a.end()) && (ia.key() <= ib.key()));
+        long long frame = take_a ? ia.key() : ib.key();
+
+        if (in_a != in_b)
+            diff += frame - last;
+        last = frame;
+
+        if (take_a)
+            in_a = (MARK_COMM_START == *(ia++));
+        else
+            in_b = (MARK_COMM_START == *(ib++));
+    }
+
+    if (in_a != in_b && totalFrames > last)
+        diff += totalFrames - last;
+
+    return diff;
+}
+
+/** \brief Flags a recording with the reference decode and again with
+ *         the fast decode, and reports the time taken and how far the
+ *         flagged breaks differ. Nothing is written to the database.
+ */
+static int CompareDecodes(
+    ProgramInfo *program_info, const QString &outputfilename)
+{
+    if (program_info->GetRecordingEndTime() > QDateTime::currentDateTime())
+    {
+        VERBOSE(VB_IMPORTANT, LOC_WARN +
+                QString("Not comparing decodes for %1, "
+                        "it is still being recorded")
+                .arg(program_info->GetPathname()));
+        return COMMFLAG_EXIT_NO_ERROR_WITH_NO_BREAKS;
+    }
+
+    bool oldDontSubmit = dontSubmitCommbreakListToDB;
+    dontSubmitCommbreakListToDB = true;
+
+    FlagResult ref, fast;
+    QTime timer;
+
+    timer.start();
+    int ref_breaks = FlagCommercials(
+        program_info, outputfilename, false, compareDecodeFlags, &ref);
+    int ref_msecs = timer.elapsed();
+
+    timer.start();
+    int fast_breaks = FlagCommercials(
+        program_info, outputfilename, false, decodeFlags, &fast);
+    int fast_msecs = timer.elapsed();
+
+    dontSubmitCommbreakListToDB = oldDontSubmit;
+
+    // the exit code of a run which did not get to flag anything
+    if (!ref.flagged || !fast.flagged)
+        return (!ref.flagged) ? ref_breaks : fast_breaks;
+
+    long long total = max(ref.totalFrames, fast.totalFrames);
+    long long diff  = count_differing_frames(ref.breaks, fast.breaks, total);
+
+    QString report = QString(
+        "decodeComparisonFor: %1\n"
+        "reference: %2 breaks in %3 secs\n"
+        "fast:      %4 breaks in %5 secs (%6x)\n"
+        "differingFrames: %7 of %8 (%9%)\n")
+        .arg(program_info->GetPathname())
+        .arg(ref_breaks).arg(ref_msecs * 0.001, 0, 'f', 1)
+        .arg(fast_breaks).arg(fast_msecs * 0.001, 0, 'f', 1)
+        .arg((fast_msecs > 0) ? (double) ref_msecs / fast_msecs : 0.0,
+             0, 'f', 2)
+        .arg(diff).arg(total)
+        .arg((total > 0) ? 100.0 * diff / total : 0.0, 0, 'f', 2);
+
+    cout << report.toLocal8Bit().constData() << flush;
+
+    return fast_breaks;
+}
+
 static int FlagCommercials(
     uint chanid, const QString &starttime,
     const QString &outputfilename, bool useDB)
@@ -870,7 +1039,11 @@ static int FlagCommercials(
         return COMMFLAG_EXIT_NO_PROGRAM_DATA;
     }
 
-    int ret = FlagCommercials(&pginfo, outputfilename, useDB);
+    int ret;
+    if (compareDecodeFlags >= 0)
+        ret = CompareDecodes(&pginfo, outputfilename);
+    else
+        ret = FlagCommercials(&pginfo, outputfilename, useDB);
 
     return ret;
 }
@@ -1125,6 +1298,43 @@ int main(int argc, char *argv[])
         {
             beNice = false;
         }
+        else if (!strcmp(a.argv()[argpos], "--threads"))
+        {
+            if (((argpos + 1) >= a.argc()) ||
+                !strncmp(a.argv()[argpos + 1], "--", 2))
+            {
+                VERBOSE(VB_IMPORTANT,
+                        "Missing or invalid parameters for --threads option");
+                return COMMFLAG_EXIT_INVALID_CMDLINE;
+            }
+
+            analysisThreads = QString(a.argv()[++argpos]).toInt();
+        }
+        else if (!strcmp(a.argv()[argpos], "--decode") ||
+                 !strcmp(a.argv()[argpos], "--comparedecode"))
+        {
+            bool compare = !strcmp(a.argv()[argpos], "--comparedecode");
+            if ((argpos + 1) >= a.argc())
+            {
+                cerr << "Missing argument to " << a.argv()[argpos]
+                     << " option\n";
+                return COMMFLAG_EXIT_INVALID_CMDLINE;
+            }
+
+            QString list = a.argv()[++argpos];
+            int flags = parse_decode_flags(list);
+            if (flags < 0)
+            {
+                cerr << "Failed to decode --decode option '"
+                     << list.toLocal8Bit().constData() << "'" << endl;
+                return COMMFLAG_EXIT_INVALID_CMDLINE;
+            }
+
+            if (compare)
+                compareDecodeFlags = flags;
+            else
+                decodeFlags = flags;
+        }
         else if (!strcmp(a.argv()[argpos], "--dontwritetodb"))
         {
             dontSubmitCommbreakListToDB = true;
@@ -1225,6 +1435,14 @@ int main(int argc, char *argv[])
                     "--outputmethod <method>      format of output written to outputfile: essentials,full\n"
                     "--hogcpu                     Do not nice the flagging process.\n"
                     "                             WARNING: This will consume all free CPU time.\n"
+                    "--threads <n>                Analyze frames on <n> threads (default is one per\n"
+                    "                             CPU, or 1 with --sleep or a low JobQueueCPU)\n"
+                    "--decode <list>              Decoder shortcuts to flag with, comma separated\n"
+                    "                             full, lowres, noloopfilter, gray, nonref, fewblocks\n"
+                    "                             (default is lowres,noloopfilter,gray)\n"
+                    "--comparedecode <list>       Flag with <list> and again with --decode, and\n"
+                    "                             report the time taken and how the breaks differ.\n"
+                    "                             Nothing is written to the database.\n"
                     "--skipdb                     Avoid DB usage\n"
                     "-h OR --help                 This text\n\n"
                     "Note: both --chanid and --starttime must be used together\n"
@@ -1442,7 +1660,10 @@ int main(int argc, char *argv[])
             }
         }
 
-        result = FlagCommercials(pginfo, outputfilename, useDB);
+        if (compareDecodeFlags >= 0)
+            result = CompareDecodes(pginfo, outputfilename);
+        else
+            result = FlagCommercials(pginfo, outputfilename, useDB);
 
         delete pginfo;
         delete pmap;
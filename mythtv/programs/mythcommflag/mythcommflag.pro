@@ -19,11 +19,12 @@ HEADERS += CommDetector2.h
 HEADERS += pgm.h
 HEADERS += EdgeDetector.h CannyEdgeDetector.h
 HEADERS += PGMConverter.h BorderDetector.h
-HEADERS += FrameAnalyzer.h
+HEADERS += FrameAnalyzer.h AudioAnalyzer.h
 HEADERS += TemplateFinder.h TemplateMatcher.h
 HEADERS += HistogramAnalyzer.h
 HEADERS += BlankFrameDetector.h
 HEADERS += SceneChangeDetector.h
+HEADERS += SilenceDetector.h
 HEADERS += PrePostRollFlagger.h
 
 HEADERS += LogoDetectorBase.h SceneChangeDetectorBase.h
@@ -44,6 +45,7 @@ SOURCES += TemplateFinder.cpp TemplateMatcher.cpp
 SOURCES += HistogramAnalyzer.cpp
 SOURCES += BlankFrameDetector.cpp
 SOURCES += SceneChangeDetector.cpp
+SOURCES += SilenceDetector.cpp
 SOURCES += PrePostRollFlagger.cpp
 
 SOURCES += main.cpp
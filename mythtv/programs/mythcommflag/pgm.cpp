@@ -1,4 +1,5 @@
 #include <climits>
+#include <cstdlib>
 
 extern "C" {
 #include "libavcodec/avcodec.h"
@@ -8,12 +9,54 @@ extern "C" {
 #include "myth_imgconvert.h"
 #include "pgm.h"
 
+#ifdef PGM_SSE2
+#include <emmintrin.h>
+extern "C" int mm_support(void);    // in libavcodec/x86/cpuid.c
+#endif
+
 /*
  * N.B.: this is really C code, but VERBOSE, #define'd in mythverbose.h, is in
  * a C++ header file, so this has to be compiled with a C++ compiler, which
  * means this has to be a C++ source file.
  */
 
+#ifdef PGM_SSE2
+static int use_sse2 = -1;
+#endif /* PGM_SSE2 */
+
+int
+pgm_use_sse2(void)
+{
+#ifdef PGM_SSE2
+    if (use_sse2 < 0)
+    {
+        use_sse2 = (mm_support() & FF_MM_SSE2) && !getenv("NO_COMMFLAG_SIMD");
+        VERBOSE(VB_COMMFLAG, QString("pgm_use_sse2 %1")
+                .arg(use_sse2 ? "using SSE2" : "using C"));
+    }
+    return use_sse2;
+#else  /* !PGM_SSE2 */
+    return 0;
+#endif /* !PGM_SSE2 */
+}
+
+int
+pgm_set_use_sse2(int enable)
+{
+    /*
+     * Select the SSE2 or the C versions regardless of NO_COMMFLAG_SIMD, so
+     * commflag-kernelbench can compare the two. SSE2 is only selected when
+     * it was built and the CPU has it. Returns the new pgm_use_sse2().
+     */
+#ifdef PGM_SSE2
+    use_sse2 = enable && (mm_support() & FF_MM_SSE2);
+    return use_sse2;
+#else  /* !PGM_SSE2 */
+    (void)enable;   /* gcc */
+    return 0;
+#endif /* !PGM_SSE2 */
+}
+
 static enum PixelFormat
 pixelTypeOfVideoFrameType(VideoFrameType codec)
 {
@@ -235,6 +278,76 @@ pgm_overlay(AVPicture *dst, const AVPicture *s1, int s1height,
     return 0;
 }
 
+#ifdef PGM_SSE2
+static inline void
+load4_pd(const unsigned char *pp, __m128d *lo, __m128d *hi)
+{
+    const __m128i   zero = _mm_setzero_si128();
+    int             word;
+    __m128i         px;
+
+    memcpy(&word, pp, sizeof(word));
+    px = _mm_unpacklo_epi16(
+            _mm_unpacklo_epi8(_mm_cvtsi32_si128(word), zero), zero);
+    *lo = _mm_cvtepi32_pd(px);
+    *hi = _mm_cvtepi32_pd(_mm_shuffle_epi32(px, _MM_SHUFFLE(1, 0, 3, 2)));
+}
+
+static inline void
+store4_pd(unsigned char *pp, __m128d lo, __m128d hi)
+{
+    const __m128d   half = _mm_set1_pd(0.5);
+    int             word;
+    __m128i         px;
+
+    /* Same rounding as the C version: add 0.5 and truncate. */
+    px = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(lo, half)),
+            _mm_cvttpd_epi32(_mm_add_pd(hi, half)));
+    px = _mm_packs_epi32(px, px);
+    px = _mm_packus_epi16(px, px);
+    word = _mm_cvtsi128_si32(px);
+    memcpy(pp, &word, sizeof(word));
+}
+
+static void
+convolve_sse2(unsigned char *dst, const unsigned char *src, int npixels,
+        int step, const double *mask, int mask_radius)
+{
+    /*
+     * Convolve "npixels" consecutive pixels with "mask" laid out "step"
+     * bytes apart. The products are summed in the same order as the C
+     * version, so the results are identical.
+     */
+    int     cc, ii;
+    double  sum;
+
+    for (cc = 0; cc + 4 <= npixels; cc += 4)
+    {
+        __m128d sumlo = _mm_setzero_pd();
+        __m128d sumhi = _mm_setzero_pd();
+
+        for (ii = -mask_radius; ii <= mask_radius; ii++)
+        {
+            __m128d weight = _mm_set1_pd(mask[ii + mask_radius]);
+            __m128d lo, hi;
+
+            load4_pd(src + cc + ii * step, &lo, &hi);
+            sumlo = _mm_add_pd(sumlo, _mm_mul_pd(weight, lo));
+            sumhi = _mm_add_pd(sumhi, _mm_mul_pd(weight, hi));
+        }
+        store4_pd(dst + cc, sumlo, sumhi);
+    }
+
+    for (; cc < npixels; cc++)
+    {
+        sum = 0;
+        for (ii = -mask_radius; ii <= mask_radius; ii++)
+            sum += mask[ii + mask_radius] * src[cc + ii * step];
+        dst[cc] = (unsigned char)(sum + 0.5);
+    }
+}
+#endif /* PGM_SSE2 */
+
 int
 pgm_convolve_radial(AVPicture *dst, AVPicture *s1, AVPicture *s2,
         const AVPicture *src, int srcheight,
@@ -267,9 +380,29 @@ pgm_convolve_radial(AVPicture *dst, AVPicture *s1, AVPicture *s2,
     av_picture_copy(s2, s1, PIX_FMT_GRAY8, newwidth, newheight);
     av_picture_copy(dst, s1, PIX_FMT_GRAY8, newwidth, newheight);
 
-    /* "s1" convolve with column vector => "s2" */
     rr2 = mask_radius + srcheight;
     cc2 = mask_radius + srcwidth;
+
+#ifdef PGM_SSE2
+    if (pgm_use_sse2())
+    {
+        const int   offset = mask_radius * newwidth + mask_radius;
+
+        for (rr = 0; rr < srcheight; rr++)
+            convolve_sse2(s2->data[0] + offset + rr * newwidth,
+                    s1->data[0] + offset + rr * newwidth,
+                    srcwidth, newwidth, mask, mask_radius);
+
+        for (rr = 0; rr < srcheight; rr++)
+            convolve_sse2(dst->data[0] + offset + rr * newwidth,
+                    s2->data[0] + offset + rr * newwidth,
+                    srcwidth, 1, mask, mask_radius);
+
+        return 0;
+    }
+#endif /* PGM_SSE2 */
+
+    /* "s1" convolve with column vector => "s2" */
     for (rr = mask_radius; rr < rr2; rr++)
     {
         for (cc = mask_radius; cc < cc2; cc++)
@@ -7,9 +7,22 @@
 #ifndef __PGM_H__
 #define __PGM_H__
 
+#include "mythconfig.h"
+
+/*
+ * SSE2 versions of the per-pixel loops are built when the compiler targets
+ * SSE2, and used when pgm_use_sse2() says the CPU has it. Setting
+ * NO_COMMFLAG_SIMD in the environment selects the C versions.
+ */
+#if HAVE_MMX && defined(__SSE2__)
+#define PGM_SSE2 1
+#endif
+
 struct VideoFrame_;
 struct AVPicture;
 
+int pgm_use_sse2(void);
+int pgm_set_use_sse2(int enable);
 int pgm_fill(struct AVPicture *dst, const struct VideoFrame_ *frame);
 int pgm_read(unsigned char *buf, int width, int height, const char *filename);
 int pgm_write(const unsigned char *buf, int width, int height,
@@ -2989,6 +2989,18 @@ static GlobalCheckBox *GRSchedMoveHigher()
     return bc;
 }
 
+static GlobalCheckBox *GRSchedInMemoryMatch()
+{
+    GlobalCheckBox *bc = new GlobalCheckBox("SchedInMemoryMatch");
+    bc->setLabel(QObject::tr("Match recording rules in memory"));
+    bc->setHelpText(QObject::tr("Match title, keyword and manual recording "
+                    "rules against the program guide inside the backend "
+                    "instead of with one database query per rule. Power "
+                    "and people searches always use the database."));
+    bc->setValue(true);
+    return bc;
+}
+
 static GlobalComboBox *GRSchedOpenEnd()
 {
     GlobalComboBox *bc = new GlobalComboBox("SchedOpenEnd");
@@ -4279,6 +4291,7 @@ GeneralRecPrioritiesSettings::GeneralRecPrioritiesSettings()
     sched->setLabel(QObject::tr("Scheduler Options"));
 
     sched->addChild(GRSchedMoveHigher());
+    sched->addChild(GRSchedInMemoryMatch());
     sched->addChild(GRSchedOpenEnd());
     sched->addChild(GRDefaultStartOffset());
     sched->addChild(GRDefaultEndOffset());
@@ -6,6 +6,7 @@
 
 #include <QCoreApplication>
 #include <QThreadPool>
+#include <QMap>
 
 #include "programinfocache.h"
 #include "programinfo.h"
@@ -25,6 +26,35 @@ static void free_vec(VPI_ptr &v)
     }
 }
 
+/** \class ProgramInfoSnapshot
+ *  \brief The last recording list loaded by any ProgramInfoCache.
+ *
+ *   It outlives the PlaybackBox instances and their caches, so a newly
+ *   opened PlaybackBox only needs to ask the backend what changed since
+ *   this list was loaded, instead of for the whole list again.
+ */
+class ProgramInfoSnapshot
+{
+  public:
+    ProgramInfoSnapshot() : instance(0), generation(0) {}
+
+    void Clear(void)
+    {
+        QMap<QString,ProgramInfo*>::iterator it = list.begin();
+        for (; it != list.end(); ++it)
+            delete *it;
+        list.clear();
+        instance = generation = 0;
+    }
+
+    QMutex                     lock;
+    /// copies of the recordings by ProgramInfo::MakeUniqueKey()
+    QMap<QString,ProgramInfo*> list;
+    uint                       instance;
+    uint                       generation;
+};
+static ProgramInfoSnapshot snapshot;
+
 class ProgramInfoLoader : public QRunnable
 {
   public:
@@ -36,7 +66,8 @@ class ProgramInfoLoader : public QRunnable
 };
 
 ProgramInfoCache::ProgramInfoCache(QObject *o) :
-    m_next_cache(NULL), m_listener(o),
+    m_next_cache(NULL), m_next_updates(NULL),
+    m_instance(0), m_generation(0), m_listener(o),
     m_load_is_queued(false), m_loads_in_progress(0)
 {
 }
@@ -50,6 +81,7 @@ ProgramInfoCache::~ProgramInfoCache()
 
     Clear();
     free_vec(m_next_cache);
+    free_vec(m_next_updates);
 }
 
 void ProgramInfoCache::ScheduleLoad(void)
@@ -64,21 +96,115 @@ void ProgramInfoCache::ScheduleLoad(void)
     }
 }
 
+/** \brief Brings the shared snapshot of the recording list up to date,
+ *         by loading the recordings which changed since it was loaded or
+ *         the whole list when the backend no longer knows those changes.
+ *
+ *  When this cache holds the list the changes apply to, and the result
+ *  of the previous load has been applied by Refresh(), only the changes
+ *  are handed to Refresh(). Otherwise it gets a copy of the whole list.
+ */
 void ProgramInfoCache::Load(void)
 {
     QMutexLocker locker(&m_lock);
     m_load_is_queued = false;
 
+    uint instance   = m_instance;
+    uint generation = m_generation;
+    bool pending    = m_next_cache || m_next_updates;
+
     locker.unlock();
     /**/
-    // the param to RemoteGetRecordedList doesn't actually matter
-    // we sort the list later anyway.
-    vector<ProgramInfo*> *tmp = RemoteGetRecordedList(false);
+    QMutexLocker snapshot_locker(&snapshot.lock);
+
+    bool in_step = instance && !pending &&
+        (instance == snapshot.instance) && (generation == snapshot.generation);
+
+    vector<ProgramInfo*> *updates = NULL;
+    QStringList deletes;
+    if (snapshot.instance)
+    {
+        updates = new vector<ProgramInfo*>;
+        if (RemoteGetRecordingChanges(snapshot.instance, snapshot.generation,
+                                      *updates, deletes))
+        {
+            QStringList::const_iterator dit = deletes.begin();
+            for (; dit != deletes.end(); ++dit)
+                delete snapshot.list.take(*dit);
+
+            vector<ProgramInfo*>::const_iterator uit = updates->begin();
+            for (; uit != updates->end(); ++uit)
+            {
+                if (!(*uit)->GetChanID())
+                    continue;
+                QString key = (*uit)->MakeUniqueKey();
+                delete snapshot.list.take(key);
+                snapshot.list[key] = new ProgramInfo(**uit);
+            }
+        }
+        else
+        {
+            free_vec(updates);
+            deletes.clear();
+        }
+    }
+
+    bool loaded = true;
+    if (!updates)
+    {
+        // the param to RemoteGetRecordedList doesn't actually matter
+        // we sort the list later anyway.
+        vector<ProgramInfo*> *list = RemoteGetRecordedList(
+            false, snapshot.instance, snapshot.generation);
+
+        uint list_instance   = snapshot.instance;
+        uint list_generation = snapshot.generation;
+        snapshot.Clear();
+
+        loaded = (list != NULL);
+        if (list)
+        {
+            vector<ProgramInfo*>::iterator it = list->begin();
+            for (; it != list->end(); ++it)
+            {
+                QString key = (*it)->MakeUniqueKey();
+                delete snapshot.list.take(key);
+                snapshot.list[key] = *it;
+            }
+            delete list;
+            snapshot.instance   = list_instance;
+            snapshot.generation = list_generation;
+        }
+    }
+
+    vector<ProgramInfo*> *tmp = NULL;
+    if (loaded && (!updates || !in_step))
+    {
+        free_vec(updates);
+        deletes.clear();
+
+        tmp = new vector<ProgramInfo*>;
+        tmp->reserve(snapshot.list.size());
+        QMap<QString,ProgramInfo*>::const_iterator it = snapshot.list.begin();
+        for (; it != snapshot.list.end(); ++it)
+            tmp->push_back(new ProgramInfo(**it));
+    }
+
+    instance   = snapshot.instance;
+    generation = snapshot.generation;
+
+    snapshot_locker.unlock();
     /**/
     locker.relock();
 
     free_vec(m_next_cache);
-    m_next_cache = tmp;
+    free_vec(m_next_updates);
+    m_next_deletes.clear();
+    m_next_cache   = tmp;
+    m_next_updates = updates;
+    m_next_deletes = deletes;
+    m_instance     = instance;
+    m_generation   = generation;
 
     QCoreApplication::postEvent(
         m_listener, new MythEvent("UPDATE_UI_LIST"));
@@ -102,9 +228,9 @@ void ProgramInfoCache::WaitForLoadToComplete(void) const
 
 /** \brief Refreshed the cache.
  *  
- *  If a new list has been loaded this fills the cache with that list
- *  if not, this simply removes list items marked for deletion from the
- *  the list.
+ *  If a new list has been loaded this fills the cache with that list,
+ *  if only the changes to the list have been loaded they are applied.
+ *  Then list items marked for deletion are removed from the list.
  *
  *  \note This must only be called from the UI thread.
  *  \note All references to the ProgramInfo pointers should be cleared
@@ -129,6 +255,46 @@ void ProgramInfoCache::Refresh(void)
         m_next_cache = NULL;
         return;
     }
+
+    if (m_next_updates)
+    {
+        QStringList::const_iterator dit = m_next_deletes.begin();
+        for (; dit != m_next_deletes.end(); ++dit)
+        {
+            uint      chanid;
+            QDateTime recstartts;
+            if (!ProgramInfo::ExtractKey(*dit, chanid, recstartts))
+                continue;
+
+            Cache::iterator it = m_cache.find(PICKey(chanid, recstartts));
+            if (it != m_cache.end())
+                it->second->SetAvailableStatus(asDeleted, "PIC::Refresh");
+        }
+        m_next_deletes.clear();
+
+        vector<ProgramInfo*>::iterator uit = m_next_updates->begin();
+        for (; uit != m_next_updates->end(); ++uit)
+        {
+            if (!(*uit)->GetChanID())
+            {
+                delete *uit;
+                continue;
+            }
+
+            PICKey k((*uit)->GetChanID(), (*uit)->GetRecordingStartTime());
+            Cache::iterator it = m_cache.find(k);
+            if (it == m_cache.end())
+            {
+                m_cache[k] = *uit;
+                continue;
+            }
+
+            it->second->clone(**uit, true);
+            delete *uit;
+        }
+        delete m_next_updates;
+        m_next_updates = NULL;
+    }
     locker.unlock();
 
     Cache::iterator it = m_cache.begin();
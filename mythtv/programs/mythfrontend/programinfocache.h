@@ -13,6 +13,7 @@ using namespace std;
 
 // Qt headers
 #include <QWaitCondition>
+#include <QStringList>
 #include <QDateTime>
 #include <QMutex>
 
@@ -73,6 +74,13 @@ class ProgramInfoCache
     mutable QMutex          m_lock;
     Cache                   m_cache;
     vector<ProgramInfo*>   *m_next_cache;
+    /// added and updated recordings to apply on the next Refresh()
+    vector<ProgramInfo*>   *m_next_updates;
+    /// keys of deleted recordings to apply on the next Refresh()
+    QStringList             m_next_deletes;
+    /// backend instance and list generation of the last load, 0 if unknown
+    uint                    m_instance;
+    uint                    m_generation;
     QObject                *m_listener;
     bool                    m_load_is_queued;
     uint                    m_loads_in_progress;
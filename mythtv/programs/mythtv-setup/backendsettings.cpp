@@ -139,6 +139,19 @@ static HostCheckBox *TruncateDeletes()
     return hc;
 };
 
+static HostLineEdit *DirectIOStorageGroups()
+{
+    HostLineEdit *he = new HostLineEdit("DirectIOStorageGroups");
+    he->setLabel(QObject::tr("Direct I/O storage groups"));
+    he->setValue("");
+    he->setHelpText(QObject::tr("Comma separated list of storage groups "
+                    "whose recordings are written with direct I/O on this "
+                    "backend. This bypasses the page cache, which helps "
+                    "when recording many streams at once, but it is not "
+                    "supported by every filesystem."));
+    return he;
+};
+
 static GlobalCheckBox *DeletesFollowLinks()
 {
     GlobalCheckBox *gc = new GlobalCheckBox("DeletesFollowLinks");
@@ -606,6 +619,20 @@ static GlobalCheckBox *AutoCommflagWhileRecording()
     return gc;
 };
 
+static GlobalCheckBox *AutoCommflagInRecorder()
+{
+    GlobalCheckBox *gc = new GlobalCheckBox("AutoCommflagInRecorder");
+    gc->setLabel(QObject::tr("Detect commercials in the recorder"));
+    gc->setValue(false);
+    gc->setHelpText(QObject::tr("If enabled, and Auto Commercial Detection is "
+                                "ON for a recording, digital recorders detect "
+                                "commercials from blank frames and silence "
+                                "while recording instead of running a "
+                                "commercial detection job. A job is still run "
+                                "if this fails."));
+    return gc;
+};
+
 static GlobalLineEdit *UserJob(uint job_num)
 {
     GlobalLineEdit *gc = new GlobalLineEdit(QString("UserJob%1").arg(job_num));
@@ -1007,6 +1034,7 @@ BackendSettings::BackendSettings() {
     fmh1->addChild(TruncateDeletes());
     fm->addChild(fmh1);
     fm->addChild(HDRingbufferSize());
+    fm->addChild(DirectIOStorageGroups());
     fm->addChild(StorageScheduler());
     group2->addChild(fm);
     group2->addChild(MiscStatusScript());
@@ -1087,6 +1115,7 @@ BackendSettings::BackendSettings() {
     group6->setLabel(QObject::tr("Job Queue (Global)"));
     group6->addChild(JobsRunOnRecordHost());
     group6->addChild(AutoCommflagWhileRecording());
+    group6->addChild(AutoCommflagInRecorder());
     group6->addChild(JobQueueCommFlagCommand());
     group6->addChild(JobQueueTranscodeCommand());
     group6->addChild(AutoTranscodeBeforeAutoCommflag());